@@ -0,0 +1,39 @@
+/*
+  Copyright (C) 2019-2021 OpenBikeSensor Contributors
+  Contact: https://openbikesensor.org
+
+  This file is part of the OpenBikeSensor project.
+
+  The OpenBikeSensor sensor firmware is free software: you can redistribute
+  it and/or modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the License,
+  or (at your option) any later version.
+
+  The OpenBikeSensor sensor firmware is distributed in the hope that it will
+  be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+  Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with
+  the OpenBikeSensor sensor firmware.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef OBS_SIM_ADAFRUIT_BMP280_H
+#define OBS_SIM_ADAFRUIT_BMP280_H
+
+#include "Wire.h"
+
+#define BMP280_ADDRESS (0x77)
+#define BMP280_ADDRESS_ALT (0x76)
+#define BMP280_CHIPID (0x58)
+
+/* Reports the ambient temperature of the simulation. */
+class Adafruit_BMP280 {
+  public:
+    explicit Adafruit_BMP280(TwoWire *theWire = &Wire) {}
+    bool begin(uint8_t addr = BMP280_ADDRESS, uint8_t chipid = BMP280_CHIPID) { return true; }
+    float readTemperature() { return (float) sim::ambientTemperature(); }
+    float readPressure() { return 101325.0f; }
+    float readAltitude(float seaLevelhPa = 1013.25f) { return 0.0f; }
+};
+
+#endif //OBS_SIM_ADAFRUIT_BMP280_H
@@ -0,0 +1,106 @@
+/*
+  Copyright (C) 2019-2021 OpenBikeSensor Contributors
+  Contact: https://openbikesensor.org
+
+  This file is part of the OpenBikeSensor project.
+
+  The OpenBikeSensor sensor firmware is free software: you can redistribute
+  it and/or modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the License,
+  or (at your option) any later version.
+
+  The OpenBikeSensor sensor firmware is distributed in the hope that it will
+  be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+  Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with
+  the OpenBikeSensor sensor firmware.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "Arduino.h"
+#include "FunctionalInterrupt.h"
+
+#include <cstdlib>
+
+EspClass ESP;
+
+unsigned long micros() {
+  return (unsigned long) (uint32_t) sim::micros();
+}
+
+unsigned long millis() {
+  return (unsigned long) (uint32_t) (sim::micros() / 1000);
+}
+
+int64_t esp_timer_get_time() {
+  return (int64_t) sim::micros();
+}
+
+void delay(uint32_t ms) {
+  sim::advance((uint64_t) ms * 1000);
+}
+
+void delayMicroseconds(uint32_t us) {
+  sim::advance(us);
+}
+
+void yield() {
+  sim::advance(sim::costs().yieldMicros);
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  sim::core::pinMode(pin, mode);
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+  sim::core::digitalWrite(pin, val);
+}
+
+int digitalRead(uint8_t pin) {
+  return sim::pinLevel(pin);
+}
+
+uint16_t analogRead(uint8_t pin) {
+  sim::consume(sim::costs().adcReadMicros);
+  return sim::analogValue(pin);
+}
+
+void attachInterrupt(uint8_t pin, void (*handler)(void), int mode) {
+  sim::core::attachInterrupt(pin, handler, mode);
+}
+
+void attachInterrupt(uint8_t pin, std::function<void(void)> intRoutine, int mode) {
+  sim::core::attachInterrupt(pin, std::move(intRoutine), mode);
+}
+
+void detachInterrupt(uint8_t pin) {
+  sim::core::detachInterrupt(pin);
+}
+
+long random(long max) {
+  return max > 0 ? (long) (sim::core::random() % (uint32_t) max) : 0;
+}
+
+long random(long min, long max) {
+  return min < max ? min + random(max - min) : min;
+}
+
+void randomSeed(unsigned long seed) {
+  // the simulation stays deterministic
+}
+
+/* There is no useful heap metric on the host, the values are typical for
+ * the firmware with BLE active.
+ */
+uint32_t EspClass::getFreeHeap() {
+  return 112 * 1024;
+}
+
+uint32_t EspClass::getMinFreeHeap() {
+  return 98 * 1024;
+}
+
+void EspClass::restart() {
+  log_e("ESP.restart() called, simulation ends.");
+  exit(0);
+}
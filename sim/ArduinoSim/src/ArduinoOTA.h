@@ -0,0 +1,57 @@
+/*
+  Copyright (C) 2019-2021 OpenBikeSensor Contributors
+  Contact: https://openbikesensor.org
+
+  This file is part of the OpenBikeSensor project.
+
+  The OpenBikeSensor sensor firmware is free software: you can redistribute
+  it and/or modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the License,
+  or (at your option) any later version.
+
+  The OpenBikeSensor sensor firmware is distributed in the hope that it will
+  be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+  Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with
+  the OpenBikeSensor sensor firmware.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef OBS_SIM_ARDUINOOTA_H
+#define OBS_SIM_ARDUINOOTA_H
+
+#include <functional>
+
+#include "WiFi.h"
+#include "Update.h"
+
+typedef enum {
+  OTA_AUTH_ERROR,
+  OTA_BEGIN_ERROR,
+  OTA_CONNECT_ERROR,
+  OTA_RECEIVE_ERROR,
+  OTA_END_ERROR
+} ota_error_t;
+
+class ArduinoOTAClass {
+  public:
+    typedef std::function<void(void)> THandlerFunction;
+    typedef std::function<void(ota_error_t)> THandlerFunction_Error;
+    typedef std::function<void(unsigned int, unsigned int)> THandlerFunction_Progress;
+
+    ArduinoOTAClass &setPort(uint16_t port) { return *this; }
+    ArduinoOTAClass &setHostname(const char *hostname) { return *this; }
+    ArduinoOTAClass &setPassword(const char *password) { return *this; }
+    ArduinoOTAClass &setPasswordHash(const char *password) { return *this; }
+    ArduinoOTAClass &onStart(THandlerFunction fn) { return *this; }
+    ArduinoOTAClass &onEnd(THandlerFunction fn) { return *this; }
+    ArduinoOTAClass &onError(THandlerFunction_Error fn) { return *this; }
+    ArduinoOTAClass &onProgress(THandlerFunction_Progress fn) { return *this; }
+    void begin() {}
+    void handle() {}
+    int getCommand() { return U_FLASH; }
+};
+
+extern ArduinoOTAClass ArduinoOTA;
+
+#endif //OBS_SIM_ARDUINOOTA_H
@@ -0,0 +1,2 @@
+/* The BLE stand-ins all live in one header. */
+#include "BLEDevice.h"
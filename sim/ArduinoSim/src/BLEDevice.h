@@ -0,0 +1,204 @@
+/*
+  Copyright (C) 2019-2021 OpenBikeSensor Contributors
+  Contact: https://openbikesensor.org
+
+  This file is part of the OpenBikeSensor project.
+
+  The OpenBikeSensor sensor firmware is free software: you can redistribute
+  it and/or modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the License,
+  or (at your option) any later version.
+
+  The OpenBikeSensor sensor firmware is distributed in the hope that it will
+  be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+  Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with
+  the OpenBikeSensor sensor firmware.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef OBS_SIM_BLEDEVICE_H
+#define OBS_SIM_BLEDEVICE_H
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "Arduino.h"
+#include "esp_bt.h"
+
+/* BLE is not simulated, the classes keep the values set by the firmware
+ * so they can be inspected but nothing is ever sent.
+ */
+
+#define ESP_GATT_UUID_CHAR_DESCRIPTION 0x2901
+#define ESP_GATT_UUID_HEART_RATE_SVC 0x180D
+#define ESP_GATT_HEART_RATE_MEAS 0x2A37
+#define ESP_GATT_PERM_READ (1 << 0)
+#define ESP_GATT_PERM_WRITE (1 << 4)
+
+class BLEUUID {
+  public:
+    BLEUUID() = default;
+    explicit BLEUUID(uint16_t uuid) {
+      char buffer[8];
+      snprintf(buffer, sizeof(buffer), "%04x", uuid);
+      mValue = buffer;
+    }
+    explicit BLEUUID(const std::string &uuid) : mValue(uuid) {}
+    explicit BLEUUID(const char *uuid) : mValue(uuid) {}
+    BLEUUID(uint8_t *pData, size_t size, bool msbFirst) {
+      static const uint8_t dashesAfter[] = {3, 5, 7, 9};
+      char buffer[3];
+      for (size_t i = 0; i < size; ++i) {
+        snprintf(buffer, sizeof(buffer), "%02x", pData[msbFirst ? i : size - 1 - i]);
+        mValue += buffer;
+        if (size == 16 && std::find(dashesAfter, dashesAfter + 4, i) != dashesAfter + 4) {
+          mValue += '-';
+        }
+      }
+    }
+    bool equals(const BLEUUID &other) const { return mValue == other.mValue; }
+    std::string toString() const { return mValue; }
+
+  private:
+    std::string mValue;
+};
+
+class BLEValue {
+  public:
+    void setValue(const std::string &value) { mValue = value; }
+    void setValue(const uint8_t *data, size_t length) { mValue.assign((const char *) data, length); }
+    std::string getValue() const { return mValue; }
+
+  private:
+    std::string mValue;
+};
+
+class BLEDescriptor {
+  public:
+    BLEDescriptor(BLEUUID uuid, uint16_t maxLen = 100) : mUuid(uuid) {}
+    BLEDescriptor(const char *uuid, uint16_t maxLen = 100) : mUuid(uuid) {}
+    virtual ~BLEDescriptor() = default;
+    void setValue(const std::string &value) { mValue.setValue(value); }
+    void setValue(const uint8_t *data, size_t length) { mValue.setValue(data, length); }
+    void setAccessPermissions(uint16_t perm) {}
+    BLEUUID getUUID() const { return mUuid; }
+
+  private:
+    BLEUUID mUuid;
+    BLEValue mValue;
+};
+
+class BLE2902 : public BLEDescriptor {
+  public:
+    BLE2902() : BLEDescriptor(BLEUUID((uint16_t) 0x2902)) {}
+};
+
+class BLECharacteristic;
+
+class BLECharacteristicCallbacks {
+  public:
+    virtual ~BLECharacteristicCallbacks() = default;
+    virtual void onRead(BLECharacteristic *pCharacteristic) {}
+    virtual void onWrite(BLECharacteristic *pCharacteristic) {}
+};
+
+class BLECharacteristic {
+  public:
+    static const uint32_t PROPERTY_READ = 1 << 0;
+    static const uint32_t PROPERTY_WRITE = 1 << 1;
+    static const uint32_t PROPERTY_NOTIFY = 1 << 2;
+    static const uint32_t PROPERTY_BROADCAST = 1 << 3;
+    static const uint32_t PROPERTY_INDICATE = 1 << 4;
+    static const uint32_t PROPERTY_WRITE_NR = 1 << 5;
+
+    BLECharacteristic(BLEUUID uuid, uint32_t properties = 0) : mUuid(uuid), mProperties(properties) {}
+    BLECharacteristic(const char *uuid, uint32_t properties = 0) : mUuid(uuid), mProperties(properties) {}
+    virtual ~BLECharacteristic() = default;
+
+    void addDescriptor(BLEDescriptor *descriptor) { mDescriptors.push_back(descriptor); }
+    void setCallbacks(BLECharacteristicCallbacks *callbacks) { mCallbacks = callbacks; }
+    void setValue(const std::string &value) { mValue.setValue(value); }
+    void setValue(const uint8_t *data, size_t length) { mValue.setValue(data, length); }
+    void setValue(uint16_t &data16) { setValue((const uint8_t *) &data16, sizeof(data16)); }
+    void setValue(uint32_t &data32) { setValue((const uint8_t *) &data32, sizeof(data32)); }
+    void setValue(int &data32) { setValue((const uint8_t *) &data32, sizeof(data32)); }
+    void setValue(float &data) { setValue((const uint8_t *) &data, sizeof(data)); }
+    void setValue(double &data) { setValue((const uint8_t *) &data, sizeof(data)); }
+    std::string getValue() const { return mValue.getValue(); }
+    void notify(bool is_notification = true) { sim::statistics().bleNotifications++; }
+    void indicate() {}
+    BLEUUID getUUID() const { return mUuid; }
+
+  private:
+    BLEUUID mUuid;
+    uint32_t mProperties;
+    BLEValue mValue;
+    BLECharacteristicCallbacks *mCallbacks = nullptr;
+    std::vector<BLEDescriptor *> mDescriptors;
+};
+
+class BLEService {
+  public:
+    explicit BLEService(BLEUUID uuid) : mUuid(uuid) {}
+    BLECharacteristic *createCharacteristic(const char *uuid, uint32_t properties) {
+      return createCharacteristic(BLEUUID(uuid), properties);
+    }
+    BLECharacteristic *createCharacteristic(BLEUUID uuid, uint32_t properties) {
+      BLECharacteristic *characteristic = new BLECharacteristic(uuid, properties);
+      addCharacteristic(characteristic);
+      return characteristic;
+    }
+    void addCharacteristic(BLECharacteristic *characteristic) { mCharacteristics.push_back(characteristic); }
+    void start() {}
+    void stop() {}
+    BLEUUID getUUID() const { return mUuid; }
+
+  private:
+    BLEUUID mUuid;
+    std::vector<BLECharacteristic *> mCharacteristics;
+};
+
+class BLEAdvertising {
+  public:
+    void addServiceUUID(BLEUUID serviceUUID) {}
+    void addServiceUUID(const char *serviceUUID) {}
+    void start() {}
+    void stop() {}
+};
+
+class BLEServer;
+
+class BLEServerCallbacks {
+  public:
+    virtual ~BLEServerCallbacks() = default;
+    virtual void onConnect(BLEServer *pServer) {}
+    virtual void onDisconnect(BLEServer *pServer) {}
+};
+
+class BLEServer {
+  public:
+    BLEService *createService(const char *uuid) { return createService(BLEUUID(uuid)); }
+    BLEService *createService(BLEUUID uuid, uint32_t numHandles = 15, uint8_t inst_id = 0) {
+      return new BLEService(uuid);
+    }
+    BLEAdvertising *getAdvertising() { return &mAdvertising; }
+    void setCallbacks(BLEServerCallbacks *callbacks) { mCallbacks = callbacks; }
+    uint16_t getConnId() { return 0; }
+    uint32_t getConnectedCount() { return 0; }
+    void disconnect(uint16_t connId) {}
+
+  private:
+    BLEAdvertising mAdvertising;
+    BLEServerCallbacks *mCallbacks = nullptr;
+};
+
+class BLEDevice {
+  public:
+    static void init(const std::string &deviceName) {}
+    static BLEServer *createServer() { return new BLEServer(); }
+    static void deinit(bool release_memory = false) {}
+};
+
+#endif //OBS_SIM_BLEDEVICE_H
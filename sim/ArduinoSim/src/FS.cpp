@@ -0,0 +1,439 @@
+/*
+  Copyright (C) 2019-2021 OpenBikeSensor Contributors
+  Contact: https://openbikesensor.org
+
+  This file is part of the OpenBikeSensor project.
+
+  The OpenBikeSensor sensor firmware is free software: you can redistribute
+  it and/or modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the License,
+  or (at your option) any later version.
+
+  The OpenBikeSensor sensor firmware is distributed in the hope that it will
+  be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+  Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with
+  the OpenBikeSensor sensor firmware.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "FS.h"
+#include "SD.h"
+#include "SPIFFS.h"
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace fs {
+
+  struct Node {
+    std::vector<uint8_t> data;
+    time_t lastWrite = 0;
+    /* Size at the last flush() or close(), what survives a power loss. */
+    size_t synced = 0;
+  };
+
+  class FileSystem {
+    public:
+      FileSystem(bool chargeTime, uint64_t capacity) : chargeTime(chargeTime), capacity(capacity) {
+        clear();
+      }
+
+      void clear() {
+        files.clear();
+        directories.clear();
+        directories.insert("/");
+        mounted = false;
+        transferredBytes = 0;
+      }
+
+      static std::string normalize(const char *path) {
+        std::string result(path ? path : "");
+        if (result.empty() || result[0] != '/') {
+          result.insert(0, "/");
+        }
+        while (result.size() > 1 && result.back() == '/') {
+          result.pop_back();
+        }
+        return result;
+      }
+
+      static std::string parent(const std::string &path) {
+        const std::string::size_type pos = path.rfind('/');
+        return pos == 0 ? "/" : path.substr(0, pos);
+      }
+
+      /* Charges the time it takes to transfer the bytes to or from the card. */
+      void transfer(size_t bytes) {
+        if (!chargeTime) {
+          return;
+        }
+        const uint64_t perKiB = sim::costs().sdMicrosPerKiB;
+        const uint64_t before = transferredBytes * perKiB / 1024;
+        transferredBytes += bytes;
+        sim::consume(transferredBytes * perKiB / 1024 - before);
+      }
+
+      void charge(uint32_t micros) {
+        if (chargeTime) {
+          sim::consume(micros);
+        }
+      }
+
+      uint64_t used() const {
+        uint64_t result = 0;
+        for (const auto &file : files) {
+          result += file.second->data.size();
+        }
+        return result;
+      }
+
+      const bool chargeTime;
+      const uint64_t capacity;
+      bool mounted = false;
+      uint64_t transferredBytes = 0;
+      std::map<std::string, std::shared_ptr<Node>> files;
+      std::set<std::string> directories;
+  };
+
+  class FileImpl {
+    public:
+      FileSystem *fileSystem = nullptr;
+      std::string path;
+      std::shared_ptr<Node> node;
+      bool directory = false;
+      bool open = false;
+      bool readable = false;
+      bool writable = false;
+      bool append = false;
+      size_t pos = 0;
+      uint64_t openedAt = 0;
+      std::vector<std::string> entries;
+      size_t nextEntry = 0;
+  };
+
+  FileSystem *createFileSystem(bool chargeTime, uint64_t capacity) {
+    return new FileSystem(chargeTime, capacity);
+  }
+
+  bool mount(FileSystem *fileSystem) {
+    fileSystem->mounted = true;
+    return true;
+  }
+
+  void unmount(FileSystem *fileSystem) {
+    fileSystem->mounted = false;
+  }
+
+  uint64_t usedBytes(FileSystem *fileSystem) {
+    return fileSystem->used();
+  }
+
+  uint64_t totalBytes(FileSystem *fileSystem) {
+    return fileSystem->capacity;
+  }
+
+  void clear(FileSystem *fileSystem) {
+    const bool mounted = fileSystem->mounted;
+    fileSystem->clear();
+    fileSystem->mounted = mounted;
+  }
+
+  size_t File::write(uint8_t c) {
+    return write(&c, 1);
+  }
+
+  size_t File::write(const uint8_t *buf, size_t size) {
+    sim::core::Internal internal;
+    if (!mImpl || !mImpl->open || !mImpl->writable || mImpl->directory) {
+      return 0;
+    }
+    FileSystem *fileSystem = mImpl->fileSystem;
+    if (fileSystem->used() + size > fileSystem->capacity) {
+      return 0;
+    }
+    std::vector<uint8_t> &data = mImpl->node->data;
+    if (mImpl->append) {
+      mImpl->pos = data.size();
+    }
+    if (mImpl->pos + size > data.size()) {
+      data.resize(mImpl->pos + size);
+    }
+    std::copy(buf, buf + size, data.begin() + mImpl->pos);
+    mImpl->pos += size;
+    mImpl->node->lastWrite = sim::core::deviceTime(nullptr);
+    const uint64_t start = sim::micros();
+    fileSystem->transfer(size);
+    if (fileSystem->chargeTime) {
+      sim::Statistics &statistics = sim::statistics();
+      statistics.sdBytesWritten += size;
+      statistics.sdMaxWriteMicros = std::max(statistics.sdMaxWriteMicros, sim::micros() - start);
+    }
+    return size;
+  }
+
+  int File::available() {
+    if (!mImpl || !mImpl->open || !mImpl->readable || mImpl->directory) {
+      return 0;
+    }
+    return (int) (mImpl->node->data.size() - std::min(mImpl->pos, mImpl->node->data.size()));
+  }
+
+  int File::read() {
+    uint8_t c;
+    return read(&c, 1) == 1 ? c : -1;
+  }
+
+  int File::peek() {
+    if (available() <= 0) {
+      return -1;
+    }
+    return mImpl->node->data[mImpl->pos];
+  }
+
+  size_t File::read(uint8_t *buf, size_t size) {
+    const size_t count = std::min(size, (size_t) available());
+    if (count == 0) {
+      return 0;
+    }
+    const std::vector<uint8_t> &data = mImpl->node->data;
+    std::copy(data.begin() + mImpl->pos, data.begin() + mImpl->pos + count, buf);
+    mImpl->pos += count;
+    mImpl->fileSystem->transfer(count);
+    return count;
+  }
+
+  void File::flush() {
+    if (mImpl && mImpl->open && mImpl->writable) {
+      const uint64_t start = sim::micros();
+      mImpl->fileSystem->charge(sim::costs().sdCloseMicros);
+      mImpl->node->synced = mImpl->node->data.size();
+      if (mImpl->fileSystem->chargeTime) {
+        sim::Statistics &statistics = sim::statistics();
+        statistics.sdMaxWriteMicros = std::max(statistics.sdMaxWriteMicros, sim::micros() - start);
+      }
+    }
+  }
+
+  bool File::seek(uint32_t pos, SeekMode mode) {
+    if (!mImpl || !mImpl->open || mImpl->directory) {
+      return false;
+    }
+    const size_t size = mImpl->node->data.size();
+    size_t target = pos;
+    if (mode == SeekCur) {
+      target = mImpl->pos + pos;
+    } else if (mode == SeekEnd) {
+      target = size - std::min((size_t) pos, size);
+    }
+    if (target > size) {
+      return false;
+    }
+    mImpl->pos = target;
+    return true;
+  }
+
+  size_t File::position() const {
+    return mImpl && mImpl->open ? mImpl->pos : 0;
+  }
+
+  size_t File::size() const {
+    return mImpl && mImpl->open && !mImpl->directory ? mImpl->node->data.size() : 0;
+  }
+
+  void File::close() {
+    if (!mImpl || !mImpl->open) {
+      return;
+    }
+    mImpl->open = false;
+    if (mImpl->writable) {
+      mImpl->node->synced = mImpl->node->data.size();
+    }
+    if (mImpl->writable && mImpl->fileSystem->chargeTime) {
+      mImpl->fileSystem->charge(sim::costs().sdCloseMicros);
+      sim::Statistics &statistics = sim::statistics();
+      const uint64_t session = sim::micros() - mImpl->openedAt;
+      statistics.sdWriteSessionMicros += session;
+      if (session > statistics.sdMaxWriteSessionMicros) {
+        statistics.sdMaxWriteSessionMicros = session;
+      }
+    }
+  }
+
+  File::operator bool() const {
+    return mImpl && mImpl->open;
+  }
+
+  time_t File::getLastWrite() {
+    return mImpl && mImpl->node ? mImpl->node->lastWrite : 0;
+  }
+
+  const char *File::name() const {
+    return mImpl ? mImpl->path.c_str() : "";
+  }
+
+  bool File::isDirectory() {
+    return mImpl && mImpl->open && mImpl->directory;
+  }
+
+  File File::openNextFile(const char *mode) {
+    if (!isDirectory() || mImpl->nextEntry >= mImpl->entries.size()) {
+      return File();
+    }
+    FS fileSystem(mImpl->fileSystem);
+    return fileSystem.open(mImpl->entries[mImpl->nextEntry++].c_str(), mode);
+  }
+
+  void File::rewindDirectory() {
+    if (isDirectory()) {
+      mImpl->nextEntry = 0;
+    }
+  }
+
+  File FS::open(const char *path, const char *mode) {
+    sim::core::Internal internal;
+    FileSystem *fileSystem = mFileSystem;
+    if (!fileSystem->mounted || !mode || !mode[0]) {
+      return File();
+    }
+    const std::string name = FileSystem::normalize(path);
+    const bool plus = mode[1] == '+';
+    std::shared_ptr<FileImpl> impl = std::make_shared<FileImpl>();
+    impl->fileSystem = fileSystem;
+    impl->path = name;
+
+    if (fileSystem->directories.count(name)) {
+      if (mode[0] != 'r') {
+        return File();
+      }
+      impl->directory = true;
+      impl->open = true;
+      const std::string prefix = name == "/" ? "/" : name + "/";
+      for (const auto &file : fileSystem->files) {
+        if (file.first.compare(0, prefix.size(), prefix) == 0
+            && file.first.find('/', prefix.size()) == std::string::npos) {
+          impl->entries.push_back(file.first);
+        }
+      }
+      for (const auto &directory : fileSystem->directories) {
+        if (directory != name && directory.compare(0, prefix.size(), prefix) == 0
+            && directory.find('/', prefix.size()) == std::string::npos) {
+          impl->entries.push_back(directory);
+        }
+      }
+      return File(impl);
+    }
+
+    auto existing = fileSystem->files.find(name);
+    switch (mode[0]) {
+      case 'r':
+        if (existing == fileSystem->files.end()) {
+          return File();
+        }
+        impl->node = existing->second;
+        impl->readable = true;
+        impl->writable = plus;
+        break;
+      case 'w':
+      case 'a':
+        if (!fileSystem->directories.count(FileSystem::parent(name))) {
+          return File();
+        }
+        if (existing == fileSystem->files.end() || mode[0] == 'w') {
+          impl->node = std::make_shared<Node>();
+          impl->node->lastWrite = sim::core::deviceTime(nullptr);
+          fileSystem->files[name] = impl->node;
+        } else {
+          impl->node = existing->second;
+        }
+        impl->writable = true;
+        impl->readable = plus;
+        impl->append = mode[0] == 'a';
+        break;
+      default:
+        return File();
+    }
+    if (fileSystem->chargeTime) {
+      sim::statistics().sdOpens++;
+    }
+    impl->openedAt = sim::micros();
+    fileSystem->charge(sim::costs().sdOpenMicros);
+    impl->open = true;
+    return File(impl);
+  }
+
+  bool FS::exists(const char *path) {
+    const std::string name = FileSystem::normalize(path);
+    return mFileSystem->mounted
+      && (mFileSystem->files.count(name) || mFileSystem->directories.count(name));
+  }
+
+  bool FS::remove(const char *path) {
+    return mFileSystem->mounted && mFileSystem->files.erase(FileSystem::normalize(path)) > 0;
+  }
+
+  bool FS::rename(const char *pathFrom, const char *pathTo) {
+    const std::string from = FileSystem::normalize(pathFrom);
+    const std::string to = FileSystem::normalize(pathTo);
+    auto file = mFileSystem->files.find(from);
+    if (!mFileSystem->mounted || file == mFileSystem->files.end() || exists(pathTo)
+        || !mFileSystem->directories.count(FileSystem::parent(to))) {
+      return false;
+    }
+    std::shared_ptr<Node> node = file->second;
+    mFileSystem->files.erase(file);
+    mFileSystem->files[to] = node;
+    return true;
+  }
+
+  bool FS::mkdir(const char *path) {
+    const std::string name = FileSystem::normalize(path);
+    if (!mFileSystem->mounted || mFileSystem->files.count(name)
+        || !mFileSystem->directories.count(FileSystem::parent(name))) {
+      return false;
+    }
+    mFileSystem->directories.insert(name);
+    return true;
+  }
+
+  bool FS::rmdir(const char *path) {
+    const std::string name = FileSystem::normalize(path);
+    const std::string prefix = name + "/";
+    for (const auto &file : mFileSystem->files) {
+      if (file.first.compare(0, prefix.size(), prefix) == 0) {
+        return false;
+      }
+    }
+    return name != "/" && mFileSystem->directories.erase(name) > 0;
+  }
+}
+
+static fs::FileSystem *sdCard() {
+  static fs::FileSystem *card = fs::createFileSystem(true, 8ULL * 1024 * 1024 * 1024);
+  return card;
+}
+
+static fs::FileSystem *spiffsPartition() {
+  static fs::FileSystem *partition = fs::createFileSystem(false, 1374476);
+  return partition;
+}
+
+fs::SDFS SD(sdCard());
+fs::SPIFFSFS SPIFFS(spiffsPartition());
+
+namespace sim {
+  void loseUnsyncedSdData() {
+    for (auto &file : sdCard()->files) {
+      file.second->data.resize(std::min(file.second->synced, file.second->data.size()));
+    }
+  }
+
+  namespace core {
+    void resetFileSystems() {
+      sdCard()->clear();
+      spiffsPartition()->clear();
+    }
+  }
+}
@@ -0,0 +1,120 @@
+/*
+  Copyright (C) 2019-2021 OpenBikeSensor Contributors
+  Contact: https://openbikesensor.org
+
+  This file is part of the OpenBikeSensor project.
+
+  The OpenBikeSensor sensor firmware is free software: you can redistribute
+  it and/or modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the License,
+  or (at your option) any later version.
+
+  The OpenBikeSensor sensor firmware is distributed in the hope that it will
+  be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+  Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with
+  the OpenBikeSensor sensor firmware.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef OBS_SIM_FS_H
+#define OBS_SIM_FS_H
+
+#include <memory>
+
+#include "Arduino.h"
+
+#define FILE_READ   "r"
+#define FILE_WRITE  "w"
+#define FILE_APPEND "a"
+
+namespace fs {
+
+  enum SeekMode {
+    SeekSet = 0,
+    SeekCur = 1,
+    SeekEnd = 2
+  };
+
+  class FileImpl;
+  class FileSystem;
+
+  /* In memory file of one of the simulated file systems. */
+  class File : public Stream {
+    public:
+      File() = default;
+      explicit File(std::shared_ptr<FileImpl> impl) : mImpl(std::move(impl)) {}
+
+      size_t write(uint8_t c) override;
+      size_t write(const uint8_t *buf, size_t size) override;
+      using Print::write;
+      int available() override;
+      int read() override;
+      int peek() override;
+      void flush() override;
+      size_t read(uint8_t *buf, size_t size);
+      size_t readBytes(char *buffer, size_t length) override {
+        return read((uint8_t *) buffer, length);
+      }
+
+      bool seek(uint32_t pos, SeekMode mode);
+      bool seek(uint32_t pos) { return seek(pos, SeekSet); }
+      size_t position() const;
+      size_t size() const;
+      void close();
+      operator bool() const;
+      time_t getLastWrite();
+      const char *name() const;
+
+      bool isDirectory();
+      File openNextFile(const char *mode = FILE_READ);
+      void rewindDirectory();
+
+    private:
+      std::shared_ptr<FileImpl> mImpl;
+  };
+
+  class FS {
+    public:
+      explicit FS(FileSystem *fileSystem) : mFileSystem(fileSystem) {}
+
+      File open(const char *path, const char *mode = FILE_READ);
+      File open(const String &path, const char *mode = FILE_READ) {
+        return open(path.c_str(), mode);
+      }
+      bool exists(const char *path);
+      bool exists(const String &path) { return exists(path.c_str()); }
+      bool remove(const char *path);
+      bool remove(const String &path) { return remove(path.c_str()); }
+      bool rename(const char *pathFrom, const char *pathTo);
+      bool rename(const String &pathFrom, const String &pathTo) {
+        return rename(pathFrom.c_str(), pathTo.c_str());
+      }
+      bool mkdir(const char *path);
+      bool mkdir(const String &path) { return mkdir(path.c_str()); }
+      bool rmdir(const char *path);
+      bool rmdir(const String &path) { return rmdir(path.c_str()); }
+
+    protected:
+      FileSystem *const mFileSystem;
+  };
+
+  /* Storage behind a FS, the SD card charges the virtual time of the
+   * operations.
+   */
+  FileSystem *createFileSystem(bool chargeTime, uint64_t capacity);
+  bool mount(FileSystem *fileSystem);
+  void unmount(FileSystem *fileSystem);
+  uint64_t usedBytes(FileSystem *fileSystem);
+  uint64_t totalBytes(FileSystem *fileSystem);
+  void clear(FileSystem *fileSystem);
+}
+
+using fs::FS;
+using fs::File;
+using fs::SeekMode;
+using fs::SeekSet;
+using fs::SeekCur;
+using fs::SeekEnd;
+
+#endif //OBS_SIM_FS_H
@@ -0,0 +1,141 @@
+/*
+  Copyright (C) 2019-2021 OpenBikeSensor Contributors
+  Contact: https://openbikesensor.org
+
+  This file is part of the OpenBikeSensor project.
+
+  The OpenBikeSensor sensor firmware is free software: you can redistribute
+  it and/or modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the License,
+  or (at your option) any later version.
+
+  The OpenBikeSensor sensor firmware is distributed in the hope that it will
+  be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+  Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with
+  the OpenBikeSensor sensor firmware.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "freertos/queue.h"
+#include "freertos/task.h"
+
+#include <cassert>
+#include <cstring>
+#include <deque>
+#include <vector>
+
+#include "sim.h"
+
+static uint64_t ticksToMicros(TickType_t ticks) {
+  return ticks == portMAX_DELAY ? UINT64_MAX : (uint64_t) ticks * portTICK_PERIOD_MS * 1000;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t code, const char *name,
+  uint32_t stackDepth, void *parameters, UBaseType_t priority,
+  TaskHandle_t *createdTask, BaseType_t coreId) {
+  TaskHandle_t task = sim::core::createTask([code, parameters]() { code(parameters); }, name);
+  if (createdTask) {
+    *createdTask = task;
+  }
+  return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t code, const char *name,
+  uint32_t stackDepth, void *parameters, UBaseType_t priority,
+  TaskHandle_t *createdTask) {
+  return xTaskCreatePinnedToCore(
+    code, name, stackDepth, parameters, priority, createdTask, tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t task) {
+  assert(task == nullptr || task == sim::core::currentTask());
+  sim::core::endTask();
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+  return sim::core::currentTask();
+}
+
+void vTaskDelay(TickType_t ticks) {
+  sim::advance((uint64_t) ticks * portTICK_PERIOD_MS * 1000);
+}
+
+TickType_t xTaskGetTickCount() {
+  return (TickType_t) (sim::micros() / 1000 / portTICK_PERIOD_MS);
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearCountOnExit, TickType_t ticksToWait) {
+  return sim::core::notifyTake(clearCountOnExit != pdFALSE, ticksToMicros(ticksToWait));
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+  sim::core::notifyGive(task);
+  return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higherPriorityTaskWoken) {
+  sim::core::notifyGive(task);
+  if (higherPriorityTaskWoken) {
+    *higherPriorityTaskWoken = pdFALSE;
+  }
+}
+
+struct SimQueue {
+  size_t length;
+  size_t itemSize;
+  std::deque<std::vector<uint8_t>> items;
+};
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize) {
+  return new SimQueue{length, itemSize, {}};
+}
+
+void vQueueDelete(QueueHandle_t queue) {
+  delete static_cast<SimQueue *>(queue);
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticksToWait) {
+  // the items of the ESP queue are allocated with the queue
+  sim::core::Internal internal;
+  SimQueue *q = static_cast<SimQueue *>(queue);
+  if (!sim::core::waitUntil(
+    [q]() { return q->items.size() < q->length; }, ticksToMicros(ticksToWait))) {
+    return pdFAIL;
+  }
+  const uint8_t *bytes = static_cast<const uint8_t *>(item);
+  q->items.emplace_back(bytes, bytes + q->itemSize);
+  return pdPASS;
+}
+
+BaseType_t xQueueSendFromISR(QueueHandle_t queue, const void *item, BaseType_t *higherPriorityTaskWoken) {
+  if (higherPriorityTaskWoken) {
+    *higherPriorityTaskWoken = pdFALSE;
+  }
+  return xQueueSend(queue, item, 0);
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *buffer, TickType_t ticksToWait) {
+  sim::core::Internal internal;
+  SimQueue *q = static_cast<SimQueue *>(queue);
+  if (!sim::core::waitUntil([q]() { return !q->items.empty(); }, ticksToMicros(ticksToWait))) {
+    return pdFAIL;
+  }
+  memcpy(buffer, q->items.front().data(), q->itemSize);
+  q->items.pop_front();
+  return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) {
+  return (UBaseType_t) static_cast<SimQueue *>(queue)->items.size();
+}
+
+UBaseType_t uxQueueSpacesAvailable(QueueHandle_t queue) {
+  SimQueue *q = static_cast<SimQueue *>(queue);
+  return (UBaseType_t) (q->length - q->items.size());
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue) {
+  static_cast<SimQueue *>(queue)->items.clear();
+  return pdPASS;
+}
@@ -0,0 +1,50 @@
+/*
+  Copyright (C) 2019-2021 OpenBikeSensor Contributors
+  Contact: https://openbikesensor.org
+
+  This file is part of the OpenBikeSensor project.
+
+  The OpenBikeSensor sensor firmware is free software: you can redistribute
+  it and/or modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the License,
+  or (at your option) any later version.
+
+  The OpenBikeSensor sensor firmware is distributed in the hope that it will
+  be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+  Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with
+  the OpenBikeSensor sensor firmware.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "HardwareSerial.h"
+
+#include "sim.h"
+
+HardwareSerial Serial(0);
+
+void HardwareSerial::begin(unsigned long baud, uint32_t config, int8_t rxPin, int8_t txPin,
+                           bool invert, unsigned long timeoutMs) {
+  sim::core::uartBegin(mUartNr, (uint32_t) baud);
+}
+
+int HardwareSerial::available() {
+  return sim::core::uartAvailable(mUartNr);
+}
+
+int HardwareSerial::read() {
+  return sim::core::uartRead(mUartNr);
+}
+
+int HardwareSerial::peek() {
+  return sim::core::uartPeek(mUartNr);
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+  return write(&c, 1);
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size) {
+  sim::core::uartWrite(mUartNr, buffer, size);
+  return size;
+}
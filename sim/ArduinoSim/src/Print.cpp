@@ -0,0 +1,111 @@
+/*
+  Copyright (C) 2019-2021 OpenBikeSensor Contributors
+  Contact: https://openbikesensor.org
+
+  This file is part of the OpenBikeSensor project.
+
+  The OpenBikeSensor sensor firmware is free software: you can redistribute
+  it and/or modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the License,
+  or (at your option) any later version.
+
+  The OpenBikeSensor sensor firmware is distributed in the hope that it will
+  be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+  Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with
+  the OpenBikeSensor sensor firmware.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "Print.h"
+
+#include <cstdarg>
+#include <cstdio>
+#include <vector>
+
+size_t Print::write(const uint8_t *buffer, size_t size) {
+  size_t n = 0;
+  while (size--) {
+    n += write(*buffer++);
+  }
+  return n;
+}
+
+/* As the ESP32 core, only output longer than 64 bytes takes heap. */
+size_t Print::printf(const char *format, ...) {
+  char stackBuffer[64];
+  va_list args;
+  va_start(args, format);
+  va_list copy;
+  va_copy(copy, args);
+  const int length = vsnprintf(stackBuffer, sizeof(stackBuffer), format, copy);
+  va_end(copy);
+  if (length < 0) {
+    va_end(args);
+    return 0;
+  }
+  if ((size_t) length < sizeof(stackBuffer)) {
+    va_end(args);
+    return write((const uint8_t *) stackBuffer, (size_t) length);
+  }
+  std::vector<char> buffer(length + 1);
+  vsnprintf(buffer.data(), buffer.size(), format, args);
+  va_end(args);
+  return write((const uint8_t *) buffer.data(), (size_t) length);
+}
+
+size_t Print::print(const __FlashStringHelper *str) {
+  return print(reinterpret_cast<const char *>(str));
+}
+
+size_t Print::print(const String &str) {
+  return write((const uint8_t *) str.c_str(), str.length());
+}
+
+size_t Print::print(const char *str) {
+  return write(str);
+}
+
+size_t Print::print(char c) {
+  return write((uint8_t) c);
+}
+
+size_t Print::print(unsigned char value, int base) {
+  return print(String(value, (unsigned char) base));
+}
+
+size_t Print::print(int value, int base) {
+  return print(String(value, (unsigned char) base));
+}
+
+size_t Print::print(unsigned int value, int base) {
+  return print(String(value, (unsigned char) base));
+}
+
+size_t Print::print(long value, int base) {
+  return print(String(value, (unsigned char) base));
+}
+
+size_t Print::print(unsigned long value, int base) {
+  return print(String(value, (unsigned char) base));
+}
+
+size_t Print::print(long long value, int base) {
+  return print(String(value, (unsigned char) base));
+}
+
+size_t Print::print(unsigned long long value, int base) {
+  return print(String(value, (unsigned char) base));
+}
+
+size_t Print::print(double value, int digits) {
+  return print(String(value, (unsigned char) digits));
+}
+
+size_t Print::print(const Printable &printable) {
+  return printable.printTo(*this);
+}
+
+size_t Print::println() {
+  return write("\r\n");
+}
@@ -1,5 +1,5 @@
 /*
-  Copyright (C) 2019 Zweirat
+  Copyright (C) 2019-2021 OpenBikeSensor Contributors
   Contact: https://openbikesensor.org
 
   This file is part of the OpenBikeSensor project.
@@ -17,14 +17,17 @@
   You should have received a copy of the GNU General Public License along with
   the OpenBikeSensor sensor firmware.  If not, see <http://www.gnu.org/licenses/>.
 */
-#ifndef OPENBIKESENSORFIRMWARE_FILE_H
-#define OPENBIKESENSORFIRMWARE_FILE_H
+#ifndef OBS_SIM_PRINTABLE_H
+#define OBS_SIM_PRINTABLE_H
 
-#include <FS.h>
+#include <cstddef>
 
-class FileUtil {
+class Print;
+
+class Printable {
   public:
-    static bool appendFile(fs::FS &fs, const char * path, const char * message);
+    virtual ~Printable() = default;
+    virtual size_t printTo(Print &p) const = 0;
 };
 
-#endif //OPENBIKESENSORFIRMWARE_FILE_H
+#endif //OBS_SIM_PRINTABLE_H
@@ -0,0 +1,51 @@
+/*
+  Copyright (C) 2019-2021 OpenBikeSensor Contributors
+  Contact: https://openbikesensor.org
+
+  This file is part of the OpenBikeSensor project.
+
+  The OpenBikeSensor sensor firmware is free software: you can redistribute
+  it and/or modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the License,
+  or (at your option) any later version.
+
+  The OpenBikeSensor sensor firmware is distributed in the hope that it will
+  be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+  Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with
+  the OpenBikeSensor sensor firmware.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef OBS_SIM_SD_H
+#define OBS_SIM_SD_H
+
+#include "FS.h"
+
+typedef enum {
+  CARD_NONE,
+  CARD_MMC,
+  CARD_SD,
+  CARD_SDHC,
+  CARD_UNKNOWN
+} sdcard_type_t;
+
+namespace fs {
+  class SDFS : public FS {
+    public:
+      explicit SDFS(FileSystem *fileSystem) : FS(fileSystem) {}
+      bool begin(uint8_t ssPin = 5, void *spi = nullptr, uint32_t frequency = 4000000,
+                 const char *mountpoint = "/sd", uint8_t max_files = 5) {
+        return mount(mFileSystem);
+      }
+      void end() { unmount(mFileSystem); }
+      sdcard_type_t cardType() { return CARD_SDHC; }
+      uint64_t cardSize() { return fs::totalBytes(mFileSystem); }
+      uint64_t totalBytes() { return fs::totalBytes(mFileSystem); }
+      uint64_t usedBytes() { return fs::usedBytes(mFileSystem); }
+  };
+}
+
+extern fs::SDFS SD;
+
+#endif //OBS_SIM_SD_H
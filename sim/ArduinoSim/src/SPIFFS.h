@@ -0,0 +1,45 @@
+/*
+  Copyright (C) 2019-2021 OpenBikeSensor Contributors
+  Contact: https://openbikesensor.org
+
+  This file is part of the OpenBikeSensor project.
+
+  The OpenBikeSensor sensor firmware is free software: you can redistribute
+  it and/or modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the License,
+  or (at your option) any later version.
+
+  The OpenBikeSensor sensor firmware is distributed in the hope that it will
+  be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+  Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with
+  the OpenBikeSensor sensor firmware.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef OBS_SIM_SPIFFS_H
+#define OBS_SIM_SPIFFS_H
+
+#include "FS.h"
+
+namespace fs {
+  class SPIFFSFS : public FS {
+    public:
+      explicit SPIFFSFS(FileSystem *fileSystem) : FS(fileSystem) {}
+      bool begin(bool formatOnFail = false, const char *basePath = "/spiffs",
+                 uint8_t maxOpenFiles = 10) {
+        return mount(mFileSystem);
+      }
+      bool format() {
+        clear(mFileSystem);
+        return true;
+      }
+      void end() { unmount(mFileSystem); }
+      size_t totalBytes() { return (size_t) fs::totalBytes(mFileSystem); }
+      size_t usedBytes() { return (size_t) fs::usedBytes(mFileSystem); }
+  };
+}
+
+extern fs::SPIFFSFS SPIFFS;
+
+#endif //OBS_SIM_SPIFFS_H
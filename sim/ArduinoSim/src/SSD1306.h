@@ -0,0 +1,70 @@
+/*
+  Copyright (C) 2019-2021 OpenBikeSensor Contributors
+  Contact: https://openbikesensor.org
+
+  This file is part of the OpenBikeSensor project.
+
+  The OpenBikeSensor sensor firmware is free software: you can redistribute
+  it and/or modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the License,
+  or (at your option) any later version.
+
+  The OpenBikeSensor sensor firmware is distributed in the hope that it will
+  be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+  Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with
+  the OpenBikeSensor sensor firmware.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef OBS_SIM_SSD1306_H
+#define OBS_SIM_SSD1306_H
+
+#include "Arduino.h"
+#include "Wire.h"
+
+enum OLEDDISPLAY_COLOR {
+  BLACK = 0,
+  WHITE = 1,
+  INVERSE = 2
+};
+
+enum OLEDDISPLAY_TEXT_ALIGNMENT {
+  TEXT_ALIGN_LEFT = 0,
+  TEXT_ALIGN_RIGHT = 1,
+  TEXT_ALIGN_CENTER = 2,
+  TEXT_ALIGN_CENTER_BOTH = 3
+};
+
+extern const uint8_t ArialMT_Plain_10[];
+extern const uint8_t ArialMT_Plain_16[];
+extern const uint8_t ArialMT_Plain_24[];
+
+/* Drawing is free, display() costs the time of the frame transfer. */
+class SSD1306 {
+  public:
+    SSD1306(uint8_t address, int sda, int scl) {}
+    bool init() { return true; }
+    void display() {
+      sim::statistics().displayRefreshes++;
+      sim::consume(sim::costs().displayMicros);
+    }
+    void clear() {}
+    void setBrightness(uint8_t brightness) {}
+    void setContrast(uint8_t contrast, uint8_t precharge = 241, uint8_t comdetect = 64) {}
+    void invertDisplay() {}
+    void normalDisplay() {}
+    void flipScreenVertically() {}
+    void setColor(OLEDDISPLAY_COLOR color) {}
+    void setFont(const uint8_t *fontData) {}
+    void setTextAlignment(OLEDDISPLAY_TEXT_ALIGNMENT textAlignment) {}
+    void drawString(int16_t x, int16_t y, const String &text) {}
+    void drawXbm(int16_t x, int16_t y, int16_t width, int16_t height, const uint8_t *xbm) {}
+    void drawHorizontalLine(int16_t x, int16_t y, int16_t length) {}
+    void drawVerticalLine(int16_t x, int16_t y, int16_t length) {}
+    void setPixel(int16_t x, int16_t y) {}
+    void fillRect(int16_t x, int16_t y, int16_t width, int16_t height) {}
+    uint16_t getStringWidth(const String &text) { return (uint16_t) (text.length() * 6); }
+};
+
+#endif //OBS_SIM_SSD1306_H
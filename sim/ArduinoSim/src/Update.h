@@ -0,0 +1,40 @@
+/*
+  Copyright (C) 2019-2021 OpenBikeSensor Contributors
+  Contact: https://openbikesensor.org
+
+  This file is part of the OpenBikeSensor project.
+
+  The OpenBikeSensor sensor firmware is free software: you can redistribute
+  it and/or modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the License,
+  or (at your option) any later version.
+
+  The OpenBikeSensor sensor firmware is distributed in the hope that it will
+  be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+  Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with
+  the OpenBikeSensor sensor firmware.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef OBS_SIM_UPDATE_H
+#define OBS_SIM_UPDATE_H
+
+#include "Arduino.h"
+
+#define UPDATE_SIZE_UNKNOWN 0xFFFFFFFF
+#define U_FLASH   0
+#define U_SPIFFS  100
+
+class UpdateClass {
+  public:
+    bool begin(size_t size = UPDATE_SIZE_UNKNOWN, int command = U_FLASH) { return false; }
+    size_t write(uint8_t *data, size_t len) { return 0; }
+    bool end(bool evenIfRemaining = false) { return false; }
+    bool hasError() { return true; }
+    void printError(Print &out) { out.println("no update in the simulation"); }
+};
+
+extern UpdateClass Update;
+
+#endif //OBS_SIM_UPDATE_H
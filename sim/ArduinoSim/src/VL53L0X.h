@@ -0,0 +1,36 @@
+/*
+  Copyright (C) 2019-2021 OpenBikeSensor Contributors
+  Contact: https://openbikesensor.org
+
+  This file is part of the OpenBikeSensor project.
+
+  The OpenBikeSensor sensor firmware is free software: you can redistribute
+  it and/or modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the License,
+  or (at your option) any later version.
+
+  The OpenBikeSensor sensor firmware is distributed in the hope that it will
+  be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+  Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with
+  the OpenBikeSensor sensor firmware.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef OBS_SIM_VL53L0X_H
+#define OBS_SIM_VL53L0X_H
+
+#include "Wire.h"
+
+class VL53L0X {
+  public:
+    bool init(bool io_2v8 = true) { return false; }
+    void setTimeout(uint16_t timeout) {}
+    void setAddress(uint8_t new_addr) {}
+    void startContinuous(uint32_t period_ms = 0) {}
+    uint16_t readRangeContinuousMillimeters() { return 65535; }
+    uint16_t readRangeSingleMillimeters() { return 65535; }
+    bool timeoutOccurred() { return true; }
+};
+
+#endif //OBS_SIM_VL53L0X_H
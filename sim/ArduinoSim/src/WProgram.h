@@ -0,0 +1,2 @@
+/* TinyGPS++ includes this when it is not built with the Arduino IDE. */
+#include "Arduino.h"
@@ -0,0 +1,316 @@
+/*
+  Copyright (C) 2019-2021 OpenBikeSensor Contributors
+  Contact: https://openbikesensor.org
+
+  This file is part of the OpenBikeSensor project.
+
+  The OpenBikeSensor sensor firmware is free software: you can redistribute
+  it and/or modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the License,
+  or (at your option) any later version.
+
+  The OpenBikeSensor sensor firmware is distributed in the hope that it will
+  be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+  Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with
+  the OpenBikeSensor sensor firmware.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "WString.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <strings.h>
+
+static std::string integerToString(unsigned long long value, bool negative, unsigned char base) {
+  if (base < 2 || base > 36) {
+    base = 10;
+  }
+  std::string result;
+  do {
+    const int digit = (int) (value % base);
+    result.push_back((char) (digit < 10 ? '0' + digit : 'a' + digit - 10));
+    value /= base;
+  } while (value);
+  if (negative) {
+    result.push_back('-');
+  }
+  std::reverse(result.begin(), result.end());
+  return result;
+}
+
+static std::string signedToString(long long value, unsigned char base) {
+  if (base == 10 && value < 0) {
+    return integerToString(0ULL - (unsigned long long) value, true, base);
+  }
+  // like the ESP32 core other bases print the two's complement
+  return integerToString((unsigned long) value, false, base);
+}
+
+static std::string floatToString(double value, unsigned char decimalPlaces) {
+  char buffer[64];
+  snprintf(buffer, sizeof(buffer), "%.*f", decimalPlaces, value);
+  return std::string(buffer);
+}
+
+String::String(const char *cstr) : mBuffer(cstr ? cstr : "") {}
+
+String::String(const __FlashStringHelper *str) : String(reinterpret_cast<const char *>(str)) {}
+
+String::String(char c) : mBuffer(1, c) {}
+
+String::String(unsigned char value, unsigned char base) : mBuffer(integerToString(value, false, base)) {}
+
+String::String(int value, unsigned char base) : mBuffer(signedToString(value, base)) {}
+
+String::String(unsigned int value, unsigned char base) : mBuffer(integerToString(value, false, base)) {}
+
+String::String(long value, unsigned char base) : mBuffer(signedToString(value, base)) {}
+
+String::String(unsigned long value, unsigned char base) : mBuffer(integerToString(value, false, base)) {}
+
+String::String(long long value, unsigned char base) : mBuffer(signedToString(value, base)) {}
+
+String::String(unsigned long long value, unsigned char base) : mBuffer(integerToString(value, false, base)) {}
+
+String::String(float value, unsigned char decimalPlaces) : mBuffer(floatToString(value, decimalPlaces)) {}
+
+String::String(double value, unsigned char decimalPlaces) : mBuffer(floatToString(value, decimalPlaces)) {}
+
+String &String::operator=(const char *cstr) {
+  mBuffer = cstr ? cstr : "";
+  return *this;
+}
+
+unsigned char String::reserve(unsigned int size) {
+  mBuffer.reserve(size);
+  return 1;
+}
+
+unsigned char String::concat(const String &str) {
+  mBuffer += str.mBuffer;
+  return 1;
+}
+
+unsigned char String::concat(const char *cstr) {
+  if (!cstr) {
+    return 0;
+  }
+  mBuffer += cstr;
+  return 1;
+}
+
+unsigned char String::concat(char c) {
+  mBuffer += c;
+  return 1;
+}
+
+unsigned char String::concat(unsigned char value) {
+  return concat(String(value));
+}
+
+unsigned char String::concat(int value) {
+  return concat(String(value));
+}
+
+unsigned char String::concat(unsigned int value) {
+  return concat(String(value));
+}
+
+unsigned char String::concat(long value) {
+  return concat(String(value));
+}
+
+unsigned char String::concat(unsigned long value) {
+  return concat(String(value));
+}
+
+unsigned char String::concat(long long value) {
+  return concat(String(value));
+}
+
+unsigned char String::concat(unsigned long long value) {
+  return concat(String(value));
+}
+
+unsigned char String::concat(float value) {
+  return concat(String(value));
+}
+
+unsigned char String::concat(double value) {
+  return concat(String(value));
+}
+
+String operator+(const String &lhs, const String &rhs) {
+  return String(lhs.mBuffer + rhs.mBuffer);
+}
+
+String operator+(const String &lhs, const char *rhs) {
+  return String(lhs.mBuffer + (rhs ? rhs : ""));
+}
+
+String operator+(const char *lhs, const String &rhs) {
+  return String((lhs ? lhs : "") + rhs.mBuffer);
+}
+
+String operator+(const String &lhs, char rhs) {
+  return String(lhs.mBuffer + rhs);
+}
+
+String operator+(const String &lhs, int rhs) {
+  return lhs + String(rhs);
+}
+
+String operator+(const String &lhs, unsigned int rhs) {
+  return lhs + String(rhs);
+}
+
+String operator+(const String &lhs, long rhs) {
+  return lhs + String(rhs);
+}
+
+String operator+(const String &lhs, unsigned long rhs) {
+  return lhs + String(rhs);
+}
+
+String operator+(const String &lhs, float rhs) {
+  return lhs + String(rhs);
+}
+
+String operator+(const String &lhs, double rhs) {
+  return lhs + String(rhs);
+}
+
+bool String::equalsIgnoreCase(const String &s) const {
+  return length() == s.length() && strcasecmp(c_str(), s.c_str()) == 0;
+}
+
+bool String::startsWith(const String &prefix) const {
+  return mBuffer.compare(0, prefix.mBuffer.length(), prefix.mBuffer) == 0;
+}
+
+bool String::endsWith(const String &suffix) const {
+  return mBuffer.length() >= suffix.mBuffer.length()
+    && mBuffer.compare(mBuffer.length() - suffix.mBuffer.length(),
+                       suffix.mBuffer.length(), suffix.mBuffer) == 0;
+}
+
+char String::charAt(unsigned int index) const {
+  return index < mBuffer.length() ? mBuffer[index] : 0;
+}
+
+void String::setCharAt(unsigned int index, char c) {
+  if (index < mBuffer.length()) {
+    mBuffer[index] = c;
+  }
+}
+
+void String::getBytes(unsigned char *buf, unsigned int bufsize, unsigned int index) const {
+  if (!bufsize || !buf) {
+    return;
+  }
+  if (index >= mBuffer.length()) {
+    buf[0] = 0;
+    return;
+  }
+  const unsigned int n = std::min(bufsize - 1, (unsigned int) mBuffer.length() - index);
+  mBuffer.copy((char *) buf, n, index);
+  buf[n] = 0;
+}
+
+static int toIndex(std::string::size_type pos) {
+  return pos == std::string::npos ? -1 : (int) pos;
+}
+
+int String::indexOf(char ch, unsigned int fromIndex) const {
+  return toIndex(mBuffer.find(ch, fromIndex));
+}
+
+int String::indexOf(const String &str, unsigned int fromIndex) const {
+  return toIndex(mBuffer.find(str.mBuffer, fromIndex));
+}
+
+int String::lastIndexOf(char ch) const {
+  return toIndex(mBuffer.rfind(ch));
+}
+
+int String::lastIndexOf(const String &str) const {
+  return toIndex(mBuffer.rfind(str.mBuffer));
+}
+
+String String::substring(unsigned int beginIndex) const {
+  return substring(beginIndex, length());
+}
+
+String String::substring(unsigned int beginIndex, unsigned int endIndex) const {
+  if (beginIndex > endIndex) {
+    std::swap(beginIndex, endIndex);
+  }
+  if (beginIndex >= mBuffer.length()) {
+    return String();
+  }
+  endIndex = std::min(endIndex, length());
+  return String(mBuffer.substr(beginIndex, endIndex - beginIndex));
+}
+
+void String::replace(char find, char replace) {
+  std::replace(mBuffer.begin(), mBuffer.end(), find, replace);
+}
+
+void String::replace(const String &find, const String &replace) {
+  if (find.isEmpty()) {
+    return;
+  }
+  std::string::size_type pos = 0;
+  while ((pos = mBuffer.find(find.mBuffer, pos)) != std::string::npos) {
+    mBuffer.replace(pos, find.mBuffer.length(), replace.mBuffer);
+    pos += replace.mBuffer.length();
+  }
+}
+
+void String::remove(unsigned int index) {
+  remove(index, (unsigned int) -1);
+}
+
+void String::remove(unsigned int index, unsigned int count) {
+  if (index < mBuffer.length()) {
+    mBuffer.erase(index, count);
+  }
+}
+
+void String::toLowerCase() {
+  for (char &c : mBuffer) {
+    c = (char) tolower((unsigned char) c);
+  }
+}
+
+void String::toUpperCase() {
+  for (char &c : mBuffer) {
+    c = (char) toupper((unsigned char) c);
+  }
+}
+
+void String::trim() {
+  const std::string::size_type first = mBuffer.find_first_not_of(" \t\r\n\f\v");
+  if (first == std::string::npos) {
+    mBuffer.clear();
+    return;
+  }
+  const std::string::size_type last = mBuffer.find_last_not_of(" \t\r\n\f\v");
+  mBuffer = mBuffer.substr(first, last - first + 1);
+}
+
+long String::toInt() const {
+  return atol(c_str());
+}
+
+float String::toFloat() const {
+  return (float) atof(c_str());
+}
+
+double String::toDouble() const {
+  return atof(c_str());
+}
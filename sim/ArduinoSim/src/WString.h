@@ -0,0 +1,137 @@
+/*
+  Copyright (C) 2019-2021 OpenBikeSensor Contributors
+  Contact: https://openbikesensor.org
+
+  This file is part of the OpenBikeSensor project.
+
+  The OpenBikeSensor sensor firmware is free software: you can redistribute
+  it and/or modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the License,
+  or (at your option) any later version.
+
+  The OpenBikeSensor sensor firmware is distributed in the hope that it will
+  be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+  Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with
+  the OpenBikeSensor sensor firmware.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef OBS_SIM_WSTRING_H
+#define OBS_SIM_WSTRING_H
+
+#include <cstdint>
+#include <string>
+
+class __FlashStringHelper;
+#define FPSTR(pstr_pointer) (reinterpret_cast<const __FlashStringHelper *>(pstr_pointer))
+#define F(string_literal) (FPSTR(string_literal))
+
+/* Arduino String backed by std::string. Only the members the firmware
+ * uses are provided, they behave like the ESP32 core implementation.
+ */
+class String {
+  public:
+    String(const char *cstr = "");
+    String(const String &str) = default;
+    String(String &&str) = default;
+    String(const __FlashStringHelper *str);
+    explicit String(char c);
+    explicit String(unsigned char value, unsigned char base = 10);
+    explicit String(int value, unsigned char base = 10);
+    explicit String(unsigned int value, unsigned char base = 10);
+    explicit String(long value, unsigned char base = 10);
+    explicit String(unsigned long value, unsigned char base = 10);
+    explicit String(long long value, unsigned char base = 10);
+    explicit String(unsigned long long value, unsigned char base = 10);
+    explicit String(float value, unsigned char decimalPlaces = 2);
+    explicit String(double value, unsigned char decimalPlaces = 2);
+
+    String &operator=(const String &rhs) = default;
+    String &operator=(String &&rhs) = default;
+    String &operator=(const char *cstr);
+
+    unsigned int length() const { return (unsigned int) mBuffer.length(); }
+    bool isEmpty() const { return mBuffer.empty(); }
+    void clear() { mBuffer.clear(); }
+    unsigned char reserve(unsigned int size);
+    const char *c_str() const { return mBuffer.c_str(); }
+    char *begin() { return &mBuffer[0]; }
+    char *end() { return begin() + length(); }
+
+    unsigned char concat(const String &str);
+    unsigned char concat(const char *cstr);
+    unsigned char concat(char c);
+    unsigned char concat(unsigned char value);
+    unsigned char concat(int value);
+    unsigned char concat(unsigned int value);
+    unsigned char concat(long value);
+    unsigned char concat(unsigned long value);
+    unsigned char concat(long long value);
+    unsigned char concat(unsigned long long value);
+    unsigned char concat(float value);
+    unsigned char concat(double value);
+
+    template<typename T>
+    String &operator+=(const T &rhs) {
+      concat(rhs);
+      return *this;
+    }
+
+    friend String operator+(const String &lhs, const String &rhs);
+    friend String operator+(const String &lhs, const char *rhs);
+    friend String operator+(const char *lhs, const String &rhs);
+    friend String operator+(const String &lhs, char rhs);
+    friend String operator+(const String &lhs, int rhs);
+    friend String operator+(const String &lhs, unsigned int rhs);
+    friend String operator+(const String &lhs, long rhs);
+    friend String operator+(const String &lhs, unsigned long rhs);
+    friend String operator+(const String &lhs, float rhs);
+    friend String operator+(const String &lhs, double rhs);
+
+    int compareTo(const String &s) const { return mBuffer.compare(s.mBuffer); }
+    bool equals(const String &s) const { return mBuffer == s.mBuffer; }
+    bool equals(const char *cstr) const { return mBuffer == (cstr ? cstr : ""); }
+    bool equalsIgnoreCase(const String &s) const;
+    bool operator==(const String &rhs) const { return equals(rhs); }
+    bool operator==(const char *cstr) const { return equals(cstr); }
+    bool operator!=(const String &rhs) const { return !equals(rhs); }
+    bool operator!=(const char *cstr) const { return !equals(cstr); }
+    bool operator<(const String &rhs) const { return compareTo(rhs) < 0; }
+    bool startsWith(const String &prefix) const;
+    bool endsWith(const String &suffix) const;
+
+    char charAt(unsigned int index) const;
+    void setCharAt(unsigned int index, char c);
+    char operator[](unsigned int index) const { return charAt(index); }
+    char &operator[](unsigned int index) { return mBuffer[index]; }
+    void getBytes(unsigned char *buf, unsigned int bufsize, unsigned int index = 0) const;
+    void toCharArray(char *buf, unsigned int bufsize, unsigned int index = 0) const {
+      getBytes((unsigned char *) buf, bufsize, index);
+    }
+
+    int indexOf(char ch, unsigned int fromIndex = 0) const;
+    int indexOf(const String &str, unsigned int fromIndex = 0) const;
+    int lastIndexOf(char ch) const;
+    int lastIndexOf(const String &str) const;
+    String substring(unsigned int beginIndex) const;
+    String substring(unsigned int beginIndex, unsigned int endIndex) const;
+
+    void replace(char find, char replace);
+    void replace(const String &find, const String &replace);
+    void remove(unsigned int index);
+    void remove(unsigned int index, unsigned int count);
+    void toLowerCase();
+    void toUpperCase();
+    void trim();
+
+    long toInt() const;
+    float toFloat() const;
+    double toDouble() const;
+
+  private:
+    explicit String(std::string &&str) : mBuffer(std::move(str)) {}
+    std::string mBuffer;
+};
+
+#endif //OBS_SIM_WSTRING_H
@@ -0,0 +1,49 @@
+/*
+  Copyright (C) 2019-2021 OpenBikeSensor Contributors
+  Contact: https://openbikesensor.org
+
+  This file is part of the OpenBikeSensor project.
+
+  The OpenBikeSensor sensor firmware is free software: you can redistribute
+  it and/or modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the License,
+  or (at your option) any later version.
+
+  The OpenBikeSensor sensor firmware is distributed in the hope that it will
+  be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+  Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with
+  the OpenBikeSensor sensor firmware.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef OBS_SIM_WEBSERVER_H
+#define OBS_SIM_WEBSERVER_H
+
+#include <functional>
+
+#include "WiFiClient.h"
+
+enum HTTPMethod { HTTP_ANY, HTTP_GET, HTTP_HEAD, HTTP_POST, HTTP_PUT, HTTP_PATCH, HTTP_DELETE, HTTP_OPTIONS };
+
+/* Only the handler registration, no request is ever received. */
+class WebServer {
+  public:
+    typedef std::function<void(void)> THandlerFunction;
+
+    explicit WebServer(int port = 80) {}
+    void begin() {}
+    void close() {}
+    void handleClient() {}
+    void on(const String &uri, THandlerFunction handler) {}
+    void on(const String &uri, HTTPMethod method, THandlerFunction fn) {}
+    void on(const String &uri, HTTPMethod method, THandlerFunction fn, THandlerFunction ufn) {}
+    void onNotFound(THandlerFunction fn) {}
+    String arg(const String &name) { return String(); }
+    bool hasArg(const String &name) { return false; }
+    void send(int code, const char *content_type = nullptr, const String &content = String()) {}
+    void send(int code, const String &content_type, const String &content) {}
+    void sendHeader(const String &name, const String &value, bool first = false) {}
+};
+
+#endif //OBS_SIM_WEBSERVER_H
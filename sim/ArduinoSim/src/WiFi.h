@@ -0,0 +1,75 @@
+/*
+  Copyright (C) 2019-2021 OpenBikeSensor Contributors
+  Contact: https://openbikesensor.org
+
+  This file is part of the OpenBikeSensor project.
+
+  The OpenBikeSensor sensor firmware is free software: you can redistribute
+  it and/or modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the License,
+  or (at your option) any later version.
+
+  The OpenBikeSensor sensor firmware is distributed in the hope that it will
+  be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+  Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with
+  the OpenBikeSensor sensor firmware.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef OBS_SIM_WIFI_H
+#define OBS_SIM_WIFI_H
+
+#include "Arduino.h"
+
+/* There is no network in the simulation, the station never connects. */
+
+typedef enum {
+  WIFI_OFF = 0,
+  WIFI_STA = 1,
+  WIFI_AP = 2,
+  WIFI_AP_STA = 3
+} wifi_mode_t;
+
+typedef enum {
+  WL_IDLE_STATUS = 0,
+  WL_NO_SSID_AVAIL = 1,
+  WL_CONNECTED = 3,
+  WL_CONNECT_FAILED = 4,
+  WL_DISCONNECTED = 6
+} wl_status_t;
+
+class IPAddress : public Printable {
+  public:
+    IPAddress(uint8_t a = 0, uint8_t b = 0, uint8_t c = 0, uint8_t d = 0) : mAddress{a, b, c, d} {}
+    String toString() const {
+      return String(mAddress[0]) + "." + String(mAddress[1]) + "."
+        + String(mAddress[2]) + "." + String(mAddress[3]);
+    }
+    size_t printTo(Print &p) const override { return p.print(toString()); }
+
+  private:
+    uint8_t mAddress[4];
+};
+
+class WiFiGenericClass {
+  public:
+    static bool mode(wifi_mode_t mode) { return true; }
+    static wifi_mode_t getMode() { return WIFI_OFF; }
+};
+
+class WiFiClass : public WiFiGenericClass {
+  public:
+    wl_status_t begin(const char *ssid, const char *passphrase = nullptr) { return WL_DISCONNECTED; }
+    uint8_t waitForConnectResult() { return WL_CONNECT_FAILED; }
+    wl_status_t status() { return WL_DISCONNECTED; }
+    bool disconnect(bool wifioff = false) { return true; }
+    bool softAP(const char *ssid, const char *passphrase = nullptr) { return true; }
+    IPAddress softAPIP() { return IPAddress(172, 20, 0, 1); }
+    IPAddress localIP() { return IPAddress(); }
+    bool setHostname(const char *hostname) { return true; }
+};
+
+extern WiFiClass WiFi;
+
+#endif //OBS_SIM_WIFI_H
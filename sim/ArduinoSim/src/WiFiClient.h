@@ -0,0 +1,39 @@
+/*
+  Copyright (C) 2019-2021 OpenBikeSensor Contributors
+  Contact: https://openbikesensor.org
+
+  This file is part of the OpenBikeSensor project.
+
+  The OpenBikeSensor sensor firmware is free software: you can redistribute
+  it and/or modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the License,
+  or (at your option) any later version.
+
+  The OpenBikeSensor sensor firmware is distributed in the hope that it will
+  be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+  Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with
+  the OpenBikeSensor sensor firmware.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef OBS_SIM_WIFICLIENT_H
+#define OBS_SIM_WIFICLIENT_H
+
+#include "WiFi.h"
+
+class WiFiClient : public Stream {
+  public:
+    int connect(const char *host, uint16_t port) { return 0; }
+    uint8_t connected() { return 0; }
+    void stop() {}
+    size_t write(uint8_t c) override { return 0; }
+    size_t write(const uint8_t *buf, size_t size) override { return 0; }
+    using Print::write;
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+    operator bool() { return false; }
+};
+
+#endif //OBS_SIM_WIFICLIENT_H
@@ -0,0 +1,37 @@
+/*
+  Copyright (C) 2019-2021 OpenBikeSensor Contributors
+  Contact: https://openbikesensor.org
+
+  This file is part of the OpenBikeSensor project.
+
+  The OpenBikeSensor sensor firmware is free software: you can redistribute
+  it and/or modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the License,
+  or (at your option) any later version.
+
+  The OpenBikeSensor sensor firmware is distributed in the hope that it will
+  be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+  Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with
+  the OpenBikeSensor sensor firmware.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef OBS_SIM_ESP32_HAL_LOG_H
+#define OBS_SIM_ESP32_HAL_LOG_H
+
+#include "sim.h"
+
+#define log_v(format, ...) sim::log('V', format, ##__VA_ARGS__)
+#define log_d(format, ...) sim::log('D', format, ##__VA_ARGS__)
+#define log_i(format, ...) sim::log('I', format, ##__VA_ARGS__)
+#define log_w(format, ...) sim::log('W', format, ##__VA_ARGS__)
+#define log_e(format, ...) sim::log('E', format, ##__VA_ARGS__)
+
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERROR_CHECK(x) (void) (x)
+#define ESP_ERROR_CHECK_WITHOUT_ABORT(x) (x)
+
+#endif //OBS_SIM_ESP32_HAL_LOG_H
@@ -1,5 +1,5 @@
 /*
-  Copyright (C) 2019 Zweirat
+  Copyright (C) 2019-2021 OpenBikeSensor Contributors
   Contact: https://openbikesensor.org
 
   This file is part of the OpenBikeSensor project.
@@ -17,23 +17,17 @@
   You should have received a copy of the GNU General Public License along with
   the OpenBikeSensor sensor firmware.  If not, see <http://www.gnu.org/licenses/>.
 */
-#include "file.h"
+#ifndef OBS_SIM_ESP_WIFI_H
+#define OBS_SIM_ESP_WIFI_H
 
-bool FileUtil::appendFile(fs::FS &fs, const char * path, const char * message) {
-  bool result = false;
-  Serial.printf("Appending to file: %s\n", path);
+#include "Arduino.h"
 
-  File file = fs.open(path, FILE_APPEND);
-  if (!file) {
-    Serial.println("Failed to open file for appending");
-    return false;
+/* Deterministic, like everything else in the simulation. */
+inline void esp_fill_random(void *buf, size_t len) {
+  uint8_t *bytes = (uint8_t *) buf;
+  for (size_t i = 0; i < len; ++i) {
+    bytes[i] = (uint8_t) sim::core::random();
   }
-  if (file.print(message)) {
-    result = true;
-    Serial.println("Message appended");
-  } else {
-    Serial.println("Append failed");
-  }
-  file.close();
-  return result;
 }
+
+#endif //OBS_SIM_ESP_WIFI_H
@@ -0,0 +1,51 @@
+/*
+  Copyright (C) 2019-2021 OpenBikeSensor Contributors
+  Contact: https://openbikesensor.org
+
+  This file is part of the OpenBikeSensor project.
+
+  The OpenBikeSensor sensor firmware is free software: you can redistribute
+  it and/or modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the License,
+  or (at your option) any later version.
+
+  The OpenBikeSensor sensor firmware is distributed in the hope that it will
+  be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+  Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with
+  the OpenBikeSensor sensor firmware.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "Wire.h"
+#include "WiFi.h"
+#include "WebServer.h"
+#include "ESPmDNS.h"
+#include "Update.h"
+#include "ArduinoOTA.h"
+#include "SSD1306.h"
+
+/* Global instances of the stand-in libraries and the parts of the firmware
+ * that are not part of the native build (config server, uploader).
+ */
+
+TwoWire Wire;
+WiFiClass WiFi;
+MDNSResponder MDNS;
+UpdateClass Update;
+ArduinoOTAClass ArduinoOTA;
+
+const uint8_t ArialMT_Plain_10[] = {0};
+const uint8_t ArialMT_Plain_16[] = {0};
+const uint8_t ArialMT_Plain_24[] = {0};
+
+class ObsConfig;
+
+WebServer server(80);
+
+void startServer(ObsConfig *pConfig) {
+  log_w("The config server is not available in the simulation.");
+}
+
+void createPrivacyPage() {
+}
@@ -0,0 +1,52 @@
+/*
+  Copyright (C) 2019-2021 OpenBikeSensor Contributors
+  Contact: https://openbikesensor.org
+
+  This file is part of the OpenBikeSensor project.
+
+  The OpenBikeSensor sensor firmware is free software: you can redistribute
+  it and/or modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the License,
+  or (at your option) any later version.
+
+  The OpenBikeSensor sensor firmware is distributed in the hope that it will
+  be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+  Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with
+  the OpenBikeSensor sensor firmware.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef OBS_SIM_TASK_H
+#define OBS_SIM_TASK_H
+
+#include "freertos/FreeRTOS.h"
+
+/* Tasks and direct to task notifications. setup() and loop() run in the
+ * "loopTask", each created task behaves as if it had a core for its own,
+ * there is no preemption. Waiting lets the virtual time pass until the
+ * task is notified or the wait times out.
+ */
+typedef void *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+#define configMAX_PRIORITIES 25
+#define tskIDLE_PRIORITY ((UBaseType_t) 0)
+#define tskNO_AFFINITY 0x7FFFFFFF
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t code, const char *name,
+  uint32_t stackDepth, void *parameters, UBaseType_t priority,
+  TaskHandle_t *createdTask, BaseType_t coreId);
+BaseType_t xTaskCreate(TaskFunction_t code, const char *name,
+  uint32_t stackDepth, void *parameters, UBaseType_t priority,
+  TaskHandle_t *createdTask);
+/* Only a task can delete itself, pass nullptr. */
+void vTaskDelete(TaskHandle_t task);
+TaskHandle_t xTaskGetCurrentTaskHandle();
+void vTaskDelay(TickType_t ticks);
+TickType_t xTaskGetTickCount();
+uint32_t ulTaskNotifyTake(BaseType_t clearCountOnExit, TickType_t ticksToWait);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higherPriorityTaskWoken);
+
+#endif //OBS_SIM_TASK_H
@@ -0,0 +1,72 @@
+/*
+  Copyright (C) 2019-2021 OpenBikeSensor Contributors
+  Contact: https://openbikesensor.org
+
+  This file is part of the OpenBikeSensor project.
+
+  The OpenBikeSensor sensor firmware is free software: you can redistribute
+  it and/or modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the License,
+  or (at your option) any later version.
+
+  The OpenBikeSensor sensor firmware is distributed in the hope that it will
+  be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+  Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with
+  the OpenBikeSensor sensor firmware.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include "sim.h"
+
+/* Counts the heap allocations of the firmware. The linker only takes this
+ * file if a test asks for sim::heapAllocations(), so tests can still bring
+ * their own operator new.
+ */
+
+static std::atomic<uint64_t> firmwareAllocations(0);
+
+static void *allocate(size_t size) {
+  if (!sim::core::Internal::active()) {
+    firmwareAllocations++;
+  }
+  void *memory = malloc(size ? size : 1);
+  if (!memory) {
+    throw std::bad_alloc();
+  }
+  return memory;
+}
+
+void *operator new(size_t size) {
+  return allocate(size);
+}
+
+void *operator new[](size_t size) {
+  return allocate(size);
+}
+
+void operator delete(void *memory) noexcept {
+  free(memory);
+}
+
+void operator delete[](void *memory) noexcept {
+  free(memory);
+}
+
+void operator delete(void *memory, size_t) noexcept {
+  free(memory);
+}
+
+void operator delete[](void *memory, size_t) noexcept {
+  free(memory);
+}
+
+namespace sim {
+  uint64_t heapAllocations() {
+    return firmwareAllocations;
+  }
+}
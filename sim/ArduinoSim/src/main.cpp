@@ -0,0 +1,116 @@
+/*
+  Copyright (C) 2019-2021 OpenBikeSensor Contributors
+  Contact: https://openbikesensor.org
+
+  This file is part of the OpenBikeSensor project.
+
+  The OpenBikeSensor sensor firmware is free software: you can redistribute
+  it and/or modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the License,
+  or (at your option) any later version.
+
+  The OpenBikeSensor sensor firmware is distributed in the hope that it will
+  be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+  Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with
+  the OpenBikeSensor sensor firmware.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef UNIT_TEST
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "Arduino.h"
+
+void setup();
+void loop();
+
+/* Runs the firmware on a scripted ride and reports how the measurement
+ * loop performs:
+ *
+ *   program [--seconds N] [--left CM] [--right CM] [--verbose]
+ *
+ * The right sensor sees a constant wall, the left sensor a car passing
+ * every 10 seconds for 600ms in the given distance.
+ */
+
+static const uint8_t RIGHT_TRIGGER_PIN = 15;
+static const uint8_t RIGHT_ECHO_PIN = 4;
+static const uint8_t LEFT_TRIGGER_PIN = 25;
+static const uint8_t LEFT_ECHO_PIN = 26;
+static const uint8_t BATTERY_PIN = 34;
+
+int main(int argc, char **argv) {
+  uint32_t seconds = 60;
+  uint16_t leftCm = 120;
+  uint16_t rightCm = 180;
+  bool verbose = false;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+      seconds = (uint32_t) atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--left") == 0 && i + 1 < argc) {
+      leftCm = (uint16_t) atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--right") == 0 && i + 1 < argc) {
+      rightCm = (uint16_t) atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--verbose") == 0) {
+      verbose = true;
+    } else {
+      fprintf(stderr, "usage: %s [--seconds N] [--left CM] [--right CM] [--verbose]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  sim::reset();
+  sim::setSerialEcho(verbose);
+  sim::setAnalogValue(BATTERY_PIN, 2400); // ~3.9V behind the 2/3 divider
+
+  sim::UltrasonicSensor right;
+  right.triggerPin = RIGHT_TRIGGER_PIN;
+  right.echoPin = RIGHT_ECHO_PIN;
+  right.distance = [rightCm](uint64_t) { return rightCm; };
+  sim::addUltrasonicSensor(right);
+
+  sim::UltrasonicSensor left;
+  left.triggerPin = LEFT_TRIGGER_PIN;
+  left.echoPin = LEFT_ECHO_PIN;
+  left.distance = [leftCm](uint64_t micros) {
+    return (uint16_t) (micros % 10000000 < 600000 ? leftCm : 0);
+  };
+  sim::addUltrasonicSensor(left);
+
+  setup();
+
+  const uint64_t loopStart = sim::micros();
+  const uint64_t end = loopStart + (uint64_t) seconds * 1000000;
+  const sim::Statistics before = sim::statistics();
+  uint32_t loops = 0;
+  uint64_t maxLoopMicros = 0;
+  while (sim::micros() < end) {
+    const uint64_t start = sim::micros();
+    loop();
+    loops++;
+    maxLoopMicros = std::max(maxLoopMicros, sim::micros() - start);
+  }
+  const sim::Statistics &after = sim::statistics();
+  const double elapsed = (double) (sim::micros() - loopStart) / 1000000.0;
+
+  printf("setup:                     %.3fs\n", loopStart / 1000000.0);
+  printf("loop() calls:              %u in %.3fs, longest %.3fms\n",
+         loops, elapsed, maxLoopMicros / 1000.0);
+  for (size_t idx = 0; idx < after.triggers.size(); ++idx) {
+    const uint32_t triggers = after.triggers[idx] - before.triggers[idx];
+    printf("sensor %zu triggers:         %u, %.1f per interval\n",
+           idx, triggers, loops ? (double) triggers / loops : 0.0);
+  }
+  printf("display refreshes:         %u\n", after.displayRefreshes - before.displayRefreshes);
+  printf("SD bytes written:          %llu\n",
+         (unsigned long long) (after.sdBytesWritten - before.sdBytesWritten));
+  printf("SD longest write or sync:  %.3fms\n", after.sdMaxWriteMicros / 1000.0);
+  printf("UART bytes lost:           %u\n", after.uartOverflowBytes);
+  return 0;
+}
+
+#endif
@@ -0,0 +1,726 @@
+/*
+  Copyright (C) 2019-2021 OpenBikeSensor Contributors
+  Contact: https://openbikesensor.org
+
+  This file is part of the OpenBikeSensor project.
+
+  The OpenBikeSensor sensor firmware is free software: you can redistribute
+  it and/or modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the License,
+  or (at your option) any later version.
+
+  The OpenBikeSensor sensor firmware is distributed in the hope that it will
+  be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+  Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with
+  the OpenBikeSensor sensor firmware.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "sim.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <sys/time.h>
+
+namespace sim {
+
+  /* Values as defined by the stand-in Arduino.h */
+  const int LOW = 0x0;
+  const int HIGH = 0x1;
+  const int RISING = 0x01;
+  const int FALLING = 0x02;
+  const int CHANGE = 0x03;
+
+  const uint8_t PIN_COUNT = 40;
+  const size_t UART_COUNT = 3;
+  /* ESP32 Arduino core default for the receive queue. */
+  const size_t UART_RX_FIFO_SIZE = 256;
+  const uint8_t GPS_UART = 1;
+  const double EARTH_RADIUS_METERS = 6371000.0;
+
+  struct Event {
+    uint64_t at;
+    uint64_t sequence;
+    std::function<void()> action;
+  };
+
+  struct EventOrder {
+    bool operator()(const Event &a, const Event &b) const {
+      return a.at > b.at || (a.at == b.at && a.sequence > b.sequence);
+    }
+  };
+
+  struct Interrupt {
+    std::function<void()> handler;
+    int mode = 0;
+  };
+
+  struct SensorState {
+    UltrasonicSensor sensor;
+    /* Falling echo of the last trigger. */
+    uint64_t busyUntil = 0;
+    /* Raising echo of the last trigger, the burst is sent. */
+    uint64_t rise = 0;
+    /* Time the burst of the last trigger comes back, 0 if nothing reflects. */
+    uint64_t burstReturn = 0;
+    /* Only the falling edge scheduled last is applied. */
+    uint32_t fallGeneration = 0;
+  };
+
+  struct Uart {
+    uint32_t baud = 0;
+    std::deque<std::pair<uint64_t, uint8_t>> pending;
+    std::deque<uint8_t> fifo;
+  };
+
+  /* A FreeRTOS task. Tasks run on their own host thread, but only one of
+   * them at a time, the others wait till the virtual time reaches their
+   * wakeAt or their until condition becomes true. All tasks behave as if
+   * they run on their own core, time one task is busy is not taken from
+   * the others.
+   */
+  struct Task {
+    explicit Task(const std::string &name) : name(name) {}
+    std::string name;
+    uint64_t wakeAt = 0;
+    std::function<bool()> until;
+    uint32_t notifications = 0;
+    bool finished = false;
+    std::condition_variable resume;
+  };
+
+  /* Unwinds the thread of a task that deletes itself. */
+  struct TaskEnd {};
+
+  struct World {
+    World() {
+      // the ESP has no time zone configured, so we run in UTC as well
+      setenv("TZ", "UTC0", 1);
+      tzset();
+    }
+
+    uint64_t now = 0;
+    uint64_t eventSequence = 0;
+    bool inEvent = false;
+    std::priority_queue<Event, std::vector<Event>, EventOrder> events;
+    Costs costs;
+    Statistics statistics;
+    int pins[PIN_COUNT] = {};
+    uint16_t analog[PIN_COUNT] = {};
+    Interrupt interrupts[PIN_COUNT];
+    std::vector<SensorState> sensors;
+    double temperature = 22.4;
+    Uart uarts[UART_COUNT];
+    GpsTrack gpsTrack;
+    bool gpsRunning = false;
+    std::vector<uint8_t> gpsReceived;
+    time_t gpsEpoch = 1622534400; // 2021-06-01T08:00:00Z
+    int64_t deviceClockOffsetMicros = 0;
+    bool serialEcho = false;
+    uint32_t randomState = 0x4f425321;
+    std::vector<Task *> tasks;
+    Task *currentTask = nullptr;
+    std::mutex taskSwitch;
+  };
+
+  World &world() {
+    // never destroyed, task threads might still wait for their turn at exit
+    static World *theWorld = nullptr;
+    if (!theWorld) {
+      theWorld = new World;
+      theWorld->currentTask = new Task("loopTask");
+      theWorld->tasks.push_back(theWorld->currentTask);
+    }
+    return *theWorld;
+  }
+
+  void reset() {
+    World &w = world();
+    w.now = 0;
+    w.eventSequence = 0;
+    w.inEvent = false;
+    w.events = std::priority_queue<Event, std::vector<Event>, EventOrder>();
+    w.costs = Costs();
+    w.statistics = Statistics();
+    for (uint8_t pin = 0; pin < PIN_COUNT; ++pin) {
+      w.pins[pin] = LOW;
+      w.analog[pin] = 0;
+      w.interrupts[pin] = Interrupt();
+    }
+    w.sensors.clear();
+    w.temperature = 22.4;
+    for (auto &uart : w.uarts) {
+      uart = Uart();
+    }
+    w.gpsTrack = GpsTrack();
+    w.gpsRunning = false;
+    w.gpsReceived.clear();
+    w.gpsEpoch = 1622534400;
+    w.deviceClockOffsetMicros = 0;
+    w.randomState = 0x4f425321;
+    // tasks created by the last run never get their turn again
+    for (Task *task : w.tasks) {
+      if (task != w.currentTask) {
+        task->finished = true;
+      }
+    }
+    w.tasks.assign(1, w.currentTask);
+    w.currentTask->notifications = 0;
+    core::resetFileSystems();
+  }
+
+  Costs &costs() {
+    return world().costs;
+  }
+
+  Statistics &statistics() {
+    return world().statistics;
+  }
+
+  uint64_t micros() {
+    return world().now;
+  }
+
+  static void runNextEvent() {
+    World &w = world();
+    Event event = w.events.top();
+    w.events.pop();
+    if (event.at > w.now) {
+      w.now = event.at;
+    }
+    w.inEvent = true;
+    event.action();
+    w.inEvent = false;
+  }
+
+  /* Hands the cpu to the given task and waits till it is our turn again. */
+  static void switchTo(Task *next, bool finished) {
+    World &w = world();
+    Task *self = w.currentTask;
+    if (next == self) {
+      return;
+    }
+    std::unique_lock<std::mutex> lock(w.taskSwitch);
+    w.currentTask = next;
+    next->resume.notify_one();
+    if (!finished) {
+      self->resume.wait(lock, [&w, self]() { return w.currentTask == self; });
+    }
+  }
+
+  /* The current task waits, fires the events in order till the task that
+   * is due next can run.
+   */
+  static void runTasks(bool finished) {
+    core::Internal internal;
+    World &w = world();
+    for (;;) {
+      Task *next = nullptr;
+      uint64_t nextAt = UINT64_MAX;
+      for (Task *task : w.tasks) {
+        if (task->finished) {
+          continue;
+        }
+        const uint64_t at = task->until && task->until() ? w.now : task->wakeAt;
+        if (next == nullptr || at < nextAt) {
+          next = task;
+          nextAt = at;
+        }
+      }
+      if (!w.events.empty() && w.events.top().at <= nextAt) {
+        runNextEvent();
+        continue;
+      }
+      if (next == nullptr || nextAt == UINT64_MAX) {
+        log('E', "All tasks wait forever, simulation ends.");
+        exit(1);
+      }
+      if (nextAt > w.now) {
+        w.now = nextAt;
+      }
+      next->until = nullptr;
+      switchTo(next, finished);
+      return;
+    }
+  }
+
+  void advanceTo(uint64_t micros) {
+    World &w = world();
+    if (w.inEvent) {
+      // Interrupt handlers run in zero time, they can not wait for later events.
+      return;
+    }
+    w.currentTask->wakeAt = std::max(micros, w.now);
+    w.currentTask->until = nullptr;
+    runTasks(false);
+  }
+
+  void advance(uint64_t micros) {
+    advanceTo(world().now + micros);
+  }
+
+  void consume(uint64_t micros) {
+    advance(micros);
+  }
+
+  void schedule(uint64_t atMicros, std::function<void()> action) {
+    core::Internal internal;
+    World &w = world();
+    w.events.push(Event{atMicros, w.eventSequence++, std::move(action)});
+  }
+
+  void setPinLevel(uint8_t pin, int level) {
+    World &w = world();
+    if (pin >= PIN_COUNT || w.pins[pin] == level) {
+      return;
+    }
+    w.pins[pin] = level;
+    const Interrupt &interrupt = w.interrupts[pin];
+    if (interrupt.handler
+      && (interrupt.mode == CHANGE
+        || (interrupt.mode == RISING && level == HIGH)
+        || (interrupt.mode == FALLING && level == LOW))) {
+      w.statistics.interruptCalls++;
+      const bool nested = w.inEvent;
+      w.inEvent = true;
+      interrupt.handler();
+      w.inEvent = nested;
+    }
+  }
+
+  int pinLevel(uint8_t pin) {
+    return pin < PIN_COUNT ? world().pins[pin] : LOW;
+  }
+
+  void setAnalogValue(uint8_t pin, uint16_t value) {
+    if (pin < PIN_COUNT) {
+      world().analog[pin] = value;
+    }
+  }
+
+  uint16_t analogValue(uint8_t pin) {
+    return pin < PIN_COUNT ? world().analog[pin] : 0;
+  }
+
+  void pressButton(uint8_t pin, uint64_t atMicros, uint32_t durationMicros) {
+    schedule(atMicros, [pin]() { setPinLevel(pin, HIGH); });
+    schedule(atMicros + durationMicros, [pin]() { setPinLevel(pin, LOW); });
+  }
+
+  void addUltrasonicSensor(const UltrasonicSensor &sensor) {
+    SensorState state;
+    state.sensor = sensor;
+    world().sensors.push_back(state);
+    world().statistics.triggers.push_back(0);
+  }
+
+  void setAmbientTemperature(double celsius) {
+    world().temperature = celsius;
+  }
+
+  double ambientTemperature() {
+    return world().temperature;
+  }
+
+  uint32_t echoMicrosForDistance(uint16_t cm) {
+    const double speedOfSound = 331.5 + 0.6 * world().temperature;
+    return (uint32_t) lround(2.0 * cm / 100.0 / speedOfSound * 1000000.0);
+  }
+
+  static void scheduleFall(size_t idx, uint64_t atMicros) {
+    SensorState &state = world().sensors[idx];
+    const uint32_t generation = ++state.fallGeneration;
+    state.busyUntil = atMicros;
+    schedule(atMicros, [idx, generation]() {
+      SensorState &current = world().sensors[idx];
+      if (current.fallGeneration == generation) {
+        setPinLevel(current.sensor.echoPin, LOW);
+      }
+    });
+  }
+
+  /* Ends the measurement of the listening sensor if the burst of the
+   * source sensor comes back while it waits for its own echo.
+   */
+  static void crossTalk(size_t listener, size_t source) {
+    World &w = world();
+    SensorState &state = w.sensors[listener];
+    const uint64_t burstReturn = w.sensors[source].burstReturn;
+    if (burstReturn > state.rise && burstReturn < state.busyUntil) {
+      scheduleFall(listener, burstReturn);
+      w.statistics.crossTalkEchos++;
+    }
+  }
+
+  /* The sensor sends its burst once the trigger pin goes low again and
+   * ignores triggers as long as the echo pin is high.
+   */
+  static void trigger(size_t idx) {
+    World &w = world();
+    SensorState &state = w.sensors[idx];
+    w.statistics.triggers[idx]++;
+    if (state.busyUntil > w.now) {
+      return;
+    }
+    const uint16_t distance = state.sensor.distance ? state.sensor.distance(w.now) : 0;
+    uint32_t duration = state.sensor.noEchoMicros;
+    state.rise = w.now + state.sensor.echoStartDelayMicros;
+    state.burstReturn = 0;
+    if (distance > 0) {
+      const uint32_t flight = echoMicrosForDistance(distance);
+      if (flight < duration) {
+        duration = flight;
+        state.burstReturn = state.rise + flight;
+        w.statistics.echos++;
+      }
+    }
+    const uint8_t echoPin = state.sensor.echoPin;
+    schedule(state.rise, [echoPin]() { setPinLevel(echoPin, HIGH); });
+    scheduleFall(idx, state.rise + duration);
+    if (state.sensor.crossTalkFrom >= 0 && (size_t) state.sensor.crossTalkFrom < w.sensors.size()) {
+      crossTalk(idx, state.sensor.crossTalkFrom);
+    }
+    for (size_t other = 0; other < w.sensors.size(); ++other) {
+      if (w.sensors[other].sensor.crossTalkFrom == (int) idx) {
+        crossTalk(other, idx);
+      }
+    }
+  }
+
+  static uint8_t nmeaChecksum(const std::string &sentence) {
+    uint8_t checksum = 0;
+    for (size_t i = 1; i < sentence.size(); ++i) {
+      checksum ^= (uint8_t) sentence[i];
+    }
+    return checksum;
+  }
+
+  static std::string nmeaSentence(const char *format, ...) {
+    char body[160];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(body, sizeof(body), format, args);
+    va_end(args);
+    std::string sentence(body);
+    char tail[8];
+    snprintf(tail, sizeof(tail), "*%02X\r\n", nmeaChecksum(sentence));
+    return sentence + tail;
+  }
+
+  static std::string nmeaCoordinate(double degrees, bool latitude) {
+    const char hemisphere = latitude ? (degrees < 0 ? 'S' : 'N') : (degrees < 0 ? 'W' : 'E');
+    degrees = fabs(degrees);
+    const int whole = (int) degrees;
+    const double minutes = (degrees - whole) * 60.0;
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), latitude ? "%02d%08.5f,%c" : "%03d%08.5f,%c",
+      whole, minutes, hemisphere);
+    return std::string(buffer);
+  }
+
+  /* Sends the GGA and RMC sentences for the given full GPS second. */
+  static void emitGpsEpoch(uint64_t at) {
+    World &w = world();
+    const GpsTrack &track = w.gpsTrack;
+    const time_t utc = w.gpsEpoch + (time_t) (at / 1000000);
+    struct tm t;
+    gmtime_r(&utc, &t);
+    const bool fix = at >= track.fixAfterMicros;
+
+    const double travelled = track.speedKmh / 3.6 * ((double) at / 1000000.0);
+    const double course = track.courseDegrees * M_PI / 180.0;
+    const double latitude = track.latitude
+      + travelled * cos(course) / EARTH_RADIUS_METERS * 180.0 / M_PI;
+    const double longitude = track.longitude
+      + travelled * sin(course) / (EARTH_RADIUS_METERS * cos(track.latitude * M_PI / 180.0)) * 180.0 / M_PI;
+
+    std::string data;
+    if (fix) {
+      data += nmeaSentence("$GPGGA,%02d%02d%02d.00,%s,%s,1,%02u,%.2f,%.1f,M,47.9,M,,",
+        t.tm_hour, t.tm_min, t.tm_sec,
+        nmeaCoordinate(latitude, true).c_str(), nmeaCoordinate(longitude, false).c_str(),
+        track.satellites, track.hdop, track.altitudeMeters);
+      data += nmeaSentence("$GPRMC,%02d%02d%02d.00,A,%s,%s,%.3f,%.2f,%02d%02d%02d,,,A",
+        t.tm_hour, t.tm_min, t.tm_sec,
+        nmeaCoordinate(latitude, true).c_str(), nmeaCoordinate(longitude, false).c_str(),
+        track.speedKmh / 1.852, track.courseDegrees,
+        t.tm_mday, t.tm_mon + 1, t.tm_year % 100);
+    } else {
+      data += nmeaSentence("$GPGGA,%02d%02d%02d.00,,,,,0,00,99.99,,,,,,",
+        t.tm_hour, t.tm_min, t.tm_sec);
+      data += nmeaSentence("$GPRMC,%02d%02d%02d.00,V,,,,,,,%02d%02d%02d,,,N",
+        t.tm_hour, t.tm_min, t.tm_sec, t.tm_mday, t.tm_mon + 1, t.tm_year % 100);
+    }
+
+    Uart &uart = w.uarts[GPS_UART];
+    const uint64_t byteMicros = 10 * 1000000ULL / (uart.baud ? uart.baud : 9600);
+    uint64_t arrival = at + 80000; // modules report a bit after the full second
+    for (char c : data) {
+      arrival += byteMicros;
+      uart.pending.push_back(std::make_pair(arrival, (uint8_t) c));
+    }
+    schedule(at + 1000000, [at]() { emitGpsEpoch(at + 1000000); });
+  }
+
+  void setGpsTrack(const GpsTrack &track) {
+    world().gpsTrack = track;
+  }
+
+  const std::vector<uint8_t> &gpsModuleReceived() {
+    return world().gpsReceived;
+  }
+
+  void setGpsEpoch(time_t epoch) {
+    world().gpsEpoch = epoch;
+  }
+
+  void setSerialEcho(bool echo) {
+    world().serialEcho = echo;
+  }
+
+  bool serialEcho() {
+    return world().serialEcho;
+  }
+
+  void log(char level, const char *format, ...) {
+    core::Internal internal;
+    if (!world().serialEcho) {
+      return;
+    }
+    va_list args;
+    va_start(args, format);
+    printf("[%c][%9.3fms] ", level, world().now / 1000.0);
+    vprintf(format, args);
+    printf("\n");
+    va_end(args);
+  }
+
+  namespace core {
+
+    /* Nesting of Internal on this thread, each task runs on a thread. */
+    static thread_local int internalDepth = 0;
+
+    Internal::Internal() {
+      internalDepth++;
+    }
+
+    Internal::~Internal() {
+      internalDepth--;
+    }
+
+    bool Internal::active() {
+      return internalDepth > 0;
+    }
+
+    void pinMode(uint8_t pin, uint8_t mode) {
+      // all pins start LOW, nothing to simulate here
+    }
+
+    void digitalWrite(uint8_t pin, uint8_t level) {
+      World &w = world();
+      if (pin >= PIN_COUNT) {
+        return;
+      }
+      const int old = w.pins[pin];
+      setPinLevel(pin, level ? HIGH : LOW);
+      if (old == HIGH && level == LOW) {
+        for (size_t idx = 0; idx < w.sensors.size(); ++idx) {
+          if (w.sensors[idx].sensor.triggerPin == pin) {
+            trigger(idx);
+          }
+        }
+      }
+    }
+
+    void attachInterrupt(uint8_t pin, std::function<void()> handler, int mode) {
+      if (pin < PIN_COUNT) {
+        world().interrupts[pin].handler = std::move(handler);
+        world().interrupts[pin].mode = mode;
+      }
+    }
+
+    void detachInterrupt(uint8_t pin) {
+      if (pin < PIN_COUNT) {
+        world().interrupts[pin] = Interrupt();
+      }
+    }
+
+    void uartBegin(uint8_t uart, uint32_t baud) {
+      World &w = world();
+      if (uart >= UART_COUNT) {
+        return;
+      }
+      w.uarts[uart].baud = baud;
+      if (uart == GPS_UART && !w.gpsRunning) {
+        w.gpsRunning = true;
+        const uint64_t nextSecond = (w.now / 1000000 + 1) * 1000000;
+        schedule(nextSecond, [nextSecond]() { emitGpsEpoch(nextSecond); });
+      }
+    }
+
+    /* Moves all bytes that arrived till now into the receive fifo, bytes
+     * are lost if it is full.
+     */
+    static Uart &receive(uint8_t uart) {
+      World &w = world();
+      Uart &u = w.uarts[uart < UART_COUNT ? uart : 0];
+      while (!u.pending.empty() && u.pending.front().first <= w.now) {
+        if (u.fifo.size() < UART_RX_FIFO_SIZE) {
+          u.fifo.push_back(u.pending.front().second);
+        } else {
+          w.statistics.uartOverflowBytes++;
+        }
+        u.pending.pop_front();
+      }
+      return u;
+    }
+
+    int uartAvailable(uint8_t uart) {
+      Internal internal;
+      return (int) receive(uart).fifo.size();
+    }
+
+    int uartRead(uint8_t uart) {
+      Internal internal;
+      Uart &u = receive(uart);
+      if (u.fifo.empty()) {
+        return -1;
+      }
+      const uint8_t result = u.fifo.front();
+      u.fifo.pop_front();
+      consume(world().costs.uartReadMicros);
+      return result;
+    }
+
+    int uartPeek(uint8_t uart) {
+      Internal internal;
+      Uart &u = receive(uart);
+      return u.fifo.empty() ? -1 : u.fifo.front();
+    }
+
+    void uartWrite(uint8_t uart, const uint8_t *data, size_t size) {
+      Internal internal;
+      World &w = world();
+      if (uart == GPS_UART) {
+        w.gpsReceived.insert(w.gpsReceived.end(), data, data + size);
+      } else if (w.serialEcho) {
+        fwrite(data, 1, size, stdout);
+      }
+    }
+
+    time_t deviceTime(uint32_t *micros) {
+      const int64_t now = (int64_t) world().now + world().deviceClockOffsetMicros;
+      if (micros) {
+        *micros = (uint32_t) (now % 1000000);
+      }
+      return (time_t) (now / 1000000);
+    }
+
+    void setDeviceTime(time_t seconds, uint32_t micros) {
+      world().deviceClockOffsetMicros =
+        (int64_t) seconds * 1000000 + micros - (int64_t) world().now;
+    }
+
+    uint32_t random() {
+      uint32_t x = world().randomState;
+      x ^= x << 13;
+      x ^= x >> 17;
+      x ^= x << 5;
+      world().randomState = x;
+      return x;
+    }
+
+    void *currentTask() {
+      return world().currentTask;
+    }
+
+    void *createTask(std::function<void()> code, const char *name) {
+      World &w = world();
+      Task *task = new Task(name);
+      task->wakeAt = w.now;
+      w.tasks.push_back(task);
+      std::thread([task, code]() {
+        World &w = world();
+        {
+          std::unique_lock<std::mutex> lock(w.taskSwitch);
+          task->resume.wait(lock, [&w, task]() { return w.currentTask == task; });
+        }
+        try {
+          code();
+        } catch (const TaskEnd &) {
+        }
+        task->finished = true;
+        runTasks(true);
+      }).detach();
+      return task;
+    }
+
+    void endTask() {
+      assert(world().currentTask != world().tasks[0]);
+      throw TaskEnd();
+    }
+
+    bool waitUntil(std::function<bool()> condition, uint64_t timeoutMicros) {
+      World &w = world();
+      if (condition() || timeoutMicros == 0 || w.inEvent) {
+        return condition();
+      }
+      w.currentTask->wakeAt =
+        timeoutMicros > UINT64_MAX - w.now ? UINT64_MAX : w.now + timeoutMicros;
+      w.currentTask->until = condition;
+      runTasks(false);
+      return condition();
+    }
+
+    void notifyGive(void *task) {
+      static_cast<Task *>(task)->notifications++;
+    }
+
+    uint32_t notifyTake(bool clear, uint64_t timeoutMicros) {
+      Task *self = world().currentTask;
+      waitUntil([self]() { return self->notifications > 0; }, timeoutMicros);
+      const uint32_t result = self->notifications;
+      if (result > 0) {
+        self->notifications = clear ? 0 : result - 1;
+      }
+      return result;
+    }
+  }
+}
+
+/* The firmware sets the system time from GPS, this must not touch the
+ * clock of the host. The native build links with --wrap for these.
+ */
+extern "C" {
+  time_t __wrap_time(time_t *t) {
+    const time_t now = sim::core::deviceTime(nullptr);
+    if (t) {
+      *t = now;
+    }
+    return now;
+  }
+
+  int __wrap_gettimeofday(struct timeval *tv, void *tz) {
+    uint32_t micros;
+    tv->tv_sec = sim::core::deviceTime(&micros);
+    tv->tv_usec = micros;
+    return 0;
+  }
+
+  int __wrap_settimeofday(const struct timeval *tv, const void *tz) {
+    if (tv) {
+      sim::core::setDeviceTime(tv->tv_sec, (uint32_t) tv->tv_usec);
+    }
+    return 0;
+  }
+}
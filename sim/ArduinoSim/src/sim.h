@@ -0,0 +1,206 @@
+/*
+  Copyright (C) 2019-2021 OpenBikeSensor Contributors
+  Contact: https://openbikesensor.org
+
+  This file is part of the OpenBikeSensor project.
+
+  The OpenBikeSensor sensor firmware is free software: you can redistribute
+  it and/or modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the License,
+  or (at your option) any later version.
+
+  The OpenBikeSensor sensor firmware is distributed in the hope that it will
+  be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+  Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with
+  the OpenBikeSensor sensor firmware.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef OBS_SIM_SIM_H
+#define OBS_SIM_SIM_H
+
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <string>
+#include <vector>
+
+/* Control interface of the host simulation.
+ *
+ * Nothing in here runs in real time. The firmware sees a virtual clock
+ * that only moves when it waits (delay(), delayMicroseconds(), yield())
+ * or when it calls something that costs time on the real device (display
+ * refresh, SD access, ...). Pin edges, NMEA bytes and button presses are
+ * events on that clock, interrupt handlers run at the exact virtual time
+ * of their edge. Every run with the same scenario gives the same result.
+ */
+namespace sim {
+
+  /* Time in microseconds the simulation charges for operations that are
+   * slow on the real hardware. Defaults are rough measurements from an
+   * OBS with a SSD1306 on 500kHz I2C and a class 10 SD card.
+   */
+  struct Costs {
+    /* Resolution of busy waits that call yield(). */
+    uint32_t yieldMicros = 10;
+    /* Full frame transfer to the SSD1306, 1k over I2C. */
+    uint32_t displayMicros = 18400;
+    /* Reading and decoding one byte from the UART. */
+    uint32_t uartReadMicros = 3;
+    uint32_t sdOpenMicros = 4000;
+    uint32_t sdCloseMicros = 2500;
+    uint32_t sdMicrosPerKiB = 1600;
+    uint32_t adcReadMicros = 10;
+  };
+
+  /* A ultrasonic sensor attached to a trigger and echo pin. distance() is
+   * asked for the distance in cm of the closest object when the sensor
+   * emits its burst, 0 means there is nothing to reflect the signal.
+   */
+  struct UltrasonicSensor {
+    uint8_t triggerPin;
+    uint8_t echoPin;
+    std::function<uint16_t(uint64_t micros)> distance;
+    /* Delay between the end of the trigger pulse and the raising echo. */
+    uint32_t echoStartDelayMicros = 300;
+    /* Echo high time if nothing reflects, JSN-SR04T: 58ms, HC-SR04: 71ms. */
+    uint32_t noEchoMicros = 58000;
+    /* Index, order of addUltrasonicSensor(), of a sensor whose burst also
+     * reaches this one, e.g. over the bike. If the echo of that burst
+     * comes in while this sensor listens, it ends the measurement. -1 for
+     * none.
+     */
+    int crossTalkFrom = -1;
+  };
+
+  /* Scripted ride for the NMEA feed on UART 1. */
+  struct GpsTrack {
+    double latitude = 48.78427;
+    double longitude = 9.18213;
+    double altitudeMeters = 247.5;
+    double courseDegrees = 90.0;
+    double speedKmh = 18.0;
+    uint8_t satellites = 8;
+    double hdop = 1.2;
+    /* Time after switch on until the module reports a fix. */
+    uint64_t fixAfterMicros = 2000000;
+  };
+
+  struct Statistics {
+    /* Trigger pulses seen by each sensor in the order of registration. */
+    std::vector<uint32_t> triggers;
+    uint32_t echos = 0;
+    /* Measurements ended by the burst of another sensor. */
+    uint32_t crossTalkEchos = 0;
+    uint32_t interruptCalls = 0;
+    uint32_t displayRefreshes = 0;
+    uint32_t bleNotifications = 0;
+    uint32_t uartOverflowBytes = 0;
+    uint32_t sdOpens = 0;
+    uint64_t sdBytesWritten = 0;
+    /* Longest time a file was open for writing. */
+    uint64_t sdMaxWriteSessionMicros = 0;
+    uint64_t sdWriteSessionMicros = 0;
+    /* Longest single write() or flush() of a file. */
+    uint64_t sdMaxWriteMicros = 0;
+  };
+
+  /* Resets the complete simulation, the virtual clock starts at 0. */
+  void reset();
+
+  Costs &costs();
+  Statistics &statistics();
+
+  /* Virtual time since "power on". */
+  uint64_t micros();
+
+  /* Lets the virtual time pass, fires all events that are due. */
+  void advance(uint64_t micros);
+  void advanceTo(uint64_t micros);
+
+  /* Time the current code is busy with an operation of the given length. */
+  void consume(uint64_t micros);
+
+  /* Runs the action at the given virtual time. */
+  void schedule(uint64_t atMicros, std::function<void()> action);
+
+  /* Drives a input pin from the outside, attached interrupts fire. */
+  void setPinLevel(uint8_t pin, int level);
+  int pinLevel(uint8_t pin);
+  void setAnalogValue(uint8_t pin, uint16_t value);
+  uint16_t analogValue(uint8_t pin);
+
+  /* Presses the button on the given pin for the given time. */
+  void pressButton(uint8_t pin, uint64_t atMicros, uint32_t durationMicros);
+
+  void addUltrasonicSensor(const UltrasonicSensor &sensor);
+  /* Air temperature used to calculate the echo time of flight. */
+  void setAmbientTemperature(double celsius);
+  double ambientTemperature();
+  /* Microseconds a echo of an object in the given distance takes. */
+  uint32_t echoMicrosForDistance(uint16_t cm);
+
+  void setGpsTrack(const GpsTrack &track);
+  /* Bytes sent to the GPS module, used to check the module configuration. */
+  const std::vector<uint8_t> &gpsModuleReceived();
+  /* UTC time the GPS module knows at virtual time 0. */
+  void setGpsEpoch(time_t epoch);
+
+  /* Drops the data written to the SD card since the last flush() or
+   * close() of each file, as a power loss does. */
+  void loseUnsyncedSdData();
+
+  /* Heap allocations (operator new) of the firmware so far, the
+   * simulation does not count its own. Not available to tests that
+   * replace operator new themselves. */
+  uint64_t heapAllocations();
+
+  /* Echo Serial and log output to stdout. */
+  void setSerialEcho(bool echo);
+  bool serialEcho();
+  void log(char level, const char *format, ...) __attribute__ ((format (printf, 2, 3)));
+
+  /* Internal API used by the stand-in Arduino core. */
+  namespace core {
+    /* Code of the simulation runs on the current thread while an instance
+     * lives, its heap allocations are not the firmware's. */
+    class Internal {
+      public:
+        Internal();
+        ~Internal();
+        Internal(const Internal &) = delete;
+        Internal &operator=(const Internal &) = delete;
+        static bool active();
+    };
+    void pinMode(uint8_t pin, uint8_t mode);
+    void digitalWrite(uint8_t pin, uint8_t level);
+    void attachInterrupt(uint8_t pin, std::function<void()> handler, int mode);
+    void detachInterrupt(uint8_t pin);
+    void uartBegin(uint8_t uart, uint32_t baud);
+    int uartAvailable(uint8_t uart);
+    int uartRead(uint8_t uart);
+    int uartPeek(uint8_t uart);
+    void uartWrite(uint8_t uart, const uint8_t *data, size_t size);
+    time_t deviceTime(uint32_t *micros);
+    void setDeviceTime(time_t seconds, uint32_t micros);
+    uint32_t random();
+    void resetFileSystems();
+    /* FreeRTOS tasks, see Task in sim.cpp for the scheduling. */
+    void *currentTask();
+    void *createTask(std::function<void()> code, const char *name);
+    /* Ends the current task, does not return. */
+    void endTask();
+    /* Lets the virtual time pass for the current task until the condition
+     * is true or the timeout expired, returns the condition.
+     */
+    bool waitUntil(std::function<bool()> condition, uint64_t timeoutMicros);
+    void notifyGive(void *task);
+    /* Lets the virtual time pass until the task got a notification or the
+     * timeout expired, returns the notification count before the call.
+     */
+    uint32_t notifyTake(bool clear, uint64_t timeoutMicros);
+  }
+}
+
+#endif //OBS_SIM_SIM_H
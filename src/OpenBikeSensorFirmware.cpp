@@ -44,7 +44,6 @@ const uint8_t BatterieVoltage_PIN = 34;
 
 int confirmedMeasurements = 0;
 int numButtonReleased = 0;
-DataSet *datasetToConfirm = nullptr;
 
 int buttonState = 0;
 
@@ -65,9 +64,8 @@ VoltageMeter* voltageMeter;
 
 String esp_chipid;
 
-#ifdef DEVELOP
 Adafruit_BMP280 bmp280(&Wire);
-#endif
+bool bmp280Found = false;
 
 // --- Local variables ---
 unsigned long measureInterval = 1000;
@@ -83,7 +81,14 @@ int lastButtonState = 0;
 
 String filename;
 
-CircularBuffer<DataSet*, 10> dataBuffer;
+/* The current interval and the ones waiting for a confirmation, oldest
+ * first. A full ring writes its oldest interval at the end of loop(). */
+IntervalRing<DataSet, DATA_BUFFER_SIZE> intervals(measureInterval);
+/* Free heap at the end of the last loop(), stays the same once the
+ * track is started. */
+uint32_t lastFreeHeap = 0;
+/* The last interval was inside a privacy area, a change is an event. */
+bool lastInsidePrivacyArea = false;
 
 FileWriter* writer;
 
@@ -97,7 +102,13 @@ const uint8_t displayAddress = 0x3c;
 int lastMeasurements = 0 ;
 
 void bluetoothConfirmed(const DataSet *dataSet, uint16_t measureIndex);
+int intervalToConfirm();
+void writeOldestInterval(uint8_t confirmationSensorID);
+void writeEvent(TrackEvent::Type type, const DataSet *set, uint16_t measureIndex, uint16_t value,
+  uint32_t atMillis = 0);
+void writeFixes();
 uint8_t batteryPercentage();
+void updateTemperature();
 
 // The BMP280 can keep up to 3.4MHz I2C speed, so no need for an individual slower speed
 
@@ -215,6 +226,28 @@ void setup() {
     displayTest->showTextOnGrid(2, 2, "SD... ok",DEFAULT_FONT);
   }
 
+  //##############################################################
+  // Init HCSR04
+  //##############################################################
+
+  sensorManager = new HCSR04SensorManager;
+
+  HCSR04SensorInfo sensorManaged1;
+  sensorManaged1.triggerPin = (config.displayConfig & DisplaySwapSensors) ? 25 : 15;
+  sensorManaged1.echoPin = (config.displayConfig & DisplaySwapSensors) ? 26 : 4;
+  sensorManaged1.sensorLocation = (char*) "Right"; // TODO
+  sensorManager->registerSensor(sensorManaged1);
+
+  HCSR04SensorInfo sensorManaged2;
+  sensorManaged2.triggerPin = (config.displayConfig & DisplaySwapSensors) ? 15 : 25;
+  sensorManaged2.echoPin = (config.displayConfig & DisplaySwapSensors) ? 4 : 26;
+  sensorManaged2.sensorLocation = (char*) "Left"; // TODO
+  sensorManager->registerSensor(sensorManaged2);
+
+  sensorManager->setOffsets(config.sensorOffsets);
+  sensorManager->setInterferenceGroups(config.sensorInterferenceGroups);
+  sensorManager->setParallelTrigger(config.parallelTrigger);
+
   //##############################################################
   // Check, if the button is pressed
   // Enter configuration mode and enable OTA
@@ -240,28 +273,6 @@ void setup() {
   SPIFFS.end();
   WiFiGenericClass::mode(WIFI_OFF);
 
-  //##############################################################
-  // Init HCSR04
-  //##############################################################
-
-  sensorManager = new HCSR04SensorManager;
-
-  HCSR04SensorInfo sensorManaged1;
-  sensorManaged1.triggerPin = (config.displayConfig & DisplaySwapSensors) ? 25 : 15;
-  sensorManaged1.echoPin = (config.displayConfig & DisplaySwapSensors) ? 26 : 4;
-  sensorManaged1.sensorLocation = (char*) "Right"; // TODO
-  sensorManager->registerSensor(sensorManaged1);
-
-  HCSR04SensorInfo sensorManaged2;
-  sensorManaged2.triggerPin = (config.displayConfig & DisplaySwapSensors) ? 15 : 25;
-  sensorManaged2.echoPin = (config.displayConfig & DisplaySwapSensors) ? 4 : 26;
-  sensorManaged2.sensorLocation = (char*) "Left"; // TODO
-  sensorManager->registerSensor(sensorManaged2);
-
-  sensorManager->setOffsets(config.sensorOffsets);
-
-  sensorManager->setPrimarySensor(LEFT_SENSOR_ID);
-
   //##############################################################
   // Prepare CSV file
   //##############################################################
@@ -271,9 +282,27 @@ void setup() {
   const String trackUniqueIdentifier = ObsUtils::createTrackUuid();
 
   if (SD.begin()) {
-    writer = new CSVFileWriter;
+    FileWriter::recoverUnfinishedTrack();
+    if (config.binaryTrack) {
+      auto *binaryWriter = new BinaryFileWriter(config.gzipTrack, config.rawEchoTrack);
+      if (config.rawEchoTrack) {
+        sensorManager->setEchoListener(
+          [binaryWriter](uint32_t triggerMillis, uint8_t sensorId, int32_t echoDurationMicroseconds) {
+            // the echo is hidden with the interval it was triggered in
+            const int interval = intervals.find(triggerMillis);
+            const DataSet *set = interval >= 0 ? intervals.at(interval) : intervals.newest();
+            if (set) {
+              binaryWriter->appendEcho(*set, triggerMillis, sensorId, echoDurationMicroseconds);
+            }
+          });
+      }
+      writer = binaryWriter;
+    } else {
+      writer = new CSVFileWriter(config.gzipTrack);
+    }
     writer->setFileName();
     writer->writeHeader(trackUniqueIdentifier);
+    writer->appendEvent({currentTime(), (uint32_t) millis(), 0, 0, TrackEvent::BOOT});
     displayTest->showTextOnGrid(2, 3, "CSV file... ok",DEFAULT_FONT);
     Serial.println("File initialised");
   } else {
@@ -295,11 +324,8 @@ void setup() {
   // Temperatur Sensor BMP280
   //##############################################################
 
-  #ifdef DEVELOP
-
-  TemperatureValue = bmp280.begin(BMP280_ADDRESS_ALT,BMP280_CHIPID);
-  TemperatureValue = bmp280.readTemperature();
-  #endif
+  bmp280Found = bmp280.begin(BMP280_ADDRESS_ALT,BMP280_CHIPID);
+  updateTemperature();
 
   //##############################################################
   // Bluetooth
@@ -388,6 +414,11 @@ void setup() {
 
   // Clear the display once!
   displayTest->clear();
+
+  // from now on the sensors are triggered independent of loop()
+  sensorManager->startMeasurementTask();
+  // and the GPS data is parsed independent of loop()
+  startGpsTask();
 }
 
 
@@ -395,7 +426,7 @@ void loop() {
 
   Serial.println("loop()");
 
-  auto* currentSet = new DataSet;
+  DataSet* currentSet = intervals.push(millis());
   //specify which sensors value can be confirmed by pressing the button, should be configurable
   const uint8_t confirmationSensorID = LEFT_SENSOR_ID;
   readGPSData(); // needs <=1ms
@@ -406,16 +437,25 @@ void loop() {
   }
   currentSet->time = currentTime();
   currentSet->millis = currentTimeMillis;
-  currentSet->location = gps.location;
-  currentSet->altitude = gps.altitude;
-  currentSet->course = gps.course;
-  currentSet->speed = gps.speed;
-  currentSet->hdop = gps.hdop;
-  currentSet->validSatellites = gps.satellites.isValid() ? (uint8_t) gps.satellites.value() : 0;
-  currentSet->batteryLevel = voltageMeter->read();
-  currentSet->isInsidePrivacyArea = isInsidePrivacyArea(currentSet->location);
+  NavPvt pvt;
+  if (recentNavPvt(pvt)) {
+    currentSet->setGpsValues(pvt);
+    currentSet->isInsidePrivacyArea = isInsidePrivacyArea(pvt.latitude / 1e7, pvt.longitude / 1e7);
+  } else {
+    currentSet->setGpsValues(gps);
+    currentSet->isInsidePrivacyArea = isInsidePrivacyArea(gps.location);
+  }
+  currentSet->setBatteryLevel(voltageMeter->read());
+  if (currentSet->isInsidePrivacyArea != lastInsidePrivacyArea) {
+    writeEvent(currentSet->isInsidePrivacyArea ? TrackEvent::PRIVACY_ENTER : TrackEvent::PRIVACY_EXIT,
+      currentSet, 0, 0);
+    lastInsidePrivacyArea = currentSet->isInsidePrivacyArea;
+  }
+  writeFixes();
+  updateTemperature();
+  currentSet->factor = sensorManager->getMicrosecondsPerCm();
 
-  sensorManager->reset();
+  sensorManager->reset(&currentSet->timeline);
 
   int measurements = 0;
 
@@ -424,15 +464,29 @@ void loop() {
   if ((timeDelta ) > (config.confirmationTimeWindow * 1000)) {
     Serial.println(">>> CTW reached - reset() <<<");
     minDistanceToConfirm = MAX_SENSOR_VALUE;
-    datasetToConfirm = nullptr;
   }
 
   // do this for the time specified by measureInterval, e.g. 1s
   while ((currentTimeMillis - startTimeMillis) < measureInterval) {
 
+    // the measurement task triggers the sensors, we take all readings that
+    // arrived meanwhile and wait for the next one if there is none
+    TickType_t wait = pdMS_TO_TICKS(measureInterval - min(measureInterval, millis() - startTimeMillis));
+    while (sensorManager->processNextReading(wait)) {
+      wait = 0;
+      currentTimeMillis = millis();
+      // if a new minimum on the selected sensor is detected, the value and the time of detection will be stored
+      if (sensorManager->sensorValues[confirmationSensorID] > 0
+        && sensorManager->sensorValues[confirmationSensorID] < minDistanceToConfirm) {
+        minDistanceToConfirm = sensorManager->sensorValues[confirmationSensorID];
+        minDistanceToConfirmIndex = sensorManager->getLastMeasureIndex(confirmationSensorID);
+        timeOfMinimum = currentTimeMillis;
+      }
+      measurements++;
+    }
     currentTimeMillis = millis();
-    sensorManager->getDistances();
     readGPSData();
+    writeFixes();
 
     #ifndef DEVELOP
     displayTest->showValues(
@@ -461,14 +515,21 @@ void loop() {
     if (bluetoothManager
         && lastBluetoothInterval != (currentTimeMillis / BLUETOOTH_INTERVAL_MILLIS)) {
       log_d("Reporting BT: %d/%d Button: %d\n",
-                    sensorManager->m_sensors[LEFT_SENSOR_ID].median->median(),
-                    sensorManager->m_sensors[RIGHT_SENSOR_ID].median->median(),
+                    sensorManager->getRawMedianDistance(LEFT_SENSOR_ID),
+                    sensorManager->getRawMedianDistance(RIGHT_SENSOR_ID),
                     buttonState);
       lastBluetoothInterval = currentTimeMillis / BLUETOOTH_INTERVAL_MILLIS;
       bluetoothManager->newSensorValues(
         currentTimeMillis,
-        sensorManager->m_sensors[LEFT_SENSOR_ID].median->median(),
-        sensorManager->m_sensors[RIGHT_SENSOR_ID].median->median());
+        sensorManager->getRawMedianDistance(LEFT_SENSOR_ID),
+        sensorManager->getRawMedianDistance(RIGHT_SENSOR_ID));
+    }
+    if (bluetoothManager) {
+      const uint16_t marks = bluetoothManager->takeMarks();
+      if (marks > 0) {
+        writeEvent(TrackEvent::MARK, currentSet, sensorManager->getCurrentMeasureIndex(), marks,
+          currentTimeMillis);
+      }
     }
 
     buttonState = digitalRead(PushButton_PIN);
@@ -485,37 +546,24 @@ void loop() {
 
         transmitConfirmedData = true;
         numButtonReleased++;
-        if (datasetToConfirm != nullptr) {
-          datasetToConfirm->confirmedDistances.push_back(minDistanceToConfirm);
-          datasetToConfirm->confirmedDistancesTimeOffset.push_back(minDistanceToConfirmIndex);
-          bluetoothConfirmed(datasetToConfirm, minDistanceToConfirmIndex);
-          datasetToConfirm = nullptr;
+        const int confirmedInterval = intervalToConfirm();
+        if (confirmedInterval >= 0) {
+          DataSet* confirmedSet = intervals.at(confirmedInterval);
+          confirmedSet->confirmations.push_back({minDistanceToConfirmIndex, minDistanceToConfirm});
+          writeEvent(TrackEvent::CONFIRM, confirmedSet, minDistanceToConfirmIndex, minDistanceToConfirm,
+            timeOfMinimum);
+          bluetoothConfirmed(confirmedSet, minDistanceToConfirmIndex);
         } else { // confirming a overtake without left measure
-          currentSet->confirmedDistances.push_back(MAX_SENSOR_VALUE);
-          currentSet->confirmedDistancesTimeOffset.push_back(
-            sensorManager->getCurrentMeasureIndex());
-          bluetoothConfirmed(currentSet, sensorManager->getCurrentMeasureIndex());
+          const uint16_t measureIndex = sensorManager->getCurrentMeasureIndex();
+          currentSet->confirmations.push_back({measureIndex, MAX_SENSOR_VALUE});
+          writeEvent(TrackEvent::CONFIRM, currentSet, measureIndex, MAX_SENSOR_VALUE, millis());
+          bluetoothConfirmed(currentSet, measureIndex);
         }
         minDistanceToConfirm = MAX_SENSOR_VALUE; // ready for next confirmation
       }
       lastButtonState = buttonState;
     }
 
-    // if a new minimum on the selected sensor is detected, the value and the time of detection will be stored
-    if (sensorManager->sensorValues[confirmationSensorID] > 0
-      && sensorManager->sensorValues[confirmationSensorID] < minDistanceToConfirm) {
-      minDistanceToConfirm = sensorManager->sensorValues[confirmationSensorID];
-      minDistanceToConfirmIndex = sensorManager->getCurrentMeasureIndex();
-      // if there was no measurement of this sensor for this index, it is the
-      // one before. This happens with fast confirmations.
-      if (sensorManager->m_sensors[confirmationSensorID].echoDurationMicroseconds[minDistanceToConfirm - 1] <= 0) {
-        minDistanceToConfirmIndex--;
-      }
-      datasetToConfirm = currentSet;
-      timeOfMinimum = currentTimeMillis;
-    }
-    measurements++;
-
       // #######################################################
       // Batterievoltage
       // #######################################################
@@ -524,41 +572,37 @@ void loop() {
       {
         BatteryValue = (float) movingaverage(&voltageBuffer,&BatterieVoltage_movav,batterie_voltage_read(BatterieVoltage_PIN));
         BatteryValue = (float)get_batterie_percent((uint16_t)BatteryValue);
-        currentSet->batteryLevel = BatteryValue;
+        currentSet->setBatteryLevel(BatteryValue);
         }else{
         (float) movingaverage(&voltageBuffer,&BatterieVoltage_movav,batterie_voltage_read(BatterieVoltage_PIN));
         BatteryValue = -1;
       }
-
-      #ifdef DEVELOP
-        TemperatureValue = bmp280.readTemperature();
-      #endif
   } // end measureInterval while
+  log_d("Readings: %d, left: %u/s, right: %u/s, max trigger jitter: %uus, lost readings: %u, dropped records: %u, rejected readings: %u",
+    measurements,
+    sensorManager->getReadingsPerSecond(LEFT_SENSOR_ID, currentTimeMillis - startTimeMillis),
+    sensorManager->getReadingsPerSecond(RIGHT_SENSOR_ID, currentTimeMillis - startTimeMillis),
+    sensorManager->getMaxTriggerJitterMicroseconds(), sensorManager->lostReadings,
+    sensorManager->droppedRecords, sensorManager->rejectedReadings);
+  if (writer) {
+    const WriterStatistics &writerStatistics = writer->getStatistics();
+    log_d("SD writes: %u, syncs: %u, failed: %u, dropped: %u bytes, max queued buffers: %u, write time p50: %ums, p99: %ums, max: %ums",
+      writerStatistics.writes, writerStatistics.syncs, writerStatistics.failedWrites, writerStatistics.droppedBytes,
+      writerStatistics.maxQueueDepth, writerStatistics.writeMillisPercentile(50),
+      writerStatistics.writeMillisPercentile(99), writerStatistics.maxWriteMillis);
+  }
+  // with the sets in the interval ring a loop() takes nothing from the heap,
+  // test/native_sim checks this
+  const uint32_t freeHeap = ESP.getFreeHeap();
+  log_d("Free heap: %u (%d since last loop), min free heap: %u, intervals waiting: %u/%u",
+    freeHeap, lastFreeHeap ? (int32_t) (freeHeap - lastFreeHeap) : 0, ESP.getMinFreeHeap(),
+    (unsigned) intervals.size(), (unsigned) intervals.capacity());
+  lastFreeHeap = freeHeap;
 
   // Write the minimum values of the while-loop to a set
   for (auto & m_sensor : sensorManager->m_sensors) {
     currentSet->sensorValues.push_back(m_sensor.minDistance);
   }
-  currentSet->measurements = sensorManager->lastReadingCount;
-  memcpy(&(currentSet->readDurationsRightInMicroseconds),
-    &(sensorManager->m_sensors[0].echoDurationMicroseconds), currentSet->measurements * sizeof(int32_t));
-  memcpy(&(currentSet->readDurationsLeftInMicroseconds),
-    &(sensorManager->m_sensors[1].echoDurationMicroseconds), currentSet->measurements * sizeof(int32_t));
-  memcpy(&(currentSet->startOffsetMilliseconds),
-    &(sensorManager->startOffsetMilliseconds), currentSet->measurements * sizeof(uint16_t));
-
-  // if nothing was detected, write the dataset to file, otherwise write it to the buffer for confirmation
-  if (!transmitConfirmedData
-    && currentSet->sensorValues[confirmationSensorID] == MAX_SENSOR_VALUE
-    && dataBuffer.isEmpty()) {
-    Serial.write("Empty Buffer, writing directly ");
-    if (writer) {
-      writer->append(*currentSet);
-    }
-    delete currentSet;
-  } else {
-    dataBuffer.push(currentSet);
-  }
 
 #ifdef DEVELOP
   Serial.write("min. distance: ");
@@ -568,30 +612,28 @@ void loop() {
   Serial.write(" measurements  \n");
 #endif
 
+  // if nothing was detected, write the dataset to file, otherwise keep it for confirmation
+  if (!transmitConfirmedData
+    && currentSet->sensorValues[confirmationSensorID] == MAX_SENSOR_VALUE
+    && intervals.size() == 1) {
+    Serial.write("Empty Buffer, writing directly ");
+    writeOldestInterval(confirmationSensorID);
+  }
+
   lastMeasurements = measurements;
 
   if (transmitConfirmedData) {
-    // Empty buffer by writing it, after confirmation it will be written to SD card directly so no confirmed sets will be lost
-    while (!dataBuffer.isEmpty() && dataBuffer.first() != datasetToConfirm) {
-      DataSet* dataset = dataBuffer.shift();
-      if (dataset->confirmedDistances.empty()) {
-        if (writer) {
-          writer->append(*dataset);
-        }
-      }
-      // write record as many times as we have confirmed values
-      for (int i = 0; i < dataset->confirmedDistances.size(); i++) {
-        // make sure the distance reported is the one that was confirmed
-        dataset->sensorValues[confirmationSensorID] = dataset->confirmedDistances[i];
-        dataset->confirmed = dataset->confirmedDistancesTimeOffset[i];
-        confirmedMeasurements++;
-        if (writer) {
-          writer->append(*dataset);
-        }
-      }
-      delete dataset;
+    // the current interval might be written below, keep what the event needs
+    const TrackEvent flushEvent = {currentSet->time, currentSet->millis, 0, 0, TrackEvent::FLUSH};
+    // Write all intervals before the one with a minimum still to confirm,
+    // after confirmation it will be written to SD card directly so no confirmed sets will be lost
+    int pending = intervalToConfirm();
+    while (!intervals.empty() && pending != 0) {
+      writeOldestInterval(confirmationSensorID);
+      pending--;
     }
-    if (writer) {  // "flush"
+    if (writer) {  // hand the confirmed sets to the SD writer task
+      writer->appendEvent(flushEvent);
       writer->flush();
     }
     Serial.printf(">>> flush - reset <<<");
@@ -604,19 +646,14 @@ void loop() {
     }
   }
 
-  // If the circular buffer is full, write just one set to the writers buffer,
-  if (dataBuffer.isFull()) { // TODO: Same code as above
-    DataSet* dataset = dataBuffer.shift();
+  // If the ring is full, write just the oldest interval to the writers buffer
+  if (intervals.full()) {
     Serial.printf("data buffer full, writing set to file buffer\n");
-    if (writer) {
-      writer->append(*dataset);
-    }
-    // we are about to delete the to be confirmed dataset, so take care for this.
-    if (datasetToConfirm == dataset) {
-      datasetToConfirm = nullptr;
+    // the minimum to confirm is about to be written, so take care for this.
+    if (intervalToConfirm() == 0) {
       minDistanceToConfirm = MAX_SENSOR_VALUE;
     }
-    delete dataset;
+    writeOldestInterval(confirmationSensorID);
   }
 
   Serial.printf("Time elapsed %lu milliseconds\n", currentTimeMillis - startTimeMillis);
@@ -624,33 +661,99 @@ void loop() {
   startTimeMillis = (currentTimeMillis / measureInterval) * measureInterval;
 }
 
-void bluetoothConfirmed(const DataSet *dataSet, uint16_t measureIndex) {
-  if (bluetoothManager) {
-    uint16_t left = dataSet->readDurationsLeftInMicroseconds[measureIndex];
-    if (left >= MAX_DURATION_MICRO_SEC && measureIndex > 0) {
-      measureIndex--;
-      left = dataSet->readDurationsLeftInMicroseconds[measureIndex];
-    }
-    uint16_t right = dataSet->readDurationsRightInMicroseconds[measureIndex];
-    if (right >= MAX_DURATION_MICRO_SEC && measureIndex > 0) {
-      right = dataSet->readDurationsLeftInMicroseconds[measureIndex - 1];
+/* Index of the interval with the minimum a button press would confirm,
+ * -1 if there is none or it was written already. */
+int intervalToConfirm() {
+  return minDistanceToConfirm < MAX_SENSOR_VALUE ? intervals.find(timeOfMinimum) : -1;
+}
+
+/* Writes the oldest interval once and drops it. With confirmations, the
+ * row holds the closest one, see DataSet::confirmed. */
+void writeOldestInterval(uint8_t confirmationSensorID) {
+  DataSet* dataset = intervals.oldest();
+  if (!dataset->confirmations.empty()) {
+    const Confirmation* closest = &dataset->confirmations[0];
+    for (const Confirmation &confirmation : dataset->confirmations) {
+      if (confirmation.distance < closest->distance) {
+        closest = &confirmation;
+      }
     }
-    if (left > MAX_DURATION_MICRO_SEC || left <= 0) {
-      left = MAX_SENSOR_VALUE;
-    } else {
-      left /= MICRO_SEC_TO_CM_DIVIDER;
+    // make sure the distance reported is the one that was confirmed
+    dataset->sensorValues[confirmationSensorID] = closest->distance;
+    dataset->confirmed = closest->measureIndex;
+    confirmedMeasurements += dataset->confirmations.size();
+  }
+  if (writer) {
+    writer->append(*dataset);
+  }
+  intervals.pop();
+}
+
+/* Events are written right away, the interval they refer to might still
+ * wait for a confirmation. */
+void writeEvent(TrackEvent::Type type, const DataSet *set, uint16_t measureIndex, uint16_t value,
+                uint32_t atMillis) {
+  if (writer) {
+    writer->appendEvent({set->time, set->millis, measureIndex, value, type, atMillis});
+  }
+}
+
+/* Writes the NAV-PVT fixes parsed since the last call, the privacy of the
+ * interval they arrived in applies. Call after the privacy of the current
+ * interval was evaluated. */
+void writeFixes() {
+  NavPvtSample sample;
+  while (takeNavPvt(sample)) {
+    const int interval = intervals.find(sample.millis);
+    DataSet *set = interval >= 0 ? intervals.at(interval) : intervals.newest();
+    if (writer && set) {
+      writer->appendFix(*set, sample.pvt, sample.millis,
+        isInsidePrivacyArea(sample.pvt.latitude / 1e7, sample.pvt.longitude / 1e7));
     }
-    if (right > MAX_DURATION_MICRO_SEC || right <= 0) {
-      right = MAX_SENSOR_VALUE;
-    } else {
-      right /= MICRO_SEC_TO_CM_DIVIDER;
+  }
+}
+
+/* Reports the last distances of both sensors up to the confirmed record. */
+void bluetoothConfirmed(const DataSet *dataSet, uint16_t measureIndex) {
+  if (bluetoothManager) {
+    uint16_t left = MAX_SENSOR_VALUE;
+    uint16_t right = MAX_SENSOR_VALUE;
+    uint16_t offsetMilliseconds = 0;
+    uint16_t idx = 0;
+    for (const TimelineRecord &record : dataSet->timeline) {
+      if (idx++ > measureIndex) {
+        break;
+      }
+      offsetMilliseconds = record.offsetMilliseconds;
+      if (record.echoDurationMicroseconds <= 0
+          || record.echoDurationMicroseconds >= (int32_t) MAX_DURATION_MICRO_SEC) {
+        continue;
+      }
+      const uint16_t distance = (uint16_t) (record.echoDurationMicroseconds / dataSet->factor);
+      if (record.sensorId == LEFT_SENSOR_ID) {
+        left = distance;
+      } else if (record.sensorId == RIGHT_SENSOR_ID) {
+        right = distance;
+      }
     }
     bluetoothManager->newPassEvent(
-      dataSet->millis + (uint32_t) dataSet->startOffsetMilliseconds[measureIndex],
+      dataSet->millis + (uint32_t) offsetMilliseconds,
       left, right);
   }
 }
 
+/* The distance depends on the speed of sound and so on the temperature,
+ * we take it from the BMP280 if there is one, else from the config.
+ */
+void updateTemperature() {
+  if (bmp280Found) {
+    TemperatureValue = bmp280.readTemperature();
+    sensorManager->setTemperature(TemperatureValue);
+  } else {
+    sensorManager->setTemperature((float) config.temperature);
+  }
+}
+
 uint8_t batteryPercentage() {
   uint8_t result = 0;
   if (voltageMeter) {
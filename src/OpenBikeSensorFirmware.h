@@ -14,6 +14,7 @@
 #include "sensor.h"
 #include "writer.h"
 #include "battery.h"
+#include "utils/intervalring.h"
 
 #include <Adafruit_BMP280.h>
 #include <VL53L0X.h>
@@ -56,3 +56,7 @@ void BluetoothManager::newPassEvent(const uint32_t millis, const uint16_t leftVa
     service->newPassEvent(millis, leftValue, rightValue);
   }
 }
+
+uint16_t BluetoothManager::takeMarks() {
+  return ObsService::takeMarks();
+}
@@ -59,6 +59,12 @@ class BluetoothManager {
      */
     void newPassEvent(uint32_t millis, uint16_t leftValue, uint16_t rightValue);
 
+    /**
+     * Marks requested by the connected device since the last call.
+     * @return number of writes to the mark characteristic
+     */
+    uint16_t takeMarks();
+
   private:
     BLEServer *pServer;
     std::list<IBluetoothService*> services;
@@ -110,18 +110,12 @@ void ClosePassService::processValuesForEventChar_Avg2s(const uint32_t millis, co
 }
 
 void ClosePassService::processValuesForEventChar_MinKalman(const uint32_t millis, const uint16_t leftValue, const uint16_t rightValue) {
-  // TODO: test these parameters!!!
-  float errMeasure = 10;
-  float q = 0.01;
+  mEventMinKalman_Filter.process(leftValue);
+  const float estimate = mEventMinKalman_Filter.currentEstimate();
 
-  mEventMinKalman_Gain = mEventMinKalman_ErrEstimate / (mEventMinKalman_ErrEstimate + errMeasure);
-  mEventMinKalman_CurrentEstimate = mEventMinKalman_LastEstimate + mEventMinKalman_Gain * ((float) leftValue - mEventMinKalman_LastEstimate);
-  mEventMinKalman_ErrEstimate = (1.0f - mEventMinKalman_Gain) * mEventMinKalman_ErrEstimate + fabsf(mEventMinKalman_LastEstimate - mEventMinKalman_CurrentEstimate) * q;
-  mEventMinKalman_LastEstimate = mEventMinKalman_CurrentEstimate;
-
-  if (mEventMinKalman_CurrentEstimate < mEventMinKalman_Min) {
+  if (estimate < mEventMinKalman_Min) {
     mEventMinKalman_MinTimestamp = millis;
-    mEventMinKalman_Min = mEventMinKalman_CurrentEstimate;
+    mEventMinKalman_Min = estimate;
   }
 
   // Below close pass threshold and last minimum value was more than one second ago
@@ -4,6 +4,7 @@
 #include <CircularBuffer.h>
 #include "_IBluetoothService.h"
 #include "globals.h"
+#include "utils/filter.h"
 
 #define SERVICE_CLOSEPASS_UUID "1FE7FAF9-CE63-4236-0003-000000000000"
 #define SERVICE_CLOSEPASS_CHAR_DISTANCE_UUID "1FE7FAF9-CE63-4236-0003-000000000001"
@@ -42,10 +43,8 @@ class ClosePassService : public IBluetoothService {
     CircularBuffer<short, 40> mEventAvg2s_Buffer;
 
     // Event characteristic - MinKalman
-    float mEventMinKalman_ErrEstimate = 10;
-    float mEventMinKalman_CurrentEstimate;
-    float mEventMinKalman_LastEstimate;
-    float mEventMinKalman_Gain;
+    // TODO: test these parameters!!!
+    KalmanFilter<uint16_t, 10, 10> mEventMinKalman_Filter;
     float mEventMinKalman_Min = UINT8_MAX;
     unsigned long mEventMinKalman_MinTimestamp = 0;
 };
@@ -18,6 +18,7 @@
   the OpenBikeSensor sensor firmware.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "ObsService.h"
+#include "sensor.h"
 
 const std::string ObsService::TIME_DESCRIPTION_TEXT("obs ms timer uint32");
 const std::string ObsService::DISTANCE_DESCRIPTION_TEXT(
@@ -28,12 +29,20 @@ const std::string ObsService::OFFSET_DESCRIPTION_TEXT(
   "Configured OBS offsets, left offset cm uint16, right offset cm uint16");
 const std::string ObsService::TRACK_ID_DESCRIPTION_TEXT(
   "Textual UUID assigned to the current track recording");
+const std::string ObsService::HEALTH_DESCRIPTION_TEXT(
+  "Sensor health: measuring ms uint32; sensors uint8; bucket us uint16; per sensor 23 counters uint32");
+const std::string ObsService::MARK_DESCRIPTION_TEXT(
+  "Write anything to mark the current position in the track");
 const BLEUUID ObsService::OBS_SERVICE_UUID = BLEUUID("1FE7FAF9-CE63-4236-0004-000000000000");
 const BLEUUID ObsService::OBS_TIME_CHARACTERISTIC_UUID = BLEUUID("1FE7FAF9-CE63-4236-0004-000000000001");
 const BLEUUID ObsService::OBS_DISTANCE_CHARACTERISTIC_UUID = BLEUUID("1FE7FAF9-CE63-4236-0004-000000000002");
 const BLEUUID ObsService::OBS_BUTTON_CHARACTERISTIC_UUID = BLEUUID("1FE7FAF9-CE63-4236-0004-000000000003");
 const BLEUUID ObsService::OBS_OFFSET_CHARACTERISTIC_UUID = BLEUUID("1FE7FAF9-CE63-4236-0004-000000000004");
 const BLEUUID ObsService::OBS_TRACK_ID_CHARACTERISTIC_UUID = BLEUUID("1FE7FAF9-CE63-4236-0004-000000000005");
+const BLEUUID ObsService::OBS_HEALTH_CHARACTERISTIC_UUID = BLEUUID("1FE7FAF9-CE63-4236-0004-000000000006");
+const BLEUUID ObsService::OBS_MARK_CHARACTERISTIC_UUID = BLEUUID("1FE7FAF9-CE63-4236-0004-000000000007");
+
+std::atomic<uint16_t> ObsService::marks{0};
 
 ObsService::ObsService(const uint16_t leftOffset, const uint16_t rightOffset, const String &trackId) {
   uint8_t offsets[4];
@@ -45,7 +54,7 @@ ObsService::ObsService(const uint16_t leftOffset, const uint16_t rightOffset, co
 
 void ObsService::setup(BLEServer *pServer) {
   // Each characteristic needs 2 handles and descriptor 1 handle.
-  mService = pServer->createService(OBS_SERVICE_UUID, 18);
+  mService = pServer->createService(OBS_SERVICE_UUID, 24);
 
   mService->addCharacteristic(&mTimeCharacteristic);
   mTimeCharacteristic.addDescriptor(&mTimeDescriptor);
@@ -69,6 +78,16 @@ void ObsService::setup(BLEServer *pServer) {
   mService->addCharacteristic(&mTrackIdCharacteristic);
   mTrackIdCharacteristic.addDescriptor(&mTrackIdDescriptor);
   mTrackIdDescriptor.setValue(TRACK_ID_DESCRIPTION_TEXT);
+
+  mService->addCharacteristic(&mHealthCharacteristic);
+  mHealthCharacteristic.addDescriptor(&mHealthDescriptor);
+  mHealthDescriptor.setValue(HEALTH_DESCRIPTION_TEXT);
+  mHealthCharacteristic.setCallbacks(&mHealthCharacteristicsCallback);
+
+  mService->addCharacteristic(&mMarkCharacteristic);
+  mMarkCharacteristic.addDescriptor(&mMarkDescriptor);
+  mMarkDescriptor.setValue(MARK_DESCRIPTION_TEXT);
+  mMarkCharacteristic.setCallbacks(&mMarkCharacteristicsCallback);
 }
 
 bool ObsService::shouldAdvertise() {
@@ -87,11 +106,44 @@ void ObsService::newPassEvent(uint32_t millis, uint16_t leftValue, uint16_t righ
   sendEventData(&mButtonCharacteristic, millis, leftValue, rightValue);
 }
 
+uint16_t ObsService::takeMarks() {
+  return marks.exchange(0);
+}
+
 void ObsTimeServiceCallback::onRead(BLECharacteristic *pCharacteristic) {
   uint32_t value = millis();
   pCharacteristic->setValue(value);
 }
 
+/* Counters of SensorHealth in order of declaration, the histogram last. */
+void ObsHealthServiceCallback::onRead(BLECharacteristic *pCharacteristic) {
+  static_assert(sizeof(SensorHealth) == (7 + ECHO_HISTOGRAM_BUCKETS) * sizeof(uint32_t),
+    "add new counters to the payload");
+  const size_t sensors = sensorManager->m_sensors.size();
+  uint8_t value[7 + MAX_NUMBER_SENSORS * sizeof(SensorHealth)];
+  const uint32_t measurementMillis = sensorManager->getMeasurementMillis();
+  memcpy(value, &measurementMillis, 4);
+  value[4] = (uint8_t) sensors;
+  memcpy(&value[5], &ECHO_HISTOGRAM_BUCKET_MICRO_SEC, 2);
+  size_t pos = 7;
+  for (size_t idx = 0; idx < sensors; ++idx) {
+    const SensorHealth &health = sensorManager->m_sensors[idx].health;
+    const uint32_t counters[] = {
+      health.triggers, health.echos, health.noEchos, health.timeoutTriggers,
+      health.lostEdges, health.startCorrections, health.phantomEchos
+    };
+    memcpy(&value[pos], counters, sizeof(counters));
+    pos += sizeof(counters);
+    memcpy(&value[pos], health.echoHistogram, sizeof(health.echoHistogram));
+    pos += sizeof(health.echoHistogram);
+  }
+  pCharacteristic->setValue(value, pos);
+}
+
+void ObsMarkServiceCallback::onWrite(BLECharacteristic *pCharacteristic) {
+  ObsService::marks++;
+}
+
 void ObsService::sendEventData(BLECharacteristic *characteristic, uint32_t millis, uint16_t leftValue, uint16_t rightValue) {
   uint8_t event[8];
   memcpy(event, &millis, sizeof(millis));
@@ -20,6 +20,8 @@
 #ifndef OPENBIKESENSORFIRMWARE_OBSSERVICE_H
 #define OPENBIKESENSORFIRMWARE_OBSSERVICE_H
 
+#include <atomic>
+
 #include "_IBluetoothService.h"
 
 
@@ -29,6 +31,19 @@ class ObsTimeServiceCallback : public BLECharacteristicCallbacks {
 };
 
 
+class ObsHealthServiceCallback : public BLECharacteristicCallbacks {
+  public:
+    void onRead(BLECharacteristic *pCharacteristic) override;
+};
+
+
+/* Counts the writes, loop() takes them as mark events of the track. */
+class ObsMarkServiceCallback : public BLECharacteristicCallbacks {
+  public:
+    void onWrite(BLECharacteristic *pCharacteristic) override;
+};
+
+
 class ObsService : public IBluetoothService {
   public:
     ObsService(uint16_t leftOffset, uint16_t rightOffset, const String &trackId);
@@ -37,6 +52,8 @@ class ObsService : public IBluetoothService {
     BLEService* getService() override;
     void newSensorValues(uint32_t millis, uint16_t leftValue, uint16_t rightValue) override;
     void newPassEvent(uint32_t millis, uint16_t leftValue, uint16_t rightValue) override;
+    /* Writes to the mark characteristic since the last call. */
+    static uint16_t takeMarks();
 
   private:
     void sendEventData(BLECharacteristic *characteristic,
@@ -65,17 +82,35 @@ class ObsService : public IBluetoothService {
       = BLECharacteristic(OBS_TRACK_ID_CHARACTERISTIC_UUID,BLECharacteristic::PROPERTY_READ);
     BLEDescriptor mTrackIdDescriptor = BLEDescriptor(BLEUUID((uint16_t)ESP_GATT_UUID_CHAR_DESCRIPTION));
 
+    BLECharacteristic mHealthCharacteristic
+      = BLECharacteristic(OBS_HEALTH_CHARACTERISTIC_UUID, BLECharacteristic::PROPERTY_READ);
+    BLEDescriptor mHealthDescriptor = BLEDescriptor(BLEUUID((uint16_t)ESP_GATT_UUID_CHAR_DESCRIPTION));
+    ObsHealthServiceCallback mHealthCharacteristicsCallback;
+
+    BLECharacteristic mMarkCharacteristic
+      = BLECharacteristic(OBS_MARK_CHARACTERISTIC_UUID, BLECharacteristic::PROPERTY_WRITE);
+    BLEDescriptor mMarkDescriptor = BLEDescriptor(BLEUUID((uint16_t)ESP_GATT_UUID_CHAR_DESCRIPTION));
+    ObsMarkServiceCallback mMarkCharacteristicsCallback;
+
+    /* Written by the bluetooth task, taken by loop(). */
+    static std::atomic<uint16_t> marks;
+    friend class ObsMarkServiceCallback;
+
     static const std::string TIME_DESCRIPTION_TEXT;
     static const std::string DISTANCE_DESCRIPTION_TEXT;
     static const std::string BUTTON_DESCRIPTION_TEXT;
     static const std::string OFFSET_DESCRIPTION_TEXT;
     static const std::string TRACK_ID_DESCRIPTION_TEXT;
+    static const std::string HEALTH_DESCRIPTION_TEXT;
+    static const std::string MARK_DESCRIPTION_TEXT;
     static const BLEUUID OBS_SERVICE_UUID;
     static const BLEUUID OBS_TIME_CHARACTERISTIC_UUID;
     static const BLEUUID OBS_DISTANCE_CHARACTERISTIC_UUID;
     static const BLEUUID OBS_BUTTON_CHARACTERISTIC_UUID;
     static const BLEUUID OBS_OFFSET_CHARACTERISTIC_UUID;
     static const BLEUUID OBS_TRACK_ID_CHARACTERISTIC_UUID;
+    static const BLEUUID OBS_HEALTH_CHARACTERISTIC_UUID;
+    static const BLEUUID OBS_MARK_CHARACTERISTIC_UUID;
 };
 
 #endif
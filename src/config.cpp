@@ -18,6 +18,7 @@
   the OpenBikeSensor sensor firmware.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
 #include <langinfo.h>
 #include "config.h"
 #include "gps.h"
@@ -36,6 +37,14 @@ const String ObsConfig::PROPERTY_OBS_NAME = String("obsName");
 const String ObsConfig::PROPERTY_NAME = String("name");
 const String ObsConfig::PROPERTY_BLUETOOTH = String("bluetooth");
 const String ObsConfig::PROPERTY_OFFSET = String("offset");
+const String ObsConfig::PROPERTY_INTERFERENCE_GROUP = String("interferenceGroup");
+const String ObsConfig::PROPERTY_PARALLEL_TRIGGER = String("parallelTrigger");
+const String ObsConfig::PROPERTY_BINARY_TRACK = String("binaryTrack");
+const String ObsConfig::PROPERTY_GZIP_TRACK = String("gzipTrack");
+const String ObsConfig::PROPERTY_RAW_ECHO_TRACK = String("rawEchoTrack");
+const String ObsConfig::PROPERTY_TRACK_SYNC_SECONDS = String("trackSyncSeconds");
+const String ObsConfig::PROPERTY_TRACK_SYNC_KIB = String("trackSyncKiB");
+const String ObsConfig::PROPERTY_GPS_RATE_HZ = String("gpsRateHz");
 const String ObsConfig::PROPERTY_SIM_RA = String("simRa");
 const String ObsConfig::PROPERTY_WIFI_SSID = String("wifiSsid");
 const String ObsConfig::PROPERTY_WIFI_PASSWORD = String("wifiPassword");
@@ -44,6 +53,7 @@ const String ObsConfig::PROPERTY_PORTAL_TOKEN = String("portalToken");
 const String ObsConfig::PROPERTY_GPS_FIX = String("gpsFix");
 const String ObsConfig::PROPERTY_DISPLAY_CONFIG = String("displayConfig");
 const String ObsConfig::PROPERTY_CONFIRMATION_TIME_SECONDS = String("confirmationTimeSeconds");
+const String ObsConfig::PROPERTY_TEMPERATURE = String("temperature");
 const String ObsConfig::PROPERTY_PRIVACY_CONFIG = String("privacyConfig");
 const String ObsConfig::PROPERTY_DEVELOPER = String("devConfig");
 const String ObsConfig::PROPERTY_SELECTED_PRESET = String("selectedPreset");
@@ -129,6 +139,13 @@ void ObsConfig::makeSureSystemDefaultsAreSet() {
   ensureSet(data, PROPERTY_NAME, "default");
   ensureSet(data, PROPERTY_SIM_RA, false);
   ensureSet(data, PROPERTY_BLUETOOTH, false);
+  ensureSet(data, PROPERTY_PARALLEL_TRIGGER, false);
+  ensureSet(data, PROPERTY_BINARY_TRACK, false);
+  ensureSet(data, PROPERTY_GZIP_TRACK, false);
+  ensureSet(data, PROPERTY_RAW_ECHO_TRACK, false);
+  ensureSet(data, PROPERTY_TRACK_SYNC_SECONDS, 10);
+  ensureSet(data, PROPERTY_TRACK_SYNC_KIB, 64);
+  ensureSet(data, PROPERTY_GPS_RATE_HZ, 1);
   data[PROPERTY_OFFSET][0] = data[PROPERTY_OFFSET][0] | 35;
   data[PROPERTY_OFFSET][1] = data[PROPERTY_OFFSET][1] | 35;
   if (ensureSet(data, PROPERTY_WIFI_SSID, "Freifunk")) {
@@ -149,6 +166,7 @@ void ObsConfig::makeSureSystemDefaultsAreSet() {
   if (getProperty<int>(PROPERTY_CONFIRMATION_TIME_SECONDS) == 0) {
     data[PROPERTY_CONFIRMATION_TIME_SECONDS] = 5;
   }
+  ensureSet(data, PROPERTY_TEMPERATURE, DEFAULT_TEMPERATURE_CELSIUS);
   ensureSet(data, PROPERTY_DEVELOPER, 0);
   ensureSet(data, PROPERTY_SELECTED_PRESET, 0);
   if (!data.containsKey(PROPERTY_PRIVACY_AREA)) {
@@ -318,10 +336,24 @@ void ObsConfig::fill(Config &cfg) const {
   for (int i : getIntegersProperty(PROPERTY_OFFSET)) {
     cfg.sensorOffsets.push_back(i);
   }
+  cfg.sensorInterferenceGroups.clear();
+  for (int i : getIntegersProperty(PROPERTY_INTERFERENCE_GROUP)) {
+    cfg.sensorInterferenceGroups.push_back(i);
+  }
+  cfg.parallelTrigger = getProperty<bool>(PROPERTY_PARALLEL_TRIGGER);
+  cfg.binaryTrack = getProperty<bool>(PROPERTY_BINARY_TRACK);
+  cfg.gzipTrack = getProperty<bool>(PROPERTY_GZIP_TRACK);
+  cfg.rawEchoTrack = getProperty<bool>(PROPERTY_RAW_ECHO_TRACK);
+  // 0 would sync with every buffer written
+  cfg.trackSyncSeconds = (uint16_t) std::min(std::max(getProperty<int>(PROPERTY_TRACK_SYNC_SECONDS), 1), 300);
+  cfg.trackSyncKiB = (uint16_t) std::min(std::max(getProperty<int>(PROPERTY_TRACK_SYNC_KIB), 1), 1024);
+  // 9600 baud of the GPS module leave room for NAV-PVT at 5 Hz
+  cfg.gpsRateHz = (uint8_t) std::min(std::max(getProperty<int>(PROPERTY_GPS_RATE_HZ), 1), 5);
   strlcpy(cfg.obsUserID, getProperty<const char*>(PROPERTY_PORTAL_TOKEN), sizeof(cfg.obsUserID));
   strlcpy(cfg.hostname, getProperty<const char*>(PROPERTY_PORTAL_URL), sizeof(cfg.hostname));
   cfg.displayConfig = getProperty<uint>(PROPERTY_DISPLAY_CONFIG);
   cfg.confirmationTimeWindow = getProperty<int>(PROPERTY_CONFIRMATION_TIME_SECONDS);
+  cfg.temperature = getProperty<int>(PROPERTY_TEMPERATURE);
   cfg.privacyConfig = getProperty<int>(PROPERTY_PRIVACY_CONFIG);
   cfg.bluetooth = getProperty<bool>(PROPERTY_BLUETOOTH);
   cfg.simRaMode = getProperty<bool>(PROPERTY_SIM_RA);
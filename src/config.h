@@ -64,6 +64,25 @@ struct PrivacyArea {
 struct Config {
   char obsName[32];
   std::vector<uint16_t> sensorOffsets;
+  /* Sensors of the same group are triggered one after the other, order as
+   * sensorOffsets. */
+  std::vector<uint8_t> sensorInterferenceGroups;
+  /* Trigger the sensors of a group independently and drop cross-talk. */
+  bool parallelTrigger;
+  /* Write the track as BinaryFileWriter instead of CSV. */
+  bool binaryTrack;
+  /* With binaryTrack each echo is written as a record of its own when it
+   * is collected, the interval records hold no measurements then. */
+  bool rawEchoTrack;
+  /* Compress the track with gzip, the file name gets ".gz" added. */
+  bool gzipTrack;
+  /* The track file is synced after this time or amount of data, a power
+   * loss costs at most what came since the last sync. */
+  uint16_t trackSyncSeconds;
+  uint16_t trackSyncKiB;
+  /* Navigation rate of the GPS module, above 1 the positions come from
+   * UBX-NAV-PVT, NMEA stays at 1 Hz. */
+  uint8_t gpsRateHz;
   char hostname[64];
   char obsUserID[64];
   uint displayConfig;
@@ -72,6 +91,8 @@ struct Config {
   int devConfig;
   int privacyConfig;
   int confirmationTimeWindow;
+  /* Ambient temperature in Celsius if there is no temperature sensor. */
+  int temperature;
   std::vector<PrivacyArea> privacyAreas;
 };
 
@@ -120,6 +141,14 @@ class ObsConfig {
     static const String PROPERTY_NAME;
     static const String PROPERTY_BLUETOOTH;
     static const String PROPERTY_OFFSET;
+    static const String PROPERTY_INTERFERENCE_GROUP;
+    static const String PROPERTY_PARALLEL_TRIGGER;
+    static const String PROPERTY_BINARY_TRACK;
+    static const String PROPERTY_GZIP_TRACK;
+    static const String PROPERTY_RAW_ECHO_TRACK;
+    static const String PROPERTY_TRACK_SYNC_SECONDS;
+    static const String PROPERTY_TRACK_SYNC_KIB;
+    static const String PROPERTY_GPS_RATE_HZ;
     static const String PROPERTY_SIM_RA;
     static const String PROPERTY_WIFI_SSID;
     static const String PROPERTY_WIFI_PASSWORD;
@@ -128,6 +157,7 @@ class ObsConfig {
     static const String PROPERTY_GPS_FIX;
     static const String PROPERTY_DISPLAY_CONFIG;
     static const String PROPERTY_CONFIRMATION_TIME_SECONDS;
+    static const String PROPERTY_TEMPERATURE;
     static const String PROPERTY_PRIVACY_CONFIG;
     static const String PROPERTY_DEVELOPER;
     static const String PROPERTY_SELECTED_PRESET;
@@ -27,6 +27,9 @@
 #include <SD.h>
 #include <FS.h>
 #include <uploader.h>
+#include "sensor.h"
+#include "trackcatalog.h"
+#include "writer.h"
 
 const char* host = "openbikesensor";
 
@@ -59,6 +62,8 @@ String style =
   "ul.directory-listing {list-style: none; text-align: left; padding: 0; margin: 0; line-height: 1.5;}"
   "li.directory a {text-decoration: none; font-weight: bold;}"
   "li.file a {text-decoration: none;}"
+  "table.health {width:100%;text-align:left}"
+  "td.bar div {background:#3498db;height:10px}"
   "</style>";
 
 String previous = "<a href='/' class='previous'>&#8249;</a>";
@@ -169,6 +174,7 @@ String navigationIndex =
   "<input type=button onclick=window.location.href='/update' class=btn value='Update Firmware'>"
   "<input type=button onclick=window.location.href='/upload' class=btn value='Upload Tracks'>"
   "<input type=button onclick=window.location.href='/sd' class=btn value='Show SD Card Contents'>"
+  "<input type=button onclick=window.location.href='/health' class=btn value='Sensor Health'>"
   "<input type=button onclick=window.location.href='/reboot' class=btn value='Reboot'>"
   "{dev}"
   + footer;
@@ -246,6 +252,8 @@ String configIndex =
   "Offset Sensor Right<input name='offsetS2' placeholder='Offset Sensor Right' value='{offset2}'>"
   "<hr>"
   "Swap Sensors (Left &#8660; Right)<input type='checkbox' name='displaySwapSensors' {displaySwapSensors}>"
+  "<hr>"
+  "Temperature<br>(&deg;C, used to calculate the distance if there is no temperature sensor)<input name='temperature' placeholder='Celsius' value='{temperature}'>"
   ""
   "<h3>GPS</h3>"
   "<label for='gpsFix'>GPS to wait for</label> "
@@ -330,10 +338,177 @@ String makeCurrentLocationPrivateIndex =
   "<div>Making current location private, waiting for fix. Press device button to cancel.</div>"
   + footer;
 
+// #########################################
+// Sensor health
+// #########################################
+
+String healthIndex =
+  header +
+  "<script>setTimeout(function() { window.location.reload(); }, 2000);</script>"
+  "{sensors}"
+  + footer;
+
 // #########################################
 
 void tryWiFiConnect(const ObsConfig *obsConfig);
 
+static String healthRow(const String &name, uint32_t value) {
+  return "<tr><td>" + name + "</td><td>" + String(value) + "</td></tr>";
+}
+
+/* Counters and echo histogram of all sensors, see SensorHealth. */
+static String sensorHealthHtml() {
+  String html;
+  for (size_t idx = 0; idx < sensorManager->m_sensors.size(); ++idx) {
+    const HCSR04SensorInfo &sensor = sensorManager->m_sensors[idx];
+    const SensorHealth &health = sensor.health;
+    html += "<h3>" + String(sensor.sensorLocation) + "</h3><table class=health>";
+    html += "<tr><td>Triggers per second</td><td>"
+      + String(sensorManager->getTriggersPerSecond(idx), 1) + "</td></tr>";
+    html += healthRow("Triggers", health.triggers);
+    html += healthRow("Echos", health.echos);
+    html += healthRow("No echo", health.noEchos);
+    html += healthRow("Timeout triggers", health.timeoutTriggers);
+    html += healthRow("Lost edges", health.lostEdges);
+    html += healthRow("Start corrections", health.startCorrections);
+    html += healthRow("Cross-talk echos", health.phantomEchos);
+    html += "</table><table class=health>";
+    uint32_t maxCount = 1;
+    for (uint32_t count : health.echoHistogram) {
+      maxCount = max(maxCount, count);
+    }
+    for (uint8_t bucket = 0; bucket < ECHO_HISTOGRAM_BUCKETS; ++bucket) {
+      const uint32_t count = health.echoHistogram[bucket];
+      html += "<tr><td>"
+        + String((int) (bucket * ECHO_HISTOGRAM_BUCKET_MICRO_SEC / sensorManager->getMicrosecondsPerCm())) + "cm"
+        + "</td><td>" + String(count) + "</td><td class=bar><div style='width:"
+        + String(count * 100 / maxCount) + "%'></div></td></tr>";
+    }
+    html += "</table>";
+  }
+  return html;
+}
+
+/* Tracks shown per page of the track list. */
+static const uint32_t TRACKS_PER_PAGE = 50;
+
+static String formatTime(uint32_t time) {
+  if (time == 0) {
+    return "";
+  }
+  const time_t t = time;
+  tm tm;
+  localtime_r(&t, &tm);
+  char text[20];
+  snprintf(text, sizeof(text), "%04d-%02d-%02d %02d:%02d",
+           tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min);
+  return String(text);
+}
+
+/* The newest tracks first from the track catalog, page 0 holds the
+ * newest TRACKS_PER_PAGE ones. */
+static String trackListHtml(uint32_t page) {
+  static const char *STATES[] = {"recording", "recorded", "uploaded", "removed"};
+  const uint32_t count = TrackCatalog::count();
+  String html = "<table class=tracks><tr><th>Track</th><th>Start</th><th>End</th>"
+    "<th>KiB</th><th>Records</th><th>Confirmed</th><th>State</th></tr>";
+  TrackEntry entries[10];
+  uint32_t end = count > page * TRACKS_PER_PAGE ? count - page * TRACKS_PER_PAGE : 0;
+  const uint32_t first = end > TRACKS_PER_PAGE ? end - TRACKS_PER_PAGE : 0;
+  while (end > first) {
+    const uint32_t start = end - min(end - first, (uint32_t) (sizeof(entries) / sizeof(entries[0])));
+    const uint32_t read = TrackCatalog::read(start, entries, end - start);
+    for (uint32_t idx = read; idx > 0; --idx) {
+      const TrackEntry &entry = entries[idx - 1];
+      const String name(entry.name);
+      html += "<tr><td><a href=\"/sd?path=" + name + "\">" + name.substring(name.lastIndexOf('/') + 1)
+        + "</a></td><td>" + formatTime(entry.startTime) + "</td><td>" + formatTime(entry.endTime)
+        + "</td><td>" + String(entry.size / 1024) + "</td><td>" + String(entry.records)
+        + "</td><td>" + String(entry.confirmed) + "</td><td>"
+        + (entry.state <= TrackEntry::REMOVED ? STATES[entry.state] : "") + "</td></tr>";
+    }
+    if (read < end - start) {
+      break;
+    }
+    end = start;
+  }
+  html += "</table>";
+  if (page > 0) {
+    html += "<a href=\"/sd?page=" + String(page - 1) + "\">Newer</a> ";
+  }
+  if (first > 0) {
+    html += "<a href=\"/sd?page=" + String(page + 1) + "\">Older</a> ";
+  }
+  html += "<a href=\"/sd?path=/\">All files</a>";
+  return html;
+}
+
+/* The portal only takes uncompressed CSV tracks, see uploader::upload(). */
+static bool isUploadable(const TrackEntry &entry) {
+  const String name(entry.name);
+  return entry.state < TrackEntry::UPLOADED
+    && !name.endsWith(BinaryFileWriter::EXTENSION)
+    && !name.endsWith(FileWriter::GZIP_EXTENSION);
+}
+
+/* Uploads the tracks of the catalog from its first pending one on and
+ * moves them to /uploaded, returns the names uploaded as html. The first
+ * pending upload moves behind all tracks done.
+ */
+static String uploadPendingTracks() {
+  String html;
+  const uint32_t count = TrackCatalog::count();
+  uint32_t firstPending = TrackCatalog::firstPendingUpload();
+  bool allDone = true;
+  TrackEntry entries[10];
+  for (uint32_t start = firstPending; start < count;) {
+    const uint32_t read = TrackCatalog::read(start, entries,
+      min(count - start, (uint32_t) (sizeof(entries) / sizeof(entries[0]))));
+    if (read == 0) {
+      break;
+    }
+    for (uint32_t idx = 0; idx < read; ++idx) {
+      TrackEntry &entry = entries[idx];
+      const String name(entry.name);
+      if (entry.state < TrackEntry::UPLOADED && name.endsWith(FileWriter::GZIP_EXTENSION)) {
+        log_w("Not uploading %s, the portal takes no gzip tracks.", name.c_str());
+        html += name;
+        html += " skipped, gzip tracks need gunzip before the upload<br>";
+      } else if (isUploadable(entry)) {
+        if (!SDFileSystem.exists(name)) {
+          entry.state = TrackEntry::REMOVED;
+          TrackCatalog::write(start + idx, entry);
+        } else if (uploader::instance()->upload(name)) {
+          SDFileSystem.mkdir("/uploaded");
+          int i = 0;
+          String uploadedName = String("/uploaded") + name;
+          while (!SDFileSystem.rename(name, uploadedName)) {
+            i++;
+            if (i > 100) {
+              break;
+            }
+            uploadedName = String("/uploaded") + name + String(i);
+          }
+          entry.state = TrackEntry::UPLOADED;
+          if (i <= 100) {
+            entry.setName(uploadedName);
+          }
+          TrackCatalog::write(start + idx, entry);
+          html += name;
+          html += "<br>";
+        }
+      }
+      if (allDone && isUploadable(entry)) {
+        allDone = false;
+        firstPending = start + idx;
+      }
+    }
+    start += read;
+  }
+  TrackCatalog::setFirstPendingUpload(allDone ? count : firstPending);
+  return html;
+}
+
 void handle_NotFound() {
   server.send(404, "text/plain", "Not found");
 }
@@ -374,6 +549,8 @@ void configAction() {
                                    server.arg("displayDistanceDetail") == "on");
   theObsConfig->setProperty(0, ObsConfig::PROPERTY_CONFIRMATION_TIME_SECONDS,
                             atoi(server.arg("confirmationTimeWindow").c_str()));
+  theObsConfig->setProperty(0, ObsConfig::PROPERTY_TEMPERATURE,
+                            atoi(server.arg("temperature").c_str()));
   theObsConfig->setProperty(0, ObsConfig::PROPERTY_BLUETOOTH,
                             (bool) (server.arg("bluetooth") == "on"));
   theObsConfig->setProperty(0, ObsConfig::PROPERTY_SIM_RA,
@@ -549,36 +726,7 @@ void startServer(ObsConfig *obsConfig) {
     html.replace("{version}", OBSVersion);
     html.replace("{subtitle}", "Upload Tracks");
 
-    File root = SDFileSystem.open("/");
-    if (!root) {
-      Serial.println("Failed to open directory");
-      return;
-    }
-    if (!root.isDirectory()) {
-      Serial.println("Not a directory");
-      return;
-    }
-
-    File file = root.openNextFile();
-    while (file) {
-      if (!file.isDirectory()) {
-        if(uploader::instance()->upload(file.name())) {
-
-          SDFileSystem.mkdir("/uploaded");
-          int i = 0;
-          while (!SDFileSystem.rename(file.name(), String("/uploaded") + file.name() + (i == 0 ? "" : String(i)))) {
-            i++;
-            if (i > 100) {
-              break;
-            }
-          }
-          html += String(file.name());
-          html += "<br>";
-        }
-      }
-      file = root.openNextFile();
-    }
-    root.close();
+    html += uploadPendingTracks();
 
     html += "</div>" + footer;
 
@@ -731,6 +879,8 @@ void startServer(ObsConfig *obsConfig) {
                 theObsConfig->getProperty<String>(ObsConfig::PROPERTY_PORTAL_TOKEN));
     html.replace("{confirmationTimeWindow}",
                  String(theObsConfig->getProperty<String>(ObsConfig::PROPERTY_CONFIRMATION_TIME_SECONDS)));
+    html.replace("{temperature}",
+                 String(theObsConfig->getProperty<int>(ObsConfig::PROPERTY_TEMPERATURE)));
 
     const uint displayConfig = (uint) theObsConfig->getProperty<uint>(
       ObsConfig::PROPERTY_DISPLAY_CONFIG);
@@ -919,15 +1069,38 @@ void startServer(ObsConfig *obsConfig) {
 
   server.on("/privacy_action", privacyAction);
 
+  // ###############################################################
+  // ### Sensor health ###
+  // ###############################################################
+
+  server.on("/health", HTTP_GET, []() {
+    // in server mode the sensors are only triggered once this page is opened
+    sensorManager->startMeasurementTask();
+    String html = healthIndex;
+    // Header
+    html.replace("{action}", "");
+    html.replace("{version}", OBSVersion);
+    html.replace("{subtitle}", "Sensor Health");
+    html.replace("{sensors}", sensorHealthHtml());
+
+    server.send(200, "text/html", html);
+  });
+
   // ###############################################################
   // SD card file systen access
   // ###############################################################
 
   server.on("/sd", []() {
-    String path = "/";
-    if (server.hasArg("path")) {
-      path = server.arg("path");
+    if (!server.hasArg("path")) {
+      String html = header;
+      html.replace("{version}", OBSVersion);
+      html.replace("{subtitle}", "Tracks");
+      html += trackListHtml(server.hasArg("page") ? server.arg("page").toInt() : 0);
+      html += footer;
+      server.send(200, "text/html", html);
+      return;
     }
+    const String path = server.arg("path");
 
     File file = SDFileSystem.open(path);
 
@@ -992,6 +1165,8 @@ void startServer(ObsConfig *obsConfig) {
       dataType = "application/pdf";
     } else if (path.endsWith(".zip")) {
       dataType = "application/zip";
+    } else if (path.endsWith(".gz")) {
+      dataType = "application/gzip";
     } else {
       // arbitrary data
       dataType = "application/octet-stream";
@@ -21,14 +21,47 @@
 #include "gps.h"
 #include <sys/time.h>
 
+#include "utils/snapshot.h"
+#include "utils/spscqueue.h"
+
 /* Value is in the past (just went by at the time of writing). */
 const time_t PAST_TIME = 1606672131;
 
+/* The GPS task drains the UART while it runs, at 9600 baud the receive
+ * buffer of the UART driver (256 bytes) holds 266ms. */
+static const BaseType_t GPS_TASK_CORE = 0;
+static const UBaseType_t GPS_TASK_PRIORITY = 3;
+static const uint32_t GPS_TASK_STACK_SIZE = 4096;
+static const TickType_t GPS_TASK_PERIOD = pdMS_TO_TICKS(20);
+/* 3s of NAV-PVT at 5 Hz. */
+static const size_t NAV_PVT_QUEUE_SIZE = 16;
+
 HardwareSerial SerialGPS(1);
+/* Only used by loop(), see readGPSData(). */
 TinyGPSPlus gps;
 
-time_t gpsTime() {
-  struct tm t;
+/* What the parser knows of the GPS module. */
+struct GpsState {
+  TinyGPSPlus gps;
+  NavPvt navPvt;
+  /* 0 till the first NAV-PVT arrived. */
+  uint32_t navPvtMillis = 0;
+};
+
+/* Owned by the GPS task once it runs, before by readGPSData(). */
+static UbxParser ubxParser;
+static GpsState parsed;
+static Snapshot<GpsState> published;
+static TaskHandle_t gpsTaskHandle = nullptr;
+/* Every NAV-PVT parsed, filled by the parser and drained by takeNavPvt(). */
+static SpscQueue<NavPvtSample, NAV_PVT_QUEUE_SIZE> navPvtQueue;
+
+/* Taken by readGPSData(). */
+static NavPvt lastNavPvt;
+static uint32_t lastNavPvtMillis = 0;
+
+static time_t gpsTime(TinyGPSPlus &gps) {
+  struct tm t = {};
   t.tm_year = gps.date.year() - 1900;
   t.tm_mon = gps.date.month() - 1; // Month, 0 - jan
   t.tm_mday = gps.date.day();
@@ -41,13 +74,30 @@ time_t gpsTime() {
 time_t currentTime() {
   time_t result;
   if (gps.date.isValid() && gps.date.age() < 2000 && gps.date.year() > 2019) {
-    result = gpsTime();
+    result = gpsTime(gps);
   } else {
     result = time(nullptr);
   }
   return result;
 }
 
+/* PUBX,40 rates count navigation solutions, at gpsRateHz the message
+ * comes once per second with rate gpsRateHz. */
+static void setNmeaRate(const char *message, uint8_t rate) {
+  char sentence[32];
+  snprintf(sentence, sizeof(sentence), "PUBX,40,%s,0,%d,0,0", message, rate);
+  uint8_t checksum = 0;
+  for (const char *c = sentence; *c; ++c) {
+    checksum ^= *c;
+  }
+  SerialGPS.printf("$%s*%02X\r\n", sentence, checksum);
+}
+
+static void sendUbx(uint8_t messageClass, uint8_t id, const uint8_t *payload, uint16_t length) {
+  uint8_t frame[16];
+  SerialGPS.write(frame, Ubx::frame(messageClass, id, payload, length, frame));
+}
+
 void configureGpsModule() {
 #ifdef DEVELOP
   Serial.println("Sending config to GPS module.");
@@ -57,8 +107,16 @@ void configureGpsModule() {
   SerialGPS.print(F("$PUBX,40,GSA,0,0,0,0*4E\r\n"));
   SerialGPS.print(F("$PUBX,40,GLL,0,0,0,0*5C\r\n"));
   SerialGPS.print(F("$PUBX,40,VTG,0,0,0,0*5E\r\n"));
-  SerialGPS.print(F("$PUBX,40,GGA,0,1,0,0*5B\r\n"));
-  SerialGPS.print(F("$PUBX,40,RMC,0,1,0,0*46\r\n"));
+  setNmeaRate("GGA", config.gpsRateHz);
+  setNmeaRate("RMC", config.gpsRateHz);
+
+  // "measRate" in ms, "navRate" 1 measurement per solution, "timeRef" GPS time
+  const uint16_t measRate = 1000 / config.gpsRateHz;
+  const uint8_t cfgRate[] = { (uint8_t) measRate, (uint8_t) (measRate >> 8), 0x01, 0x00, 0x01, 0x00 };
+  sendUbx(Ubx::CLASS_CFG, Ubx::ID_CFG_RATE, cfgRate, sizeof(cfgRate));
+  // NAV-PVT with every solution on this port, only needed above 1 Hz
+  const uint8_t cfgMsg[] = { Ubx::CLASS_NAV, Ubx::ID_NAV_PVT, (uint8_t) (config.gpsRateHz > 1 ? 1 : 0) };
+  sendUbx(Ubx::CLASS_CFG, Ubx::ID_CFG_MSG, cfgMsg, sizeof(cfgMsg));
 
   // setting also the default values here - in the net you see reports of modules with wired defaults
   // "dynModel" - "3: pedestrian"
@@ -80,7 +138,8 @@ void configureGpsModule() {
   SerialGPS.write(UBX_CFG_TP, sizeof(UBX_CFG_TP));
 }
 
-void readGPSData() {
+/* Drains the UART into parsed, true if a sentence or frame completed. */
+static bool parseGpsData() {
 #ifdef DEVELOP
   if (SerialGPS.available() > 0) {
     time_t now;
@@ -96,39 +155,112 @@ void readGPSData() {
 #endif
 
   boolean gotGpsData = false;
-  while (SerialGPS.available() > 0) {
-    if (gps.encode(SerialGPS.read())) {
-      gotGpsData = true;
-      // set system time once every minute
-      if (gps.time.isValid() && gps.date.isValid() && gps.time.isUpdated()
-          && gps.date.month() != 0 && gps.date.day() != 0 && gps.date.year() > 2019
-          && (gps.time.second() == 0 || time(nullptr) < PAST_TIME)
-          && gps.time.age() < 100) {
-        gps.time.value(); // reset "updated" flag
-        // We are in the precision of +/- 1 sec, ok for our purpose
-        const time_t t = gpsTime();
-        const struct timeval now = {.tv_sec = t};
-        settimeofday(&now, nullptr);
+  boolean gotNavPvt = false;
+  uint8_t chunk[64];
+  int available;
+  while ((available = SerialGPS.available()) > 0) {
+    const size_t size = SerialGPS.readBytes(chunk, min((size_t) available, sizeof(chunk)));
+    for (size_t idx = 0; idx < size; ++idx) {
+      const uint8_t c = chunk[idx];
+      const UbxParser::Result ubx = ubxParser.feed(c);
+      if (ubx == UbxParser::FRAME) {
+        if (ubxParser.messageClass() == Ubx::CLASS_NAV && ubxParser.id() == Ubx::ID_NAV_PVT
+            && Ubx::decodeNavPvt(ubxParser.payload(), ubxParser.payloadLength(), parsed.navPvt)) {
+          parsed.navPvtMillis = millis() | 1;
+          navPvtQueue.push({parsed.navPvt, parsed.navPvtMillis});
+          gotNavPvt = true;
+        }
+      }
+      if (ubx != UbxParser::OTHER) {
+        continue;
+      }
+      TinyGPSPlus &gps = parsed.gps;
+      if (gps.encode(c)) {
+        gotGpsData = true;
+        // set system time once every minute
+        if (gps.time.isValid() && gps.date.isValid() && gps.time.isUpdated()
+            && gps.date.month() != 0 && gps.date.day() != 0 && gps.date.year() > 2019
+            && (gps.time.second() == 0 || time(nullptr) < PAST_TIME)
+            && gps.time.age() < 100) {
+          gps.time.value(); // reset "updated" flag
+          // We are in the precision of +/- 1 sec, ok for our purpose
+          const time_t t = gpsTime(gps);
+          const struct timeval now = {.tv_sec = t};
+          settimeofday(&now, nullptr);
 #ifdef DEVELOP
-        Serial.printf("Time set %ld.\n", t);
+          Serial.printf("Time set %ld.\n", t);
 #endif
+        }
       }
     }
   }
 
   // send configuration multiple times after switch on
+  const uint32_t passedChecksum = parsed.gps.passedChecksum();
   if (gotGpsData &&
-    gps.passedChecksum() > 1 && gps.passedChecksum() < 110 && 0 == gps.passedChecksum() % 11) {
+    passedChecksum > 1 && passedChecksum < 110 && 0 == passedChecksum % 11) {
     configureGpsModule();
   }
+  return gotGpsData || gotNavPvt;
+}
+
+static void take(const GpsState &state) {
+  gps = state.gps;
+  lastNavPvt = state.navPvt;
+  lastNavPvtMillis = state.navPvtMillis;
+}
+
+static void gpsTask(void *parameter) {
+  while (true) {
+    if (parseGpsData()) {
+      published.writable() = parsed;
+      published.publish();
+    }
+    vTaskDelay(GPS_TASK_PERIOD);
+  }
+}
+
+void startGpsTask() {
+  if (gpsTaskHandle) {
+    return;
+  }
+  navPvtQueue.clear();
+  xTaskCreatePinnedToCore(gpsTask, "GPS", GPS_TASK_STACK_SIZE,
+    nullptr, GPS_TASK_PRIORITY, &gpsTaskHandle, GPS_TASK_CORE);
+}
+
+void readGPSData() {
+  if (gpsTaskHandle) {
+    if (published.update()) {
+      take(published.latest());
+    }
+  } else if (parseGpsData()) {
+    take(parsed);
+  }
+}
+
+bool recentNavPvt(NavPvt &pvt) {
+  if (lastNavPvtMillis == 0 || millis() - lastNavPvtMillis > 2000 / config.gpsRateHz) {
+    return false;
+  }
+  pvt = lastNavPvt;
+  return true;
+}
+
+bool takeNavPvt(NavPvtSample &sample) {
+  return navPvtQueue.pop(sample);
 }
 
 bool isInsidePrivacyArea(TinyGPSLocation &location) {
+  return isInsidePrivacyArea(location.lat(), location.lng());
+}
+
+bool isInsidePrivacyArea(double latitude, double longitude) {
   // quite accurate haversine formula
   // consider using simplified flat earth calculation to save time
   for (auto pa : config.privacyAreas) {
     double distance = haversine(
-      location.lat(), location.lng(), pa.transformedLatitude, pa.transformedLongitude);
+      latitude, longitude, pa.transformedLatitude, pa.transformedLongitude);
     if (distance < pa.radius) {
       return true;
     }
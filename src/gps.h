@@ -27,6 +27,7 @@
 
 #include "config.h"
 #include "globals.h"
+#include "utils/ubx.h"
 
 namespace GPS {
   const int FIX_NO_WAIT = 0;
@@ -34,12 +35,30 @@ namespace GPS {
   const int FIX_POS = -2;
 }
 
+/* A UBX-NAV-PVT with the millis() it was parsed at. */
+struct NavPvtSample {
+  NavPvt pvt;
+  uint32_t millis;
+};
+
 extern TinyGPSPlus gps;
 extern HardwareSerial SerialGPS;
 
 time_t currentTime();
+/* Parses the data of the GPS module in a task of its own from now on,
+ * readGPSData() only takes its latest state then. */
+void startGpsTask();
+/* Updates gps and recentNavPvt() with the data that arrived since the last
+ * call, never waits. */
 void readGPSData();
+/* The last UBX-NAV-PVT if it is at most 2 navigation periods old, there is
+ * none with Config::gpsRateHz 1. */
+bool recentNavPvt(NavPvt &pvt);
+/* Each UBX-NAV-PVT parsed once in the order they arrived, further ones are
+ * dropped while 16 wait to be taken. */
+bool takeNavPvt(NavPvtSample &sample);
 bool isInsidePrivacyArea(TinyGPSLocation &location);
+bool isInsidePrivacyArea(double latitude, double longitude);
 PrivacyArea newPrivacyArea(double latitude, double longitude, int radius);
 double haversine(double lat1, double lon1, double lat2, double lon2);
 
@@ -1,4 +1,3 @@
-#include <rom/queue.h>
 /*
   Copyright (C) 2019 Zweirat
   Contact: https://openbikesensor.org
@@ -22,9 +21,6 @@
 #include "sensor.h"
 #include "FunctionalInterrupt.h"
 
-const uint16_t MIN_DISTANCE_MEASURED_CM =   2;
-const uint16_t MAX_DISTANCE_MEASURED_CM = 320; // candidate to check I could not get good readings above 300
-
 const uint32_t MIN_DURATION_MICRO_SEC = MIN_DISTANCE_MEASURED_CM * MICRO_SEC_TO_CM_DIVIDER;
 const uint32_t MAX_DURATION_MICRO_SEC = MAX_DISTANCE_MEASURED_CM * MICRO_SEC_TO_CM_DIVIDER;
 
@@ -34,22 +30,57 @@ const uint32_t MAX_DURATION_MICRO_SEC = MAX_DISTANCE_MEASURED_CM * MICRO_SEC_TO_
  */
 const uint32_t MAX_TIMEOUT_MICRO_SEC = 75000;
 
-/* The last end (echo goes to low) of a measurement must be this far
- * away before a new measurement is started.
+/* The trigger schedule, see readyAt().
+ *
+ * Without a close object in sight the burst of the last measurement might
+ * still come back from far away objects. Then the last end (echo goes to
+ * low) must be DEFAULT_QUIET_PERIOD_AFTER_END_MICRO_SEC and the last
+ * start DEFAULT_QUIET_PERIOD_AFTER_START_MICRO_SEC away:
+ *  - With 35ms I could get stable readings down to 19cm (new sensor)
+ *  - With 30ms I could get stable readings down to 25/35cm only (new sensor)
+ *  - It looked fine with the old sensor for all values
  */
-const uint32_t SENSOR_QUIET_PERIOD_AFTER_END_MICRO_SEC = 10 * 1000;
+const uint32_t DEFAULT_QUIET_PERIOD_AFTER_END_MICRO_SEC = 10 * 1000;
+const uint32_t DEFAULT_QUIET_PERIOD_AFTER_START_MICRO_SEC = 35 * 1000;
 
-/* The last start of a new measurement must be as long ago as given here
-    away, until we start a new measurement.
-   - With 35ms I could get stable readings down to 19cm (new sensor)
-   - With 30ms I could get stable readings down to 25/35cm only (new sensor)
-   - It looked fine with the old sensor for all values
+/* A close object shadows the objects behind it, what is left are echos
+ * bouncing between the object and the bike. So if the last
+ * ADAPTIVE_MIN_ECHOS measurements all saw an object, we only wait for
+ * ECHO_ROUND_TRIPS times the echo duration plus a guard time.
+ */
+const uint8_t ADAPTIVE_MIN_ECHOS = 2;
+const uint32_t ECHO_ROUND_TRIPS = 3;
+const uint32_t ECHO_GUARD_MICRO_SEC = 2000;
+const uint32_t MIN_QUIET_PERIOD_AFTER_END_MICRO_SEC = 2000;
+
+/* Before we trigger a sensor, the burst of the other sensors must be gone:
+ * Their echo plus a guard time or the maximum duration we wait for if
+ * they saw nothing.
  */
-const uint32_t SENSOR_QUIET_PERIOD_AFTER_START_MICRO_SEC = 35 * 1000;
+const uint32_t CROSS_TALK_GUARD_MICRO_SEC = 2000;
+
+/* In parallel mode the sensors do not wait for each other, see
+ * setParallelTrigger(). Each trigger is delayed by a random time up to
+ * MAX_PARALLEL_TRIGGER_DELAY_MICRO_SEC and triggers are at least
+ * MIN_PARALLEL_TRIGGER_SPACING_MICRO_SEC apart, so an echo of the burst of
+ * another sensor stands out: measured from that burst it matches the echo
+ * duration of the other sensor within PHANTOM_ECHO_TOLERANCE_MICRO_SEC,
+ * see isPhantomEcho().
+ */
+const uint32_t MAX_PARALLEL_TRIGGER_DELAY_MICRO_SEC = 1000;
+const uint32_t PHANTOM_ECHO_TOLERANCE_MICRO_SEC = 150;
+const uint32_t MIN_PARALLEL_TRIGGER_SPACING_MICRO_SEC = 2 * PHANTOM_ECHO_TOLERANCE_MICRO_SEC;
 
 /* Value of HCSR04SensorInfo::end during an ongoing measurement. */
 const uint32_t MEASUREMENT_IN_PROGRESS = 0;
 
+/* The measurement task runs on the core not used by loop(), with a
+ * priority above loop() but below the WiFi and BT tasks.
+ */
+const BaseType_t MEASUREMENT_TASK_CORE = 0;
+const UBaseType_t MEASUREMENT_TASK_PRIORITY = 5;
+const uint32_t MEASUREMENT_TASK_STACK_SIZE = 4096;
+
 /* Some calculations:
  *
  * Assumption:
@@ -75,32 +106,59 @@ const uint32_t MEASUREMENT_IN_PROGRESS = 0;
  *    we save some time. Assuming 1st measure is just before the car appears
  *    besides the sensor:
  *
- *    75ms open sensor + 2x SENSOR_QUIET_PERIOD_AFTER_START_MICRO_SEC (35ms) = 145ms which is
+ *    75ms open sensor + 2x DEFAULT_QUIET_PERIOD_AFTER_START_MICRO_SEC (35ms) = 145ms which is
  *    close to the needed 148ms
  */
 
+static DistanceFilterChain<DefaultDistanceFilter> defaultFilters[MAX_NUMBER_SENSORS];
+
+/* Chunks for the timelines of the current interval and the DataSets
+ * waiting for confirmation, all of them full.
+ */
+static const size_t TIMELINE_CHUNKS = DATA_BUFFER_SIZE
+  * ((MAX_NUMBER_MEASUREMENTS_PER_INTERVAL + TimelineArena::RECORDS_PER_CHUNK - 1) / TimelineArena::RECORDS_PER_CHUNK);
+static_assert(TIMELINE_CHUNKS * TimelineArena::RECORDS_PER_CHUNK
+  >= DATA_BUFFER_SIZE * MAX_NUMBER_SENSORS * MAX_READINGS_PER_INTERVAL,
+  "the arena must hold full timelines of all buffered intervals");
+static TimelineArena::Chunk timelineChunks[TIMELINE_CHUNKS];
+TimelineArena timelineArena(timelineChunks, TIMELINE_CHUNKS);
+
+HCSR04SensorManager::HCSR04SensorManager() {
+  readings = xQueueCreate(SENSOR_READING_QUEUE_SIZE, sizeof(SensorReading));
+}
+
 void HCSR04SensorManager::registerSensor(HCSR04SensorInfo sensorInfo) {
+  assert(m_sensors.size() < MAX_NUMBER_SENSORS);
   m_sensors.push_back(sensorInfo);
   pinMode(sensorInfo.triggerPin, OUTPUT);
   pinMode(sensorInfo.echoPin, INPUT_PULLUP); // hint from https://youtu.be/xwsT-e1D9OY?t=354
   sensorValues.push_back(0); //make sure sensorValues has same size as m_sensors
   assert(sensorValues.size() == m_sensors.size());
-  if (m_sensors[m_sensors.size() - 1].median == nullptr) {
-    m_sensors[m_sensors.size() - 1].median = new Median<uint16_t>(5);
+  if (m_sensors[m_sensors.size() - 1].filter == nullptr) {
+    // shared with sensors of an earlier manager
+    m_sensors[m_sensors.size() - 1].filter = &defaultFilters[m_sensors.size() - 1];
+    m_sensors[m_sensors.size() - 1].filter->reset();
+  }
+  if (m_sensors[m_sensors.size() - 1].edges == nullptr) {
+    m_sensors[m_sensors.size() - 1].edges = new SpscQueue<EchoEdge, ECHO_EDGE_QUEUE_SIZE>();
   }
   // only one interrupt per pin, can not split RISING/FALLING here
   attachInterrupt(sensorInfo.echoPin, std::bind(&HCSR04SensorManager::isr, this, m_sensors.size() - 1), CHANGE);
 }
 
-void HCSR04SensorManager::reset() {
+void HCSR04SensorManager::reset(Timeline* timeline) {
   for (size_t idx = 0; idx < m_sensors.size(); ++idx) {
     m_sensors[idx].minDistance = MAX_SENSOR_VALUE;
-    memset(&(m_sensors[idx].echoDurationMicroseconds), 0, sizeof(m_sensors[idx].echoDurationMicroseconds));
+    m_sensors[idx].numberOfReadings = 0;
+    m_sensors[idx].lastMeasureIndex = UINT16_MAX;
   }
   startReadingMilliseconds = 0; // cheat a bit, we start the clock just with the 1st measurement
-  lastReadingCount = 0;
-  memset(&(startOffsetMilliseconds), 0, sizeof(startOffsetMilliseconds));
-  activeSensor = primarySensor;
+  maxTriggerJitterMicroseconds = 0;
+  this->timeline = timeline;
+}
+
+void HCSR04SensorManager::setEchoListener(EchoListener listener) {
+  echoListener = listener;
 }
 
 void HCSR04SensorManager::setOffsets(std::vector<uint16_t> offsets) {
@@ -110,179 +168,364 @@ void HCSR04SensorManager::setOffsets(std::vector<uint16_t> offsets) {
     } else {
       m_sensors[idx].offset = 0;
     }
+    m_sensors[idx].filter->setOffset(m_sensors[idx].offset);
   }
 }
 
-/* The primary sensor defines the measurement interval, we trigger a measurement if this
- * sensor is ready.
- */
-void HCSR04SensorManager::setPrimarySensor(uint8_t idx) {
-  primarySensor = idx;
+void HCSR04SensorManager::setInterferenceGroups(std::vector<uint8_t> groups) {
+  for (size_t idx = 0; idx < m_sensors.size(); ++idx) {
+    m_sensors[idx].interferenceGroup = idx < groups.size() ? groups[idx] : 0;
+  }
+}
+
+void HCSR04SensorManager::setTemperature(float celsius) {
+  echoDistance.setTemperature(celsius);
 }
 
+float HCSR04SensorManager::getMicrosecondsPerCm() const {
+  return echoDistance.getMicrosecondsPerCm();
+}
+
+void HCSR04SensorManager::setParallelTrigger(bool parallel) {
+  parallelTrigger = parallel;
+}
+
+void HCSR04SensorManager::startMeasurementTask() {
+  if (measurementTaskHandle) {
+    return;
+  }
+  measurementStartMillis = millis();
+  xTaskCreatePinnedToCore(measurementTask, "Measurement", MEASUREMENT_TASK_STACK_SIZE,
+    this, MEASUREMENT_TASK_PRIORITY, &measurementTaskHandle, MEASUREMENT_TASK_CORE);
+}
+
+uint32_t HCSR04SensorManager::getMeasurementMillis() {
+  return measurementTaskHandle ? millis() - measurementStartMillis : 0;
+}
+
+float HCSR04SensorManager::getTriggersPerSecond(uint8_t sensorId) {
+  const uint32_t measurementMillis = getMeasurementMillis();
+  if (measurementMillis == 0) {
+    return 0;
+  }
+  return m_sensors[sensorId].health.triggers * 1000.0f / measurementMillis;
+}
+
+void HCSR04SensorManager::measurementTask(void *parameter) {
+  HCSR04SensorManager* const manager = static_cast<HCSR04SensorManager*>(parameter);
+  for (;;) {
+    manager->getDistances();
+  }
+}
 
-/* Reads left sensor alternating to the right sensor, while
- * one sensor is used the other one has time to settle down.
+/* Triggers the sensor that gets ready first, see readyAt(). While one
+ * sensor is used the others of its interference group have time to settle
+ * down, sensors of other groups are triggered as soon as they are ready.
+ * The readings are published when the echo is in, see
+ * publishCompletedReadings().
  */
 void HCSR04SensorManager::getDistances() {
   setSensorTriggersToLow();
-  waitTillSensorIsReady(activeSensor);
+  activeSensor = waitTillNextSensorIsReady();
+  HCSR04SensorInfo* const sensor = &m_sensors[activeSensor];
+  sensor->triggerJitter = getTriggerJitter(activeSensor);
   sendTriggerToSensor(activeSensor);
-  if (startReadingMilliseconds == 0) {
-    startReadingMilliseconds = millis();
+  sensor->health.triggers++;
+  sensor->triggerMillis = millis();
+  sensor->readingPending = true;
+  if (parallelTrigger) {
+    sensor->triggerDelay = random(MAX_PARALLEL_TRIGGER_DELAY_MICRO_SEC);
   }
-  startOffsetMilliseconds[lastReadingCount] = millisSince(startReadingMilliseconds);
   // spec says 10, there are reports that the JSN-SR04T-2.0 behaves better if we wait 20 microseconds.
   // I did not observe this but others might be affected so we spend this time ;)
   // https://wolles-elektronikkiste.de/hc-sr04-und-jsn-sr04t-2-0-abstandssensoren
   delayMicroseconds(20);
   setSensorTriggersToLow();
+}
 
-  waitForEchosOrTimeout(activeSensor);
-  collectSensorResult(activeSensor);
-  activeSensor++;
-  if (activeSensor >= m_sensors.size()) {
-    activeSensor = 0;
-  }
-  setNoMeasureDate(activeSensor);
-  if (lastReadingCount < MAX_NUMBER_MEASUREMENTS_PER_INTERVAL) {
-    lastReadingCount++;
+/* Publishes one reading for each sensor whose echo ended or whose maximum
+ * duration is over. Echos of the burst of another sensor are dropped, see
+ * isPhantomEcho(). Edges must be processed before.
+ */
+void HCSR04SensorManager::publishCompletedReadings() {
+  for (size_t idx = 0; idx < m_sensors.size(); ++idx) {
+    HCSR04SensorInfo* const sensor = &m_sensors[idx];
+    if (sensor->readingPending
+      && (sensor->end != MEASUREMENT_IN_PROGRESS || microsSince(sensor->start) >= MAX_DURATION_MICRO_SEC)) {
+      if (parallelTrigger && isPhantomEcho(idx)) {
+        sensor->readingPending = false;
+        sensor->health.phantomEchos++;
+        rejectedReadings++;
+        continue;
+      }
+      SensorReading reading = {};
+      reading.triggerMillis = sensor->triggerMillis;
+      reading.triggerJitterMicroseconds = sensor->triggerJitter;
+      reading.triggeredSensors = 1 << idx;
+      reading.echoDurationMicroseconds[idx] = getEchoDuration(idx);
+      sensor->readingPending = false;
+      publishReading(reading);
+    }
   }
 }
 
 
-/* Method that reads the sensors in parallel. We observed false readings
- * that are likely caused by both sensors operated at the same time.
- * So once the alternating implementation is established this code must
- * be removed.
+/* Time between the moment the sensor could have been triggered, it was
+ * ready, and now. This is what other work costs us.
  */
-void HCSR04SensorManager::getDistancesParallel() {
-  setSensorTriggersToLow();
-  waitTillPrimarySensorIsReady();
-  sendTriggerToReadySensor();
-  if (startReadingMilliseconds == 0) {
-    startReadingMilliseconds = millis();
+uint32_t HCSR04SensorManager::getTriggerJitter(uint8_t sensorId) {
+  if (m_sensors[sensorId].trigger == 0) {
+    return 0; // 1st trigger
   }
-  // spec says 10, there are reports that the JSN-SR04T-2.0 behaves better if we wait 20 microseconds.
-  // I did not observe this but others might be affected so we spend this time ;)
-  // https://wolles-elektronikkiste.de/hc-sr04-und-jsn-sr04t-2-0-abstandssensoren
-  delayMicroseconds(20);
-  setSensorTriggersToLow();
+  return microsSince(readyAt(sensorId));
+}
 
-  waitForEchosOrTimeout();
-  collectSensorResults();
+/* Hands the reading over to processNextReading(), if loop() is behind and
+ * the queue is full the reading is lost.
+ */
+void HCSR04SensorManager::publishReading(SensorReading &reading) {
+  if (xQueueSend(readings, &reading, 0) != pdTRUE) {
+    lostReadings++;
+  }
+}
+
+bool HCSR04SensorManager::processNextReading(TickType_t ticksToWait) {
+  SensorReading reading;
+  if (xQueueReceive(readings, &reading, ticksToWait) != pdTRUE) {
+    return false;
+  }
+  if (startReadingMilliseconds == 0) {
+    startReadingMilliseconds = reading.triggerMillis;
+  }
+  maxTriggerJitterMicroseconds = max(maxTriggerJitterMicroseconds,
+    (uint16_t) min(reading.triggerJitterMicroseconds, (uint32_t) UINT16_MAX));
+  const uint16_t offset = (uint16_t) reading.triggerMillis - startReadingMilliseconds;
+  for (size_t idx = 0; idx < m_sensors.size(); ++idx) {
+    if (reading.triggeredSensors & (1 << idx)) {
+      collectSensorResult(idx, reading.echoDurationMicroseconds[idx]);
+      m_sensors[idx].numberOfReadings++;
+      if (echoListener) {
+        echoListener(reading.triggerMillis, idx, reading.echoDurationMicroseconds[idx]);
+      }
+      const TimelineRecord record = { offset, (uint8_t) idx, reading.echoDurationMicroseconds[idx] };
+      // beyond MAX_READINGS_PER_INTERVAL the arena might not hold the timelines
+      if (timeline && m_sensors[idx].numberOfReadings <= MAX_READINGS_PER_INTERVAL && timeline->push(record)) {
+        m_sensors[idx].lastMeasureIndex = timeline->size() - 1;
+      } else {
+        droppedRecords++;
+      }
+    }
+  }
+  return true;
 }
 
 uint16_t HCSR04SensorManager::getCurrentMeasureIndex() {
-  return lastReadingCount;
+  return timeline ? timeline->size() : 0;
 }
 
-/* Wait till the primary sensor is ready, this also defines the frequency of
- * measurements and ensures we do not over pace.
- */
-void HCSR04SensorManager::waitTillPrimarySensorIsReady() {
-  waitTillSensorIsReady(primarySensor);
+uint16_t HCSR04SensorManager::getLastMeasureIndex(uint8_t sensorId) {
+  const uint16_t index = m_sensors[sensorId].lastMeasureIndex;
+  if (index != UINT16_MAX) {
+    return index;
+  }
+  return getCurrentMeasureIndex() > 0 ? getCurrentMeasureIndex() - 1 : 0;
 }
 
-/* Wait till the given sensor is ready.  */
-void HCSR04SensorManager::waitTillSensorIsReady(uint8_t sensorId) {
-  while (!isReadyForStart(&m_sensors[sensorId])) {
-    yield();
+uint16_t HCSR04SensorManager::getReadingsPerSecond(uint8_t sensorId, uint32_t intervalMillis) {
+  if (intervalMillis == 0) {
+    return 0;
   }
+  return (uint16_t) ((m_sensors[sensorId].numberOfReadings * 1000 + intervalMillis / 2) / intervalMillis);
+}
+
+uint16_t HCSR04SensorManager::getMaxTriggerJitterMicroseconds() {
+  return maxTriggerJitterMicroseconds;
 }
 
-/* Start measurement with all sensors that are ready to measure, wait
- * if there is no ready sensor at all.
+/* Waits till the first sensor is ready and returns its index. We sleep
+ * till the time given by the schedule, till an echo edge comes in, which
+ * might move the schedule, or till the reading of a sensor is due.
  */
-void HCSR04SensorManager::sendTriggerToReadySensor() {
-  for (size_t idx = 0; idx < m_sensors.size(); ++idx) {
-    HCSR04SensorInfo* const sensor = &m_sensors[idx];
-    if (idx == primarySensor || isReadyForStart(sensor)) {
-      sensor->trigger = sensor->start = micros(); // will be updated with HIGH signal
-      sensor->end = MEASUREMENT_IN_PROGRESS; // will be updated with LOW signal
-      digitalWrite(sensor->triggerPin, HIGH);
+uint8_t HCSR04SensorManager::waitTillNextSensorIsReady() {
+  for (;;) {
+    for (size_t idx = 0; idx < m_sensors.size(); ++idx) {
+      processEdges(&m_sensors[idx]);
+    }
+    // updates the echo history readyAt() depends on
+    publishCompletedReadings();
+    // start with the sensor after the last one, so they alternate if ready at the same time
+    uint8_t next = (activeSensor + 1) % m_sensors.size();
+    uint32_t nextReadyAt = readyAt(next);
+    for (size_t i = 2; i <= m_sensors.size(); ++i) {
+      const uint8_t idx = (activeSensor + i) % m_sensors.size();
+      const uint32_t ready = readyAt(idx);
+      if ((int32_t) (ready - nextReadyAt) < 0) {
+        next = idx;
+        nextReadyAt = ready;
+      }
     }
+    if (isReadyForStart(next)) {
+      return next;
+    }
+    uint32_t deadline = nextReadyAt;
+    for (size_t idx = 0; idx < m_sensors.size(); ++idx) {
+      if (m_sensors[idx].readingPending) {
+        deadline = earlier(deadline, m_sensors[idx].start + MAX_DURATION_MICRO_SEC);
+      }
+    }
+    waitForEdgeOrTimeout(deadline);
   }
 }
 
-/* Start measurement with all sensors that are ready to measure, wait
- * if there is no ready sensor at all.
- */
 void HCSR04SensorManager::sendTriggerToSensor(uint8_t sensorId) {
   HCSR04SensorInfo* const sensor = &(m_sensors[sensorId]);
+  sensor->edges->clear();
   sensor->trigger = sensor->start = micros(); // will be updated with HIGH signal
   sensor->end = MEASUREMENT_IN_PROGRESS; // will be updated with LOW signal
   digitalWrite(sensor->triggerPin, HIGH);
 }
 
-boolean HCSR04SensorManager::isReadyForStart(HCSR04SensorInfo* sensor) {
-  boolean ready = false;
-  const uint32_t now = micros();
-  const uint32_t start = sensor->start;
-  const uint32_t end = sensor->end;
-  if (digitalRead(sensor->echoPin) == LOW && end != MEASUREMENT_IN_PROGRESS) { // no measurement in flight or just finished
-    if ((microsBetween(now, end) > SENSOR_QUIET_PERIOD_AFTER_END_MICRO_SEC)
-      && (microsBetween(now, start) > SENSOR_QUIET_PERIOD_AFTER_START_MICRO_SEC)) {
-      ready = true;
-    }
-  } else if (microsBetween(now, start) > 2 * MAX_TIMEOUT_MICRO_SEC) {
-    // signal or interrupt was lost altogether this is an error,
-    // should we raise it?? Now pretend the sensor is ready, hope it helps to give it a trigger.
-    ready = true;
+boolean HCSR04SensorManager::isReadyForStart(uint8_t sensorId) {
+  const boolean ready = (int32_t) (micros() - readyAt(sensorId)) >= 0;
+  HCSR04SensorInfo* const sensor = &m_sensors[sensorId];
+  if (ready && (digitalRead(sensor->echoPin) != LOW || sensor->end == MEASUREMENT_IN_PROGRESS)) {
+    sensor->health.timeoutTriggers++;
 #ifdef DEVELOP
     Serial.printf("!Timeout trigger for %s duration %u us - echo pin state: %d start: %u end: %u now: %u\n",
-      sensor->sensorLocation, now - start, digitalRead(sensor->echoPin), start, end, now);
+      sensor->sensorLocation, microsSince(sensor->start), digitalRead(sensor->echoPin),
+      sensor->start, sensor->end, (uint32_t) micros());
 #endif
   }
   return ready;
 }
 
-void HCSR04SensorManager::collectSensorResults() {
+/* Time (micros()) when the given sensor may be triggered next. This is
+ * the latest of:
+ *  - its own quiet periods after the last start and end, short if the
+ *    last echos came from a close object, see getQuietPeriodAfterStart()
+ *  - the bursts of the other sensors of its interference group are gone,
+ *    see getCrossTalkPeriod(), in parallel mode only the random trigger
+ *    delay and a minimum spacing to their triggers
+ *  - MIN_TRIGGER_PERIOD_MICRO_SEC after its last trigger, so the timelines
+ *    fit in the arena
+ * If the echo of the sensor did not end, the signal or interrupt was lost
+ * altogether, this is an error. After 2 * MAX_TIMEOUT_MICRO_SEC we
+ * pretend the sensor is ready, hope it helps to give it a trigger.
+ * Edges must be processed before.
+ */
+uint32_t HCSR04SensorManager::readyAt(uint8_t sensorId) {
+  HCSR04SensorInfo* const sensor = &m_sensors[sensorId];
+  if (digitalRead(sensor->echoPin) != LOW || sensor->end == MEASUREMENT_IN_PROGRESS) {
+    return sensor->start + 2 * MAX_TIMEOUT_MICRO_SEC;
+  }
+  const boolean closeObject = sensor->consecutiveEchos >= ADAPTIVE_MIN_ECHOS;
+  uint32_t result = later(
+    sensor->end + (closeObject ? MIN_QUIET_PERIOD_AFTER_END_MICRO_SEC : DEFAULT_QUIET_PERIOD_AFTER_END_MICRO_SEC),
+    sensor->start + getQuietPeriodAfterStart(sensor));
+  if (parallelTrigger) {
+    result += sensor->triggerDelay;
+  }
+  if (sensor->trigger != 0) {
+    result = later(result, sensor->trigger + MIN_TRIGGER_PERIOD_MICRO_SEC);
+  }
+  for (size_t idx = 0; idx < m_sensors.size(); ++idx) {
+    if (idx != sensorId && m_sensors[idx].interferenceGroup == sensor->interferenceGroup) {
+      result = later(result, parallelTrigger
+        ? m_sensors[idx].trigger + MIN_PARALLEL_TRIGGER_SPACING_MICRO_SEC
+        : m_sensors[idx].start + getCrossTalkPeriod(&m_sensors[idx]));
+    }
+  }
+  return result;
+}
+
+/* True if the echo of the given sensor is likely the burst of another
+ * sensor of its group: measured from the burst of that sensor it took
+ * the echo duration that sensor saw last. The own burst was sent at a
+ * different time, so a real echo only matches by chance. Edges must be
+ * processed before.
+ */
+boolean HCSR04SensorManager::isPhantomEcho(uint8_t sensorId) {
+  HCSR04SensorInfo* const sensor = &m_sensors[sensorId];
+  if (sensor->end == MEASUREMENT_IN_PROGRESS) {
+    return false;
+  }
   for (size_t idx = 0; idx < m_sensors.size(); ++idx) {
-    collectSensorResult(idx);
+    HCSR04SensorInfo* const other = &m_sensors[idx];
+    if (idx == sensorId || other->interferenceGroup != sensor->interferenceGroup
+      || other->consecutiveEchos == 0
+      || (int32_t) (sensor->end - other->start) <= 0
+      || microsBetween(sensor->start, other->start) < PHANTOM_ECHO_TOLERANCE_MICRO_SEC) {
+      continue;
+    }
+    if (microsBetween(sensor->end - other->start, other->lastEchoDuration) < PHANTOM_ECHO_TOLERANCE_MICRO_SEC) {
+      return true;
+    }
   }
-  startOffsetMilliseconds[lastReadingCount] = millisSince(startReadingMilliseconds);
-  if (lastReadingCount < MAX_NUMBER_MEASUREMENTS_PER_INTERVAL) {
-    lastReadingCount++;
+  return false;
+}
+
+uint32_t HCSR04SensorManager::getQuietPeriodAfterStart(HCSR04SensorInfo* sensor) {
+  if (sensor->consecutiveEchos < ADAPTIVE_MIN_ECHOS) {
+    return DEFAULT_QUIET_PERIOD_AFTER_START_MICRO_SEC;
   }
+  return min(DEFAULT_QUIET_PERIOD_AFTER_START_MICRO_SEC,
+    ECHO_ROUND_TRIPS * sensor->lastEchoDuration + ECHO_GUARD_MICRO_SEC);
 }
 
-void HCSR04SensorManager::collectSensorResult(uint8_t sensorId) {
+uint32_t HCSR04SensorManager::getCrossTalkPeriod(HCSR04SensorInfo* sensor) {
+  if (sensor->end == MEASUREMENT_IN_PROGRESS || sensor->consecutiveEchos == 0) {
+    return MAX_DURATION_MICRO_SEC;
+  }
+  return min(MAX_DURATION_MICRO_SEC, sensor->lastEchoDuration + CROSS_TALK_GUARD_MICRO_SEC);
+}
+
+/* Echo duration of the last trigger of the given sensor, -1 if the echo
+ * is still in flight but the time we want to wait is up.
+ */
+int32_t HCSR04SensorManager::getEchoDuration(uint8_t sensorId) {
   HCSR04SensorInfo* const sensor = &m_sensors[sensorId];
+  processEdges(sensor);
   const uint32_t end = sensor->end;
-  const uint32_t start = getFixedStart(sensorId, sensor);
-  uint32_t duration;
+  const uint32_t start = sensor->start;
+  int32_t result;
   if (end == MEASUREMENT_IN_PROGRESS) {
-    // measurement is still in flight! But the time we want to wait is up (> MAX_DURATION_MICRO_SEC)
-    duration = microsSince(start);
-    sensor->echoDurationMicroseconds[lastReadingCount] = -1;
-    // better save than sorry:
-    if (duration < MAX_DURATION_MICRO_SEC) {
 #ifdef DEVELOP
-      Serial.printf("Collect called to early! Sensor[%d] duration: %zu us - echo pin state: %d\n",
-        sensorId, duration, digitalRead(sensor->echoPin));
-#endif
-      duration = MAX_DURATION_MICRO_SEC;
+    // better save than sorry:
+    if (microsSince(start) < MAX_DURATION_MICRO_SEC) {
+      Serial.printf("Collect called to early! Sensor[%d] duration: %u us - echo pin state: %d\n",
+        sensorId, microsSince(start), digitalRead(sensor->echoPin));
     }
+#endif
+    result = -1;
   } else {
-    duration = microsBetween(start, end);
-    sensor->echoDurationMicroseconds[lastReadingCount] = duration;
+    result = (int32_t) microsBetween(start, end);
   }
-  uint16_t dist;
-  if (duration < MIN_DURATION_MICRO_SEC || duration >= MAX_DURATION_MICRO_SEC) {
-    dist = MAX_SENSOR_VALUE;
+  if (result >= (int32_t) MIN_DURATION_MICRO_SEC && result < (int32_t) MAX_DURATION_MICRO_SEC) {
+    sensor->lastEchoDuration = result;
+    if (sensor->consecutiveEchos < UINT8_MAX) {
+      sensor->consecutiveEchos++;
+    }
+    sensor->health.echos++;
+    sensor->health.echoHistogram[min((uint32_t) result / ECHO_HISTOGRAM_BUCKET_MICRO_SEC,
+      (uint32_t) ECHO_HISTOGRAM_BUCKETS - 1)]++;
   } else {
-    dist = static_cast<uint16_t>(duration / MICRO_SEC_TO_CM_DIVIDER);
+    sensor->consecutiveEchos = 0;
+    sensor->health.noEchos++;
   }
+  return result;
+}
+
+void HCSR04SensorManager::collectSensorResult(uint8_t sensorId, int32_t echoDuration) {
+  HCSR04SensorInfo* const sensor = &m_sensors[sensorId];
+  const uint16_t dist = echoDistance.centimeters(echoDuration);
   sensor->rawDistance = dist;
-  sensor->median->addValue(dist);
-  sensorValues[sensorId] =
-    sensor->distance = correctSensorOffset(medianMeasure(sensor, dist), sensor->offset);
+  sensor->median.process(dist);
+  sensorValues[sensorId] = sensor->distance = sensor->filter->filter(dist);
 
 #ifdef DEVELOP
-  Serial.printf("Raw sensor[%d] distance read %03u / %03u (%03u, %03u, %03u) -> *%03ucm*, duration: %zu us - echo pin state: %d\n",
-    sensorId, sensor->rawDistance, dist, sensor->distances[0], sensor->distances[1],
-    sensor->distances[2], sensorValues[sensorId], duration, digitalRead(sensor->echoPin));
+  Serial.printf("Raw sensor[%d] distance read %03u / %03u (median %03u) -> *%03ucm*, duration: %d us - echo pin state: %d\n",
+    sensorId, sensor->rawDistance, dist, sensor->median.median(), sensorValues[sensorId], echoDuration,
+    digitalRead(sensor->echoPin));
 #endif
 
   if (sensor->distance > 0 && sensor->distance < sensor->minDistance) {
@@ -292,47 +535,7 @@ void HCSR04SensorManager::collectSensorResult(uint8_t sensorId) {
 }
 
 uint16_t HCSR04SensorManager::getRawMedianDistance(uint8_t sensorId) {
- return m_sensors[sensorId].median->median();
-}
-
-void HCSR04SensorManager::setNoMeasureDate(uint8_t sensorId) {
-  m_sensors[sensorId].echoDurationMicroseconds[lastReadingCount] = -1;
-}
-
-/* During debugging I observed readings that did not get `start` updated
- * By the interrupt. Since we also set start when we send the pulse to the
- * sensor this adds 300 microseconds or 5 centimeters to the measured result.
- * After research, is a bug in the ESP!? See https://esp32.com/viewtopic.php?t=10124
- */
-uint32_t HCSR04SensorManager::getFixedStart(
-  size_t idx, const HCSR04SensorInfo *sensor) {
-  uint32_t start = sensor->start;
-  // the error appears if both sensors trigger the interrupt at the exact same
-  // time, if this happens, trigger time == start time
-  if (sensor->trigger == sensor->start) {
-    for (size_t idx2 = 0; idx2 < m_sensors.size(); ++idx2) {
-      if (idx2 != idx) {
-        // it should be save to use the start value from the other sensor.
-        const uint32_t alternativeStart = m_sensors[idx2].start;
-        if (microsBetween(alternativeStart, start) < 500) { // typically 290-310 microseconds {
-          start = alternativeStart;
-        }
-      }
-    }
-  }
-  return start;
-}
-
-uint16_t HCSR04SensorManager::correctSensorOffset(uint16_t dist, uint16_t offset) {
-  uint16_t  result;
-  if (dist == MAX_SENSOR_VALUE) {
-    result = MAX_SENSOR_VALUE;
-  } else if (dist > offset) {
-    result = dist - offset;
-  } else {
-    result = 0; // would be negative if corrected
-  }
-  return result;
+ return m_sensors[sensorId].median.median();
 }
 
 void HCSR04SensorManager::setSensorTriggersToLow() {
@@ -341,17 +544,51 @@ void HCSR04SensorManager::setSensorTriggersToLow() {
   }
 }
 
-void HCSR04SensorManager::waitForEchosOrTimeout() {
-  for (size_t idx = 0; idx < m_sensors.size(); ++idx) {
-    waitForEchosOrTimeout(idx);
+/* Blocks the calling task till the interrupt handler reports a new edge
+ * of any sensor or the given deadline (micros()) is reached. Other tasks
+ * can use the cpu meanwhile, only the last millisecond is a busy wait to
+ * not depend on the tick resolution.
+ */
+void HCSR04SensorManager::waitForEdgeOrTimeout(uint32_t deadline) {
+  const int32_t remaining = (int32_t) (deadline - micros());
+  if (remaining <= 0) {
+    return;
+  }
+  waitingTask = xTaskGetCurrentTaskHandle();
+  if (remaining > 1000) {
+    // a pending notification from an edge we already processed only costs a loop
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(remaining / 1000));
+  } else {
+    delayMicroseconds(remaining);
   }
 }
 
-void HCSR04SensorManager::waitForEchosOrTimeout(uint8_t sensorId) {
-  HCSR04SensorInfo* const sensor = &m_sensors[sensorId];
-  while ((sensor->end == MEASUREMENT_IN_PROGRESS)
-    && (microsSince(sensor->start) < MAX_DURATION_MICRO_SEC)) { // max duration not expired
-    yield();
+/* Takes the edges recorded by the interrupt handler and updates start and
+ * end of the current measurement. Edges before the last trigger or after
+ * the measurement ended are dropped.
+ *
+ * We observed lost interrupts for the raising edge if both sensors see an
+ * edge at the same time, see https://esp32.com/viewtopic.php?t=10124 so if
+ * there is an end but no start, we use the delay seen with the last
+ * complete echo.
+ */
+void HCSR04SensorManager::processEdges(HCSR04SensorInfo* sensor) {
+  EchoEdge edge;
+  while (sensor->edges->pop(edge)) {
+    if (sensor->end != MEASUREMENT_IN_PROGRESS
+      || (int32_t) (edge.micros - sensor->trigger) < 0) {
+      continue;
+    }
+    if (edge.level == HIGH) {
+      sensor->start = edge.micros;
+    } else if (sensor->start == sensor->trigger) {
+      sensor->start = sensor->trigger + sensor->echoStartDelay;
+      sensor->end = edge.micros;
+      sensor->health.startCorrections++;
+    } else {
+      sensor->echoStartDelay = sensor->start - sensor->trigger;
+      sensor->end = edge.micros;
+    }
   }
 }
 
@@ -379,49 +616,31 @@ uint32_t HCSR04SensorManager::microsSince(uint32_t a) {
   return microsBetween(micros(), a);
 }
 
-uint16_t HCSR04SensorManager::millisSince(uint16_t milliseconds) {
-  uint16_t result = ((uint16_t) millis()) - milliseconds;
-  if (result & 0x8000) {
-    result = -result;
-  }
-  return result;
-}
-
-uint16_t HCSR04SensorManager::medianMeasure(HCSR04SensorInfo *const sensor, uint16_t value) {
-  sensor->distances[sensor->nextMedianDistance++] = value;
-  if (sensor->nextMedianDistance >= MEDIAN_DISTANCE_MEASURES) {
-    sensor->nextMedianDistance = 0;
-  }
-  return median(sensor->distances[0], sensor->distances[1], sensor->distances[2]);
+/* The later of the 2 time counters given, takes care for the overflow. */
+uint32_t HCSR04SensorManager::later(uint32_t a, uint32_t b) {
+  return (int32_t) (a - b) > 0 ? a : b;
 }
 
-uint16_t HCSR04SensorManager::median(uint16_t a, uint16_t b, uint16_t c) {
-  if (a < b) {
-    if (a >= c) {
-      return a;
-    } else if (b < c) {
-      return b;
-    }
-  } else {
-    if (a < c) {
-      return a;
-    } else if (b >= c) {
-      return b;
-    }
-  }
-  return c;
+/* The earlier of the 2 time counters given, takes care for the overflow. */
+uint32_t HCSR04SensorManager::earlier(uint32_t a, uint32_t b) {
+  return (int32_t) (a - b) < 0 ? a : b;
 }
 
 void IRAM_ATTR HCSR04SensorManager::isr(int idx) {
   // since the measurement of start and stop use the same interrupt
   // mechanism we should see a similar delay.
   HCSR04SensorInfo* const sensor = &m_sensors[idx];
-  if (sensor->end == MEASUREMENT_IN_PROGRESS) {
-    const uint32_t now = micros();
-    if (HIGH == digitalRead(sensor->echoPin)) {
-      sensor->start = now;
-    } else { // LOW
-      sensor->end = now;
+  const EchoEdge edge = { (uint32_t) micros(), (uint8_t) digitalRead(sensor->echoPin) };
+  // if the queue is full the edge is lost, processEdges() can cope with this
+  if (!sensor->edges->push(edge)) {
+    sensor->health.lostEdges++;
+  }
+  const TaskHandle_t task = waitingTask;
+  if (task) {
+    BaseType_t higherPriorityTaskWoken = pdFALSE;
+    vTaskNotifyGiveFromISR(task, &higherPriorityTaskWoken);
+    if (higherPriorityTaskWoken) {
+      portYIELD_FROM_ISR();
     }
   }
 }
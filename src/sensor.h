@@ -21,105 +21,240 @@
 #ifndef OBS_SENSOR_H
 #define OBS_SENSOR_H
 
+#include <functional>
 #include <vector>
 #include <Arduino.h>
 
 #include "globals.h"
-#include "utils/median.h"
-
-/* About the speed of sound:
-   See also http://www.sengpielaudio.com/Rechner-schallgeschw.htm (german)
-    - speed of sound depends on ambient temperature
-      temp, Celsius  speed, m/sec    int factor     dist error introduced with fix int factor of 58
-                     (331.5+(0.6*t)) (2000/speed)   (speed@58 / speed) - 1
-       35            352.1           (57)           -2.1% (-3.2cm bei 150cm)
-       30            349.2
-       25            346.3
-       22.4          344.82           58             0
-       20            343.4
-       15            340.5
-       12.5          338.98           (59)          +1.7% (2.6cm bei 150)
-       10            337.5
-       5             334.5
-       0             331.5            (60)          +4%  (6cm bei 150cm)
-      −5             328.5
-      −10            325.4
-      −15            322.3
-*/
-const uint32_t MICRO_SEC_TO_CM_DIVIDER = 58; // sound speed 340M/S, 2 times back and forward
+#include "utils/echodistance.h"
+#include "utils/filter.h"
+#include "utils/spscqueue.h"
+#include "utils/timeline.h"
+
+/* SensorReading::triggeredSensors has one bit per sensor. */
+const uint8_t MAX_NUMBER_SENSORS = 4;
+static_assert(MAX_NUMBER_SENSORS <= 8, "triggeredSensors is a uint8_t");
+/* Shortest time between two triggers of a sensor, so at most 50 readings
+ * per second even if close objects would allow more. */
+const uint32_t MIN_TRIGGER_PERIOD_MICRO_SEC = 20 * 1000;
+/* Records a timeline keeps of each sensor per interval, room for an
+ * interval of 1.2s at the highest trigger rate. Readings above are
+ * counted in droppedRecords. */
+const uint16_t MAX_READINGS_PER_INTERVAL = 60;
+static_assert(MAX_READINGS_PER_INTERVAL > 1000 * 1000 / MIN_TRIGGER_PERIOD_MICRO_SEC,
+  "a timeline must hold a 1s interval at the highest trigger rate");
+/* Upper limit for the Tms/Lus/Rus columns of a CSV line, all readings of
+ * all sensors of an interval. */
+const uint16_t MAX_NUMBER_MEASUREMENTS_PER_INTERVAL = MAX_NUMBER_SENSORS * MAX_READINGS_PER_INTERVAL;
+/* The current interval and the ones waiting for a confirmation, each
+ * holds a timeline. */
+const size_t DATA_BUFFER_SIZE = 10;
+/* Capacity of the edge queue per sensor, we expect 2 edges per trigger. */
+const size_t ECHO_EDGE_QUEUE_SIZE = 16;
+/* Readings the measurement task can publish while loop() is busy, about
+ * 2 seconds. */
+const UBaseType_t SENSOR_READING_QUEUE_SIZE = 64;
+
+/* Buckets of the echo duration histogram of SensorHealth, the last one
+ * ends above MAX_DURATION_MICRO_SEC. */
+const uint8_t ECHO_HISTOGRAM_BUCKETS = 16;
+const uint16_t ECHO_HISTOGRAM_BUCKET_MICRO_SEC = 1200;
+
+/* Level change of the echo pin as recorded by the interrupt handler. */
+struct EchoEdge {
+  uint32_t micros;
+  uint8_t level;
+};
+
+/* Result of one trigger slot as published by the measurement task. */
+struct SensorReading {
+  /* millis() when the slot was triggered. */
+  uint32_t triggerMillis;
+  /* Time between the sensor being ready and the trigger. */
+  uint32_t triggerJitterMicroseconds;
+  /* One bit per sensor that was triggered in this slot. */
+  uint8_t triggeredSensors;
+  /* -1 if the echo did not end in time. */
+  int32_t echoDurationMicroseconds[MAX_NUMBER_SENSORS];
+};
 
+/* Gets each echo as processNextReading() takes it, in the order of the
+ * timeline. echoDurationMicroseconds is -1 if the echo did not end in
+ * time. */
+typedef std::function<void(uint32_t triggerMillis, uint8_t sensorId, int32_t echoDurationMicroseconds)>
+  EchoListener;
 
-const uint16_t MEDIAN_DISTANCE_MEASURES = 3;
-const uint16_t MAX_NUMBER_MEASUREMENTS_PER_INTERVAL = 60;
+/* Counters of one sensor since the measurement task started, to spot a
+ * degrading transducer. Written by the measurement task and the interrupt
+ * handler only, readers on the other core might see a state a few
+ * readings off.
+ */
+struct SensorHealth {
+  uint32_t triggers = 0;
+  /* Echos within range, see echoHistogram. */
+  uint32_t echos = 0;
+  /* Nothing in range or the echo did not end in time. */
+  uint32_t noEchos = 0;
+  /* Triggered after a timeout while the echo pin was still high. */
+  uint32_t timeoutTriggers = 0;
+  /* Edges dropped by the interrupt handler as the queue was full. */
+  uint32_t lostEdges = 0;
+  /* Echos without raising edge, the start was estimated. */
+  uint32_t startCorrections = 0;
+  /* Echos dropped as cross-talk in parallel mode. */
+  uint32_t phantomEchos = 0;
+  /* Echos in range by duration, ECHO_HISTOGRAM_BUCKET_MICRO_SEC each. */
+  uint32_t echoHistogram[ECHO_HISTOGRAM_BUCKETS] = {};
+};
 
 struct HCSR04SensorInfo {
   uint8_t triggerPin = 15;
   uint8_t echoPin = 4;
   uint16_t offset = 0;
   uint16_t rawDistance = 0;
-  uint16_t distances[MEDIAN_DISTANCE_MEASURES] = { MAX_SENSOR_VALUE, MAX_SENSOR_VALUE, MAX_SENSOR_VALUE };
-  uint16_t nextMedianDistance = 0;
   uint16_t minDistance = MAX_SENSOR_VALUE;
   uint16_t distance = MAX_SENSOR_VALUE;
   char* sensorLocation;
   unsigned long lastMinUpdate=0;
   uint32_t trigger = 0;
-  volatile uint32_t start = 0;
+  uint32_t start = 0;
   /* if end == 0 - a measurement is in progress */
-  volatile uint32_t end = 1;
-
-  int32_t echoDurationMicroseconds[MAX_NUMBER_MEASUREMENTS_PER_INTERVAL + 1];
-  Median<uint16_t>*median = nullptr;
+  uint32_t end = 1;
+  /* Time from trigger to the raising echo as seen with the last complete
+   * echo, used if the interrupt for the raising edge got lost. */
+  uint32_t echoStartDelay = 300;
+  /* Echos within range in a row, 0 after a timeout. */
+  uint8_t consecutiveEchos = 0;
+  uint32_t lastEchoDuration = 0;
+  /* Readings in the current interval. */
+  uint16_t numberOfReadings = 0;
+  /* Index of the last record of this sensor in the current timeline. */
+  uint16_t lastMeasureIndex = 0;
+  /* Sensors of the same group hear the bursts of each other, they are
+   * triggered one after the other. Sensors of different groups, e.g. a
+   * sensor facing backwards, measure at the same time. */
+  uint8_t interferenceGroup = 0;
+  /* Set while the echo of the last trigger is not published yet. */
+  bool readingPending = false;
+  uint32_t triggerMillis = 0;
+  uint32_t triggerJitter = 0;
+  /* Random delay of the next trigger in parallel mode. */
+  uint32_t triggerDelay = 0;
+  /* Filled by the interrupt handler, only processEdges() consumes. */
+  SpscQueue<EchoEdge, ECHO_EDGE_QUEUE_SIZE>* edges = nullptr;
+  /* Median of the raw distances, reported via bluetooth. */
+  MedianFilter<uint16_t, 5> median;
+  /* Must outlive the sensor, registerSensor() uses DefaultDistanceFilter
+   * if not set. */
+  DistanceFilter* filter = nullptr;
+  SensorHealth health;
 };
 
 class HCSR04SensorManager {
   public:
-    HCSR04SensorManager() {}
+    HCSR04SensorManager();
     virtual ~HCSR04SensorManager() {}
+    /* Starts a task that triggers the sensors one after the other as fast
+     * as they allow, independent of loop(). The readings are taken with
+     * processNextReading(). Further calls do nothing.
+     */
+    void startMeasurementTask();
+    /* Milliseconds since the measurement task started, 0 if it did not. */
+    uint32_t getMeasurementMillis();
+    /* Triggers per second of the given sensor since the measurement task
+     * started, see SensorHealth. */
+    float getTriggersPerSecond(uint8_t sensorId);
+    /* Triggers the next sensor of the schedule, publishes the readings
+     * of the sensors whose echo is in meanwhile. */
     void getDistances();
-    void getDistancesParallel();
-    void reset();
+    /* Takes the next published reading and updates the distances, waits up
+     * to ticksToWait for a reading. Returns false if there was none.
+     */
+    bool processNextReading(TickType_t ticksToWait);
+    /* Starts a new interval, its readings are recorded to the timeline
+     * which is only used by processNextReading(). */
+    void reset(Timeline* timeline);
+    /* Called from processNextReading(), so in the task of loop(). */
+    void setEchoListener(EchoListener listener);
     void registerSensor(HCSR04SensorInfo);
     void setOffsets(std::vector<uint16_t>);
-    void setPrimarySensor(uint8_t idx);
+    /* Interference group for each sensor in the order of registration,
+     * see HCSR04SensorInfo::interferenceGroup. Missing entries are 0. */
+    void setInterferenceGroups(std::vector<uint8_t>);
+    /* Sensors of the same interference group are triggered independent of
+     * each other, echos of the burst of another sensor are detected and
+     * dropped instead of avoided. About doubles the readings per sensor.
+     */
+    void setParallelTrigger(bool parallel);
     /* Returns the current raw median distance in cm for the
      * given sensor.
      */
     uint16_t getRawMedianDistance(uint8_t sensorId);
     /* Index for CSV - starts with 1. */
     uint16_t getCurrentMeasureIndex();
+    /* Index of the last record of the given sensor in the timeline, starts
+     * with 0. The last record if the sensor has none in this interval.
+     */
+    uint16_t getLastMeasureIndex(uint8_t sensorId);
+    /* Readings of the given sensor in the current interval per second. */
+    uint16_t getReadingsPerSecond(uint8_t sensorId, uint32_t intervalMillis);
+    /* Largest trigger jitter of the slots of the current interval. */
+    uint16_t getMaxTriggerJitterMicroseconds();
+    /* Ambient temperature used to convert the echo time to a distance. */
+    void setTemperature(float celsius);
+    /* Echo time per cm distance at the current temperature. */
+    float getMicrosecondsPerCm() const;
 
     std::vector<HCSR04SensorInfo> m_sensors;
     std::vector<uint16_t> sensorValues;
-    uint16_t lastReadingCount = 0;
-    uint16_t startOffsetMilliseconds[MAX_NUMBER_MEASUREMENTS_PER_INTERVAL + 1];
+    /* Readings that were dropped because loop() did not take them in time. */
+    uint32_t lostReadings = 0;
+    /* Records that did not fit into the timeline arena. */
+    uint32_t droppedRecords = 0;
+    /* Echos dropped in parallel mode as they came from another sensor. */
+    uint32_t rejectedReadings = 0;
 
   protected:
 
   private:
-    void waitTillSensorIsReady(uint8_t sensorId);
+    uint8_t waitTillNextSensorIsReady();
     void sendTriggerToSensor(uint8_t sensorId);
-    void waitForEchosOrTimeout(uint8_t sensorId);
-    void collectSensorResult(uint8_t sensorId);
-    void setNoMeasureDate(uint8_t sensorId);
-    void waitTillPrimarySensorIsReady();
-    void waitForEchosOrTimeout();
+    int32_t getEchoDuration(uint8_t sensorId);
+    void collectSensorResult(uint8_t sensorId, int32_t echoDuration);
     void setSensorTriggersToLow();
-    void collectSensorResults();
-    void sendTriggerToReadySensor();
+    uint32_t getTriggerJitter(uint8_t sensorId);
+    void publishReading(SensorReading &reading);
+    void publishCompletedReadings();
+    static void measurementTask(void *parameter);
     void IRAM_ATTR isr(int idx);
-    uint32_t getFixedStart(size_t idx, const HCSR04SensorInfo *sensor);
-    static uint16_t medianMeasure(HCSR04SensorInfo* const sensor, uint16_t value);
-    static uint16_t median(uint16_t a, uint16_t b, uint16_t c);
-    static uint16_t correctSensorOffset(uint16_t dist, uint16_t offset);
-    static boolean isReadyForStart(HCSR04SensorInfo* sensor);
+    void waitForEdgeOrTimeout(uint32_t deadline);
+    static void processEdges(HCSR04SensorInfo* sensor);
+    boolean isReadyForStart(uint8_t sensorId);
+    uint32_t readyAt(uint8_t sensorId);
+    boolean isPhantomEcho(uint8_t sensorId);
+    static uint32_t getQuietPeriodAfterStart(HCSR04SensorInfo* sensor);
+    static uint32_t getCrossTalkPeriod(HCSR04SensorInfo* sensor);
     static uint32_t microsBetween(uint32_t a, uint32_t b);
     static uint32_t microsSince(uint32_t a);
-    static uint16_t millisSince(uint16_t milliseconds);
+    static uint32_t later(uint32_t a, uint32_t b);
+    static uint32_t earlier(uint32_t a, uint32_t b);
     uint16_t startReadingMilliseconds = 0;
-    /* The currently used sensor for alternating use. */
+    uint16_t maxTriggerJitterMicroseconds = 0;
+    /* Records of the current interval, owned by the DataSet. */
+    Timeline* timeline = nullptr;
+    EchoListener echoListener;
+    EchoDistance echoDistance;
+    /* The sensor triggered last. */
     uint32_t activeSensor = 0;
-    uint8_t primarySensor = 1;
+    bool parallelTrigger = false;
+    TaskHandle_t measurementTaskHandle = nullptr;
+    uint32_t measurementStartMillis = 0;
+    /* Task that waits for echo edges, notified by the interrupt handler. */
+    volatile TaskHandle_t waitingTask = nullptr;
+    QueueHandle_t readings;
 };
 
+/* Shared by the timelines of all DataSets, see TIMELINE_CHUNKS. */
+extern TimelineArena timelineArena;
+
 #endif
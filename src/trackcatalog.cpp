@@ -0,0 +1,212 @@
+/*
+  Copyright (C) 2019-2021 OpenBikeSensor Contributors
+  Contact: https://openbikesensor.org
+
+  This file is part of the OpenBikeSensor project.
+
+  The OpenBikeSensor sensor firmware is free software: you can redistribute
+  it and/or modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the License,
+  or (at your option) any later version.
+
+  The OpenBikeSensor sensor firmware is distributed in the hope that it will
+  be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+  Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with
+  the OpenBikeSensor sensor firmware.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "trackcatalog.h"
+
+#include <SD.h>
+#include <cmath>
+#include <cstring>
+
+#include "writer.h"
+
+static_assert(sizeof(TrackEntry) == 108, "catalog entries are stored as they are");
+
+const char *TrackCatalog::CATALOG_FILE = "/tracks.idx";
+
+/* Track number of firmware before the catalog. */
+static const char *TRACK_NUMBER_FILE = "/tracknumber.txt";
+static const char *FIRST_TRACK_NAME = "/sensorData";
+
+bool TrackEntry::setName(const String &path) {
+  if (path.length() >= sizeof(name)) {
+    return false;
+  }
+  memset(name, 0, sizeof(name));
+  memcpy(name, path.c_str(), path.length());
+  return true;
+}
+
+void TrackEntry::addPosition(double latitude, double longitude) {
+  const int32_t lat = (int32_t) lround(latitude * 1e7);
+  const int32_t lng = (int32_t) lround(longitude * 1e7);
+  minLatitude = min(minLatitude, lat);
+  maxLatitude = max(maxLatitude, lat);
+  minLongitude = min(minLongitude, lng);
+  maxLongitude = max(maxLongitude, lng);
+}
+
+static bool isTrack(const String &name) {
+  for (const String &extension : {CSVFileWriter::EXTENSION, BinaryFileWriter::EXTENSION}) {
+    if (name.endsWith(extension) || name.endsWith(extension + FileWriter::GZIP_EXTENSION)) {
+      return true;
+    }
+  }
+  return name.startsWith(FIRST_TRACK_NAME);
+}
+
+uint32_t TrackCatalog::count() {
+  Header header;
+  if (!readHeader(header)) {
+    return 0;
+  }
+  File file = SD.open(CATALOG_FILE, FILE_READ);
+  const size_t size = file.size();
+  file.close();
+  return (size - sizeof(Header)) / sizeof(TrackEntry);
+}
+
+uint32_t TrackCatalog::read(uint32_t first, TrackEntry *entries, uint32_t size) {
+  Header header;
+  if (!readHeader(header)) {
+    return 0;
+  }
+  File file = SD.open(CATALOG_FILE, FILE_READ);
+  uint32_t result = 0;
+  if (file.seek(sizeof(Header) + first * sizeof(TrackEntry))) {
+    result = file.read((uint8_t *) entries, size * sizeof(TrackEntry)) / sizeof(TrackEntry);
+  }
+  file.close();
+  return result;
+}
+
+bool TrackCatalog::write(uint32_t index, const TrackEntry &entry) {
+  File file = SD.open(CATALOG_FILE, "r+");
+  const bool written = file.seek(sizeof(Header) + index * sizeof(TrackEntry))
+    && file.write((const uint8_t *) &entry, sizeof(entry)) == sizeof(entry);
+  file.close();
+  return written;
+}
+
+uint32_t TrackCatalog::add(const TrackEntry &entry) {
+  Header header;
+  if (!readHeader(header)) {
+    return NO_ENTRY;
+  }
+  File file = SD.open(CATALOG_FILE, FILE_APPEND);
+  const uint32_t index = (file.size() - sizeof(Header)) / sizeof(TrackEntry);
+  const bool written = file.write((const uint8_t *) &entry, sizeof(entry)) == sizeof(entry);
+  file.close();
+  return written ? index : NO_ENTRY;
+}
+
+uint32_t TrackCatalog::nextTrackNumber() {
+  Header header;
+  return readHeader(header) ? header.nextTrackNumber : 0;
+}
+
+bool TrackCatalog::setNextTrackNumber(uint32_t number) {
+  Header header;
+  if (!readHeader(header)) {
+    return false;
+  }
+  header.nextTrackNumber = number;
+  return writeHeader(header);
+}
+
+uint32_t TrackCatalog::firstPendingUpload() {
+  Header header;
+  return readHeader(header) ? header.firstPendingUpload : 0;
+}
+
+bool TrackCatalog::setFirstPendingUpload(uint32_t index) {
+  Header header;
+  if (!readHeader(header)) {
+    return false;
+  }
+  header.firstPendingUpload = index;
+  return writeHeader(header);
+}
+
+bool TrackCatalog::readHeader(Header &header) {
+  File file = SD.open(CATALOG_FILE, FILE_READ);
+  if (!file) {
+    if (!create()) {
+      return false;
+    }
+    file = SD.open(CATALOG_FILE, FILE_READ);
+  }
+  const bool valid = file.read((uint8_t *) &header, sizeof(header)) == sizeof(header)
+    && memcmp(header.magic, "OBSI", 4) == 0 && header.version == VERSION
+    && header.entrySize == sizeof(TrackEntry);
+  file.close();
+  if (!valid) {
+    log_e("Invalid track catalog %s.", CATALOG_FILE);
+  }
+  return valid;
+}
+
+bool TrackCatalog::writeHeader(const Header &header) {
+  File file = SD.open(CATALOG_FILE, "r+");
+  const bool written = file.write((const uint8_t *) &header, sizeof(header)) == sizeof(header);
+  file.close();
+  return written;
+}
+
+/* Walks the root directory once, the catalog is renamed into place when
+ * complete so a power loss here only costs the walk again.
+ */
+bool TrackCatalog::create() {
+  Header header;
+  memcpy(header.magic, "OBSI", 4);
+  header.version = VERSION;
+  header.reserved = 0;
+  header.entrySize = sizeof(TrackEntry);
+  header.nextTrackNumber = 0;
+  header.firstPendingUpload = 0;
+
+  File numberFile = SD.open(TRACK_NUMBER_FILE, FILE_READ);
+  if (numberFile) {
+    header.nextTrackNumber = numberFile.readString().toInt();
+    numberFile.close();
+  }
+
+  const String tmpPath = String(CATALOG_FILE) + ".tmp";
+  File catalog = SD.open(tmpPath.c_str(), FILE_WRITE);
+  if (!catalog) {
+    return false;
+  }
+  bool written = catalog.write((const uint8_t *) &header, sizeof(header)) == sizeof(header);
+  File root = SD.open("/");
+  File file = root.openNextFile();
+  while (file && written) {
+    const String name = file.name();
+    TrackEntry entry;
+    if (!file.isDirectory() && isTrack(name) && entry.setName(name)) {
+      entry.state = TrackEntry::RECORDED;
+      entry.size = file.size();
+      if (name.startsWith(FIRST_TRACK_NAME)) {
+        entry.number = name.substring(strlen(FIRST_TRACK_NAME)).toInt();
+        header.nextTrackNumber = max(header.nextTrackNumber, entry.number + 1);
+      }
+      written = catalog.write((const uint8_t *) &entry, sizeof(entry)) == sizeof(entry);
+    }
+    file.close();
+    file = root.openNextFile();
+  }
+  root.close();
+  written = written && catalog.seek(0)
+    && catalog.write((const uint8_t *) &header, sizeof(header)) == sizeof(header);
+  catalog.close();
+  if (!written || !SD.rename(tmpPath.c_str(), CATALOG_FILE)) {
+    log_e("Failed to create the track catalog.");
+    SD.remove(tmpPath.c_str());
+    return false;
+  }
+  return true;
+}
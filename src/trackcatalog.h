@@ -0,0 +1,111 @@
+/*
+  Copyright (C) 2019-2021 OpenBikeSensor Contributors
+  Contact: https://openbikesensor.org
+
+  This file is part of the OpenBikeSensor project.
+
+  The OpenBikeSensor sensor firmware is free software: you can redistribute
+  it and/or modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the License,
+  or (at your option) any later version.
+
+  The OpenBikeSensor sensor firmware is distributed in the hope that it will
+  be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+  Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with
+  the OpenBikeSensor sensor firmware.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef OBS_TRACKCATALOG_H
+#define OBS_TRACKCATALOG_H
+
+#include <Arduino.h>
+#include <cstdint>
+
+/* What the catalog knows about one track. Stored as it is in memory, so
+ * fixed size members only in little endian order of the ESP32.
+ */
+struct TrackEntry {
+  enum State : uint8_t {
+    /* Written by the writer task, or the ride ended with a power loss. */
+    RECORDING = 0,
+    RECORDED = 1,
+    /* Moved to /uploaded, name is the new path. */
+    UPLOADED = 2,
+    /* The file was gone when the catalog looked for it. */
+    REMOVED = 3
+  };
+
+  char name[64] = {};
+  /* n of the /sensorData<n> name the track started with, 0 if unknown. */
+  uint32_t number = 0;
+  /* Bytes up to the last sync of the file. */
+  uint32_t size = 0;
+  /* Time of the first and last record, 0 if unknown. */
+  uint32_t startTime = 0;
+  uint32_t endTime = 0;
+  uint32_t records = 0;
+  /* Records with a confirmed overtaking. */
+  uint32_t confirmed = 0;
+  /* Bounding box of the positions written in 1e-7 degrees, empty as long
+   * as minLatitude > maxLatitude. */
+  int32_t minLatitude = INT32_MAX;
+  int32_t minLongitude = INT32_MAX;
+  int32_t maxLatitude = INT32_MIN;
+  int32_t maxLongitude = INT32_MIN;
+  uint8_t state = RECORDING;
+  uint8_t reserved[3] = {};
+
+  /* False if the name does not fit. */
+  bool setName(const String &path);
+  void addPosition(double latitude, double longitude);
+  bool hasPosition() const {
+    return minLatitude <= maxLatitude;
+  };
+};
+
+/* Index of the tracks on the SD card in CATALOG_FILE, one entry per track
+ * at a fixed offset. Entry n is read or updated with a seek instead of a
+ * walk over the directory, new tracks are appended.
+ *
+ * Created from the tracks found on the card the first time it is used.
+ */
+class TrackCatalog {
+  public:
+    static const char *CATALOG_FILE;
+    static const uint32_t NO_ENTRY = UINT32_MAX;
+
+    /* Number of entries, 0 without a card. */
+    static uint32_t count();
+    /* Reads up to size entries starting at first, returns the number read. */
+    static uint32_t read(uint32_t first, TrackEntry *entries, uint32_t size);
+    static bool write(uint32_t index, const TrackEntry &entry);
+    /* Appends the entry, returns its index or NO_ENTRY. */
+    static uint32_t add(const TrackEntry &entry);
+    /* Track number for the next /sensorData<n> name. */
+    static uint32_t nextTrackNumber();
+    static bool setNextTrackNumber(uint32_t number);
+    /* Entries before this one are uploaded or never will be, the upload
+     * starts here. */
+    static uint32_t firstPendingUpload();
+    static bool setFirstPendingUpload(uint32_t index);
+
+  private:
+    struct Header {
+      char magic[4];
+      uint8_t version;
+      uint8_t reserved;
+      uint16_t entrySize;
+      uint32_t nextTrackNumber;
+      uint32_t firstPendingUpload;
+    };
+    static const uint8_t VERSION = 1;
+
+    static bool readHeader(Header &header);
+    static bool writeHeader(const Header &header);
+    /* Writes a new catalog with the tracks on the card. */
+    static bool create();
+};
+
+#endif //OBS_TRACKCATALOG_H
@@ -102,8 +102,15 @@ uploader::uploader() {
  *
  */
 bool uploader::upload(const String& fileName) {
-  if(fileName.substring(0,7) != "/sensor"
-    && !fileName.endsWith(CSVFileWriter::EXTENSION)) {
+  // the portal only takes uncompressed CSV, gunzip the track or convert
+  // binary tracks with tools/decoder
+  if (fileName.endsWith(FileWriter::GZIP_EXTENSION)) {
+    Serial.printf(("not sending " + fileName + ", the portal takes no gzip tracks\n").c_str());
+    return false;
+  }
+  if((fileName.substring(0,7) != "/sensor"
+    && !fileName.endsWith(CSVFileWriter::EXTENSION))
+    || fileName.endsWith(BinaryFileWriter::EXTENSION)) {
     Serial.printf(("not sending " + fileName + "\n").c_str());
     return false;
   }
@@ -0,0 +1,159 @@
+/*
+  Copyright (C) 2019-2021 OpenBikeSensor Contributors
+  Contact: https://openbikesensor.org
+
+  This file is part of the OpenBikeSensor project.
+
+  The OpenBikeSensor sensor firmware is free software: you can redistribute
+  it and/or modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the License,
+  or (at your option) any later version.
+
+  The OpenBikeSensor sensor firmware is distributed in the hope that it will
+  be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+  Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with
+  the OpenBikeSensor sensor firmware.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef OBS_UTILS_CSVLINE_H
+#define OBS_UTILS_CSVLINE_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include "decimal.h"
+
+/* Builds a line of text in a buffer given by the caller, numbers are
+ * formatted without String temporaries or any other heap allocation.
+ * Text that does not fit is dropped, see overflow().
+ */
+class CsvLine {
+  public:
+    CsvLine(char *buffer, size_t capacity) : buffer(buffer), capacity(capacity) {};
+
+    void clear() {
+      length = 0;
+      overflowed = false;
+    };
+    CsvLine &append(char c) {
+      if (length < capacity) {
+        buffer[length++] = c;
+      } else {
+        overflowed = true;
+      }
+      return *this;
+    };
+    CsvLine &append(const char *text, size_t size) {
+      if (size > capacity - length) {
+        size = capacity - length;
+        overflowed = true;
+      }
+      memcpy(buffer + length, text, size);
+      length += size;
+      return *this;
+    };
+    CsvLine &append(const char *text) {
+      return append(text, strlen(text));
+    };
+    CsvLine &appendUnsigned(uint64_t value) {
+      char digits[20];
+      size_t count = 0;
+      do {
+        digits[count++] = (char) ('0' + value % 10);
+        value /= 10;
+      } while (value > 0);
+      while (count > 0) {
+        append(digits[--count]);
+      }
+      return *this;
+    };
+    CsvLine &appendSigned(int64_t value) {
+      if (value < 0) {
+        append('-');
+        return appendUnsigned(0 - (uint64_t) value);
+      }
+      return appendUnsigned((uint64_t) value);
+    };
+    /* Leading zeros up to the given number of digits, e.g. for the date. */
+    CsvLine &appendPadded(uint32_t value, uint8_t digits) {
+      uint32_t limit = 1;
+      for (uint8_t idx = 1; idx < digits; ++idx) {
+        limit *= 10;
+        if (value < limit) {
+          append('0');
+        }
+      }
+      return appendUnsigned(value);
+    };
+    /* An integer holding the digits with the given number of decimals,
+     * e.g. 4878427 with 5 decimals as 48.78427. */
+    CsvLine &appendScaled(int64_t value, uint8_t decimals) {
+      const uint64_t factor = (uint64_t) Decimal::powerOf10(decimals);
+      if (value < 0) {
+        append('-');
+      }
+      const uint64_t absolute = value < 0 ? 0 - (uint64_t) value : (uint64_t) value;
+      appendUnsigned(absolute / factor);
+      if (decimals > 0) {
+        append('.');
+        appendPadded((uint32_t) (absolute % factor), decimals);
+      }
+      return *this;
+    };
+    /* Same text as printf("%.*f", decimals, value), the format of
+     * String(value, decimals) in the host simulation. Huge values are not
+     * expected in a track, printf takes care of them.
+     */
+    CsvLine &appendFixed(double value, uint8_t decimals) {
+      if (std::signbit(value)) {
+        append('-');
+      }
+      uint64_t scaled;
+      if (!Decimal::scale(value, decimals, scaled)) {
+        if (!std::isfinite(value)) {
+          return append(std::isnan(value) ? "nan" : "inf");
+        }
+        char text[330];
+        const int size = snprintf(text, sizeof(text), "%.*f", decimals, std::fabs(value));
+        return append(text, size > 0 ? std::min((size_t) size, sizeof(text) - 1) : 0);
+      }
+      const uint64_t factor = (uint64_t) Decimal::powerOf10(decimals);
+      appendUnsigned(scaled / factor);
+      if (decimals > 0) {
+        append('.');
+        uint64_t fraction = scaled % factor;
+        char digits[Decimal::MAX_DECIMALS];
+        for (uint8_t idx = decimals; idx > 0; --idx) {
+          digits[idx - 1] = (char) ('0' + fraction % 10);
+          fraction /= 10;
+        }
+        append(digits, decimals);
+      }
+      return *this;
+    };
+
+    const char *data() const {
+      return buffer;
+    };
+    size_t size() const {
+      return length;
+    };
+    /* Some text did not fit since the last clear(). */
+    bool overflow() const {
+      return overflowed;
+    };
+
+  private:
+    char *buffer;
+    size_t capacity;
+    size_t length = 0;
+    bool overflowed = false;
+};
+
+#endif //OBS_UTILS_CSVLINE_H
@@ -0,0 +1,83 @@
+/*
+  Copyright (C) 2019-2021 OpenBikeSensor Contributors
+  Contact: https://openbikesensor.org
+
+  This file is part of the OpenBikeSensor project.
+
+  The OpenBikeSensor sensor firmware is free software: you can redistribute
+  it and/or modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the License,
+  or (at your option) any later version.
+
+  The OpenBikeSensor sensor firmware is distributed in the hope that it will
+  be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+  Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with
+  the OpenBikeSensor sensor firmware.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef OBS_UTILS_DECIMAL_H
+#define OBS_UTILS_DECIMAL_H
+
+#include <cmath>
+#include <cstdint>
+
+/* Rounds doubles to a fixed number of decimals as printf("%.*f") does:
+ * from the exact binary value, ties to even. A plain lround(value * 10^n)
+ * is off by one now and then, the product is rounded before lround().
+ */
+class Decimal {
+  public:
+    static const uint8_t MAX_DECIMALS = 9;
+    /* Scaled values must be exact integers in a double. */
+    static constexpr double MAX_SCALED = 9007199254740992.0; // 2^53
+
+    /* |value| * 10^decimals rounded, false for nan, inf and values beyond
+     * MAX_SCALED. The sign is left to the caller, see std::signbit().
+     */
+    static bool scale(double value, uint8_t decimals, uint64_t &result) {
+      if (decimals > MAX_DECIMALS || !std::isfinite(value)) {
+        return false;
+      }
+      const double factor = powerOf10(decimals);
+      const double absolute = std::fabs(value);
+      // exact product absolute * factor = high + low (Dekker)
+      const double high = absolute * factor;
+      if (!(high < MAX_SCALED / 2)) {
+        return false;
+      }
+      double absoluteHigh, absoluteLow, factorHigh, factorLow;
+      split(absolute, absoluteHigh, absoluteLow);
+      split(factor, factorHigh, factorLow);
+      const double low = ((absoluteHigh * factorHigh - high) + absoluteHigh * factorLow
+        + absoluteLow * factorHigh) + absoluteLow * factorLow;
+      const double integer = std::floor(high);
+      // exact as long as it matters, close to 0.5 with Sterbenz' lemma,
+      // low is below half a unit in the last place of high
+      const double fraction = (high - integer) - 0.5;
+      result = (uint64_t) integer;
+      if (fraction > -low || (fraction == -low && (result & 1))) {
+        result++;
+      }
+      return true;
+    };
+
+    static double powerOf10(uint8_t exponent) {
+      double result = 1;
+      while (exponent-- > 0) {
+        result *= 10;
+      }
+      return result;
+    };
+
+  private:
+    /* Veltkamp split into two halves of 26 bits each. */
+    static void split(double value, double &high, double &low) {
+      const double c = 134217729.0 * value; // 2^27 + 1
+      high = c - (c - value);
+      low = value - high;
+    };
+};
+
+#endif //OBS_UTILS_DECIMAL_H
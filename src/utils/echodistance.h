@@ -0,0 +1,120 @@
+/*
+  Copyright (C) 2019-2021 OpenBikeSensor Contributors
+  Contact: https://openbikesensor.org
+
+  This file is part of the OpenBikeSensor project.
+
+  The OpenBikeSensor sensor firmware is free software: you can redistribute
+  it and/or modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the License,
+  or (at your option) any later version.
+
+  The OpenBikeSensor sensor firmware is distributed in the hope that it will
+  be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+  Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with
+  the OpenBikeSensor sensor firmware.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef OBS_UTILS_ECHODISTANCE_H
+#define OBS_UTILS_ECHODISTANCE_H
+
+#include <cmath>
+#include <cstdint>
+
+/* About the speed of sound:
+   See also http://www.sengpielaudio.com/Rechner-schallgeschw.htm (german)
+    - speed of sound depends on ambient temperature
+      temp, Celsius  speed, m/sec    int factor     dist error introduced with fix int factor of 58
+                     (331.5+(0.6*t)) (2000/speed)   (speed@58 / speed) - 1
+       35            352.1           (57)           -2.1% (-3.2cm bei 150cm)
+       30            349.2
+       25            346.3
+       22.4          344.82           58             0
+       20            343.4
+       15            340.5
+       12.5          338.98           (59)          +1.7% (2.6cm bei 150)
+       10            337.5
+       5             334.5
+       0             331.5            (60)          +4%  (6cm bei 150cm)
+      −5             328.5
+      −10            325.4
+      −15            322.3
+*/
+const uint32_t MICRO_SEC_TO_CM_DIVIDER = 58; // sound speed 340M/S, 2 times back and forward
+/* Range of the time of flight table, temperatures outside are clamped. */
+const int8_t MIN_TEMPERATURE_CELSIUS = -20;
+const int8_t MAX_TEMPERATURE_CELSIUS = 50;
+/* Temperature where the table matches MICRO_SEC_TO_CM_DIVIDER. */
+const int8_t DEFAULT_TEMPERATURE_CELSIUS = 22;
+
+const uint16_t MIN_DISTANCE_MEASURED_CM =   2;
+const uint16_t MAX_DISTANCE_MEASURED_CM = 320; // candidate to check I could not get good readings above 300
+
+/* Converts the echo time of a ultrasonic sensor into the distance in cm.
+ * Does not depend on the Arduino core, the host replay of recorded tracks
+ * (tools/replay) uses the very same conversion.
+ *
+ * MAX_SENSOR_VALUE stands for "nothing in range".
+ */
+class EchoDistance {
+  public:
+    EchoDistance() {
+      setTemperature(DEFAULT_TEMPERATURE_CELSIUS);
+    };
+    /* Ambient temperature used to convert the echo time to a distance. */
+    void setTemperature(float celsius) {
+      long index = lround(celsius) - MIN_TEMPERATURE_CELSIUS;
+      if (index < 0) {
+        index = 0;
+      } else if (index > MAX_TEMPERATURE_CELSIUS - MIN_TEMPERATURE_CELSIUS) {
+        index = MAX_TEMPERATURE_CELSIUS - MIN_TEMPERATURE_CELSIUS;
+      }
+      cmPerMicrosecond = cmPerMicrosecondTable()[index];
+    };
+    /* Inverse of getMicrosecondsPerCm(), e.g. with the Factor of a CSV
+     * line. Gives the same conversion as the temperature it came from.
+     */
+    void setMicrosecondsPerCm(float microsecondsPerCm) {
+      cmPerMicrosecond = (uint32_t) lround(65536.0f / microsecondsPerCm);
+    };
+    /* Echo time per cm distance at the current temperature. */
+    float getMicrosecondsPerCm() const {
+      return 65536.0f / (float) cmPerMicrosecond;
+    };
+    /* Distance for the given echo time, an echo that did not end in time
+     * (negative duration) counts as "nothing in range".
+     */
+    uint16_t centimeters(int32_t echoDurationMicroseconds) const {
+      if (echoDurationMicroseconds < (int32_t) (MIN_DISTANCE_MEASURED_CM * MICRO_SEC_TO_CM_DIVIDER)
+          || echoDurationMicroseconds >= (int32_t) (MAX_DISTANCE_MEASURED_CM * MICRO_SEC_TO_CM_DIVIDER)) {
+        return MAX_SENSOR_VALUE;
+      }
+      return static_cast<uint16_t>(((uint32_t) echoDurationMicroseconds * cmPerMicrosecond) >> 16);
+    };
+
+  private:
+    /* cm distance per microsecond echo time as 16.16 fixed point for each
+     * degree from MIN_TEMPERATURE_CELSIUS to MAX_TEMPERATURE_CELSIUS,
+     * 65536 * (331.5 + 0.6 * t) / 20000, see the table above.
+     */
+    static const uint16_t* cmPerMicrosecondTable() {
+      static const uint16_t CM_PER_MICROSECOND[MAX_TEMPERATURE_CELSIUS - MIN_TEMPERATURE_CELSIUS + 1] = {
+        1047, 1049, 1051, 1053, 1055, 1057, 1059, 1061, 1063, 1065, // -20
+        1067, 1069, 1071, 1072, 1074, 1076, 1078, 1080, 1082, 1084, // -10
+        1086, 1088, 1090, 1092, 1094, 1096, 1098, 1100, 1102, 1104, //   0
+        1106, 1108, 1110, 1112, 1114, 1116, 1118, 1120, 1122, 1124, //  10
+        1126, 1128, 1130, 1131, 1133, 1135, 1137, 1139, 1141, 1143, //  20
+        1145, 1147, 1149, 1151, 1153, 1155, 1157, 1159, 1161, 1163, //  30
+        1165, 1167, 1169, 1171, 1173, 1175, 1177, 1179, 1181, 1183, //  40
+        1185                                                        //  50
+      };
+      return CM_PER_MICROSECOND;
+    };
+
+    /* cm distance per microsecond echo time, 16.16 fixed point. */
+    uint32_t cmPerMicrosecond;
+};
+
+#endif //OBS_UTILS_ECHODISTANCE_H
@@ -0,0 +1,230 @@
+/*
+  Copyright (C) 2019-2021 OpenBikeSensor Contributors
+  Contact: https://openbikesensor.org
+
+  This file is part of the OpenBikeSensor project.
+
+  The OpenBikeSensor sensor firmware is free software: you can redistribute
+  it and/or modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the License,
+  or (at your option) any later version.
+
+  The OpenBikeSensor sensor firmware is distributed in the hope that it will
+  be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+  Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with
+  the OpenBikeSensor sensor firmware.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef OBS_UTILS_FILTER_H
+#define OBS_UTILS_FILTER_H
+
+#include <cmath>
+#include <cstdint>
+#include "median.h"
+
+/* Building blocks for the post processing of distance readings.
+ *
+ * A filter chain is a type, e.g.
+ *   FilterChain<uint16_t, MedianFilter<uint16_t, 3>, OffsetCorrection<uint16_t>>
+ * passes each value through the median first and corrects the offset of
+ * the result. All capacities are template parameters, a chain needs no
+ * heap and the compiler can inline the complete path. The stages do not
+ * depend on the Arduino core, so chains can also be compared on replayed
+ * data on the host.
+ *
+ * MAX_SENSOR_VALUE stands for "nothing in range" in all stages.
+ */
+
+/* Base of all stages, a stage hides what it needs. */
+template<typename T> class FilterStage {
+  public:
+    /* Distance from the sensor to the outer edge of the bike. */
+    void setOffset(uint16_t offset) {};
+    /* Forget all values seen so far. */
+    void reset() {};
+};
+
+/* Median of the last SIZE values. */
+template<typename T, size_t SIZE> class MedianFilter : public FilterStage<T> {
+  static_assert(SIZE % 2 == 1, "SIZE must be odd");
+
+  public:
+    MedianFilter() {
+      reset();
+    };
+    T process(T value) {
+      const T old = data[pos];
+      data[pos++] = value;
+      if (pos >= SIZE) {
+        pos = 0;
+      }
+      Median<T>::replaceSorted(sorted, SIZE, old, value);
+      return median();
+    };
+    T median() const {
+      return sorted[SIZE / 2];
+    };
+    void reset() {
+      for (size_t i = 0; i < SIZE; i++) {
+        data[i] = MAX_SENSOR_VALUE;
+        sorted[i] = MAX_SENSOR_VALUE;
+      }
+      pos = 0;
+    };
+
+  private:
+    T data[SIZE];
+    T sorted[SIZE];
+    size_t pos = 0;
+};
+
+/* Holds back values that jump more than MAX_JUMP away from the last value
+ * passed, the last value is repeated instead. A jump is passed if it is
+ * seen CONFIRMATIONS times in a row. Changes from or to "nothing in range"
+ * always pass.
+ */
+template<typename T, T MAX_JUMP, uint8_t CONFIRMATIONS> class OutlierGate : public FilterStage<T> {
+  public:
+    T process(T value) {
+      if (last == MAX_SENSOR_VALUE || value == MAX_SENSOR_VALUE
+          || (value > last ? value - last : last - value) <= MAX_JUMP
+          || ++jumps >= CONFIRMATIONS) {
+        last = value;
+        jumps = 0;
+      }
+      return last;
+    };
+    void reset() {
+      last = MAX_SENSOR_VALUE;
+      jumps = 0;
+    };
+
+  private:
+    T last = MAX_SENSOR_VALUE;
+    uint8_t jumps = 0;
+};
+
+/* Subtracts the offset, values below the offset become 0. */
+template<typename T> class OffsetCorrection : public FilterStage<T> {
+  public:
+    T process(T value) {
+      if (value == MAX_SENSOR_VALUE) {
+        return MAX_SENSOR_VALUE;
+      } else if (value > offset) {
+        return value - offset;
+      } else {
+        return 0; // would be negative if corrected
+      }
+    };
+    void setOffset(uint16_t newOffset) {
+      offset = newOffset;
+    };
+
+  private:
+    T offset = 0;
+};
+
+/* One dimensional Kalman filter with the measurement error in cm and the
+ * process noise in 1/1000. The estimate starts at the first value.
+ */
+template<typename T, uint16_t MEASUREMENT_ERROR, uint16_t PROCESS_NOISE_PERMILLE>
+class KalmanFilter : public FilterStage<T> {
+  public:
+    T process(T value) {
+      if (!started) {
+        estimate = value;
+        started = true;
+      }
+      const float gain = errorEstimate / (errorEstimate + MEASUREMENT_ERROR);
+      const float next = estimate + gain * ((float) value - estimate);
+      errorEstimate = (1.0f - gain) * errorEstimate
+        + std::fabs(estimate - next) * PROCESS_NOISE_PERMILLE / 1000.0f;
+      estimate = next;
+      return (T) (estimate + 0.5f);
+    };
+    float currentEstimate() const {
+      return estimate;
+    };
+    void reset() {
+      errorEstimate = MEASUREMENT_ERROR;
+      estimate = 0;
+      started = false;
+    };
+
+  private:
+    float errorEstimate = MEASUREMENT_ERROR;
+    float estimate = 0;
+    bool started = false;
+};
+
+/* Passes the value through all STAGES in order. */
+template<typename T, typename... STAGES> class FilterChain;
+
+template<typename T> class FilterChain<T> {
+  public:
+    T process(T value) {
+      return value;
+    };
+    void setOffset(uint16_t offset) {};
+    void reset() {};
+};
+
+template<typename T, typename STAGE, typename... STAGES> class FilterChain<T, STAGE, STAGES...> {
+  public:
+    T process(T value) {
+      return next.process(stage.process(value));
+    };
+    void setOffset(uint16_t offset) {
+      stage.setOffset(offset);
+      next.setOffset(offset);
+    };
+    void reset() {
+      stage.reset();
+      next.reset();
+    };
+
+  private:
+    STAGE stage;
+    FilterChain<T, STAGES...> next;
+};
+
+/* Post processing of the distances of one sensor. Implemented by
+ * DistanceFilterChain for a FilterChain type, so each sensor can bring its
+ * own chain.
+ */
+class DistanceFilter {
+  public:
+    virtual ~DistanceFilter() {}
+    virtual uint16_t filter(uint16_t distance) = 0;
+    virtual void setOffset(uint16_t offset) = 0;
+    /* Forgets the distances seen so far. */
+    virtual void reset() = 0;
+};
+
+template<typename CHAIN> class DistanceFilterChain : public DistanceFilter {
+  public:
+    uint16_t filter(uint16_t distance) override {
+      return chain.process(distance);
+    }
+    void setOffset(uint16_t offset) override {
+      chain.setOffset(offset);
+    }
+    void reset() override {
+      chain.reset();
+    }
+
+  private:
+    CHAIN chain;
+};
+
+const uint16_t MEDIAN_DISTANCE_MEASURES = 3;
+
+/* Chain of sensors that do not set their own filter: median of the last
+ * readings corrected by the sensor offset. */
+typedef FilterChain<uint16_t,
+  MedianFilter<uint16_t, MEDIAN_DISTANCE_MEASURES>,
+  OffsetCorrection<uint16_t>> DefaultDistanceFilter;
+
+#endif //OBS_UTILS_FILTER_H
@@ -0,0 +1,539 @@
+/*
+  Copyright (C) 2019-2021 OpenBikeSensor Contributors
+  Contact: https://openbikesensor.org
+
+  This file is part of the OpenBikeSensor project.
+
+  The OpenBikeSensor sensor firmware is free software: you can redistribute
+  it and/or modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the License,
+  or (at your option) any later version.
+
+  The OpenBikeSensor sensor firmware is distributed in the hope that it will
+  be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+  Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with
+  the OpenBikeSensor sensor firmware.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "gzip.h"
+
+#include <algorithm>
+#include <cstring>
+
+static const uint16_t LENGTH_BASE[29] = {
+  3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+  35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t LENGTH_EXTRA_BITS[29] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+  3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t DISTANCE_BASE[30] = {
+  1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+  257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+static const uint8_t DISTANCE_EXTRA_BITS[30] = {
+  0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+  7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+/* Order of the code length code lengths in a dynamic block header. */
+static const uint8_t CODE_LENGTH_ORDER[19] = {
+  16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15
+};
+/* Extra bits of the code length codes 16, 17 and 18 (repeats). */
+static const uint8_t REPEAT_EXTRA_BITS[3] = {2, 3, 7};
+
+static const uint16_t END_OF_BLOCK = 256;
+static const uint8_t MAX_CODE_BITS = 15;
+static const uint8_t MAX_CODE_LENGTH_BITS = 7;
+
+/* CRC-32 of gzip, 4 bits at a time to keep the table small. */
+static const uint32_t CRC_TABLE[16] = {
+  0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+  0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c, 0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c
+};
+
+static uint32_t updateCrc(uint32_t crc, const uint8_t *data, size_t size) {
+  crc = ~crc;
+  for (size_t idx = 0; idx < size; ++idx) {
+    crc ^= data[idx];
+    crc = (crc >> 4) ^ CRC_TABLE[crc & 0x0f];
+    crc = (crc >> 4) ^ CRC_TABLE[crc & 0x0f];
+  }
+  return ~crc;
+}
+
+/* Code lengths of the fixed Huffman code of deflate. */
+static uint8_t fixedLiteralLengthBits(uint16_t symbol) {
+  if (symbol < 144) {
+    return 8;
+  } else if (symbol < 256) {
+    return 9;
+  } else if (symbol < 280) {
+    return 7;
+  }
+  return 8;
+}
+
+bool GzipCompressor::write(const uint8_t *data, size_t size) {
+  if (!mInMember) {
+    writeHeader();
+    mInMember = true;
+  }
+  mCrc = updateCrc(mCrc, data, size);
+  mSize += size;
+  while (size > 0) {
+    const size_t length = std::min(size, (size_t) (MAX_MATCH - (mEnd - mPosition)));
+    for (size_t idx = 0; idx < length; ++idx) {
+      mWindow[(mEnd + idx) & (WINDOW_SIZE - 1)] = data[idx];
+    }
+    mEnd += length;
+    data += length;
+    size -= length;
+    compress(false);
+  }
+  return !mFailed;
+}
+
+bool GzipCompressor::finish() {
+  if (!mInMember) {
+    return !mFailed;
+  }
+  compress(true);
+  writeBlock(true);
+  alignToByte();
+  for (uint8_t idx = 0; idx < 4; ++idx) {
+    putByte((uint8_t) (mCrc >> (8 * idx)));
+  }
+  for (uint8_t idx = 0; idx < 4; ++idx) {
+    putByte((uint8_t) (mSize >> (8 * idx)));
+  }
+  const bool written = flushOutput();
+  reset();
+  return written;
+}
+
+void GzipCompressor::reset() {
+  mInMember = false;
+  mFailed = false;
+  mCrc = 0;
+  mSize = 0;
+  mPosition = 0;
+  mEnd = 0;
+  memset(mHead, 0, sizeof(mHead));
+  mPending = false;
+  mTokenCount = 0;
+  memset(mLiteralLengthFrequencies, 0, sizeof(mLiteralLengthFrequencies));
+  memset(mDistanceFrequencies, 0, sizeof(mDistanceFrequencies));
+  mBits = 0;
+  mBitCount = 0;
+  mBufferSize = 0;
+}
+
+uint32_t GzipCompressor::hash(uint32_t position) const {
+  const uint32_t value = mWindow[position & (WINDOW_SIZE - 1)]
+    | mWindow[(position + 1) & (WINDOW_SIZE - 1)] << 8
+    | mWindow[(position + 2) & (WINDOW_SIZE - 1)] << 16;
+  return (value * 2654435761u) >> 22; // 10 bit for HASH_SIZE
+}
+
+/* Longest match of the candidates, an older position with the same low
+ * bits is fine as the bytes are compared. */
+uint32_t GzipCompressor::findMatch(uint32_t position, uint32_t available, uint32_t &distance) {
+  const uint32_t index = hash(position);
+  uint32_t best = 0;
+  for (uint8_t way = 0; way < WAYS; ++way) {
+    const uint16_t head = mHead[index][way];
+    const uint32_t candidate = (uint16_t) (position + 1 - head);
+    if (head == 0 || candidate == 0 || candidate > MAX_DISTANCE || candidate > position) {
+      continue;
+    }
+    const uint32_t match = position - candidate;
+    uint32_t length = 0;
+    while (length < available && mWindow[(match + length) & (WINDOW_SIZE - 1)]
+           == mWindow[(position + length) & (WINDOW_SIZE - 1)]) {
+      length++;
+    }
+    if (length > best) {
+      best = length;
+      distance = candidate;
+    }
+  }
+  insert(position, index);
+  return best;
+}
+
+void GzipCompressor::insert(uint32_t position, uint32_t index) {
+  for (uint8_t way = WAYS - 1; way > 0; --way) {
+    mHead[index][way] = mHead[index][way - 1];
+  }
+  mHead[index][0] = (uint16_t) (position + 1);
+}
+
+/* Lazy as zlib: a match is only taken if the next position has no
+ * longer one. Keeps MAX_MATCH bytes of look ahead unless all is asked for.
+ */
+void GzipCompressor::compress(bool all) {
+  while (mEnd - mPosition >= (all ? 1 : MAX_MATCH)) {
+    const uint32_t available = std::min(mEnd - mPosition, (uint32_t) MAX_MATCH);
+    uint32_t distance = 0;
+    const uint32_t length = available >= MIN_MATCH ? findMatch(mPosition, available, distance) : 0;
+    if (mPending && mPendingLength >= MIN_MATCH && length <= mPendingLength) {
+      addMatch((uint16_t) mPendingLength, (uint16_t) mPendingDistance);
+      // mPosition is hashed already, skip the rest of the match
+      const uint32_t end = mPosition - 1 + mPendingLength;
+      for (uint32_t position = mPosition + 1; position < end && position + MIN_MATCH <= mEnd; ++position) {
+        insert(position, hash(position));
+      }
+      mPosition = end;
+      mPending = false;
+      continue;
+    }
+    if (mPending) {
+      addLiteral(mWindow[(mPosition - 1) & (WINDOW_SIZE - 1)]);
+    }
+    mPending = true;
+    mPendingLength = length;
+    mPendingDistance = distance;
+    mPosition++;
+  }
+  if (all && mPending) {
+    if (mPendingLength >= MIN_MATCH) {
+      addMatch((uint16_t) mPendingLength, (uint16_t) mPendingDistance);
+    } else {
+      addLiteral(mWindow[(mPosition - 1) & (WINDOW_SIZE - 1)]);
+    }
+    mPending = false;
+  }
+}
+
+void GzipCompressor::addLiteral(uint8_t literal) {
+  mTokens[mTokenCount++] = {literal, 0};
+  mLiteralLengthFrequencies[literal]++;
+  if (mTokenCount == BLOCK_TOKENS) {
+    writeBlock(false);
+  }
+}
+
+void GzipCompressor::addMatch(uint16_t length, uint16_t distance) {
+  mTokens[mTokenCount++] = {length, distance};
+  mLiteralLengthFrequencies[257 + lengthCode(length)]++;
+  mDistanceFrequencies[distanceCode(distance)]++;
+  if (mTokenCount == BLOCK_TOKENS) {
+    writeBlock(false);
+  }
+}
+
+/* Writes the tokens with the fixed or a dynamic Huffman code, whatever
+ * is shorter. */
+void GzipCompressor::writeBlock(bool last) {
+  mLiteralLengthFrequencies[END_OF_BLOCK]++;
+  buildLengths(mLiteralLengthFrequencies, LITERAL_LENGTH_CODES, MAX_CODE_BITS, mLiteralLengthBits);
+  buildLengths(mDistanceFrequencies, DISTANCE_CODES, MAX_CODE_BITS, mDistanceBits);
+
+  uint16_t literalLengths = LITERAL_LENGTH_CODES;
+  while (literalLengths > 257 && mLiteralLengthBits[literalLengths - 1] == 0) {
+    literalLengths--;
+  }
+  uint16_t distances = DISTANCE_CODES;
+  while (distances > 1 && mDistanceBits[distances - 1] == 0) {
+    distances--;
+  }
+
+  uint16_t runs = 0;
+  uint16_t codeLengthFrequencies[CODE_LENGTH_CODES] = {};
+  const uint16_t lengths = literalLengths + distances;
+  for (uint16_t idx = 0; idx < lengths;) {
+    const uint8_t bits = idx < literalLengths
+      ? mLiteralLengthBits[idx] : mDistanceBits[idx - literalLengths];
+    uint16_t repeat = 1;
+    while (idx + repeat < lengths && bits == (idx + repeat < literalLengths
+      ? mLiteralLengthBits[idx + repeat] : mDistanceBits[idx + repeat - literalLengths])) {
+      repeat++;
+    }
+    idx += repeat;
+    if (bits == 0) {
+      while (repeat >= 11) {
+        const uint16_t count = std::min(repeat, (uint16_t) 138);
+        mRuns[runs++] = 18 | (count - 11) << 8;
+        repeat -= count;
+      }
+      if (repeat >= 3) {
+        mRuns[runs++] = 17 | (repeat - 3) << 8;
+        repeat = 0;
+      }
+    } else {
+      mRuns[runs++] = bits;
+      repeat--;
+      while (repeat >= 3) {
+        const uint16_t count = std::min(repeat, (uint16_t) 6);
+        mRuns[runs++] = 16 | (count - 3) << 8;
+        repeat -= count;
+      }
+    }
+    while (repeat-- > 0) {
+      mRuns[runs++] = bits;
+    }
+  }
+  for (uint16_t idx = 0; idx < runs; ++idx) {
+    codeLengthFrequencies[mRuns[idx] & 0xff]++;
+  }
+  uint8_t codeLengthBits[CODE_LENGTH_CODES];
+  uint16_t codeLengthCodes[CODE_LENGTH_CODES];
+  buildLengths(codeLengthFrequencies, CODE_LENGTH_CODES, MAX_CODE_LENGTH_BITS, codeLengthBits);
+  buildCodes(codeLengthBits, CODE_LENGTH_CODES, codeLengthCodes);
+  uint8_t codeLengths = CODE_LENGTH_CODES;
+  while (codeLengths > 4 && codeLengthBits[CODE_LENGTH_ORDER[codeLengths - 1]] == 0) {
+    codeLengths--;
+  }
+
+  // the extra bits of lengths and distances are the same with both codes
+  uint32_t dynamicBits = 5 + 5 + 4 + 3 * codeLengths;
+  for (uint16_t idx = 0; idx < runs; ++idx) {
+    const uint8_t symbol = mRuns[idx] & 0xff;
+    dynamicBits += codeLengthBits[symbol] + (symbol >= 16 ? REPEAT_EXTRA_BITS[symbol - 16] : 0);
+  }
+  uint32_t fixedBits = 0;
+  for (uint16_t idx = 0; idx < LITERAL_LENGTH_CODES; ++idx) {
+    dynamicBits += mLiteralLengthFrequencies[idx] * mLiteralLengthBits[idx];
+    fixedBits += mLiteralLengthFrequencies[idx] * fixedLiteralLengthBits(idx);
+  }
+  for (uint16_t idx = 0; idx < DISTANCE_CODES; ++idx) {
+    dynamicBits += mDistanceFrequencies[idx] * mDistanceBits[idx];
+    fixedBits += mDistanceFrequencies[idx] * 5;
+  }
+
+  uint16_t literalLengthCodes = LITERAL_LENGTH_CODES;
+  putBits(last ? 1 : 0, 1);
+  if (fixedBits <= dynamicBits) {
+    putBits(1, 2);
+    literalLengthCodes = FIXED_LITERAL_LENGTH_CODES;
+    for (uint16_t idx = 0; idx < FIXED_LITERAL_LENGTH_CODES; ++idx) {
+      mLiteralLengthBits[idx] = fixedLiteralLengthBits(idx);
+    }
+    memset(mDistanceBits, 5, sizeof(mDistanceBits));
+  } else {
+    putBits(2, 2);
+    putBits(literalLengths - 257, 5);
+    putBits(distances - 1, 5);
+    putBits(codeLengths - 4, 4);
+    for (uint8_t idx = 0; idx < codeLengths; ++idx) {
+      putBits(codeLengthBits[CODE_LENGTH_ORDER[idx]], 3);
+    }
+    for (uint16_t idx = 0; idx < runs; ++idx) {
+      const uint8_t symbol = mRuns[idx] & 0xff;
+      putBits(codeLengthCodes[symbol], codeLengthBits[symbol]);
+      if (symbol >= 16) {
+        putBits(mRuns[idx] >> 8, REPEAT_EXTRA_BITS[symbol - 16]);
+      }
+    }
+  }
+  buildCodes(mLiteralLengthBits, literalLengthCodes, mLiteralLengthCodes);
+  buildCodes(mDistanceBits, DISTANCE_CODES, mDistanceCodes);
+  writeTokens(mLiteralLengthBits, mLiteralLengthCodes, mDistanceBits, mDistanceCodes);
+
+  mTokenCount = 0;
+  memset(mLiteralLengthFrequencies, 0, sizeof(mLiteralLengthFrequencies));
+  memset(mDistanceFrequencies, 0, sizeof(mDistanceFrequencies));
+}
+
+void GzipCompressor::writeTokens(const uint8_t *literalLengthBits, const uint16_t *literalLengthCodes,
+                                 const uint8_t *distanceBits, const uint16_t *distanceCodes) {
+  for (size_t idx = 0; idx < mTokenCount; ++idx) {
+    const Token &token = mTokens[idx];
+    if (token.distance == 0) {
+      putBits(literalLengthCodes[token.value], literalLengthBits[token.value]);
+      continue;
+    }
+    const uint8_t length = lengthCode(token.value);
+    putBits(literalLengthCodes[257 + length], literalLengthBits[257 + length]);
+    putBits(token.value - LENGTH_BASE[length], LENGTH_EXTRA_BITS[length]);
+    const uint8_t distance = distanceCode(token.distance);
+    putBits(distanceCodes[distance], distanceBits[distance]);
+    putBits(token.distance - DISTANCE_BASE[distance], DISTANCE_EXTRA_BITS[distance]);
+  }
+  putBits(literalLengthCodes[END_OF_BLOCK], literalLengthBits[END_OF_BLOCK]);
+}
+
+/* Huffman code lengths as by Moffat and Katajainen, "In-Place Calculation
+ * of Minimum-Redundancy Codes", then limited to maxBits by moving the
+ * longest codes up as zlib and miniz do.
+ */
+void GzipCompressor::buildLengths(const uint16_t *frequencies, uint16_t symbols, uint8_t maxBits,
+                                  uint8_t *lengths) {
+  uint16_t used = 0;
+  for (uint16_t symbol = 0; symbol < symbols; ++symbol) {
+    lengths[symbol] = 0;
+    if (frequencies[symbol] > 0) {
+      mSorted[used++] = symbol;
+    }
+  }
+  // a code needs two symbols at least, some decoders reject a single one
+  for (uint16_t symbol = 0; used < 2; ++symbol) {
+    if (frequencies[symbol] == 0) {
+      mSorted[used++] = symbol;
+    }
+  }
+  std::sort(mSorted, mSorted + used, [frequencies](uint16_t a, uint16_t b) {
+    return frequencies[a] < frequencies[b] || (frequencies[a] == frequencies[b] && a < b);
+  });
+  uint32_t *weights = mWeights;
+  for (uint16_t idx = 0; idx < used; ++idx) {
+    weights[idx] = std::max(frequencies[mSorted[idx]], (uint16_t) 1);
+  }
+
+  const int count = used;
+  weights[0] += weights[1];
+  int root = 0;
+  int leaf = 2;
+  for (int next = 1; next < count - 1; ++next) {
+    if (leaf >= count || weights[root] < weights[leaf]) {
+      weights[next] = weights[root];
+      weights[root++] = next;
+    } else {
+      weights[next] = weights[leaf++];
+    }
+    if (leaf >= count || (root < next && weights[root] < weights[leaf])) {
+      weights[next] += weights[root];
+      weights[root++] = next;
+    } else {
+      weights[next] += weights[leaf++];
+    }
+  }
+  weights[count - 2] = 0;
+  for (int next = count - 3; next >= 0; --next) {
+    weights[next] = weights[weights[next]] + 1;
+  }
+  int available = 1;
+  int depth = 0;
+  int next = count - 1;
+  root = count - 2;
+  while (available > 0) {
+    int inner = 0;
+    while (root >= 0 && (int) weights[root] == depth) {
+      inner++;
+      root--;
+    }
+    while (available > inner) {
+      weights[next--] = depth;
+      available--;
+    }
+    available = 2 * inner;
+    depth++;
+  }
+
+  uint16_t codes[MAX_CODE_BITS + 1] = {};
+  for (uint16_t idx = 0; idx < used; ++idx) {
+    codes[std::min(weights[idx], (uint32_t) maxBits)]++;
+  }
+  uint32_t total = 0;
+  for (uint8_t bits = 1; bits <= maxBits; ++bits) {
+    total += (uint32_t) codes[bits] << (maxBits - bits);
+  }
+  while (total > (1u << maxBits)) {
+    codes[maxBits]--;
+    for (uint8_t bits = maxBits - 1; bits > 0; --bits) {
+      if (codes[bits] > 0) {
+        codes[bits]--;
+        codes[bits + 1] += 2;
+        break;
+      }
+    }
+    total--;
+  }
+  // the rarest symbols get the longest codes
+  uint16_t idx = 0;
+  for (uint8_t bits = maxBits; bits > 0; --bits) {
+    for (uint16_t code = 0; code < codes[bits]; ++code) {
+      lengths[mSorted[idx++]] = bits;
+    }
+  }
+}
+
+/* Canonical codes, bit reversed as deflate sends codes from the most
+ * significant bit but putBits() starts with the least significant. */
+void GzipCompressor::buildCodes(const uint8_t *lengths, uint16_t symbols, uint16_t *codes) {
+  uint16_t counts[MAX_CODE_BITS + 1] = {};
+  for (uint16_t symbol = 0; symbol < symbols; ++symbol) {
+    counts[lengths[symbol]]++;
+  }
+  counts[0] = 0;
+  uint16_t next[MAX_CODE_BITS + 1];
+  uint16_t code = 0;
+  for (uint8_t bits = 1; bits <= MAX_CODE_BITS; ++bits) {
+    code = (code + counts[bits - 1]) << 1;
+    next[bits] = code;
+  }
+  for (uint16_t symbol = 0; symbol < symbols; ++symbol) {
+    const uint8_t bits = lengths[symbol];
+    if (bits == 0) {
+      continue;
+    }
+    uint16_t value = next[bits]++;
+    uint16_t reversed = 0;
+    for (uint8_t idx = 0; idx < bits; ++idx) {
+      reversed = (reversed << 1) | (value & 1);
+      value >>= 1;
+    }
+    codes[symbol] = reversed;
+  }
+}
+
+uint8_t GzipCompressor::lengthCode(uint16_t length) {
+  uint8_t code = 0;
+  while (code < 28 && LENGTH_BASE[code + 1] <= length) {
+    code++;
+  }
+  return code;
+}
+
+uint8_t GzipCompressor::distanceCode(uint16_t distance) {
+  uint8_t code = 0;
+  while (code < 29 && DISTANCE_BASE[code + 1] <= distance) {
+    code++;
+  }
+  return code;
+}
+
+/* Deflate, no name and no time, the "unknown" operating system. */
+void GzipCompressor::writeHeader() {
+  static const uint8_t HEADER[10] = {0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 0xff};
+  for (uint8_t value : HEADER) {
+    putByte(value);
+  }
+}
+
+void GzipCompressor::putBits(uint32_t value, uint8_t count) {
+  mBits |= value << mBitCount;
+  mBitCount += count;
+  while (mBitCount >= 8) {
+    putByte((uint8_t) mBits);
+    mBits >>= 8;
+    mBitCount -= 8;
+  }
+}
+
+void GzipCompressor::putByte(uint8_t value) {
+  mBuffer[mBufferSize++] = value;
+  if (mBufferSize == OUTPUT_SIZE) {
+    flushOutput();
+  }
+}
+
+void GzipCompressor::alignToByte() {
+  if (mBitCount > 0) {
+    putByte((uint8_t) mBits);
+  }
+  mBits = 0;
+  mBitCount = 0;
+}
+
+bool GzipCompressor::flushOutput() {
+  if (mBufferSize > 0 && !mFailed && !mOutput(mBuffer, mBufferSize)) {
+    mFailed = true;
+  }
+  mBufferSize = 0;
+  return !mFailed;
+}
@@ -0,0 +1,134 @@
+/*
+  Copyright (C) 2019-2021 OpenBikeSensor Contributors
+  Contact: https://openbikesensor.org
+
+  This file is part of the OpenBikeSensor project.
+
+  The OpenBikeSensor sensor firmware is free software: you can redistribute
+  it and/or modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the License,
+  or (at your option) any later version.
+
+  The OpenBikeSensor sensor firmware is distributed in the hope that it will
+  be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+  Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with
+  the OpenBikeSensor sensor firmware.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef OBS_UTILS_GZIP_H
+#define OBS_UTILS_GZIP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+/* Streaming deflate (RFC 1951) in gzip members (RFC 1952) with a 4 KiB
+ * window, lazy matching on the last WAYS positions of a hash and a Huffman
+ * code per block. All memory is part of the object, about 15 KiB, nothing
+ * is allocated while compressing.
+ *
+ * finish() ends the member, the next write() starts a new one. gzip and
+ * zlib read the members of a file as one stream.
+ */
+class GzipCompressor {
+  public:
+    /* Gets the compressed data in chunks of up to OUTPUT_SIZE bytes. */
+    typedef std::function<bool(const uint8_t *data, size_t size)> Output;
+
+    static const size_t WINDOW_SIZE = 4096;
+    static const size_t OUTPUT_SIZE = 512;
+
+    explicit GzipCompressor(Output output) : mOutput(output) {
+      reset();
+    };
+
+    /* False if the output failed, the member is broken then, see reset(). */
+    bool write(const uint8_t *data, size_t size);
+    /* Compresses what is left and writes the gzip trailer. */
+    bool finish();
+    /* Drops the current member, the next write() starts a new one. */
+    void reset();
+
+  private:
+    static const size_t MIN_MATCH = 3;
+    static const size_t MAX_MATCH = 258;
+    /* The ring keeps MAX_MATCH bytes of look ahead. */
+    static const size_t MAX_DISTANCE = WINDOW_SIZE - MAX_MATCH;
+    static const size_t HASH_SIZE = 1024;
+    /* Match candidates per hash. */
+    static const uint8_t WAYS = 2;
+    static const size_t BLOCK_TOKENS = 512;
+    static const uint16_t LITERAL_LENGTH_CODES = 286;
+    /* The fixed code has two codes more, they count for the codes. */
+    static const uint16_t FIXED_LITERAL_LENGTH_CODES = 288;
+    static const uint16_t DISTANCE_CODES = 30;
+    static const uint8_t CODE_LENGTH_CODES = 19;
+
+    /* A literal if distance is 0, otherwise a match. */
+    struct Token {
+      uint16_t value;
+      uint16_t distance;
+    };
+
+    void compress(bool all);
+    void addLiteral(uint8_t literal);
+    void addMatch(uint16_t length, uint16_t distance);
+    void writeBlock(bool last);
+    void writeTokens(const uint8_t *literalLengthBits, const uint16_t *literalLengthCodes,
+                     const uint8_t *distanceBits, const uint16_t *distanceCodes);
+    void writeHeader();
+    void putBits(uint32_t value, uint8_t count);
+    void putByte(uint8_t value);
+    void alignToByte();
+    bool flushOutput();
+    uint32_t hash(uint32_t position) const;
+    uint32_t findMatch(uint32_t position, uint32_t available, uint32_t &distance);
+    void insert(uint32_t position, uint32_t index);
+
+    /* Code lengths limited to maxBits for the symbols with a frequency. */
+    void buildLengths(const uint16_t *frequencies, uint16_t symbols, uint8_t maxBits, uint8_t *lengths);
+    static void buildCodes(const uint8_t *lengths, uint16_t symbols, uint16_t *codes);
+    static uint8_t lengthCode(uint16_t length);
+    static uint8_t distanceCode(uint16_t distance);
+
+    Output mOutput;
+    bool mInMember = false;
+    bool mFailed = false;
+    uint32_t mCrc = 0;
+    uint32_t mSize = 0;
+
+    /* Positions count the bytes of the member. */
+    uint8_t mWindow[WINDOW_SIZE];
+    uint32_t mPosition = 0;
+    uint32_t mEnd = 0;
+    /* Low 16 bit of the last positions of each hash, + 1, newest first. */
+    uint16_t mHead[HASH_SIZE][WAYS];
+    /* The token at mPosition - 1 waits for a longer match at mPosition. */
+    bool mPending = false;
+    uint32_t mPendingLength = 0;
+    uint32_t mPendingDistance = 0;
+
+    Token mTokens[BLOCK_TOKENS];
+    size_t mTokenCount = 0;
+    uint16_t mLiteralLengthFrequencies[LITERAL_LENGTH_CODES];
+    uint16_t mDistanceFrequencies[DISTANCE_CODES];
+
+    /* Used by writeBlock(), members to keep the stack of the caller small. */
+    uint8_t mLiteralLengthBits[FIXED_LITERAL_LENGTH_CODES];
+    uint16_t mLiteralLengthCodes[FIXED_LITERAL_LENGTH_CODES];
+    uint8_t mDistanceBits[DISTANCE_CODES];
+    uint16_t mDistanceCodes[DISTANCE_CODES];
+    uint16_t mSorted[LITERAL_LENGTH_CODES];
+    uint32_t mWeights[LITERAL_LENGTH_CODES];
+    /* Run length encoded code lengths, symbol | extra bits << 8. */
+    uint16_t mRuns[LITERAL_LENGTH_CODES + DISTANCE_CODES];
+
+    uint32_t mBits = 0;
+    uint8_t mBitCount = 0;
+    uint8_t mBuffer[OUTPUT_SIZE];
+    size_t mBufferSize = 0;
+};
+
+#endif //OBS_UTILS_GZIP_H
@@ -0,0 +1,75 @@
+/*
+  Copyright (C) 2019-2021 OpenBikeSensor Contributors
+  Contact: https://openbikesensor.org
+
+  This file is part of the OpenBikeSensor project.
+
+  The OpenBikeSensor sensor firmware is free software: you can redistribute
+  it and/or modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the License,
+  or (at your option) any later version.
+
+  The OpenBikeSensor sensor firmware is distributed in the hope that it will
+  be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+  Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with
+  the OpenBikeSensor sensor firmware.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef OPENBIKESENSORFIRMWARE_INLINEVECTOR_H
+#define OPENBIKESENSORFIRMWARE_INLINEVECTOR_H
+
+#include <cstddef>
+
+/* Vector with its storage inline for at most CAPACITY elements, so it
+ * never allocates. A full vector rejects further elements.
+ */
+template<typename T, size_t CAPACITY>
+class InlineVector {
+  public:
+    /* Returns false if the vector is full, the value is dropped. */
+    bool push_back(const T &value) {
+      if (count >= CAPACITY) {
+        return false;
+      }
+      data[count++] = value;
+      return true;
+    };
+    void clear() {
+      count = 0;
+    };
+    size_t size() const {
+      return count;
+    };
+    bool empty() const {
+      return count == 0;
+    };
+    static size_t capacity() {
+      return CAPACITY;
+    };
+    T &operator[](size_t index) {
+      return data[index];
+    };
+    const T &operator[](size_t index) const {
+      return data[index];
+    };
+    T* begin() {
+      return data;
+    };
+    T* end() {
+      return data + count;
+    };
+    const T* begin() const {
+      return data;
+    };
+    const T* end() const {
+      return data + count;
+    };
+
+  private:
+    T data[CAPACITY];
+    size_t count = 0;
+};
+
+#endif //OPENBIKESENSORFIRMWARE_INLINEVECTOR_H
@@ -0,0 +1,122 @@
+/*
+  Copyright (C) 2019-2021 OpenBikeSensor Contributors
+  Contact: https://openbikesensor.org
+
+  This file is part of the OpenBikeSensor project.
+
+  The OpenBikeSensor sensor firmware is free software: you can redistribute
+  it and/or modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the License,
+  or (at your option) any later version.
+
+  The OpenBikeSensor sensor firmware is distributed in the hope that it will
+  be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+  Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with
+  the OpenBikeSensor sensor firmware.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef OPENBIKESENSORFIRMWARE_INTERVALRING_H
+#define OPENBIKESENSORFIRMWARE_INTERVALRING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+
+/* The last SIZE intervals in order of their start, each holding a T that
+ * lives in the ring itself. push() constructs the newest, pop() destroys
+ * the oldest, so nothing is allocated and there are no pointers to hand
+ * around. Not thread safe, use it from one task only.
+ */
+template<typename T, size_t SIZE>
+class IntervalRing {
+  public:
+    /* intervalMillis is the usual length of an interval, see find(). */
+    explicit IntervalRing(uint32_t intervalMillis) : intervalMillis(intervalMillis) {};
+    IntervalRing(const IntervalRing &) = delete;
+    IntervalRing &operator=(const IntervalRing &) = delete;
+    ~IntervalRing() {
+      while (!empty()) {
+        pop();
+      }
+    };
+
+    /* Starts a new interval at the given millis(), nullptr if full. */
+    T* push(uint32_t startMillis) {
+      if (full()) {
+        return nullptr;
+      }
+      const size_t index = (first + count++) % SIZE;
+      starts[index] = startMillis;
+      return new (&slots[index]) T();
+    };
+    /* Destroys the oldest interval. */
+    void pop() {
+      if (!empty()) {
+        at(0)->~T();
+        first = (first + 1) % SIZE;
+        count--;
+      }
+    };
+    /* 0 is the oldest interval, size() - 1 the newest. */
+    T* at(size_t index) {
+      return reinterpret_cast<T*>(&slots[(first + index) % SIZE]);
+    };
+    uint32_t startMillis(size_t index) const {
+      return starts[(first + index) % SIZE];
+    };
+    T* oldest() {
+      return empty() ? nullptr : at(0);
+    };
+    T* newest() {
+      return empty() ? nullptr : at(count - 1);
+    };
+    /* Index of the interval the given millis() falls in, -1 if it is
+     * older than the oldest one. The newest interval has no end. Takes
+     * the index from the interval length, so a few steps at most if
+     * loop() skipped an interval.
+     */
+    int find(uint32_t millis) const {
+      if (empty() || before(millis, startMillis(0))) {
+        return -1;
+      }
+      size_t index = (millis - startMillis(0)) / intervalMillis;
+      if (index >= count) {
+        index = count - 1;
+      }
+      while (index > 0 && before(millis, startMillis(index))) {
+        index--;
+      }
+      while (index + 1 < count && !before(millis, startMillis(index + 1))) {
+        index++;
+      }
+      return (int) index;
+    };
+    size_t size() const {
+      return count;
+    };
+    bool empty() const {
+      return count == 0;
+    };
+    bool full() const {
+      return count == SIZE;
+    };
+    static size_t capacity() {
+      return SIZE;
+    };
+
+  private:
+    /* a is before b, also across the overflow of millis(). */
+    static bool before(uint32_t a, uint32_t b) {
+      return (int32_t) (a - b) < 0;
+    };
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type slots[SIZE];
+    uint32_t starts[SIZE];
+    const uint32_t intervalMillis;
+    size_t first = 0;
+    size_t count = 0;
+};
+
+#endif //OPENBIKESENSORFIRMWARE_INTERVALRING_H
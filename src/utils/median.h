@@ -20,6 +20,14 @@
 #ifndef OPENBIKESENSORFIRMWARE_MEDIAN_H
 #define OPENBIKESENSORFIRMWARE_MEDIAN_H
 
+#include <algorithm>
+#include <cstring>
+
+/* Median of the last size values added. Next to the values in order of
+ * arrival we keep them sorted, a new value replaces the oldest one with a
+ * binary search and a single memmove of the values between both, so
+ * median() is just a lookup.
+ */
 template<typename T> class Median {
 
   public:
@@ -28,40 +36,50 @@ template<typename T> class Median {
       size{size},
       mid{size/2},
       data{new T[size]},
-      temp{new T[size]},
+      sorted{new T[size]},
       pos{0} {
       for(size_t i = 0; i < size; i++) {
         data[i] = MAX_SENSOR_VALUE;
+        sorted[i] = MAX_SENSOR_VALUE;
       }
     };
     ~Median() {
-      Serial.printf("Will free Median(%d/%d) -> 0x%lx\n", size, mid, data);
       delete[] data;
-      delete[] temp;
+      delete[] sorted;
     };
     void addValue(T value) {
-      sorted = false;
+      const T old = data[pos];
       data[pos++] = value;
       if (pos >= size) {
         pos = 0;
       }
+      replaceSorted(sorted, size, old, value);
+    };
+    T median() const {
+      return sorted[mid];
     };
-    T median() {
-      if (!sorted) {
-        memcpy(temp, data, sizeof(T) * size); // std:copy needs to much mem
-        std::sort(&temp[0], &temp[size]);
-        sorted = true;
+    /* Replaces old with value in the sorted array of the given size. */
+    static void replaceSorted(T *sorted, size_t size, T old, T value) {
+      const size_t from = std::lower_bound(&sorted[0], &sorted[size], old) - &sorted[0];
+      size_t to;
+      if (old < value) {
+        // move the values between old and value one down
+        to = std::lower_bound(&sorted[from + 1], &sorted[size], value) - &sorted[0] - 1;
+        memmove(&sorted[from], &sorted[from + 1], (to - from) * sizeof(T));
+      } else {
+        // move the values between value and old one up
+        to = std::upper_bound(&sorted[0], &sorted[from], value) - &sorted[0];
+        memmove(&sorted[to + 1], &sorted[to], (from - to) * sizeof(T));
       }
-      return temp[mid];
+      sorted[to] = value;
     };
 
   private:
     const size_t size;
     const size_t mid;
     T *data;
-    T *temp;
+    T *sorted;
     size_t pos = 0;
-    boolean sorted = false;
 };
 
 #endif //OPENBIKESENSORFIRMWARE_MEDIAN_H
@@ -0,0 +1,66 @@
+/*
+  Copyright (C) 2019-2021 OpenBikeSensor Contributors
+  Contact: https://openbikesensor.org
+
+  This file is part of the OpenBikeSensor project.
+
+  The OpenBikeSensor sensor firmware is free software: you can redistribute
+  it and/or modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the License,
+  or (at your option) any later version.
+
+  The OpenBikeSensor sensor firmware is distributed in the hope that it will
+  be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+  Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with
+  the OpenBikeSensor sensor firmware.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef OBS_UTILS_SNAPSHOT_H
+#define OBS_UTILS_SNAPSHOT_H
+
+#include <atomic>
+#include <cstdint>
+
+/* Latest value of exactly one producer for exactly one consumer, e.g. a
+ * task that parses a stream and loop(). Three slots: each side owns one,
+ * the third is swapped in and out atomically. Neither side ever waits or
+ * sees a half written value, the consumer skips values it was too slow
+ * for.
+ */
+template<typename T> class Snapshot {
+  public:
+    /* Producer side, the slot to fill completely before publish(), it
+     * holds an older value. */
+    T &writable() {
+      return slots[producerSlot];
+    };
+    void publish() {
+      producerSlot = shared.exchange(producerSlot | FRESH, std::memory_order_acq_rel) & INDEX;
+    };
+    /* Consumer side, makes the last published value latest(). Returns
+     * false if there is none since the last call. */
+    bool update() {
+      if (!(shared.load(std::memory_order_relaxed) & FRESH)) {
+        return false;
+      }
+      consumerSlot = shared.exchange(consumerSlot, std::memory_order_acq_rel) & INDEX;
+      return true;
+    };
+    const T &latest() const {
+      return slots[consumerSlot];
+    };
+
+  private:
+    static const uint8_t INDEX = 0x03;
+    static const uint8_t FRESH = 0x04;
+    T slots[3] = {};
+    uint8_t producerSlot = 0;
+    uint8_t consumerSlot = 1;
+    /* Index of the slot owned by neither side, FRESH if it was published
+     * after the last update(). */
+    std::atomic<uint8_t> shared{2};
+};
+
+#endif //OBS_UTILS_SNAPSHOT_H
@@ -0,0 +1,75 @@
+/*
+  Copyright (C) 2019-2021 OpenBikeSensor Contributors
+  Contact: https://openbikesensor.org
+
+  This file is part of the OpenBikeSensor project.
+
+  The OpenBikeSensor sensor firmware is free software: you can redistribute
+  it and/or modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the License,
+  or (at your option) any later version.
+
+  The OpenBikeSensor sensor firmware is distributed in the hope that it will
+  be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+  Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with
+  the OpenBikeSensor sensor firmware.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef OPENBIKESENSORFIRMWARE_SPSCQUEUE_H
+#define OPENBIKESENSORFIRMWARE_SPSCQUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/* Bounded lock-free queue for exactly one producer and one consumer, e.g.
+ * an interrupt handler and the task that processes its data. Neither side
+ * ever waits or disables interrupts, a full queue rejects the new element.
+ * SIZE must be a power of 2, the queue holds SIZE elements.
+ */
+template<typename T, size_t SIZE> class SpscQueue {
+  static_assert(SIZE >= 2 && (SIZE & (SIZE - 1)) == 0, "SIZE must be a power of 2");
+
+  public:
+    /* Producer side, returns false if the queue is full. */
+    bool push(const T &value) {
+      const uint32_t tail = this->tail.load(std::memory_order_relaxed);
+      if (tail - head.load(std::memory_order_acquire) >= SIZE) {
+        return false;
+      }
+      data[tail & MASK] = value;
+      this->tail.store(tail + 1, std::memory_order_release);
+      return true;
+    };
+    /* Consumer side, returns false if the queue is empty. */
+    bool pop(T &value) {
+      const uint32_t head = this->head.load(std::memory_order_relaxed);
+      if (head == tail.load(std::memory_order_acquire)) {
+        return false;
+      }
+      value = data[head & MASK];
+      this->head.store(head + 1, std::memory_order_release);
+      return true;
+    };
+    /* Consumer side, drops all queued elements. */
+    void clear() {
+      head.store(tail.load(std::memory_order_acquire), std::memory_order_release);
+    };
+    size_t size() const {
+      return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    };
+    bool empty() const {
+      return size() == 0;
+    };
+
+  private:
+    static const uint32_t MASK = SIZE - 1;
+    T data[SIZE];
+    /* Both indexes run freely and overflow, only the lower bits address data. */
+    std::atomic<uint32_t> head{0};
+    std::atomic<uint32_t> tail{0};
+};
+
+#endif //OPENBIKESENSORFIRMWARE_SPSCQUEUE_H
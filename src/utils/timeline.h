@@ -0,0 +1,184 @@
+/*
+  Copyright (C) 2019-2021 OpenBikeSensor Contributors
+  Contact: https://openbikesensor.org
+
+  This file is part of the OpenBikeSensor project.
+
+  The OpenBikeSensor sensor firmware is free software: you can redistribute
+  it and/or modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the License,
+  or (at your option) any later version.
+
+  The OpenBikeSensor sensor firmware is distributed in the hope that it will
+  be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+  Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with
+  the OpenBikeSensor sensor firmware.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef OPENBIKESENSORFIRMWARE_TIMELINE_H
+#define OPENBIKESENSORFIRMWARE_TIMELINE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+/* One echo of a sensor as recorded during an interval. */
+struct TimelineRecord {
+  /* Trigger time relative to the 1st trigger of the interval. */
+  uint16_t offsetMilliseconds;
+  uint8_t sensorId;
+  /* -1 if the echo did not end in time. */
+  int32_t echoDurationMicroseconds;
+};
+
+/* Fixed pool of record chunks for all timelines, the storage is given once
+ * and never grows. Not thread safe, timelines must be filled and released
+ * by the same task.
+ */
+class TimelineArena {
+  public:
+    static const size_t RECORDS_PER_CHUNK = 16;
+    struct Chunk {
+      Chunk* next;
+      size_t size;
+      TimelineRecord records[RECORDS_PER_CHUNK];
+    };
+
+    TimelineArena(Chunk* storage, size_t chunks) {
+      for (size_t i = 0; i < chunks; ++i) {
+        storage[i].next = free;
+        free = &storage[i];
+      }
+      availableChunks = chunks;
+    };
+    /* Returns nullptr if all chunks are in use. */
+    Chunk* allocate() {
+      Chunk* chunk = free;
+      if (chunk) {
+        free = chunk->next;
+        chunk->next = nullptr;
+        chunk->size = 0;
+        availableChunks--;
+      }
+      return chunk;
+    };
+    /* Takes back the given chunk and all chunks linked to it. */
+    void release(Chunk* chunk) {
+      while (chunk) {
+        Chunk* next = chunk->next;
+        chunk->next = free;
+        free = chunk;
+        availableChunks++;
+        chunk = next;
+      }
+    };
+    size_t available() const {
+      return availableChunks;
+    };
+
+  private:
+    Chunk* free = nullptr;
+    size_t availableChunks = 0;
+};
+
+/* Records of one interval in order of arrival. Grows chunk by chunk from
+ * the arena and gives them back when cleared or destroyed. Timelines can
+ * be moved, e.g. to hand the records to the writer, but not copied.
+ */
+class Timeline {
+  public:
+    class Iterator {
+      public:
+        Iterator(const TimelineArena::Chunk* chunk, size_t index) : chunk(chunk), index(index) {};
+        const TimelineRecord &operator*() const {
+          return chunk->records[index];
+        };
+        const TimelineRecord* operator->() const {
+          return &chunk->records[index];
+        };
+        Iterator &operator++() {
+          if (++index >= chunk->size) {
+            chunk = chunk->next;
+            index = 0;
+          }
+          return *this;
+        };
+        bool operator!=(const Iterator &other) const {
+          return chunk != other.chunk || index != other.index;
+        };
+
+      private:
+        const TimelineArena::Chunk* chunk;
+        size_t index;
+    };
+
+    explicit Timeline(TimelineArena* arena = nullptr) : arena(arena) {};
+    Timeline(const Timeline &) = delete;
+    Timeline &operator=(const Timeline &) = delete;
+    Timeline(Timeline &&other) noexcept {
+      *this = std::move(other);
+    };
+    Timeline &operator=(Timeline &&other) noexcept {
+      if (this != &other) {
+        clear();
+        arena = other.arena;
+        first = other.first;
+        last = other.last;
+        records = other.records;
+        other.first = other.last = nullptr;
+        other.records = 0;
+      }
+      return *this;
+    };
+    ~Timeline() {
+      clear();
+    };
+
+    /* Returns false if the arena has no room left, the record is dropped. */
+    bool push(const TimelineRecord &record) {
+      if (!last || last->size >= TimelineArena::RECORDS_PER_CHUNK) {
+        TimelineArena::Chunk* chunk = arena ? arena->allocate() : nullptr;
+        if (!chunk) {
+          return false;
+        }
+        if (last) {
+          last->next = chunk;
+        } else {
+          first = chunk;
+        }
+        last = chunk;
+      }
+      last->records[last->size++] = record;
+      records++;
+      return true;
+    };
+    void clear() {
+      if (arena) {
+        arena->release(first);
+      }
+      first = last = nullptr;
+      records = 0;
+    };
+    size_t size() const {
+      return records;
+    };
+    bool empty() const {
+      return records == 0;
+    };
+    Iterator begin() const {
+      return Iterator(first, 0);
+    };
+    Iterator end() const {
+      return Iterator(nullptr, 0);
+    };
+
+  private:
+    TimelineArena* arena = nullptr;
+    TimelineArena::Chunk* first = nullptr;
+    TimelineArena::Chunk* last = nullptr;
+    size_t records = 0;
+};
+
+#endif //OPENBIKESENSORFIRMWARE_TIMELINE_H
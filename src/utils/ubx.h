@@ -0,0 +1,221 @@
+/*
+  Copyright (C) 2019-2021 OpenBikeSensor Contributors
+  Contact: https://openbikesensor.org
+
+  This file is part of the OpenBikeSensor project.
+
+  The OpenBikeSensor sensor firmware is free software: you can redistribute
+  it and/or modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the License,
+  or (at your option) any later version.
+
+  The OpenBikeSensor sensor firmware is distributed in the hope that it will
+  be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+  Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with
+  the OpenBikeSensor sensor firmware.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef OBS_UTILS_UBX_H
+#define OBS_UTILS_UBX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/* Navigation solution of the GPS module as sent with UBX-NAV-PVT, the
+ * fields the firmware uses in the units of the message.
+ */
+struct NavPvt {
+  /* GPS time of week of the solution in ms. */
+  uint32_t iTow = 0;
+  /* UTC */
+  uint16_t year = 0;
+  uint8_t month = 0;
+  uint8_t day = 0;
+  uint8_t hour = 0;
+  uint8_t minute = 0;
+  uint8_t second = 0;
+  bool validDate = false;
+  bool validTime = false;
+  /* 0 no fix, 2 2D, 3 3D, 4 GNSS and dead reckoning, 5 time only. */
+  uint8_t fixType = 0;
+  bool gnssFixOk = false;
+  uint8_t satellites = 0;
+  /* 1e-7 degree */
+  int32_t longitude = 0;
+  int32_t latitude = 0;
+  /* mm above mean sea level */
+  int32_t heightMsl = 0;
+  /* mm */
+  uint32_t horizontalAccuracy = 0;
+  /* mm/s */
+  int32_t groundSpeed = 0;
+  /* 1e-5 degree */
+  int32_t headingOfMotion = 0;
+  /* 1/100 */
+  uint16_t positionDop = 0;
+
+  /* A 2D or 3D position, with or without dead reckoning. */
+  bool hasPosition() const {
+    return gnssFixOk && fixType >= 2 && fixType <= 4;
+  };
+};
+
+/* Frames of the u-blox UBX protocol: sync chars, class, id, little endian
+ * payload length, payload and a 2 byte Fletcher checksum over all but the
+ * sync chars.
+ */
+class Ubx {
+  public:
+    static const uint8_t SYNC_1 = 0xb5;
+    static const uint8_t SYNC_2 = 0x62;
+    static const uint8_t CLASS_NAV = 0x01;
+    static const uint8_t CLASS_CFG = 0x06;
+    static const uint8_t ID_NAV_PVT = 0x07;
+    static const uint8_t ID_CFG_MSG = 0x01;
+    static const uint8_t ID_CFG_RATE = 0x08;
+    /* Sync chars, class, id, length and checksum. */
+    static const size_t FRAME_OVERHEAD = 8;
+    static const uint16_t NAV_PVT_LENGTH = 92;
+    /* Longest payload the parser keeps, longer frames are skipped. */
+    static const uint16_t MAX_PAYLOAD = 100;
+
+    static void checksum(const uint8_t* data, size_t size, uint8_t &a, uint8_t &b) {
+      a = 0;
+      b = 0;
+      for (size_t idx = 0; idx < size; ++idx) {
+        a += data[idx];
+        b += a;
+      }
+    };
+    /* Writes the frame to out, which must have room for the payload and
+     * FRAME_OVERHEAD. Returns the size of the frame. */
+    static size_t frame(uint8_t messageClass, uint8_t id, const uint8_t* payload, uint16_t length,
+                        uint8_t* out) {
+      out[0] = SYNC_1;
+      out[1] = SYNC_2;
+      out[2] = messageClass;
+      out[3] = id;
+      out[4] = (uint8_t) length;
+      out[5] = (uint8_t) (length >> 8);
+      memcpy(out + 6, payload, length);
+      checksum(out + 2, length + 4, out[length + 6], out[length + 7]);
+      return length + FRAME_OVERHEAD;
+    };
+    /* Fields at the offsets of the u-blox 8 protocol description, false if
+     * the payload is too short. */
+    static bool decodeNavPvt(const uint8_t* payload, size_t length, NavPvt &pvt) {
+      if (length < NAV_PVT_LENGTH) {
+        return false;
+      }
+      pvt.iTow = u32(payload);
+      pvt.year = u16(payload + 4);
+      pvt.month = payload[6];
+      pvt.day = payload[7];
+      pvt.hour = payload[8];
+      pvt.minute = payload[9];
+      pvt.second = payload[10];
+      pvt.validDate = payload[11] & 0x01;
+      pvt.validTime = payload[11] & 0x02;
+      pvt.fixType = payload[20];
+      pvt.gnssFixOk = payload[21] & 0x01;
+      pvt.satellites = payload[23];
+      pvt.longitude = (int32_t) u32(payload + 24);
+      pvt.latitude = (int32_t) u32(payload + 28);
+      pvt.heightMsl = (int32_t) u32(payload + 36);
+      pvt.horizontalAccuracy = u32(payload + 40);
+      pvt.groundSpeed = (int32_t) u32(payload + 60);
+      pvt.headingOfMotion = (int32_t) u32(payload + 64);
+      pvt.positionDop = u16(payload + 76);
+      return true;
+    };
+
+  private:
+    static uint16_t u16(const uint8_t* data) {
+      return (uint16_t) (data[0] | data[1] << 8);
+    };
+    static uint32_t u32(const uint8_t* data) {
+      return (uint32_t) data[0] | (uint32_t) data[1] << 8 | (uint32_t) data[2] << 16 | (uint32_t) data[3] << 24;
+    };
+};
+
+/* Splits the byte stream of the GPS module into UBX frames and the other
+ * bytes, which are NMEA as that never holds the 1st sync char. A frame is
+ * collected completely and its checksum verified in one pass once the last
+ * byte is in.
+ */
+class UbxParser {
+  public:
+    enum Result : uint8_t {
+      /* Not part of a UBX frame, e.g. for TinyGPS++. */
+      OTHER,
+      /* Taken as part of a frame. */
+      PENDING,
+      /* Completes a frame with a valid checksum, see payload(). */
+      FRAME,
+      /* Completes a frame with a wrong checksum, it is dropped. */
+      BAD_FRAME,
+    };
+
+    Result feed(uint8_t c) {
+      if (skip > 0) {
+        skip--;
+        return PENDING;
+      }
+      if (size == 0 || (size == 1 && c != Ubx::SYNC_2)) {
+        size = c == Ubx::SYNC_1 ? 1 : 0;
+        frame[0] = c;
+        return size ? PENDING : OTHER;
+      }
+      frame[size++] = c;
+      if (size == 6) {
+        length = (uint16_t) (frame[4] | frame[5] << 8);
+        if (length > Ubx::MAX_PAYLOAD) {
+          skippedFrames++;
+          skip = length + 2;
+          size = 0;
+        }
+        return PENDING;
+      }
+      if (size < length + Ubx::FRAME_OVERHEAD || size < 6) {
+        return PENDING;
+      }
+      size = 0;
+      uint8_t a, b;
+      Ubx::checksum(frame + 2, length + 4, a, b);
+      if (a != frame[length + 6] || b != frame[length + 7]) {
+        badFrames++;
+        return BAD_FRAME;
+      }
+      return FRAME;
+    };
+    /* Of the last frame, valid till the next call of feed(). */
+    uint8_t messageClass() const {
+      return frame[2];
+    };
+    uint8_t id() const {
+      return frame[3];
+    };
+    const uint8_t* payload() const {
+      return frame + 6;
+    };
+    uint16_t payloadLength() const {
+      return length;
+    };
+
+    /* Frames dropped due to their checksum. */
+    uint32_t badFrames = 0;
+    /* Frames longer than Ubx::MAX_PAYLOAD. */
+    uint32_t skippedFrames = 0;
+
+  private:
+    uint8_t frame[Ubx::MAX_PAYLOAD + Ubx::FRAME_OVERHEAD];
+    size_t size = 0;
+    uint16_t length = 0;
+    /* Bytes of a skipped frame still to come. */
+    uint32_t skip = 0;
+};
+
+#endif //OBS_UTILS_UBX_H
@@ -0,0 +1,72 @@
+/*
+  Copyright (C) 2019-2021 OpenBikeSensor Contributors
+  Contact: https://openbikesensor.org
+
+  This file is part of the OpenBikeSensor project.
+
+  The OpenBikeSensor sensor firmware is free software: you can redistribute
+  it and/or modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the License,
+  or (at your option) any later version.
+
+  The OpenBikeSensor sensor firmware is distributed in the hope that it will
+  be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+  Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with
+  the OpenBikeSensor sensor firmware.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef OBS_UTILS_VARINT_H
+#define OBS_UTILS_VARINT_H
+
+#include <cstddef>
+#include <cstdint>
+
+/* Variable length integers as used by the binary track format: 7 bits per
+ * byte, least significant group first, the high bit is set if more bytes
+ * follow. Signed values are zigzag encoded first, so small negative values
+ * stay short as well.
+ */
+class Varint {
+  public:
+    static const size_t MAX_BYTES = 5;
+
+    /* Writes the value to out, which must have room for MAX_BYTES.
+     * Returns the number of bytes written. */
+    static size_t encode(uint32_t value, uint8_t* out) {
+      size_t size = 0;
+      while (value >= 0x80) {
+        out[size++] = (uint8_t) (value | 0x80);
+        value >>= 7;
+      }
+      out[size++] = (uint8_t) value;
+      return size;
+    };
+    static size_t encodeSigned(int32_t value, uint8_t* out) {
+      return encode(((uint32_t) value << 1) ^ (uint32_t) (value >> 31), out);
+    };
+    /* Returns the number of bytes read, 0 if the data ends within the
+     * value or the value does not fit 32 bit. */
+    static size_t decode(const uint8_t* in, size_t available, uint32_t &value) {
+      value = 0;
+      for (size_t idx = 0; idx < available && idx < MAX_BYTES; ++idx) {
+        if (idx == MAX_BYTES - 1 && in[idx] > 0x0f) {
+          return 0;
+        }
+        value |= (uint32_t) (in[idx] & 0x7f) << (7 * idx);
+        if (!(in[idx] & 0x80)) {
+          return idx + 1;
+        }
+      }
+      return 0;
+    };
+    static size_t decodeSigned(const uint8_t* in, size_t available, int32_t &value) {
+      uint32_t zigzag;
+      const size_t size = decode(in, available, zigzag);
+      value = (int32_t) (zigzag >> 1) ^ -(int32_t) (zigzag & 1);
+      return size;
+    };
+};
+
+#endif //OBS_UTILS_VARINT_H
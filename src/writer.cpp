@@ -19,32 +19,80 @@
 */
 
 #include "writer.h"
-#include "utils/file.h"
+#include "utils/csvline.h"
+#include "utils/varint.h"
 
 const String CSVFileWriter::EXTENSION = ".obsdata.csv";
+const String BinaryFileWriter::EXTENSION = ".obsdata.bin";
+const String FileWriter::GZIP_EXTENSION = ".gz";
 
-int FileWriter::getTrackNumber() {
-  File numberFile = SD.open("/tracknumber.txt","r");
-  int trackNumber = numberFile.readString().toInt();
-  numberFile.close();
-  return trackNumber;
+/* The value as written to the CSV without the decimal point, so the
+ * decoder gives the same text, e.g. 48.784270 -> 48784270.
+ */
+static int32_t toFixedPoint(double value, unsigned char decimals) {
+  uint64_t scaled = 0;
+  Decimal::scale(value, decimals, scaled);
+  return std::signbit(value) ? -(int32_t) scaled : (int32_t) scaled;
 }
 
-void FileWriter::storeTrackNumber(int trackNumber) {
-  File numberFile = SD.open("/tracknumber.txt","w");
-  numberFile.println(trackNumber);
-  numberFile.close();
+/* Holds the name of the track while it is written and in a 2nd line its
+ * size as of the last sync, every ride ends with a power loss, see
+ * FileWriter::recoverUnfinishedTrack(). */
+static const char *UNFINISHED_TRACK_FILE = "/unfinished.txt";
+
+void DataSet::setGpsValues(TinyGPSPlus &gps) {
+  locationValid = gps.location.isValid();
+  latitude = toFixedPoint(gps.location.lat(), 6);
+  longitude = toFixedPoint(gps.location.lng(), 6);
+  altitudeCentimeters = gps.altitude.value();
+  courseValid = gps.course.isValid();
+  course = gps.course.value();
+  speedValid = gps.speed.isValid();
+  speed = toFixedPoint(gps.speed.kmph(), 2);
+  hdopValid = gps.hdop.isValid();
+  hdop = gps.hdop.value();
+  validSatellites = gps.satellites.isValid() ? (uint8_t) gps.satellites.value() : 0;
+}
+
+/* value / divisor rounded half away from zero. */
+static int32_t scaleDown(int32_t value, int32_t divisor) {
+  return (value + (value < 0 ? -divisor : divisor) / 2) / divisor;
+}
+
+void DataSet::setGpsValues(const NavPvt &pvt) {
+  locationValid = pvt.hasPosition();
+  latitude = scaleDown(pvt.latitude, 10);
+  longitude = scaleDown(pvt.longitude, 10);
+  altitudeCentimeters = scaleDown(pvt.heightMsl, 10);
+  courseValid = locationValid;
+  course = (uint16_t) scaleDown(pvt.headingOfMotion, 1000);
+  speedValid = locationValid;
+  // mm/s to 1/100 km/h
+  speed = (uint16_t) scaleDown(pvt.groundSpeed * 36, 100);
+  hdopValid = true;
+  hdop = pvt.positionDop;
+  validSatellites = pvt.satellites;
+}
+
+void DataSet::setBatteryLevel(double level) {
+  batteryLevel = (int16_t) toFixedPoint(level, 2);
 }
 
+/* The number comes from the track catalog, the names after it are only
+ * taken if a track was copied to the card by hand. */
 void FileWriter::setFileName() {
-  int number = getTrackNumber();
+  uint32_t number = TrackCatalog::nextTrackNumber();
   String base_filename = "/sensorData";
   mFileName = base_filename + String(number) + mFileExtension;
   while (SD.exists(mFileName)) {
     number++;
     mFileName = base_filename + String(number) + mFileExtension;
   }
-  storeTrackNumber(number);
+  TrackCatalog::setNextTrackNumber(number + 1);
+  mCatalogEntry.setName(mFileName);
+  mCatalogEntry.number = number;
+  mSyncedCatalogEntry = mCatalogEntry;
+  mCatalogIndex = TrackCatalog::add(mCatalogEntry);
 }
 
 void FileWriter::correctFilename() {
@@ -60,72 +108,338 @@ void FileWriter::correctFilename() {
              startTm.tm_hour, startTm.tm_min, startTm.tm_sec,
              (uint16_t)(ESP.getEfuseMac() >> 32));
     const String newName = name + mFileExtension;
+    if (mFile) {
+      // FAT can not rename open files, the next write opens it again
+      if (!mGzip || mGzip->finish()) {
+        mFile.flush();
+        mUnsyncedBytes = 0;
+        mSyncedCatalogEntry.size = mFile.size();
+      } else {
+        mGzip->reset();
+      }
+      mFile.close();
+    }
     if(!SD.exists(mFileName.c_str()) || // already written
       SD.rename(mFileName.c_str(), newName.c_str())) {
       mFileName = newName;
       mFinalFileName = true;
+      updateCatalog(TrackEntry::RECORDING);
     }
   }
 }
 
-uint16_t FileWriter::getBufferLength() const {
-  return mBuffer.length();
+/* The writer task runs on the other core than loop(), below the priority
+ * of the measurement task. */
+static const BaseType_t WRITER_TASK_CORE = 0;
+static const UBaseType_t WRITER_TASK_PRIORITY = 2;
+static const uint32_t WRITER_TASK_STACK_SIZE = 4096;
+
+uint32_t WriterStatistics::writeMillisPercentile(uint8_t percent) const {
+  uint32_t total = 0;
+  for (uint32_t count : writeMillisHistogram) {
+    total += count;
+  }
+  if (total == 0) {
+    return 0;
+  }
+  const uint32_t wanted = (total * percent + 99) / 100;
+  uint32_t seen = 0;
+  for (uint8_t bucket = 0; bucket < WRITE_MILLIS_BUCKETS - 1; ++bucket) {
+    seen += writeMillisHistogram[bucket];
+    if (seen >= wanted) {
+      return min((uint32_t) 1 << bucket, maxWriteMillis);
+    }
+  }
+  return maxWriteMillis;
 }
 
-bool FileWriter::appendString(const String &s) {
-  bool stored = false;
-  if (getBufferLength() < 11000) { // do not add data if our buffer is full already. We loose data here!
-    mBuffer.concat(s);
-    stored = true;
+FileWriter::FileWriter(String ext, bool gzip) : mFileExtension(gzip ? ext + GZIP_EXTENSION : ext) {
+  for (Buffer &buffer : mBuffers) {
+    mFreeBuffers.push(&buffer);
   }
-  if (getBufferLength() > 10000 && !(digitalRead(PushButton_PIN))) {
-    flush();
+  if (gzip) {
+    mGzip = new GzipCompressor([this](const uint8_t *data, size_t size) {
+      return writeFile(data, size);
+    });
   }
-  if (!stored && getBufferLength() < 11000) { // do not add data if our buffer is full already. We loose data here!
-    mBuffer.concat(s);
-    stored = true;
+}
+
+FileWriter::~FileWriter() {
+  flush();
+  if (mWriterTaskHandle) {
+    mStopWriterTask = true;
+    xTaskNotifyGive(mWriterTaskHandle);
+    while (!mWriterTaskEnded) {
+      vTaskDelay(1);
+    }
   }
-#ifdef DEVELOP
-  if (!stored) {
-    Serial.printf("File buffer overflow, not allowed to write - "
-                  "will skip, memory is at %dk, buffer at %u.\n",
-                  ESP.getFreeHeap() / 1024, getBufferLength());
+  delete mGzip;
+}
+
+bool FileWriter::appendString(const String &s) {
+  return appendBytes((const uint8_t *) s.c_str(), s.length());
+}
+
+/* Copies the data to the buffer we fill, a full buffer goes to the writer
+ * task and the next free one is taken. Data that does not fit in the free
+ * buffers is dropped, we never wait for the card here.
+ *
+ * A record starts a new buffer rather than being split if there is one,
+ * so the file ends with a complete record after each write. Once the
+ * sync time is over, the buffer goes to the writer task even if not full.
+ */
+bool FileWriter::appendBytes(const uint8_t *data, size_t size) {
+  if (mFilling && size > WRITE_BUFFER_SIZE - mFilling->size
+      && size <= WRITE_BUFFER_SIZE && !mFreeBuffers.empty()) {
+    handOver(false);
+  }
+  size_t available = mFreeBuffers.size() * WRITE_BUFFER_SIZE;
+  if (mFilling) {
+    available += WRITE_BUFFER_SIZE - mFilling->size;
   }
+  if (size > available) {
+    mStatistics.droppedAppends++;
+    mStatistics.droppedBytes += size;
+#ifdef DEVELOP
+    Serial.printf("File buffers full, card is too slow - will skip %u bytes.\n", (unsigned) size);
 #endif
-  return stored;
+    return false;
+  }
+  while (size > 0) {
+    if (!mFilling) {
+      mFreeBuffers.pop(mFilling);
+    }
+    const size_t length = min(size, WRITE_BUFFER_SIZE - mFilling->size);
+    memcpy(mFilling->data + mFilling->size, data, length);
+    mFilling->size += length;
+    data += length;
+    size -= length;
+    if (mFilling->size == WRITE_BUFFER_SIZE) {
+      handOver(false);
+    }
+  }
+  if (millis() - mSyncRequestMillis >= config.trackSyncSeconds * 1000UL) {
+    flush();
+  }
+  return true;
 }
 
 bool FileWriter::flush() {
-  bool result;
-#ifdef DEVELOP
-  Serial.printf("Writing to concrete file.\n");
-#endif
-  const auto start = millis();
-  result = FileUtil::appendFile(SD, mFileName.c_str(), mBuffer.c_str() );
-  mBuffer.clear();
-  mWriteTimeMillis = millis() - start;
-  if (!mFinalFileName) {
-    correctFilename();
+  mSyncRequestMillis = millis();
+  return handOver(true);
+}
+
+bool FileWriter::handOver(bool sync) {
+  if (!mFilling || mFilling->size == 0) {
+    return false;
+  }
+  mFilling->sync = sync;
+  mFilling->catalogEntry = mCatalogEntry;
+  mQueuedBuffers.push(mFilling);
+  mFilling = nullptr;
+  mStatistics.maxQueueDepth = max(mStatistics.maxQueueDepth,
+    (uint8_t) (WRITE_BUFFERS - mFreeBuffers.size()));
+  if (!mWriterTaskHandle) {
+    xTaskCreatePinnedToCore(writerTask, "SdWriter", WRITER_TASK_STACK_SIZE,
+      this, WRITER_TASK_PRIORITY, &mWriterTaskHandle, WRITER_TASK_CORE);
   }
+  xTaskNotifyGive(mWriterTaskHandle);
+  return true;
+}
+
+const WriterStatistics &FileWriter::getStatistics() const {
+  return mStatistics;
+}
+
+void FileWriter::writerTask(void *parameter) {
+  auto *writer = static_cast<FileWriter *>(parameter);
+  while (!writer->mStopWriterTask) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    writer->writeBuffers();
+  }
+  // the task might start after the stop, e.g. for a short track
+  writer->writeBuffers();
+  if (writer->mFile) {
+    if (writer->mGzip) {
+      writer->mGzip->finish();
+    }
+    writer->mFile.flush();
+    writer->mSyncedCatalogEntry.size = writer->mFile.size();
+    writer->mFile.close();
+  }
+  writer->updateCatalog(TrackEntry::RECORDED);
+  SD.remove(UNFINISHED_TRACK_FILE);
+  writer->mWriterTaskEnded = true;
+  vTaskDelete(nullptr);
+}
+
+/* Writes the queued buffers in order and hands them back to loop(). The
+ * file stays open, the directory entry is only updated with a sync. After
+ * a failed write the file is opened again with the next buffer, a gzip
+ * track continues with a new member then.
+ */
+void FileWriter::writeBuffers() {
+  Buffer *buffer;
+  while (mQueuedBuffers.pop(buffer)) {
+    const auto start = millis();
+    bool written = (mFile || openFile()) && (mGzip
+      ? mGzip->write(buffer->data, buffer->size) : writeFile(buffer->data, buffer->size));
+    if (written && (buffer->sync || mUnsyncedBytes >= config.trackSyncKiB * 1024UL)) {
+      written = !mGzip || mGzip->finish();
+      if (written) {
+        mFile.flush();
+        mUnsyncedBytes = 0;
+        mStatistics.syncs++;
+        mSyncedCatalogEntry = buffer->catalogEntry;
+        mSyncedCatalogEntry.size = mFile.size();
+        updateCatalog(TrackEntry::RECORDING);
+        writeUnfinishedMarker();
+      }
+    }
+    if (!written) {
+      mStatistics.failedWrites++;
+      mFile.close();
+      if (mGzip) {
+        mGzip->reset();
+      }
+    }
+    const uint32_t writeMillis = millis() - start;
+    mStatistics.writes++;
+    mStatistics.maxWriteMillis = max(mStatistics.maxWriteMillis, writeMillis);
+    uint8_t bucket = 0;
+    while (bucket < WRITE_MILLIS_BUCKETS - 1 && writeMillis >= ((uint32_t) 1 << bucket)) {
+      bucket++;
+    }
+    mStatistics.writeMillisHistogram[bucket]++;
+    buffer->size = 0;
+    mFreeBuffers.push(buffer);
+    if (!mFinalFileName) {
+      correctFilename();
+    }
 #ifdef DEVELOP
-  Serial.printf("Writing to concrete file done took %lums.\n", mWriteTimeMillis);
+    Serial.printf("Writing to concrete file done took %ums.\n", writeMillis);
 #endif
-  return result;
+  }
 }
 
-unsigned long FileWriter::getWriteTimeMillis() const {
-  return mWriteTimeMillis;
+void FileWriter::updateCatalog(uint8_t state) {
+  if (mCatalogIndex == TrackCatalog::NO_ENTRY) {
+    return;
+  }
+  mSyncedCatalogEntry.setName(mFileName);
+  mSyncedCatalogEntry.state = state;
+  TrackCatalog::write(mCatalogIndex, mSyncedCatalogEntry);
 }
 
-bool CSVFileWriter::writeHeader(String trackId) {
+bool FileWriter::writeFile(const uint8_t *data, size_t size) {
+  mUnsyncedBytes += size;
+  return mFile.write(data, size) == size;
+}
+
+bool FileWriter::openFile() {
+  mFile = SD.open(mFileName.c_str(), FILE_APPEND);
+  if (!mFile) {
+    log_e("Failed to open %s for appending.", mFileName.c_str());
+    return false;
+  }
+  writeUnfinishedMarker();
+  return true;
+}
+
+void FileWriter::writeUnfinishedMarker() {
+  File marker = SD.open(UNFINISHED_TRACK_FILE, FILE_WRITE);
+  marker.println(mFileName);
+  marker.print((uint32_t) mSyncedCatalogEntry.size);
+  marker.close();
+}
+
+/* The track of the last ride is named in UNFINISHED_TRACK_FILE. A gzip
+ * track is cut to the size of its last sync, the end of a member, CSV and
+ * binary tracks to their last complete record. Without truncate() in the
+ * FS API, the complete part is copied to a new file.
+ */
+bool FileWriter::recoverUnfinishedTrack() {
+  File marker = SD.open(UNFINISHED_TRACK_FILE, FILE_READ);
+  if (!marker) {
+    return false;
+  }
+  String path = marker.readStringUntil('\n');
+  path.trim(); // println() ends the line with \r\n
+  const String syncedSize = marker.readString();
+  marker.close();
+  SD.remove(UNFINISHED_TRACK_FILE);
+  const bool gzip = path.endsWith(GZIP_EXTENSION);
+  if (gzip && syncedSize.length() == 0) {
+    return false; // marker of an older firmware
+  }
+  File track = SD.open(path.c_str(), FILE_READ);
+  if (!track) {
+    return false;
+  }
+  const size_t size = track.size();
+  size_t complete;
+  if (gzip) {
+    complete = min(size, (size_t) syncedSize.toInt());
+  } else if (path.endsWith(BinaryFileWriter::EXTENSION)) {
+    complete = BinaryFileWriter::completeSize(track);
+  } else {
+    complete = CSVFileWriter::completeSize(track);
+  }
+  if (complete == size) {
+    track.close();
+    return false;
+  }
+  log_w("Track %s ends with an incomplete record, keeping %u of %u bytes.",
+    path.c_str(), (unsigned) complete, (unsigned) size);
+  if (complete == 0) {
+    track.close();
+    return SD.remove(path.c_str());
+  }
+  const String copyPath = path + ".tmp";
+  File copy = SD.open(copyPath.c_str(), FILE_WRITE);
+  bool copied = (bool) copy && track.seek(0);
+  uint8_t data[512];
+  for (size_t pos = 0; copied && pos < complete;) {
+    const size_t length = track.read(data, min(sizeof(data), complete - pos));
+    copied = length > 0 && copy.write(data, length) == length;
+    pos += length;
+  }
+  track.close();
+  copy.close();
+  if (!copied || !SD.remove(path.c_str()) || !SD.rename(copyPath.c_str(), path.c_str())) {
+    log_e("Failed to recover %s.", path.c_str());
+    SD.remove(copyPath.c_str());
+    return false;
+  }
+  return true;
+}
+
+/* Left and right come first as in all files so far, further sensors follow
+ * in the order of registration. Their columns are named after their
+ * location, e.g. "Back" and "Bus<n>".
+ */
+void FileWriter::setSensorColumns() {
+  mSensorColumns.clear();
+  mSensorColumns.push_back(LEFT_SENSOR_ID);
+  mSensorColumns.push_back(RIGHT_SENSOR_ID);
+  for (size_t idx = 0; idx < sensorManager->m_sensors.size(); ++idx) {
+    if (idx != (size_t) LEFT_SENSOR_ID && idx != (size_t) RIGHT_SENSOR_ID) {
+      mSensorColumns.push_back(idx);
+    }
+  }
+}
+
+String FileWriter::getMetadata(const String &trackId) const {
   String header;
-  header += "OBSDataFormat=2&";
+  header += "OBSDataFormat=3&";
   header += "OBSFirmwareVersion=" + String(OBSVersion) + "&";
   header += "DeviceId=" + String((uint16_t)(ESP.getEfuseMac() >> 32), 16) + "&";
-  header += "DataPerMeasurement=3&";
-  header += "MaximumMeasurementsPerLine=" + String(MAX_NUMBER_MEASUREMENTS_PER_INTERVAL) + "&";
-  header += "OffsetLeft=" + String(config.sensorOffsets[LEFT_SENSOR_ID]) + "&";
-  header += "OffsetRight=" + String(config.sensorOffsets[RIGHT_SENSOR_ID]) + "&";
+  header += "DataPerMeasurement=" + String((int) mSensorColumns.size() + 1) + "&";
+  header += "MaximumMeasurementsPerLine=" + String(maxMeasurementsPerLine()) + "&";
+  for (uint8_t sensorId : mSensorColumns) {
+    const HCSR04SensorInfo &sensor = sensorManager->m_sensors[sensorId];
+    header += "Offset" + String(sensor.sensorLocation) + "=" + String(sensor.offset) + "&";
+  }
   header += "NumberOfDefinedPrivacyAreas=" + String((int) config.privacyAreas.size()) + "&";
   header += "TrackId=" + trackId + "&";
   header += "PrivacyLevelApplied=";
@@ -159,115 +473,442 @@ bool CSVFileWriter::writeHeader(String trackId) {
   header += "MaximumValidFlightTimeMicroseconds=" + String(MAX_DURATION_MICRO_SEC) + "&";
   header += "BluetoothEnabled=" + String(config.bluetooth) + "&";
   header += "PresetId=default&";
-  header += "DistanceSensorsUsed=HC-SR04/JSN-SR04T\n";
+  header += "DistanceSensorsUsed=HC-SR04/JSN-SR04T";
+  return header;
+}
+
+/* AbsolutePrivacy : When inside privacy area, the writer does noting, unless overriding is selected and the current set is confirmed
+   NoPosition : When inside privacy area, the writer will replace latitude and longitude with NaNs
+   NoPrivacy : Privacy areas are ignored, but the value "insidePrivacyArea" will be 1 inside
+   OverridePrivacy : When selected, a full set is written, when a value was confirmed, even inside the privacy area
+*/
+bool FileWriter::isHiddenByPrivacy(const DataSet &set) {
+  return set.isInsidePrivacyArea
+    && ((config.privacyConfig & AbsolutePrivacy) || ((config.privacyConfig & OverridePrivacy) && !set.confirmed));
+}
+
+void FileWriter::addToCatalogEntry(DataSet &set) {
+  if (mCatalogEntry.startTime == 0) {
+    mCatalogEntry.startTime = set.time;
+  }
+  mCatalogEntry.endTime = set.time;
+  mCatalogEntry.records++;
+  if (set.confirmed) {
+    mCatalogEntry.confirmed++;
+  }
+  if (hasPublicPosition(set)) {
+    mCatalogEntry.addPosition(set.latitude / 1e6, set.longitude / 1e6);
+  }
+}
 
+bool FileWriter::hasPublicPosition(DataSet &set) {
+  return !((!set.locationValid) ||
+        set.hdop == 9999 ||
+        set.validSatellites == 0 ||
+      ((config.privacyConfig & NoPosition) && set.isInsidePrivacyArea
+    && !((config.privacyConfig & OverridePrivacy) && set.confirmed)));
+}
+
+bool CSVFileWriter::writeHeader(String trackId) {
+  setSensorColumns();
+  String header = getMetadata(trackId) + "\n";
   header += "Date;Time;Millis;Comment;Latitude;Longitude;Altitude;"
-    "Course;Speed;HDOP;Satellites;BatteryLevel;Left;Right;Confirmed;Marked;Invalid;"
-    "InsidePrivacyArea;Factor;Measurements";
-  for (uint16_t idx = 1; idx <= MAX_NUMBER_MEASUREMENTS_PER_INTERVAL; ++idx) {
+    "Course;Speed;HDOP;Satellites;BatteryLevel;";
+  for (uint8_t sensorId : mSensorColumns) {
+    header += String(sensorManager->m_sensors[sensorId].sensorLocation) + ";";
+  }
+  header += "Confirmed;Marked;Invalid;InsidePrivacyArea;Factor;Measurements";
+  for (uint16_t idx = 1; idx <= maxMeasurementsPerLine(); ++idx) {
     String number = String(idx);
     header += ";Tms" + number;
-    header += ";Lus" + number;
-    header += ";Rus" + number;
+    for (uint8_t sensorId : mSensorColumns) {
+      header += ";" + String(sensorManager->m_sensors[sensorId].sensorLocation[0]) + "us" + number;
+    }
   }
   header += "\n";
+  // longest line: all measurements with the largest values, comments
+  // come on top
+  mLine.resize(CSV_LINE_RESERVE + maxMeasurementsPerLine() * (6 + 11 * mSensorColumns.size()));
   return appendString(header);
 }
 
+size_t CSVFileWriter::completeSize(File &track) {
+  size_t end = track.size();
+  uint8_t data[128];
+  while (end > 0) {
+    const size_t length = min(sizeof(data), end);
+    if (!track.seek(end - length) || track.read(data, length) != length) {
+      return 0;
+    }
+    for (size_t idx = length; idx > 0; --idx) {
+      if (data[idx - 1] == '\n') {
+        return end - length + idx;
+      }
+    }
+    end -= length;
+  }
+  return 0;
+}
+
+/* One line per set, formatted in mLine without any heap allocation. */
 bool CSVFileWriter::append(DataSet &set) {
-  String csv;
-  /*
-    AbsolutePrivacy : When inside privacy area, the writer does noting, unless overriding is selected and the current set is confirmed
-    NoPosition : When inside privacy area, the writer will replace latitude and longitude with NaNs
-    NoPrivacy : Privacy areas are ignored, but the value "insidePrivacyArea" will be 1 inside
-    OverridePrivacy : When selected, a full set is written, when a value was confirmed, even inside the privacy area
-  */
-  if (set.isInsidePrivacyArea
-    && ((config.privacyConfig & AbsolutePrivacy) || ((config.privacyConfig & OverridePrivacy) && !set.confirmed))) {
+  if (isHiddenByPrivacy(set)) {
     return true;
   }
+  CsvLine csv(mLine.data(), mLine.size());
 
   tm time;
   localtime_r(&set.time, &time);
-  char date[32];
-  snprintf(date, sizeof(date),
-    "%02d.%02d.%04d;%02d:%02d:%02d;%u;",
-    time.tm_mday, time.tm_mon + 1, time.tm_year + 1900,
-    time.tm_hour, time.tm_min, time.tm_sec, set.millis);
-
-  csv += date;
-  csv += set.comment;
+  csv.appendPadded(time.tm_mday, 2).append('.').appendPadded(time.tm_mon + 1, 2).append('.')
+    .appendPadded(time.tm_year + 1900, 4).append(';');
+  csv.appendPadded(time.tm_hour, 2).append(':').appendPadded(time.tm_min, 2).append(':')
+    .appendPadded(time.tm_sec, 2).append(';');
+  csv.appendUnsigned(set.millis).append(';');
+  csv.append(set.comment);
 
 #ifdef DEVELOP
   if (time.tm_sec == 0) {
-    csv += "DEVELOP:  GPSMessages: " + String(gps.passedChecksum())
-           + " GPS crc errors: " + String(gps.failedChecksum());
+    csv.append("DEVELOP:  GPSMessages: ").appendUnsigned(gps.passedChecksum())
+      .append(" GPS crc errors: ").appendUnsigned(gps.failedChecksum());
   } else if (time.tm_sec == 1) {
-    csv += "DEVELOP: Mem: "
-           + String(ESP.getFreeHeap() / 1024) + "k Buffer: "
-           + String(getBufferLength() / 1024) + "k last write time: "
-           + String(getWriteTimeMillis());
+    csv.append("DEVELOP: Mem: ").appendUnsigned(ESP.getFreeHeap() / 1024)
+      .append("k max queued buffers: ").appendUnsigned(getStatistics().maxQueueDepth)
+      .append(" max write time: ").appendUnsigned(getStatistics().maxWriteMillis);
   } else if (time.tm_sec == 2) {
-    csv += "DEVELOP: Mem min free: "
-           + String(ESP.getMinFreeHeap() / 1024) + "k";
+    csv.append("DEVELOP: Mem min free: ").appendUnsigned(ESP.getMinFreeHeap() / 1024).append('k');
   }
 #endif
-  csv += ";";
+  csv.append(';');
 
-  if ((!set.location.isValid()) ||
-        set.hdop.value() == 9999 ||
-        set.validSatellites == 0 ||
-      ((config.privacyConfig & NoPosition) && set.isInsidePrivacyArea
-    && !((config.privacyConfig & OverridePrivacy) && set.confirmed))) {
-    csv += ";;;;;";
+  if (!hasPublicPosition(set)) {
+    csv.append(";;;;;");
   } else {
-    csv += String(set.location.lat(), 6) + ";";
-    csv += String(set.location.lng(), 6) + ";";
-    csv += String(set.altitude.meters(), 1) + ";";
-    if (set.course.isValid()) {
-      csv += String(set.course.deg(), 2);
-    }
-    csv += ";";
-    if (set.speed.isValid()) {
-      csv += String(set.speed.kmph(), 2);
-    }
-    csv += ";";
-  }
-  if (set.hdop.isValid()) {
-    csv += String(set.hdop.hdop(), 2);
-  }
-  csv += ";";
-  csv += String(set.validSatellites) + ";";
-  csv += String(set.batteryLevel, 2) + ";";
-  if (set.sensorValues[LEFT_SENSOR_ID] < MAX_SENSOR_VALUE) {
-    csv += String(set.sensorValues[LEFT_SENSOR_ID]);
-  }
-  csv += ";";
-  if (set.sensorValues[RIGHT_SENSOR_ID] < MAX_SENSOR_VALUE) {
-    csv += String(set.sensorValues[RIGHT_SENSOR_ID]);
-  }
-  csv += ";";
-  csv += String(set.confirmed) + ";";
-  csv += String(set.marked) + ";";
-  csv += String(set.invalidMeasurement) + ";";
-  csv += String(set.isInsidePrivacyArea) + ";";
-  csv += String(set.factor) + ";";
-  csv += String(set.measurements);
-
-  for (size_t idx = 0; idx < set.measurements; ++idx) {
-    csv += ";" + String(set.startOffsetMilliseconds[idx]) + ";";
-    if (set.readDurationsLeftInMicroseconds[idx] > 0) {
-      csv += String(set.readDurationsLeftInMicroseconds[idx]) + ";";
-    } else {
-      csv += ";";
-    }
-    if (set.readDurationsRightInMicroseconds[idx] > 0) {
-      csv += String(set.readDurationsRightInMicroseconds[idx]);
-    }
-  }
-  for (size_t idx = set.measurements; idx < MAX_NUMBER_MEASUREMENTS_PER_INTERVAL; ++idx) {
-    csv += ";;;";
-  }
-  csv += "\n";
-  return appendString(csv);
+    csv.appendScaled(set.latitude, 6).append(';');
+    csv.appendScaled(set.longitude, 6).append(';');
+    csv.appendFixed(set.altitudeCentimeters / 100.0, 1).append(';');
+    if (set.courseValid) {
+      csv.appendScaled(set.course, 2);
+    }
+    csv.append(';');
+    if (set.speedValid) {
+      csv.appendScaled(set.speed, 2);
+    }
+    csv.append(';');
+  }
+  if (set.hdopValid) {
+    csv.appendScaled(set.hdop, 2);
+  }
+  csv.append(';');
+  csv.appendUnsigned(set.validSatellites).append(';');
+  csv.appendScaled(set.batteryLevel, 2).append(';');
+  for (uint8_t sensorId : mSensorColumns) {
+    if (sensorId < set.sensorValues.size() && set.sensorValues[sensorId] < MAX_SENSOR_VALUE) {
+      csv.appendUnsigned(set.sensorValues[sensorId]);
+    }
+    csv.append(';');
+  }
+  csv.appendUnsigned(set.confirmed).append(';');
+  csv.append(set.marked).append(';');
+  csv.appendUnsigned(set.invalidMeasurement).append(';');
+  csv.appendUnsigned(set.isInsidePrivacyArea).append(';');
+  csv.appendFixed(set.factor, 2).append(';');
+  csv.appendUnsigned(set.timeline.size());
+
+  for (const TimelineRecord &record : set.timeline) {
+    csv.append(';').appendUnsigned(record.offsetMilliseconds);
+    for (uint8_t sensorId : mSensorColumns) {
+      csv.append(';');
+      if (record.sensorId == sensorId && record.echoDurationMicroseconds > 0) {
+        csv.appendUnsigned(record.echoDurationMicroseconds);
+      }
+    }
+  }
+  csv.append('\n');
+  if (csv.overflow()) {
+    log_e("CSV line does not fit in %u bytes, skipped.", (unsigned) mLine.size());
+    return false;
+  }
+  const TrackEntry catalogEntry = mCatalogEntry;
+  addToCatalogEntry(set);
+  if (!appendBytes((const uint8_t *) csv.data(), csv.size())) {
+    mCatalogEntry = catalogEntry;
+    return false;
+  }
+  return true;
+}
+
+void BinaryFileWriter::put(uint8_t value) {
+  mRecord.push_back(value);
+}
+
+void BinaryFileWriter::putVarint(uint32_t value) {
+  uint8_t bytes[Varint::MAX_BYTES];
+  mRecord.insert(mRecord.end(), bytes, bytes + Varint::encode(value, bytes));
+}
+
+void BinaryFileWriter::putSignedVarint(int32_t value) {
+  uint8_t bytes[Varint::MAX_BYTES];
+  mRecord.insert(mRecord.end(), bytes, bytes + Varint::encodeSigned(value, bytes));
+}
+
+void BinaryFileWriter::putString(const String &value) {
+  putString(value.c_str(), value.length());
+}
+
+void BinaryFileWriter::putString(const char *value, size_t length) {
+  putVarint(length);
+  mRecord.insert(mRecord.end(), value, value + length);
+}
+
+/* Reads a varint at the given position of the track, returns the number
+ * of bytes used, 0 if there is none. */
+static size_t readVarint(File &track, size_t pos, uint32_t &value) {
+  uint8_t data[Varint::MAX_BYTES];
+  if (!track.seek(pos)) {
+    return 0;
+  }
+  return Varint::decode(data, track.read(data, sizeof(data)), value);
+}
+
+/* Walks the length of the header fields and the records, reading ahead
+ * in chunks as records are short. */
+size_t BinaryFileWriter::completeSize(File &track) {
+  const size_t size = track.size();
+  uint8_t data[512];
+  size_t pos = 5;
+  uint32_t length;
+  size_t used = readVarint(track, pos, length);
+  pos += used + length;
+  if (used == 0 || pos >= size || !track.seek(pos) || track.read(data, 1) != 1) {
+    return 0;
+  }
+  const uint8_t sensors = data[0];
+  pos++;
+  for (uint8_t idx = 0; idx < sensors; ++idx) {
+    used = readVarint(track, pos, length);
+    pos += used + length;
+    if (used == 0 || pos > size) {
+      return 0;
+    }
+  }
+  while (pos < size) {
+    if (!track.seek(pos)) {
+      return pos;
+    }
+    const size_t available = track.read(data, min(sizeof(data), size - pos));
+    size_t offset = 0;
+    while (offset < available) {
+      used = Varint::decode(data + offset, available - offset, length);
+      if (used == 0) {
+        break; // continues in the next chunk or the file ends within
+      }
+      if (length > size - pos - offset - used) {
+        return pos + offset;
+      }
+      offset += used + length;
+    }
+    if (offset == 0) {
+      return pos;
+    }
+    pos += offset;
+  }
+  return pos;
+}
+
+/* "OBSB", the format version, the CSV metadata and the location of each
+ * sensor column. */
+bool BinaryFileWriter::writeHeader(String trackId) {
+  setSensorColumns();
+  mRecord.clear();
+  mRecord.insert(mRecord.end(), {'O', 'B', 'S', 'B'});
+  put(FORMAT_VERSION);
+  putString(mRawEchos ? getMetadata(trackId) + "&RawEchoRecords=1" : getMetadata(trackId));
+  put(mSensorColumns.size());
+  for (uint8_t sensorId : mSensorColumns) {
+    putString(String(sensorManager->m_sensors[sensorId].sensorLocation));
+  }
+  return appendBytes(mRecord.data(), mRecord.size());
+}
+
+/* One record per set with the same content as the CSV line, numbers with
+ * decimals are stored as integers with the digits of the CSV. Time,
+ * millis and the position are differences to the last record written.
+ */
+bool BinaryFileWriter::append(DataSet &set) {
+  if (isHiddenByPrivacy(set)) {
+    return true;
+  }
+  mRecord.assign(Varint::MAX_BYTES, 0);
+
+  const bool position = hasPublicPosition(set);
+  uint8_t flags = 0;
+  if (position) {
+    flags |= FLAG_POSITION;
+    if (set.courseValid) {
+      flags |= FLAG_COURSE;
+    }
+    if (set.speedValid) {
+      flags |= FLAG_SPEED;
+    }
+  }
+  if (set.hdopValid) {
+    flags |= FLAG_HDOP;
+  }
+  if (set.invalidMeasurement) {
+    flags |= FLAG_INVALID;
+  }
+  if (set.isInsidePrivacyArea) {
+    flags |= FLAG_INSIDE_PRIVACY_AREA;
+  }
+  put(flags);
+  putSignedVarint((int32_t) (set.time - mLastTime));
+  putSignedVarint((int32_t) (set.millis - mLastMillis));
+  int32_t latitude = mLastLatitude;
+  int32_t longitude = mLastLongitude;
+  if (position) {
+    latitude = set.latitude;
+    longitude = set.longitude;
+    putSignedVarint(latitude - mLastLatitude);
+    putSignedVarint(longitude - mLastLongitude);
+    putSignedVarint(toFixedPoint(set.altitudeCentimeters / 100.0, 1));
+    if (flags & FLAG_COURSE) {
+      putVarint(set.course);
+    }
+    if (flags & FLAG_SPEED) {
+      putVarint(set.speed);
+    }
+  }
+  if (flags & FLAG_HDOP) {
+    putVarint(set.hdop);
+  }
+  put(set.validSatellites);
+  putSignedVarint(set.batteryLevel);
+  for (uint8_t sensorId : mSensorColumns) {
+    putVarint(sensorId < set.sensorValues.size() ? set.sensorValues[sensorId] : MAX_SENSOR_VALUE);
+  }
+  putVarint(set.confirmed);
+  putVarint(toFixedPoint(set.factor, 2));
+  putString(set.comment, strlen(set.comment));
+  putString(set.marked, strlen(set.marked));
+
+  // written as echo records already
+  putVarint(mRawEchos ? 0 : set.timeline.size());
+  uint16_t lastOffset = 0;
+  for (const TimelineRecord &record : set.timeline) {
+    if (mRawEchos) {
+      break;
+    }
+    putSignedVarint((int32_t) record.offsetMilliseconds - lastOffset);
+    put(columnOf(record.sensorId));
+    // 0 if the echo did not end in time
+    putVarint(record.echoDurationMicroseconds > 0 ? record.echoDurationMicroseconds : 0);
+    lastOffset = record.offsetMilliseconds;
+  }
+
+  const TrackEntry catalogEntry = mCatalogEntry;
+  addToCatalogEntry(set);
+  if (!appendRecord()) {
+    mCatalogEntry = catalogEntry;
+    return false;
+  }
+  mLastTime = set.time;
+  mLastMillis = set.millis;
+  mLastLatitude = latitude;
+  mLastLongitude = longitude;
+  return true;
+}
+
+/* Flags, type, time and millis as differences to the last set written,
+ * the measurement index and the value. The differences are not taken
+ * over for the next record, so events can be skipped when reading. */
+bool BinaryFileWriter::appendEvent(const TrackEvent &event) {
+  uint32_t fixMillis = 0;
+  const bool fix = event.atMillis != 0 && nearestFix(event.atMillis, fixMillis);
+  mRecord.assign(Varint::MAX_BYTES, 0);
+  put(fix ? FLAG_EVENT | FLAG_POSITION : FLAG_EVENT);
+  put(event.type);
+  putSignedVarint((int32_t) (event.time - mLastTime));
+  putSignedVarint((int32_t) (event.millis - mLastMillis));
+  putVarint(event.measureIndex);
+  putVarint(event.value);
+  if (fix) {
+    putSignedVarint((int32_t) (fixMillis - event.millis));
+  }
+  return appendRecord();
+}
+
+/* Flags, millis, position as differences to the last position record
+ * and the course and speed as in the interval record. */
+bool BinaryFileWriter::appendFix(DataSet &set, const NavPvt &pvt, uint32_t millis, bool insidePrivacyArea) {
+  if (!pvt.hasPosition() || isHiddenByPrivacy(set) || !hasPublicPosition(set)
+      || (insidePrivacyArea && (config.privacyConfig & (AbsolutePrivacy | NoPosition | OverridePrivacy)))) {
+    return true;
+  }
+  const int32_t latitude = scaleDown(pvt.latitude, 10);
+  const int32_t longitude = scaleDown(pvt.longitude, 10);
+  mRecord.assign(Varint::MAX_BYTES, 0);
+  put(FLAG_FIX);
+  putSignedVarint((int32_t) (millis - mLastFixMillis));
+  putSignedVarint(latitude - mLastFixLatitude);
+  putSignedVarint(longitude - mLastFixLongitude);
+  putVarint((uint32_t) scaleDown(pvt.headingOfMotion, 1000));
+  putVarint((uint32_t) scaleDown(pvt.groundSpeed * 36, 100));
+  if (!appendRecord()) {
+    return false;
+  }
+  mLastFixMillis = millis;
+  mLastFixLatitude = latitude;
+  mLastFixLongitude = longitude;
+  mFixMillis[mFixes++ % FIX_HISTORY] = millis;
+  return true;
+}
+
+bool BinaryFileWriter::nearestFix(uint32_t millis, uint32_t &fixMillis) const {
+  uint32_t nearest = MAX_FIX_DISTANCE_MILLIS + 1;
+  const size_t fixes = mFixes < FIX_HISTORY ? mFixes : FIX_HISTORY;
+  for (size_t idx = 0; idx < fixes; ++idx) {
+    const uint32_t distance = (uint32_t) abs((int32_t) (mFixMillis[idx] - millis));
+    if (distance < nearest) {
+      nearest = distance;
+      fixMillis = mFixMillis[idx];
+    }
+  }
+  return nearest <= MAX_FIX_DISTANCE_MILLIS;
+}
+
+/* Flags, the distance column, the trigger time as difference to the last
+ * echo record and the echo time, about 6 bytes. */
+bool BinaryFileWriter::appendEcho(const DataSet &set, uint32_t triggerMillis, uint8_t sensorId,
+                                  int32_t echoDurationMicroseconds) {
+  if (isHiddenByPrivacy(set)) {
+    return true;
+  }
+  mRecord.assign(Varint::MAX_BYTES, 0);
+  put(FLAG_ECHO);
+  put(columnOf(sensorId));
+  putSignedVarint((int32_t) (triggerMillis - mLastEchoMillis));
+  // 0 if the echo did not end in time
+  putVarint(echoDurationMicroseconds > 0 ? echoDurationMicroseconds : 0);
+  if (!appendRecord()) {
+    return false;
+  }
+  mLastEchoMillis = triggerMillis;
+  return true;
+}
+
+uint8_t BinaryFileWriter::columnOf(uint8_t sensorId) const {
+  uint8_t column = 0;
+  while (column < mSensorColumns.size() && mSensorColumns[column] != sensorId) {
+    column++;
+  }
+  return column;
+}
+
+bool BinaryFileWriter::appendRecord() {
+  // the length goes right in front of the record
+  uint8_t length[Varint::MAX_BYTES];
+  const size_t lengthSize = Varint::encode(mRecord.size() - Varint::MAX_BYTES, length);
+  const size_t start = Varint::MAX_BYTES - lengthSize;
+  memcpy(&mRecord[start], length, lengthSize);
+  return appendBytes(&mRecord[start], mRecord.size() - start);
 }
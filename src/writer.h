@@ -28,72 +28,340 @@
 #include <vector>
 
 #include "globals.h"
+#include "trackcatalog.h"
+#include "utils/gzip.h"
+#include "utils/inlinevector.h"
+#include "utils/spscqueue.h"
+#include "utils/ubx.h"
 
+/* Buffers between loop() and the SD writer task, the card is written in
+ * WRITE_BUFFER_SIZE pieces. With about 500 bytes per second the buffers
+ * bridge a card that does not take data for 20 seconds. A power of 2.
+ */
+const size_t WRITE_BUFFERS = 4;
+const size_t WRITE_BUFFER_SIZE = 4096;
+/* Buckets of the write time histogram of WriterStatistics, bucket n counts
+ * writes that took less than 2^n ms, the last one all slower writes. */
+const uint8_t WRITE_MILLIS_BUCKETS = 12;
 
+/* Counters of the SD writer task. Written by the task, loop() might see a
+ * state a write off.
+ */
+struct WriterStatistics {
+  /* Buffers written to the card. */
+  uint32_t writes = 0;
+  /* Writes the card did not take, the data is lost. */
+  uint32_t failedWrites = 0;
+  /* Appends dropped as all buffers were waiting for the card. */
+  uint32_t droppedAppends = 0;
+  uint32_t droppedBytes = 0;
+  /* Syncs of the file, see Config::trackSyncSeconds. */
+  uint32_t syncs = 0;
+  /* Most buffers handed to the task at the same time. */
+  uint8_t maxQueueDepth = 0;
+  uint32_t maxWriteMillis = 0;
+  uint32_t writeMillisHistogram[WRITE_MILLIS_BUCKETS] = {};
+
+  /* Upper bound of the write time in ms of the given share of the
+   * writes, 0 if there was none yet. */
+  uint32_t writeMillisPercentile(uint8_t percent) const;
+};
+
+/* Button presses that confirm the same DataSet, more are dropped. */
+const size_t MAX_CONFIRMATIONS_PER_SET = 8;
+
+/* A button press that confirmed an overtaking in the interval. */
+struct Confirmation {
+  /* Index of the measurement in the timeline of the interval. */
+  uint16_t measureIndex;
+  /* MAX_SENSOR_VALUE if there was none to confirm. */
+  uint16_t distance;
+};
+
+/* Values of one interval. Kept in the interval ring of loop(), so the
+ * members keep their storage inline or in the timeline arena. Numbers
+ * are kept with the digits written to the track, e.g. latitude 48.784270
+ * as 48784270.
+ */
 struct DataSet {
   time_t time;
   uint32_t  millis;
-  String comment;
-  TinyGPSLocation location;
-  TinyGPSAltitude altitude;
-  TinyGPSCourse course;
-  TinyGPSSpeed speed;
-  TinyGPSHDOP hdop;
-  uint8_t validSatellites;
-  float BatterieVoltage;
-  double batteryLevel;
-  std::vector<uint16_t> sensorValues;
-  std::vector<uint16_t> confirmedDistances;
-  std::vector<uint16_t> confirmedDistancesTimeOffset;
+  /* Static text, the firmware does not set any so far. */
+  const char *comment = "";
+  /* Degrees * 10^6. */
+  int32_t latitude = 0;
+  int32_t longitude = 0;
+  int32_t altitudeCentimeters = 0;
+  /* 1/100 degree. */
+  uint16_t course = 0;
+  /* 1/100 km/h. */
+  uint16_t speed = 0;
+  /* 1/100, 9999 if the module has no idea. */
+  uint16_t hdop = 0;
+  uint8_t validSatellites = 0;
+  bool locationValid : 1;
+  bool courseValid : 1;
+  bool speedValid : 1;
+  bool hdopValid : 1;
+  bool invalidMeasurement : 1;
+  bool isInsidePrivacyArea : 1;
+  /* 1/100 of the battery level, -100 if not known. */
+  int16_t batteryLevel = 0;
+  InlineVector<uint16_t, MAX_NUMBER_SENSORS> sensorValues;
+  InlineVector<Confirmation, MAX_CONFIRMATIONS_PER_SET> confirmations;
+  /* Measurement index of the confirmation written with the set. */
   uint16_t confirmed = 0;
-  String marked;
-  bool invalidMeasurement = false;
-  bool isInsidePrivacyArea;
-  uint8_t factor = MICRO_SEC_TO_CM_DIVIDER;
-  uint8_t measurements;
+  /* Static text, the firmware does not set any so far. */
+  const char *marked = "";
+  /* Microseconds echo time per cm used for the distances. */
+  float factor = MICRO_SEC_TO_CM_DIVIDER;
 
   uint16_t position = 0; // fixme: num sensors?
-  uint16_t startOffsetMilliseconds[MAX_NUMBER_MEASUREMENTS_PER_INTERVAL + 1];
-  int32_t readDurationsLeftInMicroseconds[MAX_NUMBER_MEASUREMENTS_PER_INTERVAL + 1];
-  int32_t readDurationsRightInMicroseconds[MAX_NUMBER_MEASUREMENTS_PER_INTERVAL + 1];
+  /* Raw echos of the interval, filled by the sensor manager. */
+  Timeline timeline = Timeline(&timelineArena);
+
+  DataSet() : locationValid(false), courseValid(false), speedValid(false),
+    hdopValid(false), invalidMeasurement(false), isInsidePrivacyArea(false) {};
+  /* Takes the current values of the GPS module. */
+  void setGpsValues(TinyGPSPlus &gps);
+  /* Same from a UBX-NAV-PVT, hdop gets its position DOP. */
+  void setGpsValues(const NavPvt &pvt);
+  void setBatteryLevel(double level);
+};
+
+/* Something that happened during the ride, written as a short record of
+ * its own rather than as part of the interval row. Refers to the interval
+ * by its time and millis and to the measurement by its index in the
+ * timeline of the interval.
+ */
+struct TrackEvent {
+  enum Type : uint8_t {
+    /* The OBS started, the first event of a track. */
+    BOOT = 0,
+    /* Button press, value is the confirmed distance in cm or
+     * MAX_SENSOR_VALUE if there was none. */
+    CONFIRM = 1,
+    /* Mark written via bluetooth, value is the number of writes since the
+     * last interval. */
+    MARK = 2,
+    PRIVACY_ENTER = 3,
+    PRIVACY_EXIT = 4,
+    /* The data up to here was handed to the card on request. */
+    FLUSH = 5,
+  };
+  time_t time;
+  uint32_t millis;
+  uint16_t measureIndex;
+  uint16_t value;
+  Type type;
+  /* millis() the event happened at, the binary track refers to the
+   * position record nearest to it. 0 for none. */
+  uint32_t atMillis;
 };
 
 class FileWriter {
   public:
-    FileWriter() = default;;
-    explicit FileWriter(String ext) :
-      mFileExtension(std::move(ext)) {};
-    virtual ~FileWriter() = default;
+    FileWriter() : FileWriter(String()) {};
+    /* With gzip the track is compressed by the writer task and GZIP_EXTENSION
+     * is added to the file name. */
+    explicit FileWriter(String ext, bool gzip = false);
+    /* Waits till the writer task wrote all data. */
+    virtual ~FileWriter();
     void setFileName();
     virtual bool writeHeader(String trackId) = 0;
     virtual bool append(DataSet &) = 0;
+    /* Events are not hidden by privacy areas, they carry no position but
+     * refer to a position record that was written. Only the binary track
+     * holds them, the default skips them. */
+    virtual bool appendEvent(const TrackEvent &) {
+      return true;
+    };
+    /* A position of the GPS module between the intervals, received at
+     * millis during the interval of set. Only the binary track holds them,
+     * the default skips them. */
+    virtual bool appendFix(DataSet &set, const NavPvt &pvt, uint32_t millis, bool insidePrivacyArea) {
+      return true;
+    };
     bool appendString(const String &s);
+    /* As appendString() for binary data, the data is stored completely or
+     * not at all. */
+    bool appendBytes(const uint8_t *data, size_t size);
+    /* Hands the data appended so far to the writer task, which syncs the
+     * file after writing it. Does not wait for the card, returns false if
+     * nothing could be handed over. */
     bool flush();
+    const WriterStatistics &getStatistics() const;
+    /* Cuts the incomplete record or gzip member a power loss might have
+     * left at the end of the track written last. Call at boot before a new writer starts.
+     * Returns true if the track was changed. */
+    static bool recoverUnfinishedTrack();
+    static const String GZIP_EXTENSION;
 
   protected:
-    uint16_t getBufferLength() const;
-    unsigned long getWriteTimeMillis() const;
+    /* Sets mSensorColumns, left and right come first. */
+    void setSensorColumns();
+    /* Most records a timeline of the sensors in mSensorColumns holds. */
+    uint16_t maxMeasurementsPerLine() const {
+      return (uint16_t) (mSensorColumns.size() * MAX_READINGS_PER_INTERVAL);
+    };
+    /* Key value metadata of the track, the 1st line of the CSV. */
+    String getMetadata(const String &trackId) const;
+    /* The set must not be written at all due to a privacy area. */
+    static bool isHiddenByPrivacy(const DataSet &set);
+    /* The set has a position that may be written. */
+    static bool hasPublicPosition(DataSet &set);
+    /* Counts the set for the track catalog, call before the set is
+     * appended so the buffer it ends in carries it. */
+    void addToCatalogEntry(DataSet &set);
+    /* Sensor ids in the order of their columns, set by setSensorColumns(). */
+    std::vector<uint8_t> mSensorColumns;
+    /* Counts the sets appended, a copy goes with each buffer to the writer
+     * task. */
+    TrackEntry mCatalogEntry;
 
   private:
-    static void storeTrackNumber(int trackNumber);
-    static int getTrackNumber();
+    struct Buffer {
+      size_t size = 0;
+      /* Sync the file after this buffer was written. */
+      bool sync = false;
+      /* Records up to the end of this buffer. */
+      TrackEntry catalogEntry;
+      uint8_t data[WRITE_BUFFER_SIZE];
+    };
+    static void writerTask(void *parameter);
+    bool handOver(bool sync);
+    void writeBuffers();
+    bool writeFile(const uint8_t *data, size_t size);
+    bool openFile();
+    /* Names the track and its size as of the last sync for
+     * recoverUnfinishedTrack(). */
+    void writeUnfinishedMarker();
     void correctFilename();
-    String mBuffer;
+    /* Writes mSyncedCatalogEntry with the current name and size. */
+    void updateCatalog(uint8_t state);
+    /* Buffers are owned by loop() while free or filling and by the writer
+     * task while queued, the two queues hand them over. */
+    Buffer mBuffers[WRITE_BUFFERS];
+    Buffer *mFilling = nullptr;
+    SpscQueue<Buffer *, WRITE_BUFFERS> mFreeBuffers;
+    SpscQueue<Buffer *, WRITE_BUFFERS> mQueuedBuffers;
+    TaskHandle_t mWriterTaskHandle = nullptr;
+    volatile bool mStopWriterTask = false;
+    volatile bool mWriterTaskEnded = false;
+    WriterStatistics mStatistics;
+    /* millis() when loop() last asked for a sync. */
+    unsigned long mSyncRequestMillis = millis();
+    /* Kept open by the writer task for the whole ride. */
+    File mFile;
+    /* Written since the last sync, kept if the file is opened again after
+     * a failed write. */
+    size_t mUnsyncedBytes = 0;
+    /* Each sync ends a gzip member, the card holds complete members only. */
+    GzipCompressor *mGzip = nullptr;
     String mFileExtension;
+    /* Used by the writer task once the 1st buffer was handed over. */
     String mFileName;
     const unsigned long mStartedMillis = millis();
     bool mFinalFileName = false;
-    unsigned long mWriteTimeMillis = 0;
-
+    /* The writer task's copy of the entry as of the last buffer written. */
+    TrackEntry mSyncedCatalogEntry;
+    uint32_t mCatalogIndex = TrackCatalog::NO_ENTRY;
 };
 
 class CSVFileWriter : public FileWriter {
   public:
-    CSVFileWriter() : FileWriter(EXTENSION) {}
+    explicit CSVFileWriter(bool gzip = false) : FileWriter(EXTENSION, gzip) {}
     ~CSVFileWriter() override = default;
     bool writeHeader(String trackId) override;
     bool append(DataSet&) override;
+    /* Size of the track up to the end of the last complete line. */
+    static size_t completeSize(File &track);
     static const String EXTENSION;
+
+  private:
+    /* Room for the fields up to the measurements and the comments. */
+    static const size_t CSV_LINE_RESERVE = 512;
+    /* Line under construction, sized by writeHeader(). */
+    std::vector<char> mLine;
+};
+
+/* Compact binary track, see docs/software/firmware/binary_format.md.
+ * tools/decoder converts it back to the CSV.
+ */
+class BinaryFileWriter : public FileWriter {
+  public:
+    /* With rawEchos the records of the intervals hold no measurements,
+     * appendEcho() writes them. */
+    explicit BinaryFileWriter(bool gzip = false, bool rawEchos = false)
+      : FileWriter(EXTENSION, gzip), mRawEchos(rawEchos) {}
+    ~BinaryFileWriter() override = default;
+    bool writeHeader(String trackId) override;
+    bool append(DataSet&) override;
+    /* A record with FLAG_EVENT, a few bytes only. */
+    bool appendEvent(const TrackEvent &event) override;
+    /* A record with FLAG_FIX of about 12 bytes. Skipped without a position
+     * or if the set or the fix would be hidden by privacy, the fix counts
+     * as not confirmed. */
+    bool appendFix(DataSet &set, const NavPvt &pvt, uint32_t millis, bool insidePrivacyArea) override;
+    /* A record with FLAG_ECHO, call as the echo is collected, see
+     * HCSR04SensorManager::setEchoListener(). Skipped if the set of the
+     * interval is hidden by privacy, a later confirmation does not bring
+     * the echoes back. */
+    bool appendEcho(const DataSet &set, uint32_t triggerMillis, uint8_t sensorId,
+                    int32_t echoDurationMicroseconds);
+    /* Size of the track up to the end of the last complete record, 0 if
+     * the header is incomplete. */
+    static size_t completeSize(File &track);
+    static const String EXTENSION;
+    static const uint8_t FORMAT_VERSION = 3;
+    static const uint8_t FLAG_POSITION = 0x01;
+    static const uint8_t FLAG_COURSE = 0x02;
+    static const uint8_t FLAG_SPEED = 0x04;
+    static const uint8_t FLAG_HDOP = 0x08;
+    static const uint8_t FLAG_INVALID = 0x10;
+    static const uint8_t FLAG_INSIDE_PRIVACY_AREA = 0x20;
+    /* The record is a single echo, no other flag is set then. */
+    static const uint8_t FLAG_ECHO = 0x40;
+    /* The record is a TrackEvent, with FLAG_POSITION if it refers to a
+     * position record. No other flag is set then. */
+    static const uint8_t FLAG_EVENT = 0x80;
+    /* The record is a position of the GPS module between the intervals. */
+    static const uint8_t FLAG_FIX = FLAG_ECHO | FLAG_EVENT;
+    /* Position records an event can refer to, 6s at 5 Hz. */
+    static const size_t FIX_HISTORY = 32;
+    /* Events further away from a position record refer to none. */
+    static const uint32_t MAX_FIX_DISTANCE_MILLIS = 1000;
+
+  private:
+    /* Puts the length in front of mRecord and appends it. */
+    bool appendRecord();
+    /* millis of the position record written nearest to the given one. */
+    bool nearestFix(uint32_t millis, uint32_t &fixMillis) const;
+    /* Index of the distance column of the sensor. */
+    uint8_t columnOf(uint8_t sensorId) const;
+    void put(uint8_t value);
+    void putVarint(uint32_t value);
+    void putSignedVarint(int32_t value);
+    void putString(const String &value);
+    void putString(const char *value, size_t length);
+    /* Record under construction, Varint::MAX_BYTES are kept free in
+     * front for the length. */
+    std::vector<uint8_t> mRecord;
+    /* Values of the last record written, the next one holds differences. */
+    time_t mLastTime = 0;
+    uint32_t mLastMillis = 0;
+    int32_t mLastLatitude = 0;
+    int32_t mLastLongitude = 0;
+    const bool mRawEchos;
+    /* Trigger time of the last echo record written. */
+    uint32_t mLastEchoMillis = 0;
+    /* Values of the last position record written. */
+    uint32_t mLastFixMillis = 0;
+    int32_t mLastFixLatitude = 0;
+    int32_t mLastFixLongitude = 0;
+    /* millis of the last position records written, a ring. */
+    uint32_t mFixMillis[FIX_HISTORY];
+    size_t mFixes = 0;
 };
 
 #endif
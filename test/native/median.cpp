@@ -30,7 +30,7 @@ void test_function_median(void) {
   m.addValue(5);
   TEST_ASSERT_EQUAL(4, m.median());
   m.addValue(5);
-  TEST_ASSERT_EQUAL(6, m.median());
+  TEST_ASSERT_EQUAL(5, m.median());
 
 }
 
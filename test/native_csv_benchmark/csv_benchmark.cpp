@@ -0,0 +1,278 @@
+#include "unity.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+#include "utils/csvline.h"
+
+/* Compares CsvLine with the former String based formatting of a track
+ * line, String(value, decimals) is printf("%.*f") on the host. Both must
+ * give the same text, CsvLine must not allocate.
+ */
+
+static size_t allocations = 0;
+
+void *operator new(size_t size) {
+  allocations++;
+  void *memory = malloc(size ? size : 1);
+  if (!memory) {
+    throw std::bad_alloc();
+  }
+  return memory;
+}
+
+void operator delete(void *memory) noexcept {
+  free(memory);
+}
+
+void operator delete(void *memory, size_t) noexcept {
+  free(memory);
+}
+
+static const size_t RECORDS = 20000;
+static const size_t SENSORS = 2;
+
+struct Record {
+  uint32_t millis;
+  double latitude;
+  double longitude;
+  double altitude;
+  double course;
+  double speed;
+  double hdop;
+  uint8_t satellites;
+  double batteryLevel;
+  uint16_t distances[SENSORS];
+  float factor;
+  std::vector<uint16_t> offsets;
+  std::vector<uint8_t> sensors;
+  std::vector<int32_t> durations;
+};
+
+static uint32_t nextRandom(uint32_t &random) {
+  random ^= random << 13;
+  random ^= random >> 17;
+  random ^= random << 5;
+  return random;
+}
+
+/* A ride around Stuttgart with about 60 measurements per line, some
+ * values sit exactly between two roundings. */
+static std::vector<Record> createRecords() {
+  std::vector<Record> records(RECORDS);
+  uint32_t random = 0x4f425321;
+  for (size_t idx = 0; idx < records.size(); ++idx) {
+    Record &record = records[idx];
+    record.millis = 1000 * idx + nextRandom(random) % 20;
+    record.latitude = 48.78427 + (nextRandom(random) % 2000000) / 1e8;
+    record.longitude = 9.18213 + (nextRandom(random) % 2000000) / 1e8;
+    record.altitude = (nextRandom(random) % 40000) / 100.0 - 20;
+    record.course = idx % 7 == 0 ? 0.125 * (nextRandom(random) % 2880) : (nextRandom(random) % 36000) / 100.0;
+    record.speed = idx % 5 == 0 ? 2.5 + 0.005 * (nextRandom(random) % 100) : (nextRandom(random) % 4000) / 97.0;
+    record.hdop = (nextRandom(random) % 500) / 100.0;
+    record.satellites = nextRandom(random) % 14;
+    record.batteryLevel = idx % 11 == 0 ? -0.0 : (nextRandom(random) % 12000) / 99.0 - 10;
+    for (uint16_t &distance : record.distances) {
+      distance = nextRandom(random) % 3 == 0 ? 999 : (uint16_t) (nextRandom(random) % 300);
+    }
+    record.factor = 56.0f + (nextRandom(random) % 700) / 100.0f;
+    const size_t measurements = 40 + nextRandom(random) % 40;
+    for (size_t measurement = 0; measurement < measurements; ++measurement) {
+      record.offsets.push_back((uint16_t) (measurement * 1000 / measurements));
+      record.sensors.push_back(measurement % SENSORS);
+      record.durations.push_back(nextRandom(random) % 10 == 0 ? -1 : (int32_t) (nextRandom(random) % 18000));
+    }
+  }
+  return records;
+}
+
+static std::string fixed(double value, int decimals) {
+  char text[64];
+  snprintf(text, sizeof(text), "%.*f", decimals, value);
+  return text;
+}
+
+/* The line as CSVFileWriter::append() built it with String. */
+static std::string stringLine(const Record &record) {
+  std::string csv = "01.06.2021;08:00:00;" + std::to_string(record.millis) + ";";
+  csv += ";";
+  csv += fixed(record.latitude, 6) + ";";
+  csv += fixed(record.longitude, 6) + ";";
+  csv += fixed(record.altitude, 1) + ";";
+  csv += fixed(record.course, 2);
+  csv += ";";
+  csv += fixed(record.speed, 2);
+  csv += ";";
+  csv += fixed(record.hdop, 2);
+  csv += ";";
+  csv += std::to_string(record.satellites) + ";";
+  csv += fixed(record.batteryLevel, 2) + ";";
+  for (uint16_t distance : record.distances) {
+    if (distance < 999) {
+      csv += std::to_string(distance);
+    }
+    csv += ";";
+  }
+  csv += "0;;0;0;";
+  csv += fixed(record.factor, 2) + ";";
+  csv += std::to_string(record.offsets.size());
+  for (size_t idx = 0; idx < record.offsets.size(); ++idx) {
+    csv += ";" + std::to_string(record.offsets[idx]);
+    for (uint8_t sensor = 0; sensor < SENSORS; ++sensor) {
+      csv += ";";
+      if (record.sensors[idx] == sensor && record.durations[idx] > 0) {
+        csv += std::to_string(record.durations[idx]);
+      }
+    }
+  }
+  csv += "\n";
+  return csv;
+}
+
+/* The same line with CsvLine as CSVFileWriter::append() builds it now. */
+static void csvLine(const Record &record, CsvLine &csv) {
+  csv.clear();
+  csv.appendPadded(1, 2).append('.').appendPadded(6, 2).append('.').appendPadded(2021, 4).append(';');
+  csv.appendPadded(8, 2).append(':').appendPadded(0, 2).append(':').appendPadded(0, 2).append(';');
+  csv.appendUnsigned(record.millis).append(';');
+  csv.append(';');
+  csv.appendFixed(record.latitude, 6).append(';');
+  csv.appendFixed(record.longitude, 6).append(';');
+  csv.appendFixed(record.altitude, 1).append(';');
+  csv.appendFixed(record.course, 2);
+  csv.append(';');
+  csv.appendFixed(record.speed, 2);
+  csv.append(';');
+  csv.appendFixed(record.hdop, 2);
+  csv.append(';');
+  csv.appendUnsigned(record.satellites).append(';');
+  csv.appendFixed(record.batteryLevel, 2).append(';');
+  for (uint16_t distance : record.distances) {
+    if (distance < 999) {
+      csv.appendUnsigned(distance);
+    }
+    csv.append(';');
+  }
+  csv.append("0;;0;0;");
+  csv.appendFixed(record.factor, 2).append(';');
+  csv.appendUnsigned(record.offsets.size());
+  for (size_t idx = 0; idx < record.offsets.size(); ++idx) {
+    csv.append(';').appendUnsigned(record.offsets[idx]);
+    for (uint8_t sensor = 0; sensor < SENSORS; ++sensor) {
+      csv.append(';');
+      if (record.sensors[idx] == sensor && record.durations[idx] > 0) {
+        csv.appendUnsigned(record.durations[idx]);
+      }
+    }
+  }
+  csv.append('\n');
+}
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+void test_fixed_as_printf(void) {
+  const double values[] = {
+    0, -0.0, 0.5, 1.5, 2.5, 0.125, 0.375, 1.005, 2.675, -1.125, 48.784270, 9.1821349999,
+    123456.785, 0.000001, 0.0000005, 0.0000015, 99.995, 1e-300, 4503599627.5, 1e20,
+    NAN, INFINITY, -INFINITY
+  };
+  char buffer[400];
+  CsvLine line(buffer, sizeof(buffer));
+  for (double value : values) {
+    for (uint8_t decimals = 0; decimals <= 6; ++decimals) {
+      line.clear();
+      line.appendFixed(value, decimals).append('\0');
+      TEST_ASSERT_EQUAL_STRING(fixed(value, decimals).c_str(), line.data());
+    }
+  }
+  uint32_t random = 0x4f425321;
+  for (int i = 0; i < 1000000; ++i) {
+    const double value = (double) (int32_t) nextRandom(random) / (1 << (nextRandom(random) % 24));
+    const uint8_t decimals = nextRandom(random) % 7;
+    line.clear();
+    line.appendFixed(value, decimals).append('\0');
+    TEST_ASSERT_EQUAL_STRING(fixed(value, decimals).c_str(), line.data());
+  }
+}
+
+/* Values kept with the digits of the track give the text of the double. */
+void test_scaled_as_fixed(void) {
+  char buffer[40];
+  CsvLine line(buffer, sizeof(buffer));
+  const int64_t values[] = { 0, 1, -1, 9, 99, 100, 48784270, -9182135, 2147483647, -2147483647 };
+  for (int64_t value : values) {
+    for (uint8_t decimals = 0; decimals <= 6; ++decimals) {
+      line.clear();
+      line.appendScaled(value, decimals).append('\0');
+      TEST_ASSERT_EQUAL_STRING(fixed(value / Decimal::powerOf10(decimals), decimals).c_str(), line.data());
+    }
+  }
+}
+
+void test_overflow_truncates(void) {
+  char buffer[8];
+  CsvLine line(buffer, sizeof(buffer));
+  line.append("12345").appendUnsigned(6789);
+  TEST_ASSERT_TRUE(line.overflow());
+  TEST_ASSERT_EQUAL(8, line.size());
+  TEST_ASSERT_EQUAL_MEMORY("12345678", line.data(), 8);
+  line.clear();
+  TEST_ASSERT_FALSE(line.overflow());
+  line.appendSigned(-42).appendPadded(7, 3);
+  TEST_ASSERT_EQUAL_MEMORY("-42007", line.data(), 6);
+}
+
+void test_csv_benchmark(void) {
+  const std::vector<Record> records = createRecords();
+  std::vector<std::string> expected(records.size());
+
+  size_t before = allocations;
+  auto start = std::chrono::steady_clock::now();
+  for (size_t idx = 0; idx < records.size(); ++idx) {
+    expected[idx] = stringLine(records[idx]);
+  }
+  const double stringSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  const double stringAllocations = (double) (allocations - before) / records.size();
+
+  std::vector<char> buffer(4096);
+  CsvLine line(buffer.data(), buffer.size());
+  size_t bytes = 0;
+  before = allocations;
+  start = std::chrono::steady_clock::now();
+  for (const Record &record : records) {
+    csvLine(record, line);
+    bytes += line.size();
+  }
+  const double lineSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  const size_t lineAllocations = allocations - before;
+
+  printf("formatter  records/s  allocations/record\n");
+  printf("String     %9.0f  %18.1f\n", records.size() / stringSeconds, stringAllocations);
+  printf("CsvLine    %9.0f  %18.1f\n", records.size() / lineSeconds, (double) lineAllocations / records.size());
+  TEST_ASSERT_EQUAL(0, lineAllocations);
+  TEST_ASSERT_GREATER_THAN(0, bytes);
+
+  for (size_t idx = 0; idx < records.size(); ++idx) {
+    csvLine(records[idx], line);
+    TEST_ASSERT_FALSE(line.overflow());
+    TEST_ASSERT_TRUE(expected[idx] == std::string(line.data(), line.size()));
+  }
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_fixed_as_printf);
+  RUN_TEST(test_scaled_as_fixed);
+  RUN_TEST(test_overflow_truncates);
+  RUN_TEST(test_csv_benchmark);
+  UNITY_END();
+  return 0;
+}
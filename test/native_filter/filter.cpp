@@ -0,0 +1,81 @@
+#include "unity.h"
+
+#define MAX_SENSOR_VALUE 999
+#include "utils/filter.h"
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+void test_median_filter(void) {
+  MedianFilter<uint16_t, 3> median;
+  TEST_ASSERT_EQUAL(MAX_SENSOR_VALUE, median.process(100));
+  TEST_ASSERT_EQUAL(102, median.process(102));
+  TEST_ASSERT_EQUAL(101, median.process(101));
+  TEST_ASSERT_EQUAL(102, median.process(500));
+  TEST_ASSERT_EQUAL(500, median.process(MAX_SENSOR_VALUE));
+  median.reset();
+  TEST_ASSERT_EQUAL(MAX_SENSOR_VALUE, median.median());
+}
+
+void test_outlier_gate(void) {
+  OutlierGate<uint16_t, 20, 2> gate;
+  TEST_ASSERT_EQUAL(150, gate.process(150));
+  TEST_ASSERT_EQUAL(160, gate.process(160));
+  TEST_ASSERT_EQUAL(160, gate.process(40));
+  TEST_ASSERT_EQUAL(165, gate.process(165));
+  TEST_ASSERT_EQUAL(165, gate.process(60));
+  TEST_ASSERT_EQUAL(62, gate.process(62));
+  TEST_ASSERT_EQUAL(MAX_SENSOR_VALUE, gate.process(MAX_SENSOR_VALUE));
+  TEST_ASSERT_EQUAL(80, gate.process(80));
+}
+
+void test_offset_correction(void) {
+  OffsetCorrection<uint16_t> offset;
+  offset.setOffset(30);
+  TEST_ASSERT_EQUAL(120, offset.process(150));
+  TEST_ASSERT_EQUAL(0, offset.process(20));
+  TEST_ASSERT_EQUAL(MAX_SENSOR_VALUE, offset.process(MAX_SENSOR_VALUE));
+}
+
+void test_kalman_filter(void) {
+  KalmanFilter<uint16_t, 10, 10> kalman;
+  TEST_ASSERT_EQUAL(150, kalman.process(150));
+  uint16_t last = 150;
+  for (int i = 0; i < 20; i++) {
+    const uint16_t value = kalman.process(100);
+    TEST_ASSERT_TRUE(value <= last);
+    TEST_ASSERT_TRUE(value >= 100);
+    last = value;
+  }
+  TEST_ASSERT_TRUE(last < 150);
+}
+
+void test_filter_chain(void) {
+  FilterChain<uint16_t,
+    MedianFilter<uint16_t, 3>,
+    OffsetCorrection<uint16_t>> chain;
+  chain.setOffset(30);
+  chain.process(100);
+  TEST_ASSERT_EQUAL(70, chain.process(100));
+  TEST_ASSERT_EQUAL(70, chain.process(MAX_SENSOR_VALUE));
+  TEST_ASSERT_EQUAL(MAX_SENSOR_VALUE, chain.process(MAX_SENSOR_VALUE));
+  chain.reset();
+  TEST_ASSERT_EQUAL(MAX_SENSOR_VALUE, chain.process(100));
+
+  FilterChain<uint16_t> empty;
+  TEST_ASSERT_EQUAL(42, empty.process(42));
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_median_filter);
+  RUN_TEST(test_outlier_gate);
+  RUN_TEST(test_offset_correction);
+  RUN_TEST(test_kalman_filter);
+  RUN_TEST(test_filter_chain);
+  UNITY_END();
+  return 0;
+}
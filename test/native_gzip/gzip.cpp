@@ -0,0 +1,415 @@
+#include "unity.h"
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "utils/gzip.h"
+
+/* Compresses with GzipCompressor and reads the result back with the
+ * small inflate below, written along RFC 1951 and 1952 like zlib's puff.
+ */
+
+class Inflater {
+  public:
+    Inflater(const std::vector<uint8_t> &data) : data(data) {};
+
+    /* All members of the file, false if one is broken or incomplete. */
+    bool gunzip(std::vector<uint8_t> &out) {
+      while (position < data.size()) {
+        if (data.size() - position < 10 || data[position] != 0x1f || data[position + 1] != 0x8b
+            || data[position + 2] != 8 || data[position + 3] != 0) {
+          return false;
+        }
+        position += 10;
+        memberStart = out.size();
+        if (!inflate(out) || data.size() - position < 8) {
+          return false;
+        }
+        const uint32_t crc = read32();
+        const uint32_t size = read32();
+        if (crc != crc32(out.data() + memberStart, out.size() - memberStart)
+            || size != (uint32_t) (out.size() - memberStart)) {
+          return false;
+        }
+        members++;
+      }
+      return true;
+    };
+
+    size_t members = 0;
+
+  private:
+    struct Huffman {
+      uint16_t count[16];
+      uint16_t symbol[288];
+    };
+
+    bool inflate(std::vector<uint8_t> &out) {
+      bitCount = 0;
+      bool last = false;
+      while (!last && !failed) {
+        last = bits(1);
+        const uint32_t type = bits(2);
+        if (type == 0) {
+          bitCount = 0;
+          if (data.size() - position < 4) {
+            return false;
+          }
+          const uint16_t length = data[position] | data[position + 1] << 8;
+          position += 4;
+          if (data.size() - position < length) {
+            return false;
+          }
+          out.insert(out.end(), data.begin() + position, data.begin() + position + length);
+          position += length;
+        } else if (type == 1) {
+          uint8_t lengths[288 + 30];
+          for (int i = 0; i < 288; ++i) {
+            lengths[i] = i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : 8;
+          }
+          for (int i = 0; i < 30; ++i) {
+            lengths[288 + i] = 5;
+          }
+          Huffman literalLength, distance;
+          build(literalLength, lengths, 288);
+          build(distance, lengths + 288, 30);
+          codes(out, literalLength, distance);
+        } else if (type == 2) {
+          dynamic(out);
+        } else {
+          return false;
+        }
+      }
+      bitCount = 0;
+      return !failed;
+    };
+
+    void dynamic(std::vector<uint8_t> &out) {
+      static const uint8_t ORDER[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+      const uint32_t literalLengths = bits(5) + 257;
+      const uint32_t distances = bits(5) + 1;
+      const uint32_t codeLengths = bits(4) + 4;
+      uint8_t lengths[320] = {};
+      for (uint32_t i = 0; i < codeLengths; ++i) {
+        lengths[ORDER[i]] = bits(3);
+      }
+      Huffman codeLength;
+      build(codeLength, lengths, 19);
+      uint32_t index = 0;
+      while (index < literalLengths + distances && !failed) {
+        int symbol = decode(codeLength);
+        if (symbol < 16) {
+          lengths[index++] = symbol;
+          continue;
+        }
+        uint8_t length = 0;
+        uint32_t repeat;
+        if (symbol == 16) {
+          if (index == 0) {
+            failed = true;
+            return;
+          }
+          length = lengths[index - 1];
+          repeat = 3 + bits(2);
+        } else if (symbol == 17) {
+          repeat = 3 + bits(3);
+        } else {
+          repeat = 11 + bits(7);
+        }
+        if (index + repeat > literalLengths + distances) {
+          failed = true;
+          return;
+        }
+        while (repeat-- > 0) {
+          lengths[index++] = length;
+        }
+      }
+      Huffman literalLength, distance;
+      build(literalLength, lengths, literalLengths);
+      build(distance, lengths + literalLengths, distances);
+      codes(out, literalLength, distance);
+    };
+
+    void codes(std::vector<uint8_t> &out, const Huffman &literalLength, const Huffman &distance) {
+      static const uint16_t LENGTH_BASE[29] = {
+        3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+      static const uint8_t LENGTH_EXTRA[29] = {
+        0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+      static const uint16_t DISTANCE_BASE[30] = {
+        1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073,
+        4097, 6145, 8193, 12289, 16385, 24577};
+      static const uint8_t DISTANCE_EXTRA[30] = {
+        0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+      while (!failed) {
+        int symbol = decode(literalLength);
+        if (symbol < 256) {
+          out.push_back(symbol);
+        } else if (symbol == 256) {
+          return;
+        } else if (symbol - 257 < 29) {
+          symbol -= 257;
+          const uint32_t length = LENGTH_BASE[symbol] + bits(LENGTH_EXTRA[symbol]);
+          symbol = decode(distance);
+          if (symbol >= 30) {
+            failed = true;
+            return;
+          }
+          const uint32_t back = DISTANCE_BASE[symbol] + bits(DISTANCE_EXTRA[symbol]);
+          // a distance must not reach into the previous member
+          if (back > out.size() - memberStart) {
+            failed = true;
+            return;
+          }
+          for (uint32_t i = 0; i < length; ++i) {
+            out.push_back(out[out.size() - back]);
+          }
+        } else {
+          failed = true;
+        }
+      }
+    };
+
+    static void build(Huffman &huffman, const uint8_t *lengths, int symbols) {
+      uint16_t offsets[16];
+      for (int i = 0; i < 16; ++i) {
+        huffman.count[i] = 0;
+      }
+      for (int i = 0; i < symbols; ++i) {
+        huffman.count[lengths[i]]++;
+      }
+      offsets[1] = 0;
+      for (int i = 1; i < 15; ++i) {
+        offsets[i + 1] = offsets[i] + huffman.count[i];
+      }
+      for (int i = 0; i < symbols; ++i) {
+        if (lengths[i] != 0) {
+          huffman.symbol[offsets[lengths[i]]++] = i;
+        }
+      }
+    };
+
+    int decode(const Huffman &huffman) {
+      int code = 0;
+      int first = 0;
+      int index = 0;
+      for (int length = 1; length < 16; ++length) {
+        code |= bits(1);
+        const int count = huffman.count[length];
+        if (code - count < first) {
+          return huffman.symbol[index + (code - first)];
+        }
+        index += count;
+        first += count;
+        first <<= 1;
+        code <<= 1;
+      }
+      failed = true;
+      return 0;
+    };
+
+    uint32_t bits(int need) {
+      uint32_t value = bitBuffer & ((1u << bitCount) - 1);
+      while (bitCount < need) {
+        if (position == data.size()) {
+          failed = true;
+          return 0;
+        }
+        value |= (uint32_t) data[position++] << bitCount;
+        bitCount += 8;
+      }
+      bitBuffer = value >> need;
+      bitCount -= need;
+      return value & ((1u << need) - 1);
+    };
+
+    uint32_t read32() {
+      uint32_t value = 0;
+      for (int i = 0; i < 4; ++i) {
+        value |= (uint32_t) data[position++] << (8 * i);
+      }
+      return value;
+    };
+
+    static uint32_t crc32(const uint8_t *data, size_t size) {
+      uint32_t crc = 0xffffffff;
+      for (size_t i = 0; i < size; ++i) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; ++bit) {
+          crc = (crc >> 1) ^ (crc & 1 ? 0xedb88320 : 0);
+        }
+      }
+      return ~crc;
+    };
+
+    const std::vector<uint8_t> &data;
+    size_t position = 0;
+    size_t memberStart = 0;
+    uint32_t bitBuffer = 0;
+    int bitCount = 0;
+    bool failed = false;
+};
+
+static uint32_t nextRandom(uint32_t &random) {
+  random ^= random << 13;
+  random ^= random >> 17;
+  random ^= random << 5;
+  return random;
+}
+
+/* Lines shaped like the CSV of a ride with two sensors. */
+static std::string createTrack(size_t lines) {
+  std::string track = "OBSDataFormat=2&OBSFirmwareVersion=v0.3.999&DataPerMeasurement=3\n"
+    "Date;Time;Millis;Comment;Latitude;Longitude;Altitude;Course;Speed;HDOP;Satellites;BatteryLevel;"
+    "Left;Right;Confirmed;Marked;Invalid;InsidePrivacyArea;Factor;Measurements\n";
+  uint32_t random = 0x4f425321;
+  char text[64];
+  for (size_t line = 0; line < lines; ++line) {
+    snprintf(text, sizeof(text), "01.06.2021;07:%02u:%02u;%u;;48.%06u;9.%06u;%u.%u;",
+      (unsigned) (line / 60 % 60), (unsigned) (line % 60), (unsigned) (1000 * line + nextRandom(random) % 20),
+      (unsigned) (784270 + line * 3), (unsigned) (182335 + line * 2),
+      (unsigned) (240 + nextRandom(random) % 10), (unsigned) (nextRandom(random) % 10));
+    track += text;
+    track += "90.00;18.00;1.20;8;2.90;;177;0;;0;0;58.00;";
+    const uint32_t measurements = 40 + nextRandom(random) % 10;
+    track += std::to_string(measurements);
+    for (uint32_t measurement = 0; measurement < measurements; ++measurement) {
+      track += ";" + std::to_string(measurement * 1000 / measurements);
+      track += measurement % 2 ? ";;" : ";";
+      track += std::to_string(nextRandom(random) % 4 == 0 ? 18561 : 10000 + nextRandom(random) % 300);
+      track += measurement % 2 ? "" : ";";
+    }
+    track += "\n";
+  }
+  return track;
+}
+
+static void compress(const std::string &input, size_t chunk, size_t member, std::vector<uint8_t> &output) {
+  GzipCompressor *gzip = new GzipCompressor([&output](const uint8_t *data, size_t size) {
+    output.insert(output.end(), data, data + size);
+    return true;
+  });
+  size_t written = 0;
+  for (size_t position = 0; position < input.size(); position += chunk) {
+    const size_t size = std::min(chunk, input.size() - position);
+    TEST_ASSERT_TRUE(gzip->write((const uint8_t *) input.data() + position, size));
+    written += size;
+    if (member > 0 && written >= member) {
+      TEST_ASSERT_TRUE(gzip->finish());
+      written = 0;
+    }
+  }
+  TEST_ASSERT_TRUE(gzip->finish());
+  delete gzip;
+}
+
+static void assertRoundTrip(const std::string &input, size_t chunk, size_t member) {
+  std::vector<uint8_t> output;
+  compress(input, chunk, member, output);
+  std::vector<uint8_t> decoded;
+  Inflater inflater(output);
+  TEST_ASSERT_TRUE(inflater.gunzip(decoded));
+  TEST_ASSERT_EQUAL(input.size(), decoded.size());
+  TEST_ASSERT_TRUE(std::string(decoded.begin(), decoded.end()) == input);
+}
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+void test_track_round_trip(void) {
+  const std::string track = createTrack(2000);
+  const size_t chunks[] = {1, 700, 4096};
+  for (size_t chunk : chunks) {
+    assertRoundTrip(track, chunk, 0);
+    assertRoundTrip(track, chunk, 10000);
+  }
+}
+
+/* gzip tools read the members of a file as one, each ends with a sync. */
+void test_member_per_finish(void) {
+  const std::string track = createTrack(100);
+  std::vector<uint8_t> output;
+  compress(track, 512, 8192, output);
+  std::vector<uint8_t> decoded;
+  Inflater inflater(output);
+  TEST_ASSERT_TRUE(inflater.gunzip(decoded));
+  TEST_ASSERT_EQUAL((track.size() + 8191) / 8192, inflater.members);
+
+  // a member cut by a power loss is noticed
+  std::vector<uint8_t> cut(output.begin(), output.end() - 5);
+  Inflater cutInflater(cut);
+  decoded.clear();
+  TEST_ASSERT_FALSE(cutInflater.gunzip(decoded));
+}
+
+void test_random_and_repeated_data(void) {
+  std::string random(100000, ' ');
+  uint32_t state = 0x4f425321;
+  for (char &c : random) {
+    c = (char) nextRandom(state);
+  }
+  assertRoundTrip(random, 700, 0);
+  assertRoundTrip(std::string(100000, ';'), 700, 0);
+  assertRoundTrip("x", 1, 0);
+  // few symbols with very different frequencies need codes longer than 15 bit
+  std::string skewed;
+  uint32_t a = 1, b = 1;
+  for (char c = 'a'; c < 'a' + 25; ++c) {
+    skewed += std::string(std::min(a, (uint32_t) 5000), c);
+    const uint32_t next = a + b;
+    a = b;
+    b = next;
+  }
+  for (size_t idx = skewed.size() - 1; idx > 0; --idx) {
+    std::swap(skewed[idx], skewed[nextRandom(state) % (idx + 1)]);
+  }
+  assertRoundTrip(skewed, 700, 0);
+}
+
+void test_output_failure_is_reported(void) {
+  bool fail = true;
+  std::vector<uint8_t> output;
+  GzipCompressor *gzip = new GzipCompressor([&](const uint8_t *data, size_t size) {
+    output.insert(output.end(), data, data + size);
+    return !fail;
+  });
+  const std::string track = createTrack(10);
+  gzip->write((const uint8_t *) track.data(), track.size());
+  TEST_ASSERT_FALSE(gzip->finish());
+  fail = false;
+  output.clear();
+  gzip->reset();
+  TEST_ASSERT_TRUE(gzip->write((const uint8_t *) track.data(), track.size()));
+  TEST_ASSERT_TRUE(gzip->finish());
+  delete gzip;
+  std::vector<uint8_t> decoded;
+  Inflater inflater(output);
+  TEST_ASSERT_TRUE(inflater.gunzip(decoded));
+  TEST_ASSERT_EQUAL(track.size(), decoded.size());
+}
+
+void test_gzip_benchmark(void) {
+  const std::string track = createTrack(5000);
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<uint8_t> output;
+  compress(track, 700, 10000, output);
+  const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  printf("track bytes  gzip bytes  ratio  MB/s  compressor bytes\n");
+  printf("%11zu  %10zu  %5.2f  %4.1f  %16zu\n", track.size(), output.size(),
+    (double) track.size() / output.size(), track.size() / seconds / 1e6, sizeof(GzipCompressor));
+  TEST_ASSERT_GREATER_THAN(2 * output.size(), track.size());
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_track_round_trip);
+  RUN_TEST(test_member_per_finish);
+  RUN_TEST(test_random_and_repeated_data);
+  RUN_TEST(test_output_failure_is_reported);
+  RUN_TEST(test_gzip_benchmark);
+  UNITY_END();
+  return 0;
+}
@@ -0,0 +1,94 @@
+#include "unity.h"
+
+#define boolean bool
+#define MAX_SENSOR_VALUE 999
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "utils/median.h"
+
+/* Compares the incremental Median with the former implementation, which
+ * copied and sorted the window for every median() call, for the window
+ * sizes we might use. Like the firmware we ask for the median after every
+ * value. Both must give the same results.
+ */
+
+static const size_t SAMPLES = 100000;
+static const size_t WINDOW_SIZES[] = { 3, 5, 7, 9, 15, 21, 31, 45, 61 };
+
+template<typename T> class SortingMedian {
+  public:
+    explicit SortingMedian(size_t size) : size(size), data(size, MAX_SENSOR_VALUE), temp(size) {}
+    void addValue(T value) {
+      data[pos++] = value;
+      if (pos >= size) {
+        pos = 0;
+      }
+    }
+    T median() {
+      memcpy(temp.data(), data.data(), sizeof(T) * size);
+      std::sort(temp.begin(), temp.end());
+      return temp[size / 2];
+    }
+
+  private:
+    const size_t size;
+    std::vector<T> data;
+    std::vector<T> temp;
+    size_t pos = 0;
+};
+
+/* Distances as seen by a sensor, mostly a stable value with noise and
+ * some "no echo" readings.
+ */
+static std::vector<uint16_t> createSamples() {
+  std::vector<uint16_t> samples(SAMPLES);
+  uint32_t random = 0x4f425321;
+  for (auto &sample : samples) {
+    random ^= random << 13;
+    random ^= random >> 17;
+    random ^= random << 5;
+    sample = random % 10 == 0 ? MAX_SENSOR_VALUE : (uint16_t) (120 + random % 40);
+  }
+  return samples;
+}
+
+template<typename M> static double nanosPerSample(
+  size_t windowSize, const std::vector<uint16_t> &samples, std::vector<uint16_t> &medians) {
+  M median(windowSize);
+  const auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < samples.size(); ++i) {
+    median.addValue(samples[i]);
+    medians[i] = median.median();
+  }
+  const auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count() / samples.size();
+}
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+void test_median_benchmark(void) {
+  const std::vector<uint16_t> samples = createSamples();
+  std::vector<uint16_t> expected(samples.size());
+  std::vector<uint16_t> actual(samples.size());
+  printf("window  sort ns/sample  incremental ns/sample\n");
+  for (size_t windowSize : WINDOW_SIZES) {
+    const double sorting = nanosPerSample<SortingMedian<uint16_t>>(windowSize, samples, expected);
+    const double incremental = nanosPerSample<Median<uint16_t>>(windowSize, samples, actual);
+    printf("%6zu  %14.1f  %21.1f\n", windowSize, sorting, incremental);
+    TEST_ASSERT_TRUE(expected == actual);
+  }
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_median_benchmark);
+  UNITY_END();
+  return 0;
+}
@@ -0,0 +1,117 @@
+#include "unity.h"
+
+#include "utils/inlinevector.h"
+#include "utils/intervalring.h"
+
+/* Counts its instances to see construction and destruction by the ring. */
+struct Counted {
+  static int instances;
+  int value = 42;
+  Counted() {
+    instances++;
+  }
+  ~Counted() {
+    instances--;
+  }
+};
+int Counted::instances = 0;
+
+static const size_t INTERVALS = 3;
+static const uint32_t INTERVAL_MILLIS = 1000;
+
+void setUp(void) {
+  Counted::instances = 0;
+}
+
+void tearDown(void) {
+}
+
+void test_ring_constructs_and_destroys_intervals(void) {
+  {
+    IntervalRing<Counted, INTERVALS> ring(INTERVAL_MILLIS);
+    TEST_ASSERT_EQUAL(0, Counted::instances);
+    Counted* interval = ring.push(0);
+    TEST_ASSERT_NOT_NULL(interval);
+    TEST_ASSERT_EQUAL(1, Counted::instances);
+    TEST_ASSERT_EQUAL(42, interval->value);
+    interval->value = 7;
+    ring.pop();
+    TEST_ASSERT_EQUAL(0, Counted::instances);
+    // a reused slot starts fresh
+    TEST_ASSERT_EQUAL(42, ring.push(1000)->value);
+    ring.push(2000);
+  }
+  TEST_ASSERT_EQUAL(0, Counted::instances);
+}
+
+void test_full_ring_keeps_order(void) {
+  IntervalRing<Counted, INTERVALS> ring(INTERVAL_MILLIS);
+  for (int i = 0; i < 5; ++i) {
+    if (ring.full()) {
+      ring.pop();
+    }
+    ring.push(i * INTERVAL_MILLIS)->value = i;
+  }
+  TEST_ASSERT_TRUE(ring.full());
+  TEST_ASSERT_NULL(ring.push(5000));
+  TEST_ASSERT_EQUAL(2, ring.oldest()->value);
+  TEST_ASSERT_EQUAL(3, ring.at(1)->value);
+  TEST_ASSERT_EQUAL(4, ring.newest()->value);
+  TEST_ASSERT_EQUAL_UINT32(2000, ring.startMillis(0));
+}
+
+void test_find_interval_of_millis(void) {
+  IntervalRing<Counted, INTERVALS> ring(INTERVAL_MILLIS);
+  TEST_ASSERT_EQUAL(-1, ring.find(0));
+  ring.push(10000);
+  ring.push(11005);
+  // loop() took too long, one interval is missing
+  ring.push(13000);
+  TEST_ASSERT_EQUAL(-1, ring.find(9999));
+  TEST_ASSERT_EQUAL(0, ring.find(10000));
+  TEST_ASSERT_EQUAL(0, ring.find(11004));
+  TEST_ASSERT_EQUAL(1, ring.find(11005));
+  TEST_ASSERT_EQUAL(1, ring.find(12999));
+  TEST_ASSERT_EQUAL(2, ring.find(13000));
+  TEST_ASSERT_EQUAL(2, ring.find(60000));
+}
+
+void test_find_across_millis_overflow(void) {
+  IntervalRing<Counted, INTERVALS> ring(INTERVAL_MILLIS);
+  ring.push(UINT32_MAX - 1500);
+  ring.push(UINT32_MAX - 500);
+  ring.push(500);
+  TEST_ASSERT_EQUAL(0, ring.find(UINT32_MAX - 1000));
+  TEST_ASSERT_EQUAL(1, ring.find(UINT32_MAX));
+  TEST_ASSERT_EQUAL(1, ring.find(0));
+  TEST_ASSERT_EQUAL(2, ring.find(600));
+}
+
+void test_inline_vector_drops_values_when_full(void) {
+  InlineVector<uint16_t, 2> values;
+  TEST_ASSERT_TRUE(values.empty());
+  TEST_ASSERT_TRUE(values.push_back(1));
+  TEST_ASSERT_TRUE(values.push_back(2));
+  TEST_ASSERT_FALSE(values.push_back(3));
+  TEST_ASSERT_EQUAL(2, values.size());
+  TEST_ASSERT_EQUAL(1, values[0]);
+  TEST_ASSERT_EQUAL(2, values[1]);
+  int sum = 0;
+  for (uint16_t value : values) {
+    sum += value;
+  }
+  TEST_ASSERT_EQUAL(3, sum);
+  values.clear();
+  TEST_ASSERT_EQUAL(0, values.size());
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_ring_constructs_and_destroys_intervals);
+  RUN_TEST(test_full_ring_keeps_order);
+  RUN_TEST(test_find_interval_of_millis);
+  RUN_TEST(test_find_across_millis_overflow);
+  RUN_TEST(test_inline_vector_drops_values_when_full);
+  UNITY_END();
+  return 0;
+}
@@ -0,0 +1,169 @@
+/*
+  Copyright (C) 2019-2021 OpenBikeSensor Contributors
+  Contact: https://openbikesensor.org
+
+  This file is part of the OpenBikeSensor project.
+
+  The OpenBikeSensor sensor firmware is free software: you can redistribute
+  it and/or modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the License,
+  or (at your option) any later version.
+
+  The OpenBikeSensor sensor firmware is distributed in the hope that it will
+  be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+  Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with
+  the OpenBikeSensor sensor firmware.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <unity.h>
+
+#include <Arduino.h>
+#include <sim.h>
+
+#include "sensor.h"
+
+/* Runs the trigger schedule of the sensor manager in the host simulation
+ * without the firmware around.
+ */
+
+static const uint64_t RUN_MICROS = 2000000;
+static const uint8_t BACK_SENSOR_ID = 2;
+
+static HCSR04SensorManager* manager;
+
+static void addSensor(uint8_t triggerPin, uint8_t echoPin, uint16_t cm, const char *location,
+                      int crossTalkFrom = -1) {
+  sim::UltrasonicSensor sensor;
+  sensor.triggerPin = triggerPin;
+  sensor.echoPin = echoPin;
+  sensor.distance = [cm](uint64_t) { return cm; };
+  sensor.crossTalkFrom = crossTalkFrom;
+  sim::addUltrasonicSensor(sensor);
+
+  HCSR04SensorInfo info;
+  info.triggerPin = triggerPin;
+  info.echoPin = echoPin;
+  info.sensorLocation = (char*) location;
+  manager->registerSensor(info);
+}
+
+void setUp() {
+  sim::reset();
+  manager = new HCSR04SensorManager;
+}
+
+void tearDown() {
+  delete manager;
+}
+
+/* Triggers for RUN_MICROS and returns the readings per sensor. */
+static std::vector<uint32_t> run() {
+  std::vector<uint32_t> readings(manager->m_sensors.size(), 0);
+  manager->reset(nullptr);
+  const uint64_t end = sim::micros() + RUN_MICROS;
+  while (sim::micros() < end) {
+    manager->getDistances();
+    while (manager->processNextReading(0)) {
+    }
+  }
+  for (size_t idx = 0; idx < readings.size(); ++idx) {
+    readings[idx] = manager->m_sensors[idx].numberOfReadings;
+  }
+  return readings;
+}
+
+/* Left and right see a car, the sensor facing backwards a bike following
+ * us. */
+static void addThreeSensors() {
+  addSensor(15, 4, 150, "Right");
+  addSensor(25, 26, 120, "Left");
+  addSensor(32, 33, 100, "Back");
+}
+
+void test_one_group_triggers_in_turn() {
+  addThreeSensors();
+  const std::vector<uint32_t> readings = run();
+  for (size_t idx = 0; idx < readings.size(); ++idx) {
+    TEST_ASSERT_GREATER_THAN_UINT32(20, readings[idx]);
+  }
+  // all sensors see an object, they get the same share of the schedule
+  TEST_ASSERT_UINT32_WITHIN(2, readings[0], readings[1]);
+  TEST_ASSERT_UINT32_WITHIN(2, readings[0], readings[BACK_SENSOR_ID]);
+  TEST_ASSERT_EQUAL_UINT32(0, manager->lostReadings);
+}
+
+void test_separate_group_measures_in_parallel() {
+  addThreeSensors();
+  const std::vector<uint32_t> shared = run();
+  manager->setInterferenceGroups({0, 0, 1});
+  const std::vector<uint32_t> separate = run();
+
+  // the back sensor does not wait for the others any more, the others
+  // keep their rate
+  TEST_ASSERT_GREATER_THAN_UINT32(shared[BACK_SENSOR_ID] * 4 / 3, separate[BACK_SENSOR_ID]);
+  TEST_ASSERT_GREATER_OR_EQUAL(shared[0], separate[0]);
+  TEST_ASSERT_GREATER_OR_EQUAL(shared[1], separate[1]);
+  TEST_ASSERT_EQUAL_UINT32(0, manager->lostReadings);
+}
+
+/* In turn each sensor waits for the echos of the others, in parallel
+ * only for its own. */
+void test_parallel_trigger_adds_readings() {
+  addThreeSensors();
+  const std::vector<uint32_t> alternating = run();
+  manager->setParallelTrigger(true);
+  const std::vector<uint32_t> parallel = run();
+
+  // the right sensor is limited by its own echo of the car
+  TEST_ASSERT_UINT32_WITHIN(3, alternating[0], parallel[0]);
+  TEST_ASSERT_GREATER_THAN_UINT32(alternating[1] * 11 / 10, parallel[1]);
+  TEST_ASSERT_GREATER_THAN_UINT32(alternating[BACK_SENSOR_ID] * 4 / 3, parallel[BACK_SENSOR_ID]);
+}
+
+/* The burst of the right sensor reaches the left sensor, which has
+ * nothing in sight. All echos the left sensor sees are cross-talk.
+ */
+void test_parallel_trigger_rejects_cross_talk() {
+  addSensor(15, 4, 60, "Right");
+  addSensor(25, 26, 0, "Left", 0);
+  manager->setParallelTrigger(true);
+  const std::vector<uint32_t> readings = run();
+
+  TEST_ASSERT_GREATER_THAN_UINT32(20, sim::statistics().crossTalkEchos);
+  TEST_ASSERT_GREATER_THAN_UINT32(20, manager->rejectedReadings);
+  TEST_ASSERT_GREATER_THAN_UINT32(50, readings[0]);
+  TEST_ASSERT_UINT16_WITHIN(1, 60, manager->m_sensors[0].minDistance);
+  TEST_ASSERT_EQUAL_UINT16(MAX_SENSOR_VALUE, manager->m_sensors[1].minDistance);
+}
+
+void test_health_counts_echos() {
+  addSensor(15, 4, 150, "Right");
+  addSensor(25, 26, 0, "Left");
+  run();
+
+  const SensorHealth &right = manager->m_sensors[0].health;
+  TEST_ASSERT_GREATER_THAN_UINT32(50, right.triggers);
+  // the last trigger might still wait for its echo
+  TEST_ASSERT_UINT32_WITHIN(1, right.triggers, right.echos);
+  TEST_ASSERT_EQUAL_UINT32(0, right.noEchos);
+  TEST_ASSERT_EQUAL_UINT32(right.echos,
+    right.echoHistogram[sim::echoMicrosForDistance(150) / ECHO_HISTOGRAM_BUCKET_MICRO_SEC]);
+  TEST_ASSERT_EQUAL_UINT32(0, right.lostEdges);
+
+  const SensorHealth &left = manager->m_sensors[1].health;
+  TEST_ASSERT_GREATER_THAN_UINT32(10, left.triggers);
+  TEST_ASSERT_EQUAL_UINT32(0, left.echos);
+  TEST_ASSERT_UINT32_WITHIN(1, left.triggers, left.noEchos);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_one_group_triggers_in_turn);
+  RUN_TEST(test_separate_group_measures_in_parallel);
+  RUN_TEST(test_parallel_trigger_adds_readings);
+  RUN_TEST(test_parallel_trigger_rejects_cross_talk);
+  RUN_TEST(test_health_counts_echos);
+  return UNITY_END();
+}
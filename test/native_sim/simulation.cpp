@@ -0,0 +1,472 @@
+/*
+  Copyright (C) 2019-2021 OpenBikeSensor Contributors
+  Contact: https://openbikesensor.org
+
+  This file is part of the OpenBikeSensor project.
+
+  The OpenBikeSensor sensor firmware is free software: you can redistribute
+  it and/or modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the License,
+  or (at your option) any later version.
+
+  The OpenBikeSensor sensor firmware is distributed in the hope that it will
+  be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+  Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with
+  the OpenBikeSensor sensor firmware.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <unity.h>
+
+#include <Arduino.h>
+#include <SD.h>
+
+#include "config.h"
+#include "sensor.h"
+#include "trackcatalog.h"
+#include "writer.h"
+#include "utils/intervalring.h"
+#include "utils/varint.h"
+
+/* Runs setup() and loop() of the firmware in the host simulation on a
+ * short scripted ride, the right sensor sees a wall, the left sensor a
+ * car passing every 10 seconds.
+ */
+
+void setup();
+void loop();
+extern HCSR04SensorManager* sensorManager;
+extern FileWriter* writer;
+extern IntervalRing<DataSet, DATA_BUFFER_SIZE> intervals;
+
+static const uint16_t RIGHT_DISTANCE_CM = 180;
+static const uint16_t LEFT_DISTANCE_CM = 120;
+static const uint16_t CLOSE_DISTANCE_CM = 40;
+static const uint16_t DEFAULT_OFFSET_CM = 35;
+static const uint8_t BATTERY_PIN = 34;
+
+static uint32_t loops = 0;
+static uint32_t leftTriggersBeforeLoop = 0;
+static uint32_t rightTriggersBeforeLoop = 0;
+/* Both sensors see an object right beside the bike. */
+static bool closeObjects = false;
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+static String findTrackFile(const char *extension = ".obsdata.csv") {
+  File root = SD.open("/");
+  File file = root.openNextFile();
+  while (file) {
+    const String name = file.name();
+    file.close();
+    if (name.endsWith(extension)) {
+      return name;
+    }
+    file = root.openNextFile();
+  }
+  return String();
+}
+
+static String csvField(const String &line, int column) {
+  int start = 0;
+  for (int i = 0; i < column && start >= 0; ++i) {
+    start = line.indexOf(';', start);
+    if (start >= 0) {
+      start++;
+    }
+  }
+  if (start < 0) {
+    return String();
+  }
+  const int end = line.indexOf(';', start);
+  return end < 0 ? line.substring(start) : line.substring(start, end);
+}
+
+void test_setup_completes_with_gps_fix() {
+  sim::reset();
+  sim::setAnalogValue(BATTERY_PIN, 2400);
+
+  sim::UltrasonicSensor right;
+  right.triggerPin = 15;
+  right.echoPin = 4;
+  right.distance = [](uint64_t) { return closeObjects ? CLOSE_DISTANCE_CM : RIGHT_DISTANCE_CM; };
+  sim::addUltrasonicSensor(right);
+
+  sim::UltrasonicSensor left;
+  left.triggerPin = 25;
+  left.echoPin = 26;
+  left.distance = [](uint64_t micros) {
+    if (closeObjects) {
+      return CLOSE_DISTANCE_CM;
+    }
+    return (uint16_t) (micros % 10000000 < 600000 ? LEFT_DISTANCE_CM : 0);
+  };
+  sim::addUltrasonicSensor(left);
+
+  setup();
+
+  TEST_ASSERT_LESS_THAN_UINT32(10000, millis());
+  rightTriggersBeforeLoop = sim::statistics().triggers[0];
+  leftTriggersBeforeLoop = sim::statistics().triggers[1];
+}
+
+void test_loop_flushes_track_file() {
+  // the track is synced every trackSyncSeconds
+  const uint64_t end = sim::micros() + (2 * config.trackSyncSeconds + 5) * 1000000ULL;
+  while (sim::micros() < end) {
+    loop();
+    loops++;
+  }
+  TEST_ASSERT_EQUAL_UINT32(0, writer->getStatistics().droppedAppends);
+  const String fileName = findTrackFile();
+  TEST_ASSERT_FALSE(fileName.isEmpty());
+
+  File file = SD.open(fileName);
+  TEST_ASSERT_TRUE(file.readStringUntil('\n').startsWith("OBSDataFormat=3&"));
+  TEST_ASSERT_TRUE(file.readStringUntil('\n').startsWith("Date;Time;Millis;Comment;"));
+
+  // the firmware truncates the distance, so allow 1cm less
+  int rows = 0;
+  int rowsWithCar = 0;
+  int rowsWithWall = 0;
+  int events = 0;
+  while (file.available()) {
+    const String line = file.readStringUntil('\n');
+    if (csvField(line, 3).startsWith("Event=")) {
+      events++;
+      continue;
+    }
+    rows++;
+    if (abs(csvField(line, 12).toInt() - (LEFT_DISTANCE_CM - DEFAULT_OFFSET_CM)) <= 1) {
+      rowsWithCar++;
+    }
+    if (abs(csvField(line, 13).toInt() - (RIGHT_DISTANCE_CM - DEFAULT_OFFSET_CM)) <= 1) {
+      rowsWithWall++;
+    }
+  }
+  file.close();
+  // events are part of the binary track only
+  TEST_ASSERT_EQUAL(0, events);
+  TEST_ASSERT_GREATER_THAN(10, rows);
+  // the first interval starts without a measurement
+  TEST_ASSERT_GREATER_OR_EQUAL(rows - 1, rowsWithWall);
+  TEST_ASSERT_GREATER_OR_EQUAL(rows / 10, rowsWithCar);
+  // the PUBX and UBX configuration is sent after some NMEA sentences
+  TEST_ASSERT_GREATER_THAN_UINT32(0, sim::gpsModuleReceived().size());
+}
+
+/* The intervals live in their ring and the timelines in the arena, a
+ * loop() takes nothing from the heap, neither do the tasks it feeds.
+ */
+void test_loop_does_not_allocate() {
+  const uint64_t allocations = sim::heapAllocations();
+  for (int i = 0; i < 3 * config.trackSyncSeconds; ++i) {
+    loop();
+    loops++;
+  }
+  TEST_ASSERT_EQUAL_UINT64(allocations, sim::heapAllocations());
+}
+
+/* Lower bound of what the measurement task achieves today, a drop points
+ * to new blocking code in the task. The left sensor mostly sees nothing,
+ * its echo pin stays high for 58ms then. The wall seen by the right
+ * sensor allows a shorter schedule.
+ */
+void test_measurements_per_interval() {
+  TEST_ASSERT_GREATER_THAN_UINT32(0, loops);
+  const uint32_t leftTriggers = sim::statistics().triggers[1] - leftTriggersBeforeLoop;
+  TEST_ASSERT_GREATER_OR_EQUAL(14, leftTriggers / loops);
+  const uint32_t rightTriggers = sim::statistics().triggers[0] - rightTriggersBeforeLoop;
+  TEST_ASSERT_GREATER_OR_EQUAL(25, rightTriggers / loops);
+}
+
+/* Display refresh, GPS and SD writes in loop() must not delay a trigger. */
+void test_trigger_jitter_independent_of_loop() {
+  for (int i = 0; i < 5; ++i) {
+    loop();
+    TEST_ASSERT_LESS_THAN_UINT32(1000, sensorManager->getMaxTriggerJitterMicroseconds());
+  }
+  TEST_ASSERT_EQUAL_UINT32(0, sensorManager->lostReadings);
+}
+
+/* The writer task waits for the card, loop() keeps its interval even if
+ * a write of a buffer takes most of a second. */
+void test_slow_card_does_not_delay_loop() {
+  const uint32_t microsPerKiB = sim::costs().sdMicrosPerKiB;
+  sim::costs().sdMicrosPerKiB = 200000;
+  const uint32_t writes = writer->getStatistics().writes;
+  for (int i = 0; i < 20; ++i) {
+    const uint64_t start = sim::micros();
+    loop();
+    TEST_ASSERT_LESS_THAN_UINT64(1100000, sim::micros() - start);
+  }
+  sim::costs().sdMicrosPerKiB = microsPerKiB;
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(writes + 2, writer->getStatistics().writes);
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(500, writer->getStatistics().maxWriteMillis);
+  TEST_ASSERT_EQUAL_UINT32(0, writer->getStatistics().droppedAppends);
+}
+
+/* At 0 degree a fixed factor of 58us/cm would report the wall 6cm too far. */
+void test_distance_compensates_temperature() {
+  sim::setAmbientTemperature(0.0);
+  loop();
+  loop();
+  TEST_ASSERT_FLOAT_WITHIN(0.1, 60.3, sensorManager->getMicrosecondsPerCm());
+  TEST_ASSERT_UINT16_WITHIN(1, RIGHT_DISTANCE_CM - DEFAULT_OFFSET_CM, sensorManager->m_sensors[0].distance);
+}
+
+/* With close objects both sensors are triggered at the highest rate, the
+ * timelines of all intervals waiting for a confirmation keep each reading.
+ */
+void test_full_ring_keeps_all_readings() {
+  closeObjects = true;
+  const uint32_t droppedRecords = sensorManager->droppedRecords;
+  for (size_t i = 0; i < 2 * DATA_BUFFER_SIZE; ++i) {
+    loop();
+  }
+  closeObjects = false;
+  // the ring was full, loop() wrote the oldest interval at its end
+  TEST_ASSERT_EQUAL_UINT32(DATA_BUFFER_SIZE - 1, intervals.size());
+  TEST_ASSERT_EQUAL_UINT32(droppedRecords, sensorManager->droppedRecords);
+  TEST_ASSERT_EQUAL_UINT32(0, sensorManager->lostReadings);
+  // the newest interval, all readings are in its timeline
+  const DataSet* set = intervals.newest();
+  TEST_ASSERT_EQUAL_UINT32(sensorManager->m_sensors[0].numberOfReadings
+    + sensorManager->m_sensors[1].numberOfReadings, set->timeline.size());
+  for (size_t idx = 0; idx < 2; ++idx) {
+    TEST_ASSERT_UINT32_WITHIN(2, 1000 * 1000 / MIN_TRIGGER_PERIOD_MICRO_SEC,
+      sensorManager->m_sensors[idx].numberOfReadings);
+  }
+}
+
+/* Without power only what was synced is left on the card, the last sync
+ * is at most trackSyncSeconds ago and the track ends with a complete line.
+ */
+void test_power_loss_costs_one_sync_window() {
+  const uint64_t end = sim::micros() + 30 * 1000000ULL;
+  uint32_t syncs = writer->getStatistics().syncs;
+  uint32_t syncMillis = millis();
+  while (sim::micros() < end) {
+    loop();
+    if (writer->getStatistics().syncs != syncs) {
+      syncs = writer->getStatistics().syncs;
+      syncMillis = millis();
+    }
+  }
+  TEST_ASSERT_LESS_THAN_UINT32((config.trackSyncSeconds + 2) * 1000, millis() - syncMillis);
+  sim::loseUnsyncedSdData();
+
+  File file = SD.open(findTrackFile());
+  TEST_ASSERT_TRUE(file.readStringUntil('\n').startsWith("OBSDataFormat=3&"));
+  TEST_ASSERT_TRUE(file.seek(file.size() - 1));
+  TEST_ASSERT_EQUAL('\n', file.read());
+  file.close();
+}
+
+/* The writer keeps the entry of its track in the catalog up to the last
+ * sync. */
+void test_catalog_holds_the_track() {
+  const uint32_t count = TrackCatalog::count();
+  TEST_ASSERT_GREATER_THAN_UINT32(0, count);
+  TrackEntry entry;
+  TEST_ASSERT_EQUAL_UINT32(1, TrackCatalog::read(count - 1, &entry, 1));
+  const String fileName = findTrackFile();
+  TEST_ASSERT_EQUAL_STRING(fileName.c_str(), entry.name);
+  TEST_ASSERT_EQUAL(TrackEntry::RECORDING, entry.state);
+  TEST_ASSERT_EQUAL_UINT32(SD.open(fileName).size(), entry.size);
+  TEST_ASSERT_GREATER_THAN_UINT32(10, entry.records);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(entry.endTime, entry.startTime);
+  TEST_ASSERT_GREATER_THAN_UINT32(entry.number, TrackCatalog::nextTrackNumber());
+}
+
+static void writeFile(const char *path, const char *data, size_t size) {
+  File file = SD.open(path, FILE_WRITE);
+  file.write((const uint8_t *) data, size);
+  file.close();
+}
+
+static String readFile(const char *path) {
+  File file = SD.open(path);
+  String content;
+  while (file.available()) {
+    content += (char) file.read();
+  }
+  file.close();
+  return content;
+}
+
+/* The part of the last record written before the power loss is cut. */
+void test_boot_recovers_unfinished_track() {
+  writeFile("/unfinished.obsdata.csv", "a;b\n1;2\n3;", 10);
+  writeFile("/unfinished.txt", "/unfinished.obsdata.csv", 23);
+  TEST_ASSERT_TRUE(FileWriter::recoverUnfinishedTrack());
+  TEST_ASSERT_FALSE(SD.exists("/unfinished.txt"));
+  TEST_ASSERT_TRUE(readFile("/unfinished.obsdata.csv") == "a;b\n1;2\n");
+  TEST_ASSERT_FALSE(FileWriter::recoverUnfinishedTrack());
+
+  // header with metadata "m" and one sensor "L", a record of 2 bytes, then
+  // one announcing 5 bytes of which only 3 were written
+  const char binary[] = "OBSB\x01\x01m\x01\x01L\x02xy\x05abc";
+  writeFile("/unfinished.obsdata.bin", binary, sizeof(binary) - 1);
+  writeFile("/unfinished.txt", "/unfinished.obsdata.bin", 23);
+  TEST_ASSERT_TRUE(FileWriter::recoverUnfinishedTrack());
+  TEST_ASSERT_EQUAL(13, SD.open("/unfinished.obsdata.bin").size());
+
+  // the header is not complete
+  writeFile("/unfinished.obsdata.bin", binary, 8);
+  writeFile("/unfinished.txt", "/unfinished.obsdata.bin", 23);
+  TEST_ASSERT_TRUE(FileWriter::recoverUnfinishedTrack());
+  TEST_ASSERT_FALSE(SD.exists("/unfinished.obsdata.bin"));
+
+  // a gzip track keeps the members complete at the last sync
+  writeFile("/unfinished.obsdata.csv.gz", "member1member2mem", 17);
+  writeFile("/unfinished.txt", "/unfinished.obsdata.csv.gz\n14", 29);
+  TEST_ASSERT_TRUE(FileWriter::recoverUnfinishedTrack());
+  TEST_ASSERT_TRUE(readFile("/unfinished.obsdata.csv.gz") == "member1member2");
+
+  // the marker of an older firmware has no size
+  writeFile("/unfinished.obsdata.csv.gz", "member1member2mem", 17);
+  writeFile("/unfinished.txt", "/unfinished.obsdata.csv.gz", 26);
+  TEST_ASSERT_FALSE(FileWriter::recoverUnfinishedTrack());
+  TEST_ASSERT_EQUAL(17, SD.open("/unfinished.obsdata.csv.gz").size());
+}
+
+/* Records of a binary track without their length, the header skipped. */
+static std::vector<std::vector<uint8_t>> readBinaryRecords(const String &path) {
+  std::vector<uint8_t> track;
+  File file = SD.open(path);
+  while (file.available()) {
+    track.push_back((uint8_t) file.read());
+  }
+  file.close();
+  std::vector<std::vector<uint8_t>> records;
+  size_t pos = 5; // magic and version
+  uint32_t length;
+  pos += Varint::decode(&track[pos], track.size() - pos, length) + length; // metadata
+  uint8_t sensors = track[pos++];
+  while (sensors-- > 0) {
+    pos += Varint::decode(&track[pos], track.size() - pos, length) + length;
+  }
+  while (pos < track.size()) {
+    const size_t lengthSize = Varint::decode(&track[pos], track.size() - pos, length);
+    TEST_ASSERT_GREATER_THAN(0, lengthSize);
+    records.emplace_back(&track[pos + lengthSize], &track[pos + lengthSize + length]);
+    pos += lengthSize + length;
+  }
+  return records;
+}
+
+/* Records of the kind FLAG_ECHO, FLAG_EVENT or FLAG_FIX. */
+static int countRecords(const std::vector<std::vector<uint8_t>> &records, uint8_t kind) {
+  int count = 0;
+  for (const auto &record : records) {
+    if (!record.empty() && (record[0] & BinaryFileWriter::FLAG_FIX) == kind) {
+      count++;
+    }
+  }
+  return count;
+}
+
+/* Raw echoes of an interval hidden by a privacy area are not written. */
+void test_raw_echoes_hidden_in_privacy_area() {
+  const int privacyConfig = config.privacyConfig;
+  config.privacyConfig = AbsolutePrivacy;
+  DataSet hidden;
+  hidden.isInsidePrivacyArea = true;
+  DataSet visible;
+
+  auto *binaryWriter = new BinaryFileWriter(false, true);
+  binaryWriter->setFileName();
+  binaryWriter->writeHeader("test");
+  binaryWriter->appendEcho(visible, 1000, 0, 5000);
+  binaryWriter->appendEcho(hidden, 1020, 0, 5000);
+  binaryWriter->appendEcho(hidden, 1040, 1, 5000);
+  binaryWriter->appendEcho(visible, 1060, 1, 5000);
+  delete binaryWriter;
+  config.privacyConfig = privacyConfig;
+
+  const String fileName = findTrackFile(".obsdata.bin");
+  TEST_ASSERT_FALSE(fileName.isEmpty());
+  TEST_ASSERT_EQUAL(2, countRecords(readBinaryRecords(fileName), BinaryFileWriter::FLAG_ECHO));
+  SD.remove(fileName);
+}
+
+static NavPvt navPvtAt(int32_t latitude, int32_t longitude) {
+  NavPvt pvt;
+  pvt.fixType = 3;
+  pvt.gnssFixOk = true;
+  pvt.satellites = 8;
+  pvt.latitude = latitude;
+  pvt.longitude = longitude;
+  pvt.groundSpeed = 5000;
+  pvt.positionDop = 120;
+  return pvt;
+}
+
+/* All fixes of the GPS module at 5 Hz reach the track, a confirmation
+ * refers to the one nearest to its minimum. */
+void test_every_fix_reaches_the_track() {
+  DataSet set;
+  set.setGpsValues(navPvtAt(487842700, 91234500));
+  set.millis = 1000;
+
+  auto *binaryWriter = new BinaryFileWriter(false, false);
+  binaryWriter->setFileName();
+  binaryWriter->writeHeader("test");
+  for (uint32_t millis = 1000; millis < 2000; millis += 200) {
+    binaryWriter->appendFix(set, navPvtAt(487842700 + (int32_t) millis, 91234500), millis, false);
+  }
+  // the minimum was 450ms after the start of the interval, the fix at 1400 is nearest
+  binaryWriter->appendEvent({set.time, set.millis, 3, 84, TrackEvent::CONFIRM, 1450});
+  // no fix during the last second
+  binaryWriter->appendEvent({set.time, set.millis, 4, 84, TrackEvent::CONFIRM, 3500});
+  binaryWriter->append(set);
+  delete binaryWriter;
+
+  const String fileName = findTrackFile(".obsdata.bin");
+  TEST_ASSERT_FALSE(fileName.isEmpty());
+  const auto records = readBinaryRecords(fileName);
+  TEST_ASSERT_EQUAL(8, records.size());
+  TEST_ASSERT_EQUAL(5, countRecords(records, BinaryFileWriter::FLAG_FIX));
+  TEST_ASSERT_EQUAL(2, countRecords(records, BinaryFileWriter::FLAG_EVENT));
+  const std::vector<uint8_t> &confirm = records[5];
+  TEST_ASSERT_EQUAL(BinaryFileWriter::FLAG_EVENT | BinaryFileWriter::FLAG_POSITION, confirm[0]);
+  TEST_ASSERT_EQUAL(TrackEvent::CONFIRM, confirm[1]);
+  size_t pos = 2;
+  int32_t time, millis, fixMillis;
+  uint32_t index, value;
+  pos += Varint::decodeSigned(&confirm[pos], confirm.size() - pos, time);
+  pos += Varint::decodeSigned(&confirm[pos], confirm.size() - pos, millis);
+  pos += Varint::decode(&confirm[pos], confirm.size() - pos, index);
+  pos += Varint::decode(&confirm[pos], confirm.size() - pos, value);
+  pos += Varint::decodeSigned(&confirm[pos], confirm.size() - pos, fixMillis);
+  TEST_ASSERT_EQUAL(confirm.size(), pos);
+  TEST_ASSERT_EQUAL(1000, millis);
+  TEST_ASSERT_EQUAL(3, index);
+  TEST_ASSERT_EQUAL(400, fixMillis);
+  TEST_ASSERT_EQUAL(BinaryFileWriter::FLAG_EVENT, records[6][0]);
+  SD.remove(fileName);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_setup_completes_with_gps_fix);
+  RUN_TEST(test_loop_flushes_track_file);
+  RUN_TEST(test_loop_does_not_allocate);
+  RUN_TEST(test_measurements_per_interval);
+  RUN_TEST(test_trigger_jitter_independent_of_loop);
+  RUN_TEST(test_slow_card_does_not_delay_loop);
+  RUN_TEST(test_distance_compensates_temperature);
+  RUN_TEST(test_full_ring_keeps_all_readings);
+  RUN_TEST(test_power_loss_costs_one_sync_window);
+  RUN_TEST(test_catalog_holds_the_track);
+  RUN_TEST(test_boot_recovers_unfinished_track);
+  RUN_TEST(test_raw_echoes_hidden_in_privacy_area);
+  RUN_TEST(test_every_fix_reaches_the_track);
+  return UNITY_END();
+}
@@ -0,0 +1,73 @@
+#include "unity.h"
+
+#include <thread>
+
+#include "utils/snapshot.h"
+
+/* Both halves are written one after the other, a torn read differs. */
+struct Pair {
+  uint32_t first;
+  uint32_t second;
+};
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+void test_update_takes_last_published_value(void) {
+  Snapshot<Pair> snapshot;
+  TEST_ASSERT_FALSE(snapshot.update());
+  snapshot.writable() = { 1, 1 };
+  snapshot.publish();
+  snapshot.writable() = { 2, 2 };
+  snapshot.publish();
+  TEST_ASSERT_TRUE(snapshot.update());
+  TEST_ASSERT_EQUAL_UINT32(2, snapshot.latest().first);
+  TEST_ASSERT_FALSE(snapshot.update());
+  TEST_ASSERT_EQUAL_UINT32(2, snapshot.latest().first);
+  snapshot.writable() = { 3, 3 };
+  snapshot.publish();
+  TEST_ASSERT_TRUE(snapshot.update());
+  TEST_ASSERT_EQUAL_UINT32(3, snapshot.latest().first);
+}
+
+void test_consumer_never_sees_torn_values(void) {
+  Snapshot<Pair> snapshot;
+  const uint32_t values = 200000;
+  std::thread producer([&snapshot]() {
+    for (uint32_t value = 1; value <= values; ++value) {
+      Pair &pair = snapshot.writable();
+      pair.first = value;
+      pair.second = value;
+      snapshot.publish();
+    }
+  });
+  uint32_t last = 0;
+  uint32_t torn = 0;
+  uint32_t backwards = 0;
+  while (last < values) {
+    if (snapshot.update()) {
+      const Pair &pair = snapshot.latest();
+      if (pair.first != pair.second) {
+        torn++;
+      }
+      if (pair.first <= last) {
+        backwards++;
+      }
+      last = pair.first;
+    }
+  }
+  producer.join();
+  TEST_ASSERT_EQUAL_UINT32(0, torn);
+  TEST_ASSERT_EQUAL_UINT32(0, backwards);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_update_takes_last_published_value);
+  RUN_TEST(test_consumer_never_sees_torn_values);
+  UNITY_END();
+  return 0;
+}
@@ -0,0 +1,76 @@
+#include "unity.h"
+
+#include "utils/timeline.h"
+
+static const size_t CHUNKS = 3;
+static TimelineArena::Chunk storage[CHUNKS];
+static TimelineArena* arena;
+
+void setUp(void) {
+  arena = new TimelineArena(storage, CHUNKS);
+}
+
+void tearDown(void) {
+  delete arena;
+}
+
+static TimelineRecord record(uint16_t offset) {
+  return { offset, (uint8_t) (offset % 2), (int32_t) offset * 58 };
+}
+
+void test_timeline_grows_over_chunks(void) {
+  Timeline timeline(arena);
+  for (uint16_t i = 0; i < 2 * TimelineArena::RECORDS_PER_CHUNK + 1; ++i) {
+    TEST_ASSERT_TRUE(timeline.push(record(i)));
+  }
+  TEST_ASSERT_EQUAL(2 * TimelineArena::RECORDS_PER_CHUNK + 1, timeline.size());
+  TEST_ASSERT_EQUAL(0, arena->available());
+
+  uint16_t expected = 0;
+  for (const TimelineRecord &r : timeline) {
+    TEST_ASSERT_EQUAL(expected, r.offsetMilliseconds);
+    TEST_ASSERT_EQUAL(expected % 2, r.sensorId);
+    TEST_ASSERT_EQUAL(expected * 58, r.echoDurationMicroseconds);
+    expected++;
+  }
+  TEST_ASSERT_EQUAL(timeline.size(), expected);
+}
+
+void test_full_arena_drops_records(void) {
+  Timeline timeline(arena);
+  for (uint16_t i = 0; i < CHUNKS * TimelineArena::RECORDS_PER_CHUNK; ++i) {
+    TEST_ASSERT_TRUE(timeline.push(record(i)));
+  }
+  TEST_ASSERT_FALSE(timeline.push(record(0)));
+  TEST_ASSERT_EQUAL(CHUNKS * TimelineArena::RECORDS_PER_CHUNK, timeline.size());
+
+  timeline.clear();
+  TEST_ASSERT_EQUAL(CHUNKS, arena->available());
+  TEST_ASSERT_TRUE(timeline.empty());
+  TEST_ASSERT_FALSE(timeline.begin() != timeline.end());
+}
+
+void test_move_hands_over_records(void) {
+  Timeline source(arena);
+  source.push(record(1));
+  source.push(record(2));
+  {
+    Timeline target(arena);
+    target.push(record(3));
+    target = std::move(source);
+    TEST_ASSERT_EQUAL(2, target.size());
+    TEST_ASSERT_EQUAL(0, source.size());
+    TEST_ASSERT_EQUAL(CHUNKS - 1, arena->available());
+    TEST_ASSERT_EQUAL(1, (*target.begin()).offsetMilliseconds);
+  }
+  TEST_ASSERT_EQUAL(CHUNKS, arena->available());
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_timeline_grows_over_chunks);
+  RUN_TEST(test_full_arena_drops_records);
+  RUN_TEST(test_move_hands_over_records);
+  UNITY_END();
+  return 0;
+}
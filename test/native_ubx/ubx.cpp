@@ -0,0 +1,151 @@
+#include "unity.h"
+
+#include <string>
+#include <vector>
+
+#include "utils/ubx.h"
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+static const char NMEA[] =
+  "$GPGGA,123456.00,4847.05623,N,00910.97580,E,1,09,1.10,245.1,M,47.9,M,,*5C\r\n";
+
+/* As sent by a NEO-M8 at 2024-05-01 12:34:56 UTC. */
+static const uint8_t NAV_PVT[] = {
+  0xb5, 0x62, 0x01, 0x07, 0x5c, 0x00, 0xd0, 0x40, 0x28, 0x17, 0xe8, 0x07, 0x05, 0x01, 0x0c, 0x22,
+  0x38, 0x07, 0x19, 0x00, 0x00, 0x00, 0xc0, 0x1d, 0xfe, 0xff, 0x03, 0x01, 0xea, 0x09, 0x34, 0x34,
+  0x79, 0x05, 0x91, 0xe3, 0x13, 0x1d, 0x4b, 0x6d, 0x04, 0x00, 0x83, 0xbd, 0x03, 0x00, 0xac, 0x0d,
+  0x00, 0x00, 0x50, 0x14, 0x00, 0x00, 0x50, 0xfb, 0xff, 0xff, 0x04, 0x10, 0x00, 0x00, 0x1e, 0x00,
+  0x00, 0x00, 0xb4, 0x15, 0x00, 0x00, 0x4e, 0x61, 0xbc, 0x00, 0x90, 0x01, 0x00, 0x00, 0xf0, 0x49,
+  0x02, 0x00, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0xa4, 0xab
+};
+
+/* UBX-ACK-ACK of a UBX-CFG-NAV5. */
+static const uint8_t ACK[] = { 0xb5, 0x62, 0x05, 0x01, 0x02, 0x00, 0x06, 0x24, 0x32, 0x5b };
+
+static std::vector<uint8_t> stream() {
+  std::vector<uint8_t> bytes(NMEA, NMEA + sizeof(NMEA) - 1);
+  bytes.insert(bytes.end(), NAV_PVT, NAV_PVT + sizeof(NAV_PVT));
+  bytes.insert(bytes.end(), ACK, ACK + sizeof(ACK));
+  bytes.insert(bytes.end(), NMEA, NMEA + sizeof(NMEA) - 1);
+  return bytes;
+}
+
+void test_nmea_passes_through(void) {
+  UbxParser parser;
+  std::string other;
+  int frames = 0;
+  for (uint8_t c : stream()) {
+    const UbxParser::Result result = parser.feed(c);
+    if (result == UbxParser::OTHER) {
+      other += (char) c;
+    } else if (result == UbxParser::FRAME) {
+      frames++;
+    }
+  }
+  TEST_ASSERT_EQUAL_STRING((std::string(NMEA) + NMEA).c_str(), other.c_str());
+  TEST_ASSERT_EQUAL(2, frames);
+  TEST_ASSERT_EQUAL(0, parser.badFrames);
+}
+
+void test_decodes_nav_pvt(void) {
+  UbxParser parser;
+  NavPvt pvt;
+  bool decoded = false;
+  for (uint8_t c : stream()) {
+    if (parser.feed(c) == UbxParser::FRAME
+        && parser.messageClass() == Ubx::CLASS_NAV && parser.id() == Ubx::ID_NAV_PVT) {
+      decoded = Ubx::decodeNavPvt(parser.payload(), parser.payloadLength(), pvt);
+    }
+  }
+  TEST_ASSERT_TRUE(decoded);
+  TEST_ASSERT_EQUAL_UINT32(388514000, pvt.iTow);
+  TEST_ASSERT_EQUAL(2024, pvt.year);
+  TEST_ASSERT_EQUAL(5, pvt.month);
+  TEST_ASSERT_EQUAL(1, pvt.day);
+  TEST_ASSERT_EQUAL(12, pvt.hour);
+  TEST_ASSERT_EQUAL(34, pvt.minute);
+  TEST_ASSERT_EQUAL(56, pvt.second);
+  TEST_ASSERT_TRUE(pvt.validDate);
+  TEST_ASSERT_TRUE(pvt.validTime);
+  TEST_ASSERT_EQUAL(3, pvt.fixType);
+  TEST_ASSERT_TRUE(pvt.hasPosition());
+  TEST_ASSERT_EQUAL(9, pvt.satellites);
+  TEST_ASSERT_EQUAL_INT32(91829300, pvt.longitude);
+  TEST_ASSERT_EQUAL_INT32(487842705, pvt.latitude);
+  TEST_ASSERT_EQUAL_INT32(245123, pvt.heightMsl);
+  TEST_ASSERT_EQUAL_UINT32(3500, pvt.horizontalAccuracy);
+  TEST_ASSERT_EQUAL_INT32(5556, pvt.groundSpeed);
+  TEST_ASSERT_EQUAL_INT32(12345678, pvt.headingOfMotion);
+  TEST_ASSERT_EQUAL(132, pvt.positionDop);
+}
+
+void test_drops_frames_with_bad_checksum(void) {
+  std::vector<uint8_t> bytes = stream();
+  bytes[sizeof(NMEA) - 1 + 30] ^= 0x10; // a bit of the longitude
+  UbxParser parser;
+  int frames = 0;
+  int badFrames = 0;
+  for (uint8_t c : bytes) {
+    const UbxParser::Result result = parser.feed(c);
+    if (result == UbxParser::FRAME) {
+      frames++;
+      TEST_ASSERT_EQUAL(0x05, parser.messageClass());
+    } else if (result == UbxParser::BAD_FRAME) {
+      badFrames++;
+    }
+  }
+  TEST_ASSERT_EQUAL(1, frames);
+  TEST_ASSERT_EQUAL(1, badFrames);
+  TEST_ASSERT_EQUAL(1, parser.badFrames);
+}
+
+void test_skips_oversized_frames(void) {
+  std::vector<uint8_t> bytes = { 0xb5, 0x62, 0x0a, 0x04, 0xc8, 0x00 };
+  bytes.insert(bytes.end(), 200 + 2, 0xb5);
+  bytes.insert(bytes.end(), ACK, ACK + sizeof(ACK));
+  bytes.insert(bytes.end(), NMEA, NMEA + sizeof(NMEA) - 1);
+  UbxParser parser;
+  std::string other;
+  int frames = 0;
+  for (uint8_t c : bytes) {
+    const UbxParser::Result result = parser.feed(c);
+    if (result == UbxParser::OTHER) {
+      other += (char) c;
+    } else if (result == UbxParser::FRAME) {
+      frames++;
+    }
+  }
+  TEST_ASSERT_EQUAL(1, frames);
+  TEST_ASSERT_EQUAL(1, parser.skippedFrames);
+  TEST_ASSERT_EQUAL_STRING(NMEA, other.c_str());
+}
+
+void test_frame_matches_configuration_sent(void) {
+  // UBX_CFG_NAV5 of configureGpsModule()
+  const uint8_t expected[] = {
+    0xb5, 0x62, 0x06, 0x24, 0x24, 0x00, 0xff, 0xff, 0x03, 0x03, 0x00, 0x00, 0x00, 0x00, 0x10, 0x27,
+    0x00, 0x00, 0x05, 0x00, 0xfa, 0x00, 0xfa, 0x00, 0x64, 0x00, 0x2c, 0x01, 0x50, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x14, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x77, 0x76
+  };
+  uint8_t frame[sizeof(expected)];
+  TEST_ASSERT_EQUAL(sizeof(expected),
+                    Ubx::frame(0x06, 0x24, expected + 6, sizeof(expected) - Ubx::FRAME_OVERHEAD, frame));
+  TEST_ASSERT_EQUAL_MEMORY(expected, frame, sizeof(expected));
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_nmea_passes_through);
+  RUN_TEST(test_decodes_nav_pvt);
+  RUN_TEST(test_drops_frames_with_bad_checksum);
+  RUN_TEST(test_skips_oversized_frames);
+  RUN_TEST(test_frame_matches_configuration_sent);
+  UNITY_END();
+  return 0;
+}
@@ -0,0 +1,61 @@
+#include "unity.h"
+
+#include "utils/varint.h"
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+void test_small_values_take_one_byte(void) {
+  uint8_t bytes[Varint::MAX_BYTES];
+  TEST_ASSERT_EQUAL(1, Varint::encode(0, bytes));
+  TEST_ASSERT_EQUAL(0, bytes[0]);
+  TEST_ASSERT_EQUAL(1, Varint::encode(127, bytes));
+  TEST_ASSERT_EQUAL(127, bytes[0]);
+  TEST_ASSERT_EQUAL(2, Varint::encode(128, bytes));
+  TEST_ASSERT_EQUAL(0x80, bytes[0]);
+  TEST_ASSERT_EQUAL(0x01, bytes[1]);
+  TEST_ASSERT_EQUAL(1, Varint::encodeSigned(-1, bytes));
+  TEST_ASSERT_EQUAL(1, bytes[0]);
+  TEST_ASSERT_EQUAL(1, Varint::encodeSigned(63, bytes));
+  TEST_ASSERT_EQUAL(2, Varint::encodeSigned(-65, bytes));
+}
+
+void test_round_trip(void) {
+  const uint32_t values[] = { 0, 1, 300, 18561, 65535, 2097152, 0xffffffff };
+  for (uint32_t value : values) {
+    uint8_t bytes[Varint::MAX_BYTES];
+    const size_t size = Varint::encode(value, bytes);
+    uint32_t decoded;
+    TEST_ASSERT_EQUAL(size, Varint::decode(bytes, size, decoded));
+    TEST_ASSERT_EQUAL_UINT32(value, decoded);
+  }
+  const int32_t signedValues[] = { 0, -1, 1, -1000, 48784270, INT32_MIN, INT32_MAX };
+  for (int32_t value : signedValues) {
+    uint8_t bytes[Varint::MAX_BYTES];
+    const size_t size = Varint::encodeSigned(value, bytes);
+    int32_t decoded;
+    TEST_ASSERT_EQUAL(size, Varint::decodeSigned(bytes, size, decoded));
+    TEST_ASSERT_EQUAL_INT32(value, decoded);
+  }
+}
+
+void test_decode_rejects_incomplete_values(void) {
+  uint8_t bytes[Varint::MAX_BYTES];
+  const size_t size = Varint::encode(18561, bytes);
+  uint32_t decoded;
+  TEST_ASSERT_EQUAL(0, Varint::decode(bytes, size - 1, decoded));
+  const uint8_t tooLong[] = { 0xff, 0xff, 0xff, 0xff, 0x7f };
+  TEST_ASSERT_EQUAL(0, Varint::decode(tooLong, sizeof(tooLong), decoded));
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_small_values_take_one_byte);
+  RUN_TEST(test_round_trip);
+  RUN_TEST(test_decode_rejects_incomplete_values);
+  UNITY_END();
+  return 0;
+}
@@ -0,0 +1,574 @@
+/*
+  Copyright (C) 2019-2021 OpenBikeSensor Contributors
+  Contact: https://openbikesensor.org
+
+  This file is part of the OpenBikeSensor project.
+
+  The OpenBikeSensor sensor firmware is free software: you can redistribute
+  it and/or modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the License,
+  or (at your option) any later version.
+
+  The OpenBikeSensor sensor firmware is distributed in the hope that it will
+  be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+  Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with
+  the OpenBikeSensor sensor firmware.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "utils/varint.h"
+
+/* Converts binary tracks of BinaryFileWriter back to the CSV format:
+ *
+ *   program [--output DIR] [--events|--echoes|--fixes] TRACK.obsdata.bin...
+ *
+ * TRACK.obsdata.csv is written next to the binary track or to DIR. The
+ * result is the CSV the firmware would have written for the track, see
+ * docs/software/firmware/binary_format.md. A track that ends within a
+ * record, e.g. after a power loss, is converted up to the last complete
+ * record.
+ *
+ * Events, echoes and positions between the intervals are not part of that
+ * CSV. With --events TRACK.obsdata.events.csv gets the events of the track
+ * only, the records of the intervals are skipped after their time. With
+ * --echoes TRACK.obsdata.echoes.csv gets the echo records of a track
+ * written with rawEchoTrack. With --fixes TRACK.obsdata.fixes.csv gets the
+ * position records.
+ */
+
+static const uint8_t FORMAT_VERSION = 3;
+/* Oldest version still read, it has no events. */
+static const uint8_t MIN_FORMAT_VERSION = 1;
+static const uint8_t FLAG_POSITION = 0x01;
+static const uint8_t FLAG_COURSE = 0x02;
+static const uint8_t FLAG_SPEED = 0x04;
+static const uint8_t FLAG_HDOP = 0x08;
+static const uint8_t FLAG_INVALID = 0x10;
+static const uint8_t FLAG_INSIDE_PRIVACY_AREA = 0x20;
+static const uint8_t FLAG_ECHO = 0x40;
+static const uint8_t FLAG_EVENT = 0x80;
+/* Both bits tell the kind of the record, set together for a position. */
+static const uint8_t FLAG_FIX = FLAG_ECHO | FLAG_EVENT;
+static const uint32_t NO_SENSOR_VALUE = 999;
+/* Names of the TrackEvent types as written by the firmware. */
+static const char *const EVENT_NAMES[] = {
+  "Boot", "Confirm", "Mark", "PrivacyEnter", "PrivacyExit", "Flush"
+};
+
+/* Reads the values of a record or the header, fails on the first value
+ * that does not fit in the remaining data. */
+class Reader {
+  public:
+    Reader(const uint8_t* data, size_t size) : data(data), size(size) {};
+    bool byte(uint8_t &value) {
+      if (pos >= size) {
+        return false;
+      }
+      value = data[pos++];
+      return true;
+    };
+    bool varint(uint32_t &value) {
+      const size_t read = Varint::decode(data + pos, size - pos, value);
+      pos += read;
+      return read > 0;
+    };
+    bool signedVarint(int32_t &value) {
+      const size_t read = Varint::decodeSigned(data + pos, size - pos, value);
+      pos += read;
+      return read > 0;
+    };
+    bool string(std::string &value) {
+      uint32_t length;
+      if (!varint(length) || length > size - pos) {
+        return false;
+      }
+      value.assign((const char*) data + pos, length);
+      pos += length;
+      return true;
+    };
+    size_t position() const {
+      return pos;
+    };
+
+  private:
+    const uint8_t* data;
+    size_t size;
+    size_t pos = 0;
+};
+
+/* As String(value / 10^decimals, decimals) of the firmware. */
+static std::string fixed(int64_t value, int decimals) {
+  std::string result = value < 0 ? "-" : "";
+  uint64_t absolute = value < 0 ? (uint64_t) -value : (uint64_t) value;
+  uint64_t divider = 1;
+  for (int i = 0; i < decimals; ++i) {
+    divider *= 10;
+  }
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), "%llu.%0*llu", (unsigned long long) (absolute / divider), decimals,
+    (unsigned long long) (absolute % divider));
+  return result + buffer;
+}
+
+static std::string metadataValue(const std::string &metadata, const std::string &key) {
+  const std::string prefix = key + "=";
+  size_t start = 0;
+  while (start < metadata.size()) {
+    size_t end = metadata.find('&', start);
+    if (end == std::string::npos) {
+      end = metadata.size();
+    }
+    if (metadata.compare(start, prefix.size(), prefix) == 0) {
+      return metadata.substr(start + prefix.size(), end - start - prefix.size());
+    }
+    start = end + 1;
+  }
+  return std::string();
+}
+
+/* Date, time and millis columns of the CSV. */
+static std::string dateColumns(int64_t time, uint32_t millis) {
+  const time_t seconds = (time_t) time;
+  tm utc;
+  gmtime_r(&seconds, &utc);
+  char date[48];
+  snprintf(date, sizeof(date), "%02d.%02d.%04d;%02d:%02d:%02d;%u;",
+    utc.tm_mday, utc.tm_mon + 1, utc.tm_year + 1900, utc.tm_hour, utc.tm_min, utc.tm_sec, millis);
+  return date;
+}
+
+/* Reads the header, pos is set to the first record. Returns an error
+ * message, empty on success. */
+static std::string readHeader(const std::vector<uint8_t> &track, std::string &metadata,
+                              std::vector<std::string> &locations, size_t &pos) {
+  if (track.size() < 5 || memcmp(track.data(), "OBSB", 4) != 0) {
+    return "not a binary track";
+  }
+  if (track[4] < MIN_FORMAT_VERSION || track[4] > FORMAT_VERSION) {
+    return "unknown format version " + std::to_string(track[4]);
+  }
+  Reader header(track.data() + 5, track.size() - 5);
+  uint8_t sensors;
+  if (!header.string(metadata) || !header.byte(sensors)) {
+    return "incomplete header";
+  }
+  for (uint8_t idx = 0; idx < sensors; ++idx) {
+    std::string location;
+    if (!header.string(location) || location.empty()) {
+      return "incomplete header";
+    }
+    locations.push_back(location);
+  }
+  pos = 5 + header.position();
+  return std::string();
+}
+
+/* Finds the next record at pos, which is moved behind it. Returns an error
+ * message, empty on success. */
+static std::string nextRecord(const std::vector<uint8_t> &track, size_t &pos, Reader &record) {
+  uint32_t length;
+  const size_t lengthSize = Varint::decode(track.data() + pos, track.size() - pos, length);
+  if (lengthSize == 0 || length > track.size() - pos - lengthSize) {
+    return "incomplete record at byte " + std::to_string(pos);
+  }
+  record = Reader(track.data() + pos + lengthSize, length);
+  pos += lengthSize + length;
+  return std::string();
+}
+
+/* A position record, the values of the previous one are updated. */
+struct Fix {
+  uint32_t millis = 0;
+  int32_t latitude = 0;
+  int32_t longitude = 0;
+  uint32_t course = 0;
+  uint32_t speed = 0;
+};
+
+/* The rest of a position record after its flags. */
+static bool readFix(Reader &record, Fix &fix) {
+  int32_t millisDelta, latitudeDelta, longitudeDelta;
+  if (!record.signedVarint(millisDelta) || !record.signedVarint(latitudeDelta)
+      || !record.signedVarint(longitudeDelta) || !record.varint(fix.course) || !record.varint(fix.speed)) {
+    return false;
+  }
+  fix.millis += (uint32_t) millisDelta;
+  fix.latitude += latitudeDelta;
+  fix.longitude += longitudeDelta;
+  return true;
+}
+
+/* The rest of an event record after its flags as CSV line, time and
+ * millis are those of the last interval record. The position of the event
+ * is taken from fixes by its millis. */
+static bool eventLine(Reader &record, uint8_t flags, int64_t time, uint32_t millis,
+                      const std::map<uint32_t, Fix> &fixes, std::string &line) {
+  uint8_t type;
+  int32_t timeDelta, millisDelta, fixDelta = 0;
+  uint32_t index, value;
+  if (!record.byte(type) || !record.signedVarint(timeDelta) || !record.signedVarint(millisDelta)
+      || !record.varint(index) || !record.varint(value)
+      || ((flags & FLAG_POSITION) && !record.signedVarint(fixDelta))) {
+    return false;
+  }
+  const char *name = type < sizeof(EVENT_NAMES) / sizeof(EVENT_NAMES[0]) ? EVENT_NAMES[type] : "Unknown";
+  const uint32_t eventMillis = millis + (uint32_t) millisDelta;
+  line = dateColumns(time + timeDelta, eventMillis)
+    + "Event=" + name + "&Index=" + std::to_string(index) + "&Value=" + std::to_string(value);
+  const auto fix = fixes.find(eventMillis + (uint32_t) fixDelta);
+  if ((flags & FLAG_POSITION) && fix != fixes.end()) {
+    line += "&Latitude=" + fixed(fix->second.latitude, 6) + "&Longitude=" + fixed(fix->second.longitude, 6);
+  }
+  line += "\n";
+  return true;
+}
+
+/* Returns an error message, empty on success. */
+static std::string decode(const std::vector<uint8_t> &track, std::string &csv) {
+  std::string metadata;
+  std::vector<std::string> locations;
+  size_t pos;
+  const std::string error = readHeader(track, metadata, locations, pos);
+  if (!error.empty()) {
+    return error;
+  }
+  const uint8_t sensors = locations.size();
+  const int maxMeasurements = atoi(metadataValue(metadata, "MaximumMeasurementsPerLine").c_str());
+
+  csv = metadata + "\n";
+  csv += "Date;Time;Millis;Comment;Latitude;Longitude;Altitude;"
+    "Course;Speed;HDOP;Satellites;BatteryLevel;";
+  for (const std::string &location : locations) {
+    csv += location + ";";
+  }
+  csv += "Confirmed;Marked;Invalid;InsidePrivacyArea;Factor;Measurements";
+  for (int idx = 1; idx <= maxMeasurements; ++idx) {
+    const std::string number = std::to_string(idx);
+    csv += ";Tms" + number;
+    for (const std::string &location : locations) {
+      csv += ";" + location.substr(0, 1) + "us" + number;
+    }
+  }
+  csv += "\n";
+
+  int64_t time = 0;
+  uint32_t millis = 0;
+  int32_t latitude = 0;
+  int32_t longitude = 0;
+  while (pos < track.size()) {
+    Reader record(nullptr, 0);
+    const std::string recordError = nextRecord(track, pos, record);
+    if (!recordError.empty()) {
+      return recordError;
+    }
+
+    std::string line;
+    uint8_t flags, satellites;
+    int32_t timeDelta, millisDelta, battery;
+    std::string comment, marked;
+    if (!record.byte(flags)) {
+      return "broken record";
+    }
+    if (flags & (FLAG_ECHO | FLAG_EVENT)) {
+      continue; // not part of the CSV
+    }
+    if (!record.signedVarint(timeDelta) || !record.signedVarint(millisDelta)) {
+      return "broken record";
+    }
+    time += timeDelta;
+    millis += (uint32_t) millisDelta;
+    const std::string date = dateColumns(time, millis);
+
+    std::string position;
+    if (flags & FLAG_POSITION) {
+      int32_t latitudeDelta, longitudeDelta, altitude;
+      uint32_t course = 0, speed = 0;
+      if (!record.signedVarint(latitudeDelta) || !record.signedVarint(longitudeDelta)
+          || !record.signedVarint(altitude)
+          || ((flags & FLAG_COURSE) && !record.varint(course))
+          || ((flags & FLAG_SPEED) && !record.varint(speed))) {
+        return "broken record";
+      }
+      latitude += latitudeDelta;
+      longitude += longitudeDelta;
+      position = fixed(latitude, 6) + ";" + fixed(longitude, 6) + ";" + fixed(altitude, 1) + ";";
+      if (flags & FLAG_COURSE) {
+        position += fixed(course, 2);
+      }
+      position += ";";
+      if (flags & FLAG_SPEED) {
+        position += fixed(speed, 2);
+      }
+      position += ";";
+    } else {
+      position = ";;;;;";
+    }
+    uint32_t hdop = 0;
+    if (((flags & FLAG_HDOP) && !record.varint(hdop))
+        || !record.byte(satellites) || !record.signedVarint(battery)) {
+      return "broken record";
+    }
+    std::string values;
+    for (uint8_t idx = 0; idx < sensors; ++idx) {
+      uint32_t value;
+      if (!record.varint(value)) {
+        return "broken record";
+      }
+      if (value < NO_SENSOR_VALUE) {
+        values += std::to_string(value);
+      }
+      values += ";";
+    }
+    uint32_t confirmed, factor, measurements;
+    if (!record.varint(confirmed) || !record.varint(factor)
+        || !record.string(comment) || !record.string(marked) || !record.varint(measurements)) {
+      return "broken record";
+    }
+
+    line = date + comment + ";" + position;
+    if (flags & FLAG_HDOP) {
+      line += fixed(hdop, 2);
+    }
+    line += ";" + std::to_string(satellites) + ";" + fixed(battery, 2) + ";" + values;
+    line += std::to_string(confirmed) + ";" + marked + ";"
+      + ((flags & FLAG_INVALID) ? "1;" : "0;")
+      + ((flags & FLAG_INSIDE_PRIVACY_AREA) ? "1;" : "0;")
+      + fixed(factor, 2) + ";" + std::to_string(measurements);
+
+    int32_t offset = 0;
+    for (uint32_t idx = 0; idx < measurements; ++idx) {
+      int32_t offsetDelta;
+      uint8_t column;
+      uint32_t duration;
+      if (!record.signedVarint(offsetDelta) || !record.byte(column) || !record.varint(duration)) {
+        return "broken record";
+      }
+      offset += offsetDelta;
+      line += ";" + std::to_string(offset);
+      for (uint8_t sensor = 0; sensor < sensors; ++sensor) {
+        line += ";";
+        // empty if the echo did not end in time, as the OBS writes it
+        if (sensor == column && duration > 0) {
+          line += std::to_string(duration);
+        }
+      }
+    }
+    csv += line + "\n";
+  }
+  return std::string();
+}
+
+/* Only the time of the interval records is read, the rest is skipped by
+ * its length. Returns an error message, empty on success. */
+static std::string decodeEvents(const std::vector<uint8_t> &track, std::string &csv) {
+  std::string metadata;
+  std::vector<std::string> locations;
+  size_t pos;
+  const std::string error = readHeader(track, metadata, locations, pos);
+  if (!error.empty()) {
+    return error;
+  }
+  csv = "Date;Time;Millis;Event\n";
+  int64_t time = 0;
+  uint32_t millis = 0;
+  Fix fix;
+  std::map<uint32_t, Fix> fixes;
+  while (pos < track.size()) {
+    Reader record(nullptr, 0);
+    const std::string recordError = nextRecord(track, pos, record);
+    if (!recordError.empty()) {
+      return recordError;
+    }
+    uint8_t flags;
+    int32_t timeDelta, millisDelta;
+    std::string line;
+    if (!record.byte(flags)) {
+      return "broken record";
+    }
+    if ((flags & FLAG_FIX) == FLAG_FIX) {
+      if (!readFix(record, fix)) {
+        return "broken record";
+      }
+      fixes[fix.millis] = fix;
+    } else if (flags & FLAG_ECHO) {
+      continue;
+    } else if (flags & FLAG_EVENT) {
+      if (!eventLine(record, flags, time, millis, fixes, line)) {
+        return "broken record";
+      }
+      csv += line;
+    } else if (record.signedVarint(timeDelta) && record.signedVarint(millisDelta)) {
+      time += timeDelta;
+      millis += (uint32_t) millisDelta;
+    } else {
+      return "broken record";
+    }
+  }
+  return std::string();
+}
+
+/* One line per echo record with its trigger time, the location of the
+ * sensor and the echo time as in the CSV. Returns an error message, empty
+ * on success. */
+static std::string decodeEchoes(const std::vector<uint8_t> &track, std::string &csv) {
+  std::string metadata;
+  std::vector<std::string> locations;
+  size_t pos;
+  const std::string error = readHeader(track, metadata, locations, pos);
+  if (!error.empty()) {
+    return error;
+  }
+  csv = "Millis;Sensor;EchoMicroseconds\n";
+  uint32_t millis = 0;
+  while (pos < track.size()) {
+    Reader record(nullptr, 0);
+    const std::string recordError = nextRecord(track, pos, record);
+    if (!recordError.empty()) {
+      return recordError;
+    }
+    uint8_t flags, column;
+    int32_t millisDelta;
+    uint32_t duration;
+    if (!record.byte(flags)) {
+      return "broken record";
+    }
+    if ((flags & FLAG_FIX) != FLAG_ECHO) {
+      continue;
+    }
+    if (!record.byte(column) || !record.signedVarint(millisDelta) || !record.varint(duration)
+        || column >= locations.size()) {
+      return "broken record";
+    }
+    millis += (uint32_t) millisDelta;
+    csv += std::to_string(millis) + ";" + locations[column] + ";"
+      + (duration > 0 ? std::to_string(duration) : std::string()) + "\n";
+  }
+  return std::string();
+}
+
+/* One line per position record. Returns an error message, empty on
+ * success. */
+static std::string decodeFixes(const std::vector<uint8_t> &track, std::string &csv) {
+  std::string metadata;
+  std::vector<std::string> locations;
+  size_t pos;
+  const std::string error = readHeader(track, metadata, locations, pos);
+  if (!error.empty()) {
+    return error;
+  }
+  csv = "Millis;Latitude;Longitude;Course;Speed\n";
+  Fix fix;
+  while (pos < track.size()) {
+    Reader record(nullptr, 0);
+    const std::string recordError = nextRecord(track, pos, record);
+    if (!recordError.empty()) {
+      return recordError;
+    }
+    uint8_t flags;
+    if (!record.byte(flags)) {
+      return "broken record";
+    }
+    if ((flags & FLAG_FIX) != FLAG_FIX) {
+      continue;
+    }
+    if (!readFix(record, fix)) {
+      return "broken record";
+    }
+    csv += std::to_string(fix.millis) + ";" + fixed(fix.latitude, 6) + ";" + fixed(fix.longitude, 6) + ";"
+      + fixed(fix.course, 2) + ";" + fixed(fix.speed, 2) + "\n";
+  }
+  return std::string();
+}
+
+static std::string csvName(const std::string &path, const std::string &outputDir, const char *suffix) {
+  std::string name = path;
+  const std::string extension = ".bin";
+  if (name.size() > extension.size()
+      && name.compare(name.size() - extension.size(), extension.size(), extension) == 0) {
+    name.erase(name.size() - extension.size());
+  }
+  name += suffix;
+  if (!outputDir.empty()) {
+    const size_t slash = name.find_last_of('/');
+    name = outputDir + "/" + (slash == std::string::npos ? name : name.substr(slash + 1));
+  }
+  return name;
+}
+
+int main(int argc, char **argv) {
+  std::string outputDir;
+  std::vector<std::string> tracks;
+  bool events = false;
+  bool echoes = false;
+  bool fixes = false;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+      outputDir = argv[++i];
+    } else if (strcmp(argv[i], "--events") == 0) {
+      events = true;
+    } else if (strcmp(argv[i], "--echoes") == 0) {
+      echoes = true;
+    } else if (strcmp(argv[i], "--fixes") == 0) {
+      fixes = true;
+    } else if (argv[i][0] == '-') {
+      tracks.clear();
+      break;
+    } else {
+      tracks.push_back(argv[i]);
+    }
+  }
+  if (tracks.empty() || events + echoes + fixes > 1) {
+    fprintf(stderr, "usage: %s [--output DIR] [--events|--echoes|--fixes] TRACK.obsdata.bin...\n", argv[0]);
+    return 2;
+  }
+
+  int failed = 0;
+  for (const std::string &path : tracks) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+      fprintf(stderr, "%s: can not read\n", path.c_str());
+      failed++;
+      continue;
+    }
+    const std::vector<uint8_t> track((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    std::string csv;
+    std::string error;
+    if (events) {
+      error = decodeEvents(track, csv);
+    } else if (echoes) {
+      error = decodeEchoes(track, csv);
+    } else if (fixes) {
+      error = decodeFixes(track, csv);
+    } else {
+      error = decode(track, csv);
+    }
+    if (!error.empty()) {
+      fprintf(stderr, "%s: %s\n", path.c_str(), error.c_str());
+      failed++;
+      if (csv.empty()) {
+        continue;
+      }
+    }
+    const std::string name = csvName(path, outputDir,
+      events ? ".events.csv" : echoes ? ".echoes.csv" : fixes ? ".fixes.csv" : ".csv");
+    std::ofstream out(name, std::ios::binary);
+    if (!out.write(csv.data(), csv.size())) {
+      fprintf(stderr, "%s: can not write\n", name.c_str());
+      failed++;
+      continue;
+    }
+    printf("%s: %zu bytes -> %s: %zu bytes\n", path.c_str(), track.size(), name.c_str(), csv.size());
+  }
+  return failed ? 1 : 0;
+}
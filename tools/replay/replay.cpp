@@ -0,0 +1,488 @@
+/*
+  Copyright (C) 2019-2021 OpenBikeSensor Contributors
+  Contact: https://openbikesensor.org
+
+  This file is part of the OpenBikeSensor project.
+
+  The OpenBikeSensor sensor firmware is free software: you can redistribute
+  it and/or modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation, either version 3 of the License,
+  or (at your option) any later version.
+
+  The OpenBikeSensor sensor firmware is distributed in the hope that it will
+  be useful, but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+  Public License for more details.
+
+  You should have received a copy of the GNU General Public License along with
+  the OpenBikeSensor sensor firmware.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <vector>
+
+#define MAX_SENSOR_VALUE 999
+#include "utils/echodistance.h"
+#include "utils/filter.h"
+
+/* Replays recorded tracks through the distance processing of the firmware:
+ *
+ *   program [--threads N] [--chain NAME]... [--temperature C]
+ *           [--output DIR] TRACK.csv|DIR...
+ *
+ * The echo times of the Tms/Lus/Rus columns go through the conversion
+ * (EchoDistance) and the filter chain of HCSR04SensorManager, the minimum
+ * per line is what the firmware writes to the Left/Right/... columns. The
+ * replayed minimums are compared with the recorded ones, each --chain is
+ * replayed on its own to compare filters on the same tracks. Directories
+ * are searched for *.csv files, one track is replayed per thread.
+ *
+ * With --output the replayed values are written to DIR/<track>.<chain>.csv
+ * as Millis and one column per sensor.
+ *
+ * Known differences to the ride: Lines with a confirmed overtaking carry
+ * the confirmed distance and are not compared, lines dropped inside
+ * privacy areas miss in the filter history. Tracks of older firmware
+ * have no value for echos that did not end in time, such records are
+ * skipped.
+ */
+
+static const uint16_t DEFAULT_OFFSET = 0;
+
+typedef DistanceFilter* (*FilterFactory)();
+
+template<typename CHAIN> static DistanceFilter* createChain() {
+  return new DistanceFilterChain<CHAIN>();
+}
+
+struct ChainInfo {
+  const char* name;
+  const char* description;
+  FilterFactory create;
+};
+
+static const ChainInfo CHAINS[] = {
+  { "default", "firmware default, median of 3 and offset",
+    createChain<DefaultDistanceFilter> },
+  { "raw", "offset only",
+    createChain<FilterChain<uint16_t, OffsetCorrection<uint16_t>>> },
+  { "median5", "median of 5 and offset",
+    createChain<FilterChain<uint16_t,
+      MedianFilter<uint16_t, 5>, OffsetCorrection<uint16_t>>> },
+  { "outlier", "outlier gate 50cm/2, median of 3 and offset",
+    createChain<FilterChain<uint16_t, OutlierGate<uint16_t, 50, 2>,
+      MedianFilter<uint16_t, 3>, OffsetCorrection<uint16_t>>> },
+  { "kalman", "median of 3, Kalman 5cm/100 permille and offset",
+    createChain<FilterChain<uint16_t, MedianFilter<uint16_t, 3>,
+      KalmanFilter<uint16_t, 5, 100>, OffsetCorrection<uint16_t>>> },
+};
+
+struct Options {
+  unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+  std::vector<const ChainInfo*> chains;
+  /* Use the Factor column of each line if NAN. */
+  float temperature = NAN;
+  std::string output;
+};
+
+/* Result of the replay of one track with one chain. */
+struct ChainResult {
+  /* Sensor values of all lines without confirmed overtaking. */
+  uint64_t compared = 0;
+  uint64_t equal = 0;
+  /* Replayed a distance where the firmware saw nothing in range. */
+  uint64_t replayedOnly = 0;
+  /* Recorded a distance where the replay sees nothing in range. */
+  uint64_t recordedOnly = 0;
+  /* Sum of the differences where both are in range. */
+  uint64_t absoluteDifference = 0;
+
+  void add(const ChainResult &other) {
+    compared += other.compared;
+    equal += other.equal;
+    replayedOnly += other.replayedOnly;
+    recordedOnly += other.recordedOnly;
+    absoluteDifference += other.absoluteDifference;
+  }
+};
+
+struct TrackResult {
+  bool replayed = false;
+  std::string error;
+  uint64_t bytes = 0;
+  uint64_t lines = 0;
+  uint64_t records = 0;
+  /* Records without a value, echoes that did not end in time. */
+  uint64_t timeoutRecords = 0;
+  std::vector<ChainResult> chains;
+};
+
+/* Splits the line at the separator in place. */
+static void split(std::string &line, char separator, std::vector<const char*> &fields) {
+  fields.clear();
+  fields.push_back(&line[0]);
+  for (char &c : line) {
+    if (c == separator) {
+      c = 0;
+      fields.push_back(&c + 1);
+    }
+  }
+}
+
+static int indexOf(const std::vector<const char*> &fields, const char* name) {
+  for (size_t idx = 0; idx < fields.size(); ++idx) {
+    if (strcmp(fields[idx], name) == 0) {
+      return (int) idx;
+    }
+  }
+  return -1;
+}
+
+static std::string metadataValue(const std::vector<const char*> &metadata, const std::string &key) {
+  const std::string prefix = key + "=";
+  for (const char* entry : metadata) {
+    if (strncmp(entry, prefix.c_str(), prefix.size()) == 0) {
+      return std::string(entry + prefix.size());
+    }
+  }
+  return std::string();
+}
+
+static std::string baseName(const std::string &path) {
+  const size_t slash = path.find_last_of('/');
+  std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+  const size_t dot = name.find_last_of('.');
+  return dot == std::string::npos ? name : name.substr(0, dot);
+}
+
+/* Replay state of one chain for all sensors of a track. */
+class ChainReplay {
+  public:
+    ChainReplay(const ChainInfo* chain, const std::vector<uint16_t> &offsets) {
+      for (uint16_t offset : offsets) {
+        filters.emplace_back(chain->create());
+        filters.back()->setOffset(offset);
+      }
+      minDistances.resize(offsets.size(), MAX_SENSOR_VALUE);
+    }
+    void startLine() {
+      std::fill(minDistances.begin(), minDistances.end(), MAX_SENSOR_VALUE);
+    }
+    /* As HCSR04SensorManager::collectSensorResult(). */
+    void collect(size_t sensor, uint16_t rawDistance) {
+      const uint16_t distance = filters[sensor]->filter(rawDistance);
+      if (distance > 0 && distance < minDistances[sensor]) {
+        minDistances[sensor] = distance;
+      }
+    }
+
+    std::vector<std::unique_ptr<DistanceFilter>> filters;
+    std::vector<uint16_t> minDistances;
+    std::unique_ptr<std::ofstream> output;
+};
+
+static void replayTrack(const std::string &path, const Options &options, TrackResult &result) {
+  std::ifstream in(path);
+  std::string metadataLine;
+  std::string headerLine;
+  if (!in || !std::getline(in, metadataLine) || !std::getline(in, headerLine)) {
+    result.error = "can not read the header";
+    return;
+  }
+  std::vector<const char*> metadata;
+  split(metadataLine, '&', metadata);
+  const std::string format = metadataValue(metadata, "OBSDataFormat");
+  if (format != "2" && format != "3") {
+    result.error = "not a OBSDataFormat=2 or 3 file";
+    return;
+  }
+  const size_t dataPerMeasurement = (size_t) atoi(metadataValue(metadata, "DataPerMeasurement").c_str());
+
+  std::vector<const char*> header;
+  split(headerLine, ';', header);
+  const int millisColumn = indexOf(header, "Millis");
+  const int batteryColumn = indexOf(header, "BatteryLevel");
+  const int confirmedColumn = indexOf(header, "Confirmed");
+  const int factorColumn = indexOf(header, "Factor");
+  const int measurementsColumn = indexOf(header, "Measurements");
+  const int firstRecordColumn = indexOf(header, "Tms1");
+  if (millisColumn < 0 || batteryColumn < 0 || confirmedColumn <= batteryColumn
+      || factorColumn < 0 || measurementsColumn < 0 || firstRecordColumn < 0) {
+    result.error = "missing columns";
+    return;
+  }
+  // the distance columns are between BatteryLevel and Confirmed, their
+  // echo times in the same order after Tms<n>
+  const size_t sensors = (size_t) (confirmedColumn - batteryColumn - 1);
+  if (dataPerMeasurement != sensors + 1) {
+    result.error = "DataPerMeasurement does not match the sensor columns";
+    return;
+  }
+  std::vector<uint16_t> offsets;
+  std::vector<std::string> locations;
+  for (size_t sensor = 0; sensor < sensors; ++sensor) {
+    const std::string location = header[batteryColumn + 1 + sensor];
+    std::string offset = metadataValue(metadata, "Offset" + location);
+    if (offset.empty()) {
+      offset = metadataValue(metadata, "HandlebarOffset" + location);
+    }
+    offsets.push_back(offset.empty() ? DEFAULT_OFFSET : (uint16_t) atoi(offset.c_str()));
+    locations.push_back(location);
+  }
+
+  EchoDistance echoDistance;
+  if (!std::isnan(options.temperature)) {
+    echoDistance.setTemperature(options.temperature);
+  }
+  std::vector<ChainReplay> replays;
+  replays.reserve(options.chains.size());
+  for (const ChainInfo* chain : options.chains) {
+    replays.emplace_back(chain, offsets);
+    if (!options.output.empty()) {
+      const std::string name = options.output + "/" + baseName(path) + "." + chain->name;
+      replays.back().output.reset(new std::ofstream(name + ".csv"));
+      if (!*replays.back().output) {
+        result.error = "can not write " + name + ".csv";
+        return;
+      }
+      *replays.back().output << "Millis";
+      for (const std::string &location : locations) {
+        *replays.back().output << ";" << location;
+      }
+      *replays.back().output << "\n";
+    }
+  }
+  result.chains.resize(options.chains.size());
+  result.bytes = metadataLine.size() + headerLine.size() + 2;
+
+  std::string line;
+  std::vector<const char*> fields;
+  std::string lastMillis;
+  // the record number each sensor was seen last, see below
+  std::vector<uint64_t> lastRecords(sensors, 0);
+  while (std::getline(in, line)) {
+    result.bytes += line.size() + 1;
+    split(line, ';', fields);
+    if (fields.size() <= (size_t) measurementsColumn) {
+      continue;
+    }
+    result.lines++;
+    // lines with more than one confirmed overtaking repeat the interval
+    const bool repeated = lastMillis == fields[millisColumn];
+    lastMillis = fields[millisColumn];
+    if (!repeated) {
+      if (std::isnan(options.temperature)) {
+        echoDistance.setMicrosecondsPerCm((float) atof(fields[factorColumn]));
+      }
+      for (ChainReplay &replay : replays) {
+        replay.startLine();
+      }
+      const size_t measurements = (size_t) atoi(fields[measurementsColumn]);
+      for (size_t idx = 0; idx < measurements; ++idx) {
+        const size_t column = firstRecordColumn + idx * dataPerMeasurement;
+        if (column + sensors >= fields.size()) {
+          break;
+        }
+        result.records++;
+        bool found = false;
+        for (size_t sensor = 0; sensor < sensors; ++sensor) {
+          const char* value = fields[column + 1 + sensor];
+          if (*value) {
+            const uint16_t rawDistance = echoDistance.centimeters(atoi(value));
+            for (ChainReplay &replay : replays) {
+              replay.collect(sensor, rawDistance);
+            }
+            lastRecords[sensor] = result.records;
+            found = true;
+          }
+        }
+        if (!found && sensors > 0) {
+          // The echo did not end in time, the OBS leaves all fields empty.
+          // The sensors take turns, the one waiting longest timed out.
+          const size_t sensor = (size_t) (std::min_element(lastRecords.begin(), lastRecords.end())
+            - lastRecords.begin());
+          for (ChainReplay &replay : replays) {
+            replay.collect(sensor, echoDistance.centimeters(-1));
+          }
+          lastRecords[sensor] = result.records;
+          result.timeoutRecords++;
+        }
+      }
+    }
+
+    const bool confirmed = atoi(fields[confirmedColumn]) != 0;
+    for (size_t chain = 0; chain < replays.size(); ++chain) {
+      ChainReplay &replay = replays[chain];
+      ChainResult &chainResult = result.chains[chain];
+      for (size_t sensor = 0; sensor < sensors && !confirmed; ++sensor) {
+        const char* value = fields[batteryColumn + 1 + sensor];
+        const uint16_t recorded = *value ? (uint16_t) atoi(value) : MAX_SENSOR_VALUE;
+        const uint16_t replayed = replay.minDistances[sensor];
+        chainResult.compared++;
+        if (recorded == replayed) {
+          chainResult.equal++;
+        } else if (recorded == MAX_SENSOR_VALUE) {
+          chainResult.replayedOnly++;
+        } else if (replayed == MAX_SENSOR_VALUE) {
+          chainResult.recordedOnly++;
+        } else {
+          chainResult.absoluteDifference += recorded > replayed ? recorded - replayed : replayed - recorded;
+        }
+      }
+      if (replay.output) {
+        *replay.output << fields[millisColumn];
+        for (uint16_t distance : replay.minDistances) {
+          *replay.output << ";";
+          if (distance < MAX_SENSOR_VALUE) {
+            *replay.output << distance;
+          }
+        }
+        *replay.output << "\n";
+      }
+    }
+  }
+  result.replayed = true;
+}
+
+static void findTracks(const std::string &path, std::vector<std::string> &tracks) {
+  struct stat info;
+  if (stat(path.c_str(), &info) != 0) {
+    fprintf(stderr, "%s: not found\n", path.c_str());
+    return;
+  }
+  if (!S_ISDIR(info.st_mode)) {
+    tracks.push_back(path);
+    return;
+  }
+  DIR* dir = opendir(path.c_str());
+  if (!dir) {
+    return;
+  }
+  while (dirent* entry = readdir(dir)) {
+    const std::string name = entry->d_name;
+    if (name == "." || name == "..") {
+      continue;
+    }
+    const std::string child = path + "/" + name;
+    if (stat(child.c_str(), &info) == 0 && S_ISDIR(info.st_mode)) {
+      findTracks(child, tracks);
+    } else if (name.size() > 4 && strcasecmp(name.c_str() + name.size() - 4, ".csv") == 0) {
+      tracks.push_back(child);
+    }
+  }
+  closedir(dir);
+}
+
+static const ChainInfo* findChain(const char* name) {
+  for (const ChainInfo &chain : CHAINS) {
+    if (strcmp(chain.name, name) == 0) {
+      return &chain;
+    }
+  }
+  return nullptr;
+}
+
+static int usage(const char* program) {
+  fprintf(stderr, "usage: %s [--threads N] [--chain NAME]... [--temperature C] [--output DIR] TRACK.csv|DIR...\n",
+    program);
+  fprintf(stderr, "chains:\n");
+  for (const ChainInfo &chain : CHAINS) {
+    fprintf(stderr, "  %-10s %s\n", chain.name, chain.description);
+  }
+  return 2;
+}
+
+int main(int argc, char **argv) {
+  Options options;
+  std::vector<std::string> tracks;
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+      options.threads = (unsigned) std::max(1, atoi(argv[++i]));
+    } else if (strcmp(argv[i], "--chain") == 0 && i + 1 < argc) {
+      const ChainInfo* chain = findChain(argv[++i]);
+      if (!chain) {
+        return usage(argv[0]);
+      }
+      options.chains.push_back(chain);
+    } else if (strcmp(argv[i], "--temperature") == 0 && i + 1 < argc) {
+      options.temperature = (float) atof(argv[++i]);
+    } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+      options.output = argv[++i];
+    } else if (argv[i][0] == '-') {
+      return usage(argv[0]);
+    } else {
+      findTracks(argv[i], tracks);
+    }
+  }
+  if (tracks.empty()) {
+    return usage(argv[0]);
+  }
+  if (options.chains.empty()) {
+    options.chains.push_back(&CHAINS[0]);
+  }
+  std::sort(tracks.begin(), tracks.end());
+
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<TrackResult> results(tracks.size());
+  std::atomic<size_t> next(0);
+  std::vector<std::thread> workers;
+  for (unsigned idx = 0; idx < std::min(options.threads, (unsigned) tracks.size()); ++idx) {
+    workers.emplace_back([&]() {
+      for (size_t track = next++; track < tracks.size(); track = next++) {
+        replayTrack(tracks[track], options, results[track]);
+      }
+    });
+  }
+  for (std::thread &worker : workers) {
+    worker.join();
+  }
+  const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  TrackResult total;
+  total.chains.resize(options.chains.size());
+  size_t replayed = 0;
+  for (size_t idx = 0; idx < tracks.size(); ++idx) {
+    const TrackResult &result = results[idx];
+    if (!result.replayed) {
+      fprintf(stderr, "%s: %s\n", tracks[idx].c_str(), result.error.c_str());
+      continue;
+    }
+    replayed++;
+    total.bytes += result.bytes;
+    total.lines += result.lines;
+    total.records += result.records;
+    total.timeoutRecords += result.timeoutRecords;
+    for (size_t chain = 0; chain < options.chains.size(); ++chain) {
+      total.chains[chain].add(result.chains[chain]);
+    }
+  }
+
+  printf("tracks:                    %zu of %zu\n", replayed, tracks.size());
+  printf("lines:                     %llu\n", (unsigned long long) total.lines);
+  printf("records:                   %llu, %llu timeouts\n",
+         (unsigned long long) total.records, (unsigned long long) total.timeoutRecords);
+  printf("replay:                    %.3fs with %u threads, %.0f records/s, %.1f MiB/s\n",
+         seconds, options.threads, total.records / seconds, total.bytes / seconds / 1048576.0);
+  for (size_t chain = 0; chain < options.chains.size(); ++chain) {
+    const ChainResult &result = total.chains[chain];
+    const uint64_t different = result.compared - result.equal - result.replayedOnly - result.recordedOnly;
+    printf("chain %-10s           %llu of %llu values as recorded, %llu new, %llu missing, "
+           "%llu different by %.1fcm on average\n",
+           options.chains[chain]->name,
+           (unsigned long long) result.equal, (unsigned long long) result.compared,
+           (unsigned long long) result.replayedOnly, (unsigned long long) result.recordedOnly,
+           (unsigned long long) different,
+           different ? (double) result.absoluteDifference / different : 0.0);
+  }
+  return replayed > 0 ? 0 : 1;
+}